@@ -4,6 +4,7 @@ CXXFLAGS = -std=c++11 -Wall -Wextra -pedantic -g # デバッグ情報を含め
 
 # --- ディレクトリ定義 ---
 SRC_DIR = src
+TOOLS_DIR = tools
 OBJ_DIR = obj
 BIN_DIR = bin
 INC_DIR = include # プロジェクト自身のインクルードディレクトリ
@@ -19,9 +20,13 @@ GSTREAMER_LIBS = $(shell pkg-config --libs gstreamer-1.0)
 CXXFLAGS += $(GSTREAMER_CFLAGS) # GStreamer のコンパイルフラグを追加
 
 # pkg-configが成功したかチェック
+# (GStreamer を使わないターゲットだけをビルドする場合はチェックしない)
+GST_FREE_GOALS = replay inversion-eval bench param-check state sync-client clean protect unprotect
+ifneq ($(filter-out $(GST_FREE_GOALS),$(or $(MAKECMDGOALS),all)),)
 ifeq ($(GSTREAMER_CFLAGS),)
     $(error "pkg-config could not find gstreamer-1.0. Make sure it is installed and PKG_CONFIG_PATH is set.")
 endif
+endif
 
 # --- インクルードディレクトリ ---
 # プロジェクトのインクルードディレクトリと外部ライブラリのインクルードディレクトリを追加
@@ -33,7 +38,7 @@ LDFLAGS = -L$(NAVIGATOR_LIB_PATH) \
 
 # --- リンクするライブラリ ---
 # コマンドで指定された特定のライブラリ名を使用
-LIBS = -lbluerobotics_navigator -lpthread -lm
+LIBS = -lbluerobotics_navigator -lpthread -lm -lrt # -lrt: shm_open (古い glibc 用)
 LIBS += $(GSTREAMER_LIBS) # GStreamer のリンクライブラリを追加
 
 # --- ターゲット実行ファイル ---
@@ -46,9 +51,99 @@ SRCS = $(wildcard $(SRC_DIR)/*.cpp)
 # ソースファイル名に基づいて OBJ_DIR 内のオブジェクトファイル名を生成
 OBJS = $(patsubst $(SRC_DIR)/%.cpp,$(OBJ_DIR)/%.o,$(SRCS))
 
+# --- リプレイツール (フライトレコーダーの記録を制御コードに流して出力を比較する) ---
+# ハードウェアライブラリの代わりに tools/sim_hardware.cpp をリンクする (navigator-lib のヘッダーのみ使用)
+REPLAY_TARGET = $(BIN_DIR)/flight_replay
+REPLAY_EXCLUDED_SRCS = main.cpp gstPipeline.cpp config_synchronizer.cpp network.cpp sensor_data.cpp flight_recorder.cpp metrics.cpp live_state.cpp config_reloader.cpp param_protocol.cpp video_bitrate.cpp
+REPLAY_SRCS = $(filter-out $(addprefix $(SRC_DIR)/,$(REPLAY_EXCLUDED_SRCS)),$(SRCS))
+REPLAY_OBJS = $(patsubst $(SRC_DIR)/%.cpp,$(OBJ_DIR)/%.o,$(REPLAY_SRCS)) \
+              $(OBJ_DIR)/$(TOOLS_DIR)/flight_replay.o $(OBJ_DIR)/$(TOOLS_DIR)/sim_hardware.o
+
+# --- 反転検出の評価 (記録した加速度を反転検出器に流し、検出の遅れと誤検出を数える) ---
+# INVERSION_EVAL_ARGS に記録ファイルを指定する。既定では合成した記録を obj/ に書き出して評価する
+#   例: make -f Makefile.mk inversion-eval INVERSION_EVAL_ARGS="recordings/flight_*.rec"
+INVERSION_EVAL_TARGET = $(BIN_DIR)/inversion_eval
+INVERSION_EVAL_ARGS = --synth $(OBJ_DIR)/inversion_traces
+INVERSION_EVAL_OBJS = $(patsubst $(SRC_DIR)/%.cpp,$(OBJ_DIR)/%.o,$(REPLAY_SRCS)) \
+                      $(OBJ_DIR)/$(TOOLS_DIR)/inversion_eval.o $(OBJ_DIR)/$(TOOLS_DIR)/sim_hardware.o
+
+# --- マイクロベンチマーク (制御ループのホットパスを tools/sim_hardware.cpp 上で計測する) ---
+# 結果は BENCH_OUTPUT に JSON で書き出す。BENCH_ARGS で計測時間や対象を指定できる
+#   例: make -f Makefile.mk bench BENCH_ARGS="--min-time 2 network/"
+BENCH_TARGET = $(BIN_DIR)/bench
+BENCH_OUTPUT = bench_output.txt
+BENCH_ARGS =
+BENCH_EXCLUDED_SRCS = main.cpp gstPipeline.cpp config_synchronizer.cpp live_state.cpp param_protocol.cpp
+BENCH_SRCS = $(filter-out $(addprefix $(SRC_DIR)/,$(BENCH_EXCLUDED_SRCS)),$(SRCS))
+BENCH_OBJS = $(patsubst $(SRC_DIR)/%.cpp,$(OBJ_DIR)/%.o,$(BENCH_SRCS)) \
+             $(OBJ_DIR)/$(TOOLS_DIR)/bench.o $(OBJ_DIR)/$(TOOLS_DIR)/sim_hardware.o
+
+# --- パラメータ要求の確認 (param:set が nan や範囲外の値を拒否し、live の変更が保存されないことを確かめる) ---
+# 設定同期が不正な項目を拒否することは config_sync_client を実行して確かめる (同じ BIN_DIR にビルドする)
+# ハードウェアライブラリの代わりに tools/sim_hardware.cpp をリンクする (設定同期はループバックのポートで動かす)
+PARAM_CHECK_TARGET = $(BIN_DIR)/param_check
+PARAM_CHECK_EXCLUDED_SRCS = main.cpp gstPipeline.cpp
+PARAM_CHECK_SRCS = $(filter-out $(addprefix $(SRC_DIR)/,$(PARAM_CHECK_EXCLUDED_SRCS)),$(SRCS))
+PARAM_CHECK_OBJS = $(patsubst $(SRC_DIR)/%.cpp,$(OBJ_DIR)/%.o,$(PARAM_CHECK_SRCS)) \
+                   $(OBJ_DIR)/$(TOOLS_DIR)/param_check.o $(OBJ_DIR)/$(TOOLS_DIR)/sim_hardware.o
+
+# --- 稼働状態の読み出しツール (制御プロセスが公開する共有メモリを読む) ---
+STATE_TARGET = $(BIN_DIR)/rov_state
+STATE_OBJS = $(OBJ_DIR)/$(TOOLS_DIR)/rov_state.o
+
+# --- 設定同期のクライアント (地上局の代わりに設定同期サーバーへ接続する) ---
+SYNC_CLIENT_TARGET = $(BIN_DIR)/config_sync_client
+SYNC_CLIENT_OBJS = $(OBJ_DIR)/$(TOOLS_DIR)/config_sync_client.o $(OBJ_DIR)/config_session.o
+
 # --- デフォルトターゲット: 実行ファイルをビルド ---
 all: $(TARGET)
 
+# --- リプレイツールをビルド ---
+replay: $(REPLAY_TARGET)
+
+$(REPLAY_TARGET): $(REPLAY_OBJS) | $(BIN_DIR)
+	$(CXX) $^ -o $@ -lpthread -lm
+	@echo "Build complete: $(REPLAY_TARGET)"
+
+# --- 反転検出の評価をビルドして実行 ---
+inversion-eval: $(INVERSION_EVAL_TARGET)
+	./$(INVERSION_EVAL_TARGET) $(INVERSION_EVAL_ARGS)
+
+$(INVERSION_EVAL_TARGET): $(INVERSION_EVAL_OBJS) | $(BIN_DIR)
+	$(CXX) $^ -o $@ -lpthread -lm
+	@echo "Build complete: $(INVERSION_EVAL_TARGET)"
+
+# --- パラメータ要求の確認をビルドして実行 ---
+param-check: $(PARAM_CHECK_TARGET) $(SYNC_CLIENT_TARGET)
+	./$(PARAM_CHECK_TARGET)
+
+$(PARAM_CHECK_TARGET): $(PARAM_CHECK_OBJS) | $(BIN_DIR)
+	$(CXX) $^ -o $@ -lpthread -lm -lrt
+	@echo "Build complete: $(PARAM_CHECK_TARGET)"
+
+# --- 稼働状態の読み出しツールをビルド ---
+state: $(STATE_TARGET)
+
+$(STATE_TARGET): $(STATE_OBJS) | $(BIN_DIR)
+	$(CXX) $^ -o $@ -lrt
+	@echo "Build complete: $(STATE_TARGET)"
+
+# --- 設定同期のクライアントをビルド ---
+sync-client: $(SYNC_CLIENT_TARGET)
+
+$(SYNC_CLIENT_TARGET): $(SYNC_CLIENT_OBJS) | $(BIN_DIR)
+	$(CXX) $^ -o $@
+	@echo "Build complete: $(SYNC_CLIENT_TARGET)"
+
+# --- ベンチマークをビルドして実行 ---
+bench: $(BENCH_TARGET)
+	./$(BENCH_TARGET) --out $(BENCH_OUTPUT) $(BENCH_ARGS)
+	@echo "Benchmark results: $(BENCH_OUTPUT)"
+
+$(BENCH_TARGET): $(BENCH_OBJS) | $(BIN_DIR)
+	$(CXX) $^ -o $@ -lpthread -lm
+	@echo "Build complete: $(BENCH_TARGET)"
+
 # --- 実行ファイルをリンクするルール ---
 $(TARGET): $(OBJS) | $(BIN_DIR) # リンク前に BIN_DIR が存在することを確認
 	$(CXX) $(LDFLAGS) $^ -o $@ $(LIBS)
@@ -59,6 +154,11 @@ $(TARGET): $(OBJS) | $(BIN_DIR) # リンク前に BIN_DIR が存在すること
 $(OBJ_DIR)/%.o: $(SRC_DIR)/%.cpp | $(OBJ_DIR) # コンパイル前に OBJ_DIR が存在することを確認
 	$(CXX) $(CXXFLAGS) $(INCLUDES) -c $< -o $@
 
+# tools/ の .cpp ファイルを OBJ_DIR/tools の .o ファイルにコンパイル
+$(OBJ_DIR)/$(TOOLS_DIR)/%.o: $(TOOLS_DIR)/%.cpp | $(OBJ_DIR)
+	@mkdir -p $(dir $@)
+	$(CXX) $(CXXFLAGS) $(INCLUDES) -I$(TOOLS_DIR) -c $< -o $@
+
 # --- ディレクトリ作成 ---
 # これらのターゲットは、ディレクトリが存在しない場合に作成します
 # これらは、順序のみの依存関係 (|) を使用するコンパイルおよびリンクルールの前提条件です
@@ -75,10 +175,10 @@ clean:
 	@echo "Cleaned."
 
 # --- Phony ターゲット (ファイルを表さないターゲット) ---
-.PHONY: all clean protect unprotect release $(OBJ_DIR) $(BIN_DIR)
+.PHONY: all replay inversion-eval bench param-check state sync-client clean protect unprotect release $(OBJ_DIR) $(BIN_DIR)
 
 # --- 中間ファイルが削除されるのを防ぐ ---
-.SECONDARY: $(OBJS)
+.SECONDARY: $(OBJS) $(REPLAY_OBJS) $(INVERSION_EVAL_OBJS) $(BENCH_OBJS) $(PARAM_CHECK_OBJS) $(STATE_OBJS) $(SYNC_CLIENT_OBJS)
 
 # --- ソースコード保護: オーナー以外は読み書き不可 ---
 # ディレクトリ: rwx------  ファイル: rw-------
@@ -0,0 +1,26 @@
+#ifndef ATTITUDE_ESTIMATOR_H // インクルードガード
+#define ATTITUDE_ESTIMATOR_H
+
+#include "bindings.h" // AxisData 構造体を使用するため
+
+// 姿勢推定 (AHRS) の出力を保持する構造体
+struct AttitudeEstimate {
+  float q[4];          // 姿勢クォータニオン (w, x, y, z)
+  float roll_deg;      // ロール角 (deg)
+  float pitch_deg;     // ピッチ角 (deg)
+  float yaw_deg;       // ヨー角 / 方位 (deg, -180 ~ 180)
+  float gyro_bias[3];  // 推定ジャイロバイアス (rad/s, X, Y, Z)
+  bool valid;          // 初回の加速度サンプルで初期化済みかどうか
+};
+
+// --- 関数のプロトタイプ宣言 ---
+// 推定器の状態をリセットする (次の更新で加速度/磁気から姿勢を初期化する)
+void attitude_init();
+// IMU サンプル1回分で姿勢を更新する (Madgwick MARG フィルタ + ジャイロバイアス推定)
+// gyro は read_gyro() の生値、dt_s は前回更新からの経過時間 (秒)
+void attitude_update(const AxisData &accel, const AxisData &gyro,
+                     const AxisData &mag, float dt_s);
+// 最新の姿勢推定値を取得する (メインスレッドからのみ呼び出すこと)
+const AttitudeEstimate &attitude_get();
+
+#endif // ATTITUDE_ESTIMATOR_H
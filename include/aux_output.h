@@ -0,0 +1,27 @@
+#ifndef AUX_OUTPUT_H // インクルードガード
+#define AUX_OUTPUT_H
+
+#include "config.h" // CONFIG_MAX_AUX_OUTPUTS のため
+#include <stdint.h> // uint16_t のため
+#include <string>   // std::string を使用するため
+
+// 補助出力 (LED, グリッパー等) は g_config.aux_outputs の表で定義される。
+// 出力を追加する場合はコードではなく設定ファイルに [AUX_n] セクションを追加する。
+
+// --- 関数のプロトタイプ宣言 ---
+// 保存された段階があれば復元し、すべての補助出力に現在の段階の PWM を出力する
+void aux_output_init();
+// 制御周期ごとに呼び出す。押されたボタンに対応する出力の段階を進め、値が変わった出力だけを書き込む
+void aux_output_update(uint16_t buttons);
+// すべての補助出力を段階 0 (OFF) の PWM にする (段階自体は保持する)
+void aux_output_disable();
+// 補助出力の状態を文字列として取得する (同期用)
+// フォーマット: led_status:led=pwm_off,led2=pwm_on1,...
+std::string aux_output_state_string();
+// 補助出力の段階をファイルに保存する (フェイルセーフ/再起動時の状態保持用)
+void aux_output_save_state_to_file();
+// 現在の段階を取得する / 設定して出力し直す (フライトレコーダーとリプレイ用)
+void aux_output_get_levels(uint8_t levels[CONFIG_MAX_AUX_OUTPUTS]);
+void aux_output_set_levels(const uint8_t levels[CONFIG_MAX_AUX_OUTPUTS]);
+
+#endif // AUX_OUTPUT_H
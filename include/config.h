@@ -6,6 +6,52 @@
 #include <iostream>
 #include <mutex> // std::mutex をインクルード
 
+// 推力曲線を個別に設定できるスラスターのチャンネル数 (thruster_control.h の NUM_THRUSTERS と同じ値)
+#define CONFIG_THRUSTER_CHANNELS 6
+
+// 補助出力 (LED, グリッパー等) の最大数と、1出力あたりの最大段階数
+#define CONFIG_MAX_AUX_OUTPUTS 8
+#define CONFIG_MAX_AUX_LEVELS 8
+
+// 補助出力1つ分の設定。ボタンを押すたびに levels[0] -> levels[1] -> ... -> levels[0] と進む
+struct AuxOutputConfig {
+    std::string name;                   // 状態同期で使う名前 (led, led2, ...)
+    int channel;                        // PWM チャンネル番号 (-1 で未使用)
+    int button_mask;                    // 段階を進めるボタン (GamepadButton のビットマスク)
+    int level_count;                    // 段階数 (2 ~ CONFIG_MAX_AUX_LEVELS)
+    int levels[CONFIG_MAX_AUX_LEVELS];  // 各段階の PWM 値 (levels[0] が OFF)
+};
+
+// カメラの最大数 ([CAMERA_1] ~ [CAMERA_4]。従来の [GSTREAMER_CAMERA_n] は別名)
+#define CONFIG_MAX_CAMERAS 4
+
+// カメラ1台分の映像配信の設定。DEVICE が空のカメラは使わない
+struct CameraConfig {
+    std::string device;            // カメラデバイスのパス (空なら未使用)
+    int port;                      // 映像の送信先の UDP ポート
+    int width;
+    int height;
+    int framerate_num;
+    int framerate_den;
+    bool is_h264_native_source;    // true: カメラの H.264 をそのまま送る, false: x264enc でエンコードする
+    int rtp_payload_type;
+    int rtp_config_interval;
+    bool low_latency;              // 遅延を優先する (古いフレームを捨てるキュー、udpsink の sync=false など)
+    int key_int_max;               // キーフレームの最大間隔 (フレーム数、0: エンコーダーの既定)
+    int x264_bitrate;              // エンコードする場合のビットレート (kbps)。H.264 カメラでは自動調整の上限
+    // 以下はエンコードする場合のみ使用
+    std::string x264_tune;
+    std::string x264_speed_preset;
+    int x264_slices;               // 1フレームのスライス数 (0: x264 の既定)
+};
+
+// 機体の反転を検出したときの対応
+enum class InversionResponse {
+    NEUTRAL, // 反転中はスラスターを停止し、復帰したら操縦を再開する
+    ALERT,   // 操縦PCへの警告のみ
+    RESTART  // LED状態を保存してプロセスを終了し、systemd に再起動させる
+};
+
 // 設定値を保持する構造体
 struct AppConfig {
     // PWM設定
@@ -18,38 +64,8 @@ struct AppConfig {
     // ジョイスティック設定
     int joystick_deadzone;
 
-    // LED設定
-    int led_pwm_channel;
-    int led_pwm_on;
-    int led_pwm_off;
-
-    // LED 2 (Bボタン) 設定
-    int led2_pwm_channel;
-    int led2_pwm_off;
-    int led2_pwm_on1;
-    int led2_pwm_on2;
-    int led2_pwm_max;
-
-    // LED 3 (Xボタン) 設定
-    int led3_pwm_channel;
-    int led3_pwm_off;
-    int led3_pwm_on1;
-    int led3_pwm_on2;
-    int led3_pwm_max;
-
-    // LED 4 (Aボタン) 設定
-    int led4_pwm_channel;
-    int led4_pwm_off;
-    int led4_pwm_on1;
-    int led4_pwm_on2;
-    int led4_pwm_max;
-
-    // LED 5 (RBボタン) 設定
-    int led5_pwm_channel;
-    int led5_pwm_off;
-    int led5_pwm_on1;
-    int led5_pwm_on2;
-    int led5_pwm_max;
+    // 補助出力 (LED, グリッパー等) 設定。[LED]/[LED2]~[LED5] または [AUX_n] から読み込む
+    AuxOutputConfig aux_outputs[CONFIG_MAX_AUX_OUTPUTS];
 
     // スラスター制御設定 (平滑化、ジャイロ補正)
     float smoothing_factor_horizontal;
@@ -59,6 +75,86 @@ struct AppConfig {
     float yaw_threshold_dps;
     float yaw_gain;
 
+    // 姿勢推定 (AHRS) 設定
+    float ahrs_beta;        // Madgwick フィルタの補正ゲイン
+    float ahrs_zeta;        // ジャイロバイアス推定ゲイン
+    float ahrs_gyro_scale;  // read_gyro() の値を rad/s に変換する係数
+    bool ahrs_use_mag;      // 磁気センサーを方位補正に使用するか
+
+    // 深度保持設定
+    int depth_hold_button;            // モード切替ボタン (GamepadButton のビットマスク)
+    float depth_water_density;        // 水の密度 (kg/m^3)
+    float depth_pressure_to_pa;       // read_pressure() の値を Pa に変換する係数
+    float depth_surface_pressure_pa;  // 水面気圧 (Pa)。0 以下なら起動時に自動計測
+    int depth_calibration_samples;    // 自動計測に使うサンプル数
+    float depth_filter_alpha;         // 深度ローパスフィルタ係数 (0~1)
+    float depth_kp;                   // 比例ゲイン (PWM/m)
+    float depth_ki;                   // 積分ゲイン (PWM/(m*s))
+    float depth_kd;                   // 微分ゲイン (PWM/(m/s))
+    float depth_integral_limit;       // 積分項の上限 (m*s)
+    int depth_max_output;             // 制御出力の上限 (pwm_min からの加算量)
+    int depth_output_sign;            // 1: 推力で潜航する機体, -1: 推力で浮上する機体
+
+    // 方位保持設定
+    bool heading_hold_enabled;          // false の場合は従来のヨーレートしきい値制御を使用
+    float heading_hold_kp;              // 方位誤差に対する比例ゲイン (PWM/deg)
+    float heading_hold_kd;              // ヨーレートに対する微分ゲイン (PWM/(deg/s))
+    int heading_hold_max_output;        // 補正量の上限 (PWM)
+    float heading_hold_rate_limit;      // 補正量の変化速度の上限 (PWM/s)
+    float heading_hold_latch_rate_dps;  // このヨーレート未満になったら方位をラッチする
+
+    // 推力曲線設定
+    bool thrust_curve_enabled;       // 推力曲線による PWM の線形化を行うか
+    std::string thrust_curve_csv;    // 全チャンネル共通の推力曲線 CSV (pwm_us,thrust_N)
+    std::string thrust_curve_channel_csv[CONFIG_THRUSTER_CHANNELS]; // チャンネル個別の CSV (空なら共通)
+
+    // 電力制限設定
+    bool power_limit_enabled;              // 推定電流が予算を超えたら推力をスケールするか
+    float power_budget_a;                  // 電流予算 (A)
+    float power_thruster_full_current_a;   // スラスター1基の最大指令時の電流 (A)
+    float power_current_exponent;          // 電流モデルの指数 (電流 ∝ 指令率^指数)
+    float power_base_current_a;            // スラスター以外の消費電流 (A)
+    int power_voltage_adc_channel;         // バッテリー電圧の ADC チャンネル (-1 で無効)
+    float power_voltage_scale;             // ADC 値 -> 電圧 (V) の係数
+    int power_current_adc_channel;         // 電流センサーの ADC チャンネル (-1 で無効)
+    float power_current_scale;             // ADC 値 -> 電流 (A) の係数
+    float power_current_offset;            // 電流センサーのゼロ点 (ADC 値)
+    float power_low_voltage_v;             // この電圧を下回ると予算を縮小する (V)
+    float power_cutoff_voltage_v;          // 予算が最小 (25%) になる電圧 (V)
+
+    // 反転検出設定
+    InversionResponse inversion_response;  // 反転を検出したときの対応
+    float inversion_filter_tau_s;          // 重力方向ローパスフィルタの時定数 (秒)
+    float inversion_enter_angle_deg;       // この傾きを超えたら反転とみなす (deg)
+    float inversion_exit_angle_deg;        // この傾きを下回ったら復帰とみなす (deg)
+    float inversion_dwell_s;               // 状態を切り替えるのに必要な継続時間 (秒)
+    int inversion_calibration_samples;     // 基準の重力方向を決めるサンプル数
+    float inversion_spike_ratio;           // 大きさが基準のこの倍率を超える/下回るサンプルは破棄
+    int inversion_reference_z_sign;        // 基準の重力方向 (0: 起動時の姿勢, 1: +Z, -1: -Z)
+
+    // フライトレコーダー設定
+    bool recorder_enabled;           // 制御周期ごとの入出力をファイルに記録するか
+    std::string recorder_directory;  // 記録ファイルの出力先ディレクトリ
+    int recorder_buffer_kb;          // 書き込みスレッドへ渡すリングバッファの容量 (KiB)
+    int recorder_max_file_mb;        // 記録ファイルの上限サイズ (MiB, 0 で無制限)
+
+    // 周期内の処理時間のトレース設定
+    bool trace_enabled;              // トレースポイントで時刻を記録するか (実行中に切り替え可能)
+    int trace_buffer_events;         // スレッドごとのリングバッファに保持するイベント数
+    std::string trace_directory;     // SIGUSR1 で書き出すトレースファイル (Chrome trace JSON) の出力先
+
+    // 遅延ヒストグラム設定
+    float latency_window_s;          // パーセンタイルを集計してテレメトリに載せる期間 (秒)
+
+    // 監視用エンドポイント (Prometheus テキスト形式) 設定
+    bool metrics_enabled;            // HTTP エンドポイントを起動するか
+    std::string metrics_bind;        // 待ち受けるアドレス (127.0.0.1 でローカルのみ)
+    int metrics_port;                // 待ち受けるTCPポート
+
+    // 稼働状態の共有メモリ公開設定
+    bool live_state_enabled;         // 周期ごとの状態を共有メモリに公開するか
+    std::string live_state_shm_name; // shm_open に渡す名前 (/ で始める)
+
     // ネットワーク設定
     int network_recv_port;
     int network_send_port;
@@ -69,35 +165,22 @@ struct AppConfig {
     unsigned int sensor_send_interval;
     unsigned int loop_delay_us; // usleep の引数
 
-    // GStreamer カメラ1設定
-    std::string gst1_device;
-    int gst1_port;
-    int gst1_width;
-    int gst1_height;
-    int gst1_framerate_num;
-    int gst1_framerate_den;
-    bool gst1_is_h264_native_source;
-    int gst1_rtp_payload_type;
-    int gst1_rtp_config_interval;
-
-    // GStreamer カメラ2設定
-    std::string gst2_device;
-    int gst2_port;
-    int gst2_width;
-    int gst2_height;
-    int gst2_framerate_num;
-    int gst2_framerate_den;
-    bool gst2_is_h264_native_source;
-    int gst2_rtp_payload_type;
-    int gst2_rtp_config_interval;
-    int gst2_x264_bitrate;
-    std::string gst2_x264_tune;
-    std::string gst2_x264_speed_preset;
+    // カメラ (映像の送信先のホストは NETWORK の client_host)
+    CameraConfig cameras[CONFIG_MAX_CAMERAS];
+
+    // 映像のビットレートの自動調整 (操縦パケットの届き方から回線の混雑を判断し、操縦を優先する)
+    bool video_bitrate_adaptive;
+    int video_bitrate_min_kbps;       // 混雑時に下げる下限 (カメラごと)
+    int video_bitrate_max_kbps;       // 回復時に上げる上限 (カメラごと。各カメラの X264_BITRATE も超えない)
+    int video_bitrate_control_gap_ms; // 操縦パケットの間隔がこれを超えたら混雑とみなす
 
     // Config Synchronizer settings
     int config_sync_cpp_recv_port;
     std::string config_sync_wpf_host;
     int config_sync_wpf_recv_port;
+    bool config_watch_file;        // config.ini の直接の編集を inotify で検知してリロードする
+    int config_watch_debounce_ms;  // 最後の書き込みからリロードまで待つ時間 (ミリ秒)
+    unsigned int config_generation; // 設定ファイルの世代 (機体が保存するたびに1増える。テレメトリの CFG_GEN)
 
     // デフォルト値を設定するコンストラクタ
     AppConfig(); // 実装は config.cpp に記述
@@ -108,7 +191,18 @@ extern AppConfig g_config;
 // g_config を保護するためのグローバルミューテックス
 extern std::mutex g_config_mutex;
 
-// 設定ファイルを読み込む関数
+// 設定ファイルを読み込み、g_config に適用する関数 (起動時とツール用)
 bool loadConfig(const std::string& filename);
+// 設定を out にパースして検証する (g_config は変更しない。filename はエラー表示用)
+bool parseConfig(std::istream& input, const std::string& filename, AppConfig& out);
+// 起動時の読み込み。成功したら内容を控え (config_last_good_path) に残し、失敗したら控えから
+// 設定ファイルを復元して読み込む (壊れたファイルは "<filename>.broken" に退避する)
+bool loadConfigWithFallback(const std::string& filename);
+
+// ファイルを一時ファイルへの書き込み + fsync + rename で置き換える。
+// 書き込みの途中で電源が切れても、古い内容か新しい内容のどちらかが必ず残る
+bool config_write_file_atomic(const std::string& path, const std::string& contents);
+// 最後に検証に通った設定ファイルの控えのパス ("<path>.last-good")
+std::string config_last_good_path(const std::string& path);
 
 #endif // CONFIG_H
\ No newline at end of file
@@ -0,0 +1,79 @@
+#ifndef CONFIG_RELOADER_H
+#define CONFIG_RELOADER_H
+
+#include "config.h"
+#include "config_schema.h"
+#include "thrust_curve.h"
+#include <atomic>
+#include <stdint.h>
+#include <string>
+#include <thread>
+
+// リロードで読み込んだ設定一式。専用スレッドで構築し、制御スレッドが周期の境界で適用する。
+struct ConfigSnapshot {
+    AppConfig config;                 // パースと検証が済んだ設定
+    ThrustCurveTables* thrust_curve;  // 構築済みの推力曲線テーブル (無効なら nullptr)
+    bool thrust_curve_ok;             // false: 構築に失敗したので以前のテーブルを使い続ける
+    std::string contents;             // 設定ファイルの全文 (フライトレコーダー用)
+    unsigned changes;                 // 変更を反映する担当 (CONFIG_APPLY_BIT の組み合わせ)
+};
+
+// リロード用スレッドで反映する担当の処理 (カメラのパイプラインなど)。
+// config は適用後の設定、previous は適用前の設定。成功したら true を返す
+typedef bool (*ConfigApplyHandler)(const AppConfig& config, const AppConfig& previous);
+
+// g_config_updated_flag と設定ファイルの変更 (inotify) を監視し、設定ファイルの読み込み・パース・検証・推力曲線の構築を
+// 専用スレッドで行う。制御スレッドは apply_pending() で g_config と推力曲線を交換するだけで、
+// ファイル I/O もメモリの確保・解放も行わない。変更された項目は担当ごとに振り分け、
+// 制御スレッドの担当 (ネットワークなど) は apply_pending() の戻り値で、それ以外は
+// set_handler() で登録した処理で、適用後にリロード用スレッドが反映する。
+class ConfigReloader {
+public:
+    ConfigReloader(const std::string& config_path);
+    ~ConfigReloader();
+
+    // リロード用スレッドで反映する担当の処理を登録する (start() の前に呼ぶ)
+    void set_handler(ConfigApplyTarget target, ConfigApplyHandler handler);
+    void start();
+    void stop();
+
+    // 制御スレッドから周期の最初に呼ぶ。適用待ちの設定があれば交換し、変更された担当
+    // (CONFIG_APPLY_BIT の組み合わせ) を返す。適用しなかった場合は 0
+    unsigned apply_pending();
+    // 設定ファイルを読み込んで適用待ちにする (通常はリロード用スレッドが呼ぶ。ベンチマーク用に公開)
+    void reload();
+
+private:
+    void run();
+    bool read_config_file(std::string& contents);
+    // 読み込んだ内容をパース・検証して適用待ちにする (start_ns は読み込みを始めた時刻)
+    void load(const std::string& contents, int64_t start_ns);
+    // 設定ファイルのあるディレクトリを inotify で監視する ([CONFIG_SYNC] WATCH_FILE)
+    void open_watch();
+    void close_watch();
+    // inotify のイベントを読み、設定ファイルが書き換えられていれば m_watch_event_ns を更新する
+    void read_watch_events();
+    // 直接の編集を検知したときのリロード。前回読み込んだ内容と同じなら何もしない
+    void reload_if_changed();
+    // 制御スレッドが適用を終えた古い設定を受け取り、登録された担当の処理を行ってから解放する
+    void collect_retired();
+    static void free_snapshot(ConfigSnapshot* snapshot);
+
+    std::string m_config_path;
+    std::thread m_thread;
+    std::atomic<bool> m_shutdown_flag;
+    AppConfig m_base;                        // 適用待ちをすべて適用した後の設定 (差分の基準。リロード用スレッドのみ)
+    ConfigApplyHandler m_handlers[CONFIG_APPLY_TARGET_COUNT];
+    std::atomic<ConfigSnapshot*> m_pending;  // 適用待ち (リロード用スレッド -> 制御スレッド)
+    std::atomic<ConfigSnapshot*> m_retired;  // 適用後の古い設定 (制御スレッド -> リロード用スレッド)
+    std::string m_loaded_contents;           // 最後に読み込んだ設定ファイルの内容 (リロード用スレッドのみ)
+    int m_watch_fd;                          // inotify (監視しない場合は -1)
+    std::string m_watch_name;                // 監視するディレクトリ内の設定ファイルの名前
+    int64_t m_watch_debounce_ns;
+    int64_t m_watch_event_ns;                // 最後に書き換えを検知した時刻 (0: 検知していない)
+};
+
+// 担当ごとの反映にかかった時間を監視用カウンタに記録する
+void config_record_apply(ConfigApplyTarget target, int64_t elapsed_ns);
+
+#endif // CONFIG_RELOADER_H
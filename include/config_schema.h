@@ -0,0 +1,85 @@
+#ifndef CONFIG_SCHEMA_H
+#define CONFIG_SCHEMA_H
+
+#include "config.h"
+#include "ini_document.h"
+#include <string>
+#include <vector>
+
+// config.ini の1項目の型
+enum ConfigFieldType {
+    CONFIG_INT,
+    CONFIG_UINT,
+    CONFIG_FLOAT,
+    CONFIG_DOUBLE,
+    CONFIG_BOOL,               // "true" のみ真
+    CONFIG_STRING,
+    CONFIG_SIGN,               // 負なら -1、それ以外は 1
+    CONFIG_BUTTON,             // "Y", "DPadUp" などのボタン名、または 0x0010 などの数値
+    CONFIG_INVERSION_RESPONSE, // NEUTRAL / ALERT / RESTART
+    CONFIG_AUX_LEVELS,         // "1100,1300,1600" 形式の段階リスト (段階数も設定する)
+    CONFIG_AUX_LEVEL           // 従来の [LED] 形式の段階1つ分 (OFF_VALUE など。差分の対象外)
+};
+
+// 変更を反映する担当。変更された項目はこの単位で振り分け、担当ごとに必要な処理だけを行う
+enum ConfigApplyTarget {
+    CONFIG_APPLY_CONTROL,      // 制御スレッドが毎周期参照する (交換した次の周期から反映)
+    CONFIG_APPLY_PWM,          // PWM 周波数 (制御スレッドで再設定)
+    CONFIG_APPLY_NETWORK,      // 操縦用の UDP ソケット (制御スレッドで再バインド)
+    CONFIG_APPLY_CAMERA,       // カメラのパイプライン (リロード用スレッドで、変わったカメラだけを再構成)
+    CONFIG_APPLY_RESTART,      // 起動時にのみ参照する (再起動後に反映)
+    CONFIG_APPLY_TARGET_COUNT
+};
+#define CONFIG_APPLY_BIT(target) (1u << (target))
+
+// 設定項目の定義。パース・範囲の検証・文字列化・差分の検出はすべてこの表に従う。
+// 既定値は AppConfig のコンストラクタの値 (既定値を1か所で管理するため表には持たない)。
+struct ConfigField {
+    const char* section;     // config.ini のセクション名 (補助出力は AUX_n、カメラは CAMERA_n。[LED]/[LEDn]、[GSTREAMER_CAMERA_n] は別名)
+    const char* key;         // config.ini のキー
+    ConfigFieldType type;
+    double min;              // 数値型の許容範囲 (両端を含む)
+    double max;
+    void* (*member)(AppConfig& config, int index); // AppConfig 内の格納先
+    int index;               // 配列の要素番号 (補助出力、カメラ、推力曲線のチャンネル)
+    int arg;                 // CONFIG_AUX_LEVEL の段階番号 (-1: 最後の段階)
+    unsigned apply;          // 変更を反映する担当 (CONFIG_APPLY_BIT の組み合わせ)
+};
+
+// --- 関数のプロトタイプ宣言 ---
+// すべての設定項目 (config.ini のセクション順)
+const std::vector<ConfigField>& config_schema();
+// セクションとキーから項目を探す (大文字・小文字は区別しない)。無ければ nullptr
+const ConfigField* config_find_field(const std::string& section, const std::string& key);
+// 項目の名前 ("[SECTION] KEY" 形式、ログ用)
+std::string config_field_name(const ConfigField& field);
+// value を型と範囲に従って検証し、config に格納する。失敗した場合は error に理由を入れて false を返す
+bool config_set_field(const ConfigField& field, const std::string& value, AppConfig& config,
+                      std::string& error);
+// config の値を config.ini の表記で返す
+std::string config_format_field(const ConfigField& field, const AppConfig& config);
+// a と b で値が異なる項目の一覧 (CONFIG_AUX_LEVEL などの別名は含まない)
+std::vector<const ConfigField*> config_diff(const AppConfig& a, const AppConfig& b);
+// 項目の一覧から、変更を反映する担当をまとめる (CONFIG_APPLY_BIT の組み合わせ)
+unsigned config_apply_targets(const std::vector<const ConfigField*>& fields);
+// a と b で値が異なる数値・真偽値の項目の担当をまとめる (文字列などは比べない)。
+// メモリを確保しないので、制御スレッドで g_config と交換前後の設定を比べるのに使う
+unsigned config_scalar_apply_targets(const AppConfig& a, const AppConfig& b);
+// 担当の名前 ("control", "network", "camera" など。ログと監視用エンドポイントのラベル用)
+const char* config_apply_target_name(int target);
+
+// 項目間の整合性 (PWM の大小関係、補助出力のチャンネルなど) を検証する。満たしていなければ error に理由を入れる
+bool config_validate(const AppConfig& config, std::string& error);
+
+// ドキュメントの各エントリを1回ずつ表に従って out に格納し、項目間の整合性を検証する。
+// 表に無いキーは無視する (地上局アプリケーション用の項目など)。filename はエラー表示用。
+// 失敗した場合は error (nullptr でなければ) に最初の誤りの内容を入れる
+bool config_from_document(const IniDocument& doc, const std::string& filename, AppConfig& out,
+                          std::string* error = nullptr);
+// 項目を書き込むセクション名 (補助出力とカメラはファイルで使われている [LED] / [LEDn] / [AUX_n]、
+// [GSTREAMER_CAMERA_n] / [CAMERA_n] に合わせる)
+std::string config_document_section(const IniDocument& doc, const ConfigField& field);
+// config のうちドキュメントの内容と異なる項目だけをドキュメントに書き込む (コメントや順序は保持)
+void config_to_document(const AppConfig& config, IniDocument& doc);
+
+#endif // CONFIG_SCHEMA_H
@@ -0,0 +1,59 @@
+#ifndef CONFIG_SESSION_H
+#define CONFIG_SESSION_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// 地上局との設定同期セッションのフレーム形式 (ConfigSynchronizer が使用する)。
+// 地上局は CPP_RECV_PORT に接続して最初に CONFIG_SESSION_MAGIC を送り、以降は接続を保ったまま
+// 次のフレームを双方向に送受信する:
+//   [本体の長さ uint32 (ビッグエンディアン、種別を含む)] [種別 uint8] [本体]
+// 数値はすべてビッグエンディアン。項目は [セクション長 uint8][セクション][キー長 uint8][キー]
+// [値の長さ uint16][値] を件数 (uint16) だけ並べる。
+#define CONFIG_SESSION_MAGIC "RCS1"
+#define CONFIG_SESSION_MAGIC_LEN 4
+#define CONFIG_SESSION_MAX_FRAME (64 * 1024) // これを超える長さのフレームは不正として切断する
+
+enum ConfigFrameType {
+    CONFIG_FRAME_HELLO = 1,    // 地上局 -> 機体: epoch, version (前回の接続で受け取った版。無ければ 0)
+    CONFIG_FRAME_SNAPSHOT = 2, // 機体 -> 地上局: epoch, version, 全項目 (版を引き継げない場合)
+    CONFIG_FRAME_DELTA = 3,    // 双方向: epoch, version, 変更された項目
+                               //   (機体 -> 地上局: 適用後の版、地上局 -> 機体: 基準にした版)
+    CONFIG_FRAME_ACK = 4,      // 機体 -> 地上局: epoch, version (地上局の差分を適用した版)
+    CONFIG_FRAME_ERROR = 5,    // 機体 -> 地上局: message (差分を拒否した理由など)
+    CONFIG_FRAME_PING = 6,     // 双方向: message (相手は同じ本体の PONG を返す)
+    CONFIG_FRAME_PONG = 7
+};
+
+// 設定の1項目 (config.ini の表記のまま)
+struct ConfigEntry {
+    std::string section;
+    std::string key;
+    std::string value;
+};
+
+struct ConfigFrame {
+    int type;                          // ConfigFrameType
+    uint32_t epoch;                    // 版の系列 (プロセスの起動ごとに変わる)
+    uint64_t version;                  // 設定の版 (変更のたびに増える)
+    std::vector<ConfigEntry> entries;  // SNAPSHOT / DELTA の項目
+    std::string message;               // ERROR / PING / PONG の本体
+};
+
+enum ConfigDecodeResult {
+    CONFIG_DECODE_OK,          // 1フレームを取り出した
+    CONFIG_DECODE_INCOMPLETE,  // フレームの途中まで (続きを受信してから再度呼ぶ)
+    CONFIG_DECODE_ERROR        // 不正なフレーム (接続を切断する)
+};
+
+// --- 関数のプロトタイプ宣言 ---
+// frame を out の末尾に追加する
+void config_session_encode(const ConfigFrame& frame, std::string& out);
+// data[0..len) の先頭から1フレームを取り出す。OK の場合は consumed に使用したバイト数を入れる。
+// ERROR の場合は error に理由を入れる
+ConfigDecodeResult config_session_decode(const char* data, size_t len, ConfigFrame& frame,
+                                         size_t& consumed, std::string& error);
+
+#endif // CONFIG_SESSION_H
@@ -1,13 +1,28 @@
 #ifndef CONFIG_SYNCHRONIZER_H
 #define CONFIG_SYNCHRONIZER_H
 
+#include "config.h"
+#include "config_session.h"
+#include "ini_document.h"
+#include <stdint.h>
+#include <deque>
+#include <map>
+#include <mutex>
 #include <string>
 #include <thread>
 #include <atomic>
+#include <vector>
 
 // 設定が更新され、リロードが必要なことを通知するフラグ。
 extern std::atomic<bool> g_config_updated_flag;
+// g_config を変更するたびに増えるカウンタ (ConfigReloader などが増やす)。
+// 設定同期スレッドはこれを見て、機体側での変更を地上局へ送る。
+extern std::atomic<unsigned> g_config_change_count;
 
+// 地上局アプリケーションとの設定の同期。CPP_RECV_PORT で待ち受け、次の2種類の接続を受け付ける:
+//   - セッション (config_session.h): 接続を保ったまま、版番号付きの差分を双方向に送受信する
+//   - 従来形式: "長さ\n" + "[SECTION]KEY=VALUE" の行を1回送り、"OK\n" / "ERROR <理由>\n" を受け取って切断する
+// 接続はすべてノンブロッキングで epoll により多重化し、複数の地上局を同時に扱う。
 class ConfigSynchronizer {
 public:
     ConfigSynchronizer(const std::string& config_path);
@@ -15,21 +30,84 @@ public:
 
     void start();
     void stop();
+    // 項目を config.ini に保存するよう依頼する (どのスレッドからでも呼べる。保存は同期スレッドで行う)
+    void persist(const std::vector<ConfigEntry>& entries);
 
 private:
+    enum ConnectionKind {
+        CONNECTION_UNKNOWN,  // 先頭のバイトを待っている
+        CONNECTION_SESSION,  // CONFIG_SESSION_MAGIC で始まった接続
+        CONNECTION_LEGACY    // 従来形式の1回限りの更新
+    };
+
+    // 地上局との接続1本分の状態
+    struct Connection {
+        int sock;
+        ConnectionKind kind;
+        std::string rx;          // 受信したがまだ処理していないバイト列
+        std::string tx;          // 送信待ちのバイト列
+        bool hello_received;     // セッション: HELLO を受信したか (それまでは差分を送らない)
+        bool close_after_flush;  // 送信待ちを送り終えたら切断する (応答済みの従来形式、ERROR の後)
+        bool dead;               // 切断する (イベント処理の最後にまとめて閉じる)
+        std::string close_reason;
+        int64_t last_rx_ns;      // 最後に受信した時刻 (タイムアウトの判定用)
+        int64_t last_tx_ns;      // 最後に送信した時刻 (ハートビートの判定用)
+        uint32_t epoll_events;   // epoll に登録中のイベント
+    };
+
+    // 版ごとの変更内容 (再接続した地上局に差分だけを送るために保持する)
+    struct ConfigChange {
+        uint64_t version;
+        std::vector<ConfigEntry> entries;
+    };
+
     void run();
     bool load_config();
-    void save_config();
+    bool save_config(const IniDocument& doc, std::string& error);
     std::string serialize_config();
-    void update_config_from_string(const std::string& data);
+    bool update_config_from_string(const std::string& data, std::vector<ConfigEntry>& entries,
+                                   std::string& error);
+    bool apply_remote_entries(const std::vector<ConfigEntry>& entries, std::string& error);
+    void record_change(const std::vector<ConfigEntry>& entries, int origin_sock);
+    void publish_local_changes();
+    void save_persisted();
+    IniDocument disk_document();
+    IniDocument effective_document();
+    void drop_live_entries(const std::vector<ConfigEntry>& entries);
     bool send_config_to_wpf();
-    void handle_client_connection(int client_sock);
     void receive_config_updates();
 
+    void accept_connections(int listen_sock);
+    void read_connection(Connection& conn);
+    void process_session_input(Connection& conn);
+    void process_legacy_input(Connection& conn);
+    void handle_session_frame(Connection& conn, const ConfigFrame& frame);
+    void send_hello_reply(Connection& conn, const ConfigFrame& hello);
+    void send_frame(Connection& conn, const ConfigFrame& frame);
+    void send_error(Connection& conn, const std::string& message);
+    void flush_connection(Connection& conn);
+    void check_timeouts(int64_t now_ns);
+    void update_epoll_events(Connection& conn);
+    void mark_dead(Connection& conn, const std::string& reason);
+    void close_dead_connections();
+    void close_all_connections();
 
     std::string m_config_path;
     std::thread m_thread;
     std::atomic<bool> m_shutdown_flag;
+
+    uint32_t m_epoch;                     // 版の系列 (起動ごとに変わる。再接続時の照合用)
+    uint64_t m_version;                   // 地上局と共有している設定の版
+    std::deque<ConfigChange> m_history;   // 直近の版の変更内容
+    AppConfig m_published;                // 最後に確認した g_config (機体側の変更の検出用)
+    unsigned m_seen_change_count;         // 最後に確認した g_config_change_count
+    std::mutex m_persist_mutex;
+    std::vector<ConfigEntry> m_persist_queue; // persist() で依頼された項目 (m_persist_mutex で保護)
+    // 機体側で変更され、config.ini には保存していない項目 (パラメータ要求の live など)。
+    // 地上局への差分とスナップショットには含めるが、ファイルには書かない (同期スレッドのみが使う)
+    std::vector<ConfigEntry> m_live_entries;
+    int m_epoll_fd;
+    std::map<int, Connection> m_connections; // ソケット -> 接続
 };
 
 #endif // CONFIG_SYNCHRONIZER_H
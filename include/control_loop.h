@@ -0,0 +1,39 @@
+#ifndef CONTROL_LOOP_H // インクルードガード
+#define CONTROL_LOOP_H
+
+#include "bindings.h"           // AxisData 構造体を使用するため
+#include "gamepad.h"            // GamepadData 構造体を使用するため
+#include "inversion_detector.h" // InversionEvent を使用するため
+
+// 制御周期1回分の入力。メインループとリプレイツール (tools/flight_replay.cpp) が
+// 同じ入力から同じ出力を得られるよう、ハードウェアや時刻の読み取りはすべてここに含める。
+struct ControlInputs {
+  const char *packet;   // 今回受信したゲームパッドデータ (無ければ nullptr)
+  int packet_len;       // 受信データの長さ (無ければ 0)
+  AxisData gyro;        // read_gyro() の値
+  AxisData accel;       // read_accel() の値
+  AxisData mag;         // read_mag() の値
+  float pressure;       // read_pressure() の値
+  float adc[4];         // read_adc_all() の値 (電力制限器の電圧・電流)
+  bool adc_valid;       // adc を読み取った周期か (false なら電力制限器の計測値を更新しない)
+  float dt_s;           // 前回の周期からの経過時間 (秒)
+  bool control_enabled; // スラスターを駆動するか (フェイルセーフ中は false)
+};
+
+// 制御周期1回分の結果 (通信やプロセス終了などの副作用はメインループが行う)
+struct ControlOutputs {
+  InversionEvent inversion_event; // 反転検出の状態変化
+  bool restart_requested;         // [INVERSION] RESPONSE=RESTART で反転を検出した
+};
+
+// --- 関数のプロトタイプ宣言 ---
+// 姿勢推定・深度保持・方位保持・反転検出・電力制限の状態をリセットする
+void control_init();
+// 1周期分の制御 (姿勢推定 -> ゲームパッド解析 -> 各制御器 -> スラスター出力) を行う
+ControlOutputs control_step(const ControlInputs &inputs);
+// 保持しているゲームパッドの状態をニュートラルに戻す (通信タイムアウト時)
+void control_reset_gamepad();
+// 制御に使用している最新のゲームパッドの状態を取得する
+const GamepadData &control_get_gamepad();
+
+#endif // CONTROL_LOOP_H
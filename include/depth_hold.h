@@ -0,0 +1,27 @@
+#ifndef DEPTH_HOLD_H // インクルードガード
+#define DEPTH_HOLD_H
+
+#include "gamepad.h" // GamepadData 構造体を使用するため
+
+// 深度保持モードの状態 (テレメトリ用)
+struct DepthHoldStatus {
+  float depth_m;    // フィルタ済み深度推定値 (m, 水面=0, 下向き正)
+  float setpoint_m; // 深度保持の目標深度 (m)
+  bool calibrated;  // 水面気圧のキャリブレーションが完了しているか
+  bool active;      // 深度保持モードが有効か
+};
+
+// --- 関数のプロトタイプ宣言 ---
+// 深度推定器と制御器を初期化する (水面キャリブレーションもやり直す)
+void depth_hold_init();
+// 制御周期ごとに呼び出す。ボタンによるモード切替、深度推定、PID計算を行う。
+// pressure は read_pressure() の生値、dt_s は前回呼び出しからの経過時間 (秒)
+void depth_hold_update(const GamepadData &gamepad_data, float pressure,
+                       float dt_s);
+// 垂直スラスター (Ch4, Ch5) の目標PWM値を決定する
+// 深度保持が無効、またはパイロットがスティックを操作中なら manual_pwm をそのまま返す
+int depth_hold_vertical_pwm(int manual_pwm);
+// 現在の状態を取得する
+DepthHoldStatus depth_hold_get_status();
+
+#endif // DEPTH_HOLD_H
@@ -0,0 +1,77 @@
+#ifndef FLIGHT_RECORDER_H // インクルードガード
+#define FLIGHT_RECORDER_H
+
+#include "config.h"       // CONFIG_MAX_AUX_OUTPUTS を使用するため
+#include "control_loop.h" // ControlInputs を使用するため
+#include <stdint.h>       // 固定幅整数型のため
+#include <string>         // std::string を使用するため
+
+// --- 記録ファイルの形式 ---
+// [FlightRecordFileHeader] に続いて [FlightRecordHeader + ペイロード] が並ぶ。
+// 記録した機体と同じアーキテクチャ (Raspberry Pi) の構造体レイアウトをそのまま書き出す。
+#define FLIGHT_RECORD_MAGIC "ROVREC1"     // 7文字 + 終端 = 8バイト
+#define FLIGHT_RECORD_VERSION 1
+#define FLIGHT_RECORD_PWM_CHANNELS 16     // 記録する PWM 出力のチャンネル数 (Navigator の全チャンネル)
+
+// ファイル先頭のヘッダー
+struct FlightRecordFileHeader {
+  char magic[8];                               // FLIGHT_RECORD_MAGIC
+  uint32_t version;                            // FLIGHT_RECORD_VERSION
+  uint32_t tick_size;                          // sizeof(FlightRecordTick) (形式の整合性確認用)
+  uint8_t aux_levels[CONFIG_MAX_AUX_OUTPUTS];  // 記録開始時の補助出力の段階
+};
+
+// レコードの種類
+enum FlightRecordType : uint16_t {
+  FLIGHT_RECORD_TICK = 1,  // 制御周期1回分 (FlightRecordTick + 受信データ)
+  FLIGHT_RECORD_CONFIG = 2, // 適用した設定ファイルの全文 (開始時とリロード時)
+  FLIGHT_RECORD_PARAM = 3   // パラメータ要求で変更した1項目 ("SECTION.KEY=値"。同じ周期の制御の前に適用)
+};
+
+// 各レコードの先頭
+struct FlightRecordHeader {
+  uint16_t type;   // FlightRecordType
+  uint16_t reserved;
+  uint32_t length; // 続くペイロードのバイト数
+};
+
+// FlightRecordTick::flags のビット
+#define FLIGHT_TICK_CONTROL_ENABLED 0x01 // スラスターを駆動した周期
+#define FLIGHT_TICK_ADC_VALID 0x02       // この周期に ADC を読み取った (ControlInputs::adc_valid。adc が有効)
+#define FLIGHT_TICK_FAILSAFE_ENTERED 0x04 // この周期に通信タイムアウトでフェイルセーフに入った
+
+// 制御周期1回分の記録 (この後に packet_len バイトの受信データが続く)
+struct FlightRecordTick {
+  uint32_t tick;       // 周期の通し番号
+  uint32_t flags;      // FLIGHT_TICK_* の組み合わせ
+  int64_t time_ns;     // CLOCK_MONOTONIC の時刻 (ns)
+  float dt_s;          // 制御に渡した経過時間 (秒)
+  AxisData gyro;       // 制御に渡したセンサー値
+  AxisData accel;
+  AxisData mag;
+  float pressure;
+  float adc[4];        // FLIGHT_TICK_ADC_VALID の場合のみ有効
+  uint16_t pwm_us[FLIGHT_RECORD_PWM_CHANNELS]; // 周期終了時の PWM 出力 (us)
+  uint32_t packet_len; // 続く受信データのバイト数
+};
+
+// --- 関数のプロトタイプ宣言 ---
+// [RECORDER] ENABLED=true なら記録ファイルを作成し、書き込みスレッドを開始する
+// thruster_init() の後に呼び出すこと (補助出力の段階をヘッダーに記録するため)
+bool flight_recorder_start(const std::string &config_path);
+// 残りのデータを書き出してファイルを閉じる
+void flight_recorder_stop();
+// 設定ファイルの全文を記録する (記録の開始時)
+void flight_recorder_note_config(const std::string &config_path);
+// 読み込み済みの設定ファイルの全文を記録する (制御スレッドがリロードした設定を適用したとき)
+void flight_recorder_note_config_contents(const std::string &contents);
+// パラメータ要求 (param:set) で g_config に反映した値を記録する (制御スレッドが反映したとき)
+void flight_recorder_note_param(const char *section, const char *key,
+                                const std::string &value);
+// 制御周期1回分を記録する (周期の最後に呼び出す)。リングバッファが一杯なら破棄する
+void flight_recorder_record_tick(const ControlInputs &inputs,
+                                 bool failsafe_entered, int64_t time_ns);
+// リングバッファ不足・サイズ上限・長すぎる値で破棄したレコード数 (周期・設定変更・パラメータ変更の合計)
+unsigned int flight_recorder_dropped();
+
+#endif // FLIGHT_RECORDER_H
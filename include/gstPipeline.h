@@ -1,10 +1,16 @@
 #ifndef GST_PIPELINE_H
 #define GST_PIPELINE_H
 
+#include "config.h"
 #include <gst/gst.h>
-#include <thread>
 
+// config.ini の [CAMERA_n] (DEVICE が空でないもの) ごとに映像配信のパイプラインを作る。
+// 全カメラのバスの監視は、1つの GMainContext を回す1本のスレッドで行う
 bool start_gstreamer_pipelines();
 void stop_gstreamer_pipelines();
+// 設定の変更を、設定が変わったカメラだけに反映する。送信先と x264enc のビットレートは
+// 再生中のまま変更し、それ以外が変わった場合はそのカメラのパイプラインだけを作り直す
+bool reconfigure_gstreamer_cameras(const AppConfig &config,
+                                   const AppConfig &previous);
 
 #endif // GST_PIPELINE_H
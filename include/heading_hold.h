@@ -0,0 +1,21 @@
+#ifndef HEADING_HOLD_H // インクルードガード
+#define HEADING_HOLD_H
+
+#include "bindings.h" // AxisData 構造体を使用するため
+#include "gamepad.h"  // GamepadData 構造体を使用するため
+
+// --- 関数のプロトタイプ宣言 ---
+// 方位保持制御器の状態をリセットする
+void heading_hold_init();
+// 制御周期ごとに呼び出す。旋回スティックを離したら方位をラッチし、
+// 姿勢推定器のヨー角に対して補正量を計算する。dt_s は前回呼び出しからの経過時間 (秒)
+void heading_hold_update(const GamepadData &gamepad_data,
+                         const AxisData &gyro_data, float dt_s);
+// 方位保持が機能しているか (無効化されている、または姿勢推定が未初期化なら false)
+bool heading_hold_available();
+// 水平スラスターに加えるヨー補正量 (PWM)。正: 左旋回方向 (Ch1, Ch2)、負: 右旋回方向 (Ch0, Ch3)
+int heading_hold_output();
+// 現在の方位誤差 (deg)。未ラッチ時は 0
+float heading_hold_error_deg();
+
+#endif // HEADING_HOLD_H
@@ -0,0 +1,48 @@
+#ifndef INI_DOCUMENT_H
+#define INI_DOCUMENT_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+// config.ini の1行分。コメントや空行も元のテキストのまま保持する
+struct IniLine {
+    enum Kind { OTHER, SECTION, ENTRY, INVALID };
+    Kind kind;
+    std::string text;     // 元の行 (書き出し時はこのまま出力する)
+    std::string section;  // 所属するセクション名 (ファイル上の表記のまま)
+    std::string key;      // ENTRY のキー (前後の空白を除く)
+    std::string value;    // ENTRY の値 (前後の空白を除く)
+};
+
+// コメント・空行・キーの順序を保持したまま読み書きできる INI ファイル。
+// セクション名とキーの比較は大文字・小文字を区別しない。
+class IniDocument {
+public:
+    // ファイルを読み込む (開けなければ false)
+    bool load(const std::string& path);
+    // 文字列ストリームなどから読み込む (既存の内容は破棄する)
+    void parse(std::istream& input);
+    void write(std::ostream& out) const;
+    std::string to_string() const;
+
+    // 値を探す (同じキーが複数あれば最後のもの)。無ければ nullptr
+    const std::string* find(const std::string& section, const std::string& key) const;
+    std::string get(const std::string& section, const std::string& key,
+                    const std::string& fallback = "") const;
+    bool has_section(const std::string& section) const;
+    // 値を書き換える。キーが無ければセクションの最後に、セクションも無ければファイルの最後に追加する
+    void set(const std::string& section, const std::string& key, const std::string& value);
+
+    const std::vector<IniLine>& lines() const { return m_lines; }
+
+private:
+    std::vector<IniLine> m_lines;
+};
+
+// 文字列の前後の空白を削除する
+std::string ini_trim(const std::string& str);
+// 大文字・小文字を区別せずに比較する
+bool ini_equal(const std::string& a, const std::string& b);
+
+#endif // INI_DOCUMENT_H
@@ -0,0 +1,32 @@
+#ifndef INVERSION_DETECTOR_H // インクルードガード
+#define INVERSION_DETECTOR_H
+
+#include "bindings.h" // AxisData 構造体を使用するため
+
+// 状態が切り替わった周期にだけ返されるイベント
+enum class InversionEvent {
+  NONE,    // 変化なし
+  ENTERED, // 反転状態に入った (ENTER_ANGLE_DEG 超過が DWELL_S 継続)
+  CLEARED  // 反転状態から復帰した (EXIT_ANGLE_DEG 未満が DWELL_S 継続)
+};
+
+// 反転検出器の状態 (テレメトリ用)
+struct InversionStatus {
+  float tilt_deg;     // 基準姿勢からのフィルタ済み重力ベクトルの傾き (deg)
+  bool calibrated;    // 基準の重力方向が確定しているか
+  bool inverted;      // 反転状態か
+  unsigned events;    // 反転状態に入った回数
+  unsigned rejected;  // 大きさが異常で破棄した加速度サンプル数 (衝突など)
+};
+
+// --- 関数のプロトタイプ宣言 ---
+// 検出器をリセットする (基準の重力方向も取り直す)
+void inversion_detector_init();
+// 制御周期ごとに呼び出す。accel は read_accel() の生値、dt_s は前回からの経過時間 (秒)
+InversionEvent inversion_detector_update(const AxisData &accel, float dt_s);
+// 現在反転状態か
+bool inversion_detector_is_inverted();
+// 現在の状態を取得する
+InversionStatus inversion_detector_get_status();
+
+#endif // INVERSION_DETECTOR_H
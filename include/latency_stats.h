@@ -0,0 +1,34 @@
+#ifndef LATENCY_STATS_H // インクルードガード
+#define LATENCY_STATS_H
+
+#include <stdint.h> // int64_t, uint32_t のため
+
+// 計測する遅延の種類
+enum LatencyMetric {
+  LATENCY_TICK_PERIOD,   // 周期の開始から次の周期の開始まで
+  LATENCY_TICK_WORK,     // 周期の開始からスリープ直前まで (処理時間)
+  LATENCY_PACKET_TO_PWM, // カーネルがパケットを受信してから PWM を出力するまで
+  LATENCY_SENSOR_READ,   // 制御に使うセンサー (ジャイロ/加速度/磁気/圧力) の読み取り時間
+  LATENCY_METRIC_COUNT
+};
+
+// 直近の集計期間 ([LATENCY] WINDOW_S) のパーセンタイル (us)
+struct LatencySummary {
+  uint32_t count; // サンプル数 (0 ならパーセンタイルも 0)
+  float p50_us;
+  float p99_us;
+  float p999_us;
+  float max_us;
+};
+
+// --- 関数のプロトタイプ宣言 ---
+// すべてのヒストグラムと集計結果をリセットする
+void latency_stats_init();
+// 1サンプルを記録する (ヒープ確保なし。制御スレッドから呼び出す)
+void latency_stats_record(LatencyMetric metric, int64_t ns);
+// 周期ごとに呼び出す。集計期間が経過していればパーセンタイルを確定してヒストグラムをリセットする
+void latency_stats_tick(int64_t now_ns);
+// 直近に確定した集計結果を取得する (テレメトリ用)
+LatencySummary latency_stats_get(LatencyMetric metric);
+
+#endif // LATENCY_STATS_H
@@ -0,0 +1,97 @@
+#ifndef LIVE_STATE_H // インクルードガード
+#define LIVE_STATE_H
+
+#include <atomic>   // std::atomic のため
+#include <errno.h>  // errno, ESRCH のため
+#include <sched.h>  // sched_yield のため
+#include <signal.h> // kill (書き込み側の生存確認) のため
+#include <stdint.h> // 固定幅整数型のため
+
+// 稼働中の制御ループの状態を POSIX 共有メモリ (shm_open) に公開する。
+// 制御スレッドは周期ごとにシーケンスロック (seqlock) で書き込むだけで、読み出し側
+// (tools/rov_state.cpp など) はこのプロセスにシステムコールを発行せず、任意の頻度で読める。
+// このヘッダーは読み出しツールからも使うため、他のモジュールのヘッダーには依存しない。
+
+#define LIVE_STATE_DEFAULT_NAME "/rov_live_state"
+#define LIVE_STATE_MAGIC "ROVLIVE"
+#define LIVE_STATE_VERSION 1u
+#define LIVE_STATE_PWM_CHANNELS 16
+#define LIVE_STATE_AUX_OUTPUTS 8
+
+// 公開する状態 (固定レイアウト。項目を変更したら LIVE_STATE_VERSION を上げる)
+struct LiveStateData {
+  uint64_t tick;       // 周期の通し番号
+  int64_t time_ns;     // 周期の開始時刻 (CLOCK_MONOTONIC)
+  // 最新のゲームパッドデータ
+  int32_t left_thumb_x, left_thumb_y, right_thumb_x, right_thumb_y;
+  int32_t lt, rt;
+  uint32_t buttons;
+  // PWM 出力 (us, 0 は未出力) と補助出力の段階
+  uint16_t pwm_us[LIVE_STATE_PWM_CHANNELS];
+  uint8_t aux_levels[LIVE_STATE_AUX_OUTPUTS];
+  // センサー値 (read_* の生値)
+  float gyro[3], accel[3], mag[3];
+  float pressure;
+  // 推定値
+  float roll_deg, pitch_deg, yaw_deg;
+  float depth_m, depth_setpoint_m;
+  // ループの統計
+  float tick_period_us; // 直前の周期
+  float tick_work_us;   // 直前の周期の処理時間 (スリープを除く)
+  uint32_t loop_overruns;
+  uint32_t failsafe_entries;
+  // 状態フラグ
+  uint8_t failsafe;          // フェイルセーフ中
+  uint8_t control_enabled;   // スラスターを駆動している
+  uint8_t depth_hold_active; // 深度保持モード
+  uint8_t inverted;          // 反転検出中
+};
+
+// 共有メモリのレイアウト。seq が奇数の間は書き込み中
+struct LiveStateSegment {
+  char magic[8];          // LIVE_STATE_MAGIC
+  uint32_t version;       // LIVE_STATE_VERSION
+  uint32_t data_size;     // sizeof(LiveStateData)
+  std::atomic<uint32_t> seq;
+  uint32_t writer_pid;    // 書き込み中のプロセス
+  LiveStateData data;
+};
+
+// 読み出し側の再試行の上限 (LIVE_STATE_READ_RETRIES 回ごとに書き込み側の生存を確認する)
+#define LIVE_STATE_READ_RETRIES 1000
+#define LIVE_STATE_READ_ROUNDS 100
+
+// 読み出し側: 書き込みと重ならなかった一貫したコピーを取得する。
+// 書き込み側が書き込み途中で終了すると seq は奇数のまま戻らないため、再試行は上限までとし、
+// 途中で書き込み側のプロセスが無くなっていれば (kill(pid, 0) が ESRCH) すぐに失敗を返す
+inline bool live_state_read(const LiveStateSegment *segment, LiveStateData *out) {
+  for (int attempt = 1; attempt <= LIVE_STATE_READ_RETRIES * LIVE_STATE_READ_ROUNDS; ++attempt) {
+    uint32_t before = segment->seq.load(std::memory_order_acquire);
+    if ((before & 1u) == 0) { // 奇数は書き込み中
+      *out = segment->data;
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (segment->seq.load(std::memory_order_relaxed) == before) {
+        return true;
+      }
+    }
+    if (attempt % LIVE_STATE_READ_RETRIES == 0) {
+      if (kill(static_cast<pid_t>(segment->writer_pid), 0) != 0 && errno == ESRCH) {
+        return false;
+      }
+      sched_yield();
+    }
+  }
+  return false;
+}
+
+// --- 関数のプロトタイプ宣言 (書き込み側, 制御プロセス) ---
+// 共有メモリを作成して公開を開始する ([LIVE_STATE] ENABLED=false なら何もしない)
+bool live_state_open();
+// 共有メモリを削除する
+void live_state_close();
+// 周期の最後に1回呼び出す。data を seqlock で書き込む
+void live_state_publish(const LiveStateData &data);
+// 公開中か (false の間は LiveStateData を組み立てる必要がない)
+bool live_state_active();
+
+#endif // LIVE_STATE_H
@@ -0,0 +1,84 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <stdint.h>
+#include <string>
+#include <thread>
+
+// 監視用のカウンタとゲージ。各モジュールが relaxed の原子操作で更新し、
+// MetricsServer のスレッドが読み出して Prometheus のテキスト形式で返す。
+// (制御ループはロックを取らず、読み出し側を待つこともない)
+#define METRICS_MAX_CAMERAS 4 // CONFIG_MAX_CAMERAS (config.h)
+#define METRICS_CONFIG_APPLY_TARGETS 5 // CONFIG_APPLY_TARGET_COUNT (config_schema.h)
+
+struct Metrics {
+    // 通信 (network.cpp)
+    std::atomic<uint64_t> packets_received;    // 制御に使用した操縦パケット数
+    std::atomic<uint64_t> packets_superseded;  // 同じ周期に届いた新しいパケットで上書きされ、使われなかった数
+    std::atomic<uint64_t> packets_rejected;    // 許可されていないIPアドレスから届いて破棄した数
+    std::atomic<uint64_t> send_errors;         // 送信に失敗した数
+
+    // パラメータ要求 (param_protocol.cpp)
+    std::atomic<uint64_t> param_requests;      // 処理したパラメータ要求の数
+    std::atomic<uint64_t> param_sets;          // 値を変更した数
+    std::atomic<uint64_t> param_rejected;      // 拒否した要求の数 (不正な形式、範囲外の値など)
+    std::atomic<uint64_t> param_dropped;       // 1周期に届いた数が多すぎて破棄した数 (network.cpp)
+
+    // メインループ (main.cpp)
+    std::atomic<uint64_t> ticks;               // 制御周期の回数
+    std::atomic<uint64_t> loop_overruns;       // 周期が LOOP_DELAY_US の 1.5 倍を超えた回数
+    std::atomic<int64_t> last_tick_period_ns;  // 直前の周期 (ns)
+    std::atomic<uint64_t> failsafe_entries;    // 通信タイムアウトでフェイルセーフに入った回数
+    std::atomic<bool> failsafe_active;         // フェイルセーフ中か
+    std::atomic<uint64_t> config_reloads;      // 設定のリロードに成功した回数
+    std::atomic<uint64_t> config_reload_failures; // 設定のリロードに失敗した回数
+    std::atomic<int64_t> config_parse_ns;      // 直前のリロードの読み込み・パース・検証の時間 (リロード用スレッド)
+    std::atomic<int64_t> config_apply_ns;      // 直前のリロードを制御スレッドで適用した時間
+    std::atomic<int64_t> config_apply_target_ns[METRICS_CONFIG_APPLY_TARGETS];     // 担当ごとの直前の反映時間
+    std::atomic<uint64_t> config_apply_target_count[METRICS_CONFIG_APPLY_TARGETS]; // 担当ごとの反映回数
+    std::atomic<uint64_t> inversion_events;    // 反転を検出した回数
+
+    // GStreamer (gstPipeline.cpp)
+    std::atomic<int> camera_state[METRICS_MAX_CAMERAS];       // GstState (0: 未作成, 1: NULL, 2: READY, 3: PAUSED, 4: PLAYING)
+    std::atomic<uint64_t> camera_frames[METRICS_MAX_CAMERAS]; // カメラから取得したフレーム数
+    std::atomic<uint64_t> camera_errors[METRICS_MAX_CAMERAS]; // パイプラインのエラー・EOS の数
+    std::atomic<uint64_t> camera_warnings[METRICS_MAX_CAMERAS]; // パイプラインの警告メッセージ数
+    std::atomic<uint64_t> camera_restarts[METRICS_MAX_CAMERAS]; // エラー・EOS による自動の再起動の回数
+    std::atomic<int64_t> camera_first_frame_ns[METRICS_MAX_CAMERAS]; // 直前の起動から最初のフレームまでの時間
+    std::atomic<int64_t> camera_latency_ns[METRICS_MAX_CAMERAS];     // 直近1秒の撮影から udpsink までの遅延の平均
+    std::atomic<int64_t> camera_latency_max_ns[METRICS_MAX_CAMERAS]; // 同じ区間の最大値
+
+    // 映像のビットレートの自動調整 (video_bitrate.cpp)
+    std::atomic<int> video_bitrate_kbps;           // カメラごとの目標ビットレート (0: 自動調整なし)
+    std::atomic<uint64_t> video_bitrate_decreases; // 混雑を検出してビットレートを下げた回数
+    std::atomic<int64_t> control_gap_max_ns;       // 直前の区間の操縦パケットの最大の間隔
+};
+
+extern Metrics g_metrics;
+
+// relaxed でカウンタを1増やす
+inline void metrics_increment(std::atomic<uint64_t> &counter) {
+    counter.fetch_add(1, std::memory_order_relaxed);
+}
+
+// [METRICS] の BIND:PORT で GET /metrics に応答する HTTP サーバー (専用スレッド)
+class MetricsServer {
+public:
+    MetricsServer();
+    ~MetricsServer();
+
+    bool start();
+    void stop();
+
+private:
+    void run();
+    void handle_client(int client_sock);
+    std::string render();
+
+    int m_listen_sock;
+    std::thread m_thread;
+    std::atomic<bool> m_shutdown_flag;
+};
+
+#endif // METRICS_H
@@ -10,6 +10,16 @@
 #define DEFAULT_RECV_PORT 12345 // デフォルトの受信UDPポート番号
 #define DEFAULT_SEND_PORT 12346 // デフォルトの送信UDPポート番号
 #define NET_BUFFER_SIZE 1024 // ネットワーク送受信バッファのサイズ (バイト単位)
+#define NET_PARAM_PREFIX "param:" // パラメータ要求 (param_protocol.h) のパケットの先頭
+#define NET_PARAM_PREFIX_LEN 6
+#define NET_PARAM_QUEUE_SIZE 8 // 1周期に保持するパラメータ要求の数 (超えた分は破棄)
+
+// 操縦パケットとは別に受け取ったメッセージ (NUL 終端)
+typedef struct {
+  char data[NET_BUFFER_SIZE];
+  size_t len;
+  struct sockaddr_in from; // 送信元 (応答の宛先)
+} NetworkMessage;
 
 // ネットワーク通信の状態を保持する構造体
 typedef struct {
@@ -25,6 +35,10 @@ typedef struct {
       client_addr_known; // 送信先クライアントアドレスが設定されているかを示すフラグ
   struct timespec
       last_successful_recv_time; // 最後にデータパケットを正常に受信した時刻
+  struct timespec
+      last_packet_kernel_time; // 最後に返したパケットをカーネルが受信した時刻 (CLOCK_REALTIME, SO_TIMESTAMPNS。取得できなければ 0)
+  NetworkMessage param_queue[NET_PARAM_QUEUE_SIZE]; // この周期に届いたパラメータ要求 (操縦パケットで上書きしない)
+  int param_queue_count;
 } NetworkContext;
 
 // 関数のプロトタイプ宣言
@@ -35,9 +49,14 @@ void network_close(
     NetworkContext *ctx); // ネットワーク関連のリソース（ソケット）を解放する
 ssize_t
 network_receive(NetworkContext *ctx, char *buffer,
-                size_t buffer_size); // UDPデータを受信する (ノンブロッキング)
+                size_t buffer_size); // UDPデータを受信する (ノンブロッキング。パラメータ要求は param_queue に入れる)
 bool network_send(NetworkContext *ctx, const char *data,
                   size_t data_len); // UDPデータを送信する
+bool network_reply(NetworkContext *ctx, const NetworkMessage *request,
+                   const char *data,
+                   size_t data_len); // メッセージの送信元へ応答する (宛先ポートは送信ポート)
+bool network_rebind(NetworkContext *ctx, int recv_port,
+                    int send_port); // 受信・送信ポートを変更する (クライアントの状態は保持)
 bool network_update_send_address(
     NetworkContext *
         ctx); // 最後に受信したクライアントのアドレスを送信先として設定するヘルパー関数
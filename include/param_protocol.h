@@ -0,0 +1,32 @@
+#ifndef PARAM_PROTOCOL_H
+#define PARAM_PROTOCOL_H
+
+#include "network.h" // NetworkContext, NetworkMessage
+
+class ConfigSynchronizer;
+
+// 操縦用の UDP で設定項目を読み書きするパラメータ要求 (MAVLink の PARAM_* に相当)。
+// 要求は操縦パケットと同じ受信ポートに届く "param:" で始まるテキストで、応答は送信元の
+// SEND_PORT へ返す。項目の名前は "SECTION.KEY"、<seq> は要求と応答を対応付ける番号。
+//
+//   要求 (操縦PC -> 機体):
+//     param:get,<seq>,<SECTION.KEY>
+//     param:set,<seq>,<live|persist>,<SECTION.KEY>,<値>   (persist: config.ini にも保存する)
+//     param:list,<seq>[,<開始番号>]
+//   応答 (機体 -> 操縦PC):
+//     param:value,<seq>,<番号>,<項目数>,<SECTION.KEY>,<型>,<値>   (get と list。list は数周期に分けて送る)
+//     param:ack,<seq>,<SECTION.KEY>,<型>,<値>,<live|persist>      (set を反映した)
+//     param:nack,<seq>,<理由>
+//
+// 型は int / uint / float / double / bool / string / sign / button / enum / levels。
+// set で変更できるのは、制御スレッドが毎周期参照する数値・真偽値の項目と PWM_FREQUENCY のみ
+// (カメラ・ポート・推力曲線など、再構成が必要な項目は設定の同期で変更する)。
+// live の変更は次に config.ini をリロードしたときにファイルの値に戻る。
+
+// --- 関数のプロトタイプ宣言 ---
+void param_protocol_init(); // 項目の一覧を作る (制御ループの開始前に1回呼ぶ)
+// この周期に届いた要求 (ctx->param_queue) を処理して応答し、送信中の list の続きを送る。
+// 値を変更した場合は反映先 (CONFIG_APPLY_BIT の組み合わせ) を返す。sync は persist の保存先
+unsigned param_protocol_process(NetworkContext *ctx, ConfigSynchronizer *sync);
+
+#endif // PARAM_PROTOCOL_H
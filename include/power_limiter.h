@@ -0,0 +1,30 @@
+#ifndef POWER_LIMITER_H // インクルードガード
+#define POWER_LIMITER_H
+
+// 電力制限の状態 (テレメトリ用)
+struct PowerLimiterStatus {
+  float adc[4];                // 最後に取り込んだ ADC の値 (read_adc_all の結果)
+  float voltage_v;             // 計測したバッテリー電圧 (V)
+  float current_a;             // 計測した電流 (A)
+  float estimated_current_a;   // 指令PWMから推定したスラスター電流 (A、補正後)
+  float budget_a;              // 現在の電流予算 (A、低電圧時は縮小)
+  float headroom_a;            // 予算に対する余裕 (A、負なら制限中)
+  float scale;                 // 直近の推力スケール係数 (1.0 = 制限なし)
+  unsigned int limit_events;   // 制限が作動した回数
+  bool limiting;               // 現在制限中か
+};
+
+// --- 関数のプロトタイプ宣言 ---
+// 電力制限器の状態をリセットする
+void power_limiter_init();
+// ADC の計測値 (read_adc_all の結果) を取り込み、電流推定の補正係数を更新する
+void power_limiter_update_measurements(const float *adc, int count);
+// スラスターの目標PWM値 (線形な指令値) を、推定電流が予算内に収まるよう一律にスケールする
+// target_pwm は count 個のスラスターの目標値 (PWM_MIN で停止)。方向 (各チャンネルの比率) は保たれる。
+void power_limiter_apply(int *target_pwm, int count);
+// 平滑化後に実際にスラスターへ出力した PWM 値 (線形な指令値) を通知する。補正係数はこの値に対して当てはめる
+void power_limiter_note_output(const int *output_pwm, int count);
+// 現在の状態を取得する
+PowerLimiterStatus power_limiter_get_status();
+
+#endif // POWER_LIMITER_H
@@ -5,7 +5,7 @@
 #include <vector>   // ADCデータなどの配列データを扱うために含める (現在は直接使用していない)
 #include <stddef.h> // size_t 型を使用するため
 
-#define SENSOR_BUFFER_SIZE 512 // センサーデータを格納する文字列バッファの推奨サイズ
+#define SENSOR_BUFFER_SIZE 1536 // センサーデータを格納する文字列バッファの推奨サイズ (姿勢・深度・電力などのフィールド追加に合わせて拡張)
 
 // 関数のプロトタイプ宣言
 // 関連するすべてのセンサーを読み取り、指定されたバッファに文字列としてフォーマットする
@@ -0,0 +1,30 @@
+#ifndef THRUST_CURVE_H // インクルードガード
+#define THRUST_CURVE_H
+
+#define THRUST_LUT_SIZE 256 // 推力 -> PWM 逆変換テーブルの分割数
+
+struct AppConfig;
+// 全チャンネル分の逆変換テーブル (内容は thrust_curve.cpp のみが参照する)
+struct ThrustCurveTables;
+
+// --- 関数のプロトタイプ宣言 ---
+// 設定 ([THRUST_CURVE]) に従って各スラスターの推力曲線 CSV を読み込み、逆変換テーブルを構築する
+// 失敗した場合は false を返し、直前に構築したテーブル (または無効状態) を維持する
+// (thrust_curve_build + thrust_curve_install を呼び出し元のスレッドで行う。起動時とツール用)
+bool thrust_curve_load();
+// config に従ってテーブルを構築し *out に返す (無効なら nullptr)。ファイルを読むため制御スレッドでは呼ばない
+bool thrust_curve_build(const AppConfig &config, ThrustCurveTables **out);
+// 制御スレッドが参照するテーブルを差し替え、以前のテーブルを返す (ポインタの交換のみ)
+ThrustCurveTables *thrust_curve_install(ThrustCurveTables *tables);
+// thrust_curve_build で構築したテーブルを解放する (nullptr は何もしない)
+void thrust_curve_free(ThrustCurveTables *tables);
+// 推力曲線による線形化が有効か
+bool thrust_curve_enabled();
+// 指定チャンネルの推力 (N) を PWM パルス幅 (us) に変換する (テーブル参照 + 線形補間、O(1))。
+// テーブルが無い場合や、チャンネルが 0 ~ CONFIG_THRUSTER_CHANNELS-1 の外なら PWM_MIN を返す
+int thrust_curve_thrust_to_pwm(int channel, float thrust_n);
+// ミキサーが出力した「線形な」PWM 指令値 (PWM_MIN ~ PWM_BOOST_MAX を推力 0% ~ 100% とみなす) を、
+// 推力曲線を考慮した実際の PWM 値に変換する。無効時と範囲外のチャンネルではそのまま返す。
+int thrust_curve_linearize(int channel, int linear_pwm);
+
+#endif // THRUST_CURVE_H
@@ -4,29 +4,30 @@
 #include "gamepad.h"  // GamepadData 構造体の定義が必要なためインクルード
 #include "bindings.h" // AxisData 構造体を使用するため (read_gyro() の戻り値型)
 #include "config.h"   // グローバル設定オブジェクト g_config を使用するため
-#include <string>     // std::string を使用するため
 
 // --- 定数定義 ---
 // NUM_THRUSTERS はハードウェア固定値なので、ここでは定数として残す
 
 #define NUM_THRUSTERS 6 // 制御対象のスラスター総数 (Ch0-3 水平, Ch4-5 前進/後退)
+#define NUM_PWM_CHANNELS 16 // Navigator の PWM チャンネル総数 (スラスター + 補助出力)
 
-// --- LED制御用定数 ---
-// LED_PWM_CHANNEL, LED_PWM_ON, LED_PWM_OFF は config.h/cpp に移動
+// --- LED制御 ---
+// LED などの補助出力は aux_output.h のモジュールで制御する (設定は g_config.aux_outputs)
 
 // --- 関数のプロトタイプ宣言 ---
 // スラスター制御モジュールを初期化する (PWM設定など)
 bool thruster_init();
+// g_config.pwm_frequency を PWM に再設定し、出力中のパルス幅を保ったまま出し直す (設定の変更時)
+void thruster_apply_frequency();
 // スラスター制御を無効化する (PWM停止など)
 void thruster_disable();
 // ゲームパッドデータとジャイロデータに基づいてすべてのスラスターのPWM出力を更新する
 void thruster_update(const GamepadData &gamepad_data, const AxisData &gyro_data);
 // すべてのスラスターを指定されたPWM値に設定する (LEDは変更しない)
 void thruster_set_all_pwm(int pwm_value);
-// LEDの状態を文字列として取得する (同期用)
-std::string get_led_state_string();
-
-// LEDの状態をファイルに保存する (フェイルセーフ/再起動時の状態保持用)
-void thruster_save_led_state_to_file();
+// 指定チャンネルに PWM 値を出力する (PWM_MIN ~ PWM_BOOST_MAX にクランプ。補助出力用)
+void thruster_write_pwm(int channel, int pulse_width_us);
+// 指定チャンネルに最後に出力した PWM 値 (クランプ後, us) を取得する。未出力なら 0
+int thruster_get_output_pwm(int channel);
 
 #endif // THRUSTER_CONTROL_H
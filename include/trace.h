@@ -0,0 +1,63 @@
+#ifndef TRACE_H // インクルードガード
+#define TRACE_H
+
+#include <atomic>   // std::atomic のため
+#include <stdint.h> // int64_t のため
+#include <string>   // std::string のため
+#include <time.h>   // clock_gettime のため
+
+// 周期内の各処理の開始/終了時刻を、スレッドごとのリングバッファに記録する。
+// 使い方: 計測したいブロックの先頭に TRACE_SCOPE("network_receive"); と書く。
+// 無効時のコストは g_trace_enabled の読み出しと分岐1回のみ。
+// 記録は SIGUSR1 (または trace_request_dump()) で Chrome trace JSON として書き出し、
+// chrome://tracing や https://ui.perfetto.dev で表示する。
+
+// トレースが有効か ([TRACE] ENABLED。trace_set_enabled() で切り替える)
+extern std::atomic<bool> g_trace_enabled;
+
+// 単調増加時刻 (ns)
+inline int64_t trace_now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+// --- 関数のプロトタイプ宣言 ---
+// 書き出し用スレッドと SIGUSR1 のハンドラを開始する
+void trace_start();
+// 書き出し用スレッドを停止する
+void trace_stop();
+// 記録の有効/無効を切り替える (設定のリロード時に呼び出す)
+void trace_set_enabled(bool enabled);
+// 呼び出し元のスレッドのリングバッファを確保する。登録していないスレッドのトレースポイントは無視される
+void trace_register_thread(const std::string &name);
+// 1区間を記録する (通常は TRACE_SCOPE を使う)
+void trace_record(const char *name, int64_t start_ns, int64_t end_ns);
+// 書き出し用スレッドに書き出しを依頼する (シグナルハンドラからも呼び出せる)
+void trace_request_dump();
+
+// ブロックの開始から終了までを1区間として記録する
+class TraceScope {
+public:
+  explicit TraceScope(const char *name)
+      : m_name(name),
+        m_start_ns(g_trace_enabled.load(std::memory_order_relaxed) ? trace_now_ns()
+                                                                   : 0) {}
+  ~TraceScope() {
+    if (m_start_ns != 0) {
+      trace_record(m_name, m_start_ns, trace_now_ns());
+    }
+  }
+
+private:
+  TraceScope(const TraceScope &);
+  TraceScope &operator=(const TraceScope &);
+  const char *m_name; // 文字列リテラルであること (ポインタのみ保持する)
+  int64_t m_start_ns; // 0 なら記録しない
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(name)
+
+#endif // TRACE_H
@@ -0,0 +1,28 @@
+#ifndef VIDEO_BITRATE_H // インクルードガード
+#define VIDEO_BITRATE_H
+
+#include <stdint.h> // int64_t のため
+
+// 目標を見直す間隔 (ミリ秒)
+#define VIDEO_BITRATE_INTERVAL_MS 1000
+
+// 自動調整の設定 (AppConfig の [VIDEO_BITRATE] から取り出したもの)
+struct VideoBitrateSettings {
+  bool adaptive;
+  int min_kbps;
+  int max_kbps;
+  int control_gap_ms;
+};
+
+// --- 関数のプロトタイプ宣言 ---
+// 操縦パケットの受信時刻 (ns) を記録する (制御スレッドから。受け取ったパケットごとに呼ぶ)
+void video_bitrate_note_control_packet(int64_t arrival_ns);
+// 操縦パケットが CONNECTION_TIMEOUT_SECONDS より長く途切れたときに呼ぶ (制御スレッドから)。
+// 再開後の最初のパケットまでの間隔を混雑として数えない
+void video_bitrate_note_connection_lost();
+// VIDEO_BITRATE_INTERVAL_MS ごとに呼び出す (映像側のスレッドから)。直近の区間の操縦パケットの
+// 間隔と送信エラーから回線の混雑を判断し、カメラごとの目標ビットレート (kbps) を返す。
+// 混雑していれば下げ、混雑が無い区間が続けば少しずつ戻す。自動調整が無効なら 0
+int video_bitrate_update(const VideoBitrateSettings &settings);
+
+#endif // VIDEO_BITRATE_H
@@ -0,0 +1,200 @@
+#include "attitude_estimator.h"
+#include "config.h"  // グローバル設定オブジェクト g_config を使用するため
+#include <algorithm> // std::max, std::min のため
+#include <cmath>     // std::sqrt, std::atan2, std::asin のため
+
+// ラジアン <-> 度 変換係数
+static const float RAD_TO_DEG = 57.2957795f;
+
+// 推定器の状態 (ファイルスコープ、メインスレッド専用。ヒープ確保は行わない)
+static AttitudeEstimate estimate = {{1.0f, 0.0f, 0.0f, 0.0f},
+                                    0.0f,
+                                    0.0f,
+                                    0.0f,
+                                    {0.0f, 0.0f, 0.0f},
+                                    false};
+
+// --- ヘルパー関数 ---
+
+// 逆平方根 (ゼロ入力時は 0 を返す)
+static float inv_sqrt(float x) {
+  if (x <= 0.0f) {
+    return 0.0f;
+  }
+  return 1.0f / std::sqrt(x);
+}
+
+// クォータニオンからオイラー角 (deg) を計算して estimate に反映する
+static void update_euler() {
+  const float q0 = estimate.q[0], q1 = estimate.q[1], q2 = estimate.q[2],
+              q3 = estimate.q[3];
+  estimate.roll_deg =
+      std::atan2(2.0f * (q0 * q1 + q2 * q3), 1.0f - 2.0f * (q1 * q1 + q2 * q2)) *
+      RAD_TO_DEG;
+  float sinp = 2.0f * (q0 * q2 - q3 * q1);
+  sinp = std::max(-1.0f, std::min(1.0f, sinp)); // asin の定義域にクランプ
+  estimate.pitch_deg = std::asin(sinp) * RAD_TO_DEG;
+  estimate.yaw_deg =
+      std::atan2(2.0f * (q0 * q3 + q1 * q2), 1.0f - 2.0f * (q2 * q2 + q3 * q3)) *
+      RAD_TO_DEG;
+}
+
+// 加速度 (と磁気) から初期姿勢を求める。起動直後の収束待ちを無くすため。
+static void initialize_from_vectors(float ax, float ay, float az, float mx,
+                                    float my, float mz, bool use_mag) {
+  float roll = std::atan2(ay, az);
+  float pitch = std::atan2(-ax, std::sqrt(ay * ay + az * az));
+  float yaw = 0.0f;
+  if (use_mag) {
+    // 傾き補償付きの方位計算
+    float cr = std::cos(roll), sr = std::sin(roll);
+    float cp = std::cos(pitch), sp = std::sin(pitch);
+    float bx = mx * cp + my * sr * sp + mz * cr * sp;
+    float by = my * cr - mz * sr;
+    yaw = std::atan2(-by, bx);
+  }
+  float cy = std::cos(yaw * 0.5f), sy = std::sin(yaw * 0.5f);
+  float cp = std::cos(pitch * 0.5f), sp = std::sin(pitch * 0.5f);
+  float cr = std::cos(roll * 0.5f), sr = std::sin(roll * 0.5f);
+  estimate.q[0] = cr * cp * cy + sr * sp * sy;
+  estimate.q[1] = sr * cp * cy - cr * sp * sy;
+  estimate.q[2] = cr * sp * cy + sr * cp * sy;
+  estimate.q[3] = cr * cp * sy - sr * sp * cy;
+}
+
+// --- モジュール関数 ---
+
+void attitude_init() {
+  estimate.q[0] = 1.0f;
+  estimate.q[1] = estimate.q[2] = estimate.q[3] = 0.0f;
+  estimate.gyro_bias[0] = estimate.gyro_bias[1] = estimate.gyro_bias[2] = 0.0f;
+  estimate.roll_deg = estimate.pitch_deg = estimate.yaw_deg = 0.0f;
+  estimate.valid = false;
+}
+
+void attitude_update(const AxisData &accel, const AxisData &gyro,
+                     const AxisData &mag, float dt_s) {
+  const float beta = g_config.ahrs_beta;
+  const float zeta = g_config.ahrs_zeta;
+
+  // 加速度がゼロ (読み取り失敗) の場合は勾配補正を行えないのでスキップ
+  float a_norm = inv_sqrt(accel.x * accel.x + accel.y * accel.y +
+                          accel.z * accel.z);
+  if (a_norm == 0.0f || dt_s <= 0.0f) {
+    return;
+  }
+  float ax = accel.x * a_norm, ay = accel.y * a_norm, az = accel.z * a_norm;
+
+  float m_norm =
+      inv_sqrt(mag.x * mag.x + mag.y * mag.y + mag.z * mag.z);
+  bool use_mag = g_config.ahrs_use_mag && m_norm != 0.0f;
+  float mx = mag.x * m_norm, my = mag.y * m_norm, mz = mag.z * m_norm;
+
+  if (!estimate.valid) {
+    initialize_from_vectors(ax, ay, az, mx, my, mz, use_mag);
+    estimate.valid = true;
+    update_euler();
+    return;
+  }
+
+  float q0 = estimate.q[0], q1 = estimate.q[1], q2 = estimate.q[2],
+        q3 = estimate.q[3];
+
+  // --- 目的関数の勾配 (補正方向) を計算 ---
+  float s0, s1, s2, s3;
+  const float _2q0 = 2.0f * q0, _2q1 = 2.0f * q1, _2q2 = 2.0f * q2,
+              _2q3 = 2.0f * q3;
+  const float q0q0 = q0 * q0, q1q1 = q1 * q1, q2q2 = q2 * q2, q3q3 = q3 * q3;
+
+  if (use_mag) {
+    // 9軸 (MARG) 版
+    const float _2q0mx = 2.0f * q0 * mx, _2q0my = 2.0f * q0 * my,
+                _2q0mz = 2.0f * q0 * mz, _2q1mx = 2.0f * q1 * mx;
+    const float _2q0q2 = 2.0f * q0 * q2, _2q2q3 = 2.0f * q2 * q3;
+    const float q0q1 = q0 * q1, q0q2 = q0 * q2, q0q3 = q0 * q3, q1q2 = q1 * q2,
+                q1q3 = q1 * q3, q2q3 = q2 * q3;
+
+    // 地球座標系での磁場の基準方向
+    float hx = mx * q0q0 - _2q0my * q3 + _2q0mz * q2 + mx * q1q1 +
+               _2q1 * my * q2 + _2q1 * mz * q3 - mx * q2q2 - mx * q3q3;
+    float hy = _2q0mx * q3 + my * q0q0 - _2q0mz * q1 + _2q1mx * q2 -
+               my * q1q1 + my * q2q2 + _2q2 * mz * q3 - my * q3q3;
+    float _2bx = std::sqrt(hx * hx + hy * hy);
+    float _2bz = -_2q0mx * q2 + _2q0my * q1 + mz * q0q0 + _2q1mx * q3 -
+                 mz * q1q1 + _2q2 * my * q3 - mz * q2q2 + mz * q3q3;
+    float _4bx = 2.0f * _2bx, _4bz = 2.0f * _2bz;
+
+    float fax = 2.0f * q1q3 - _2q0q2 - ax;
+    float fay = 2.0f * q0q1 + _2q2q3 - ay;
+    float faz = 1.0f - 2.0f * q1q1 - 2.0f * q2q2 - az;
+    float fmx = _2bx * (0.5f - q2q2 - q3q3) + _2bz * (q1q3 - q0q2) - mx;
+    float fmy = _2bx * (q1q2 - q0q3) + _2bz * (q0q1 + q2q3) - my;
+    float fmz = _2bx * (q0q2 + q1q3) + _2bz * (0.5f - q1q1 - q2q2) - mz;
+
+    s0 = -_2q2 * fax + _2q1 * fay - _2bz * q2 * fmx +
+         (-_2bx * q3 + _2bz * q1) * fmy + _2bx * q2 * fmz;
+    s1 = _2q3 * fax + _2q0 * fay - 4.0f * q1 * faz + _2bz * q3 * fmx +
+         (_2bx * q2 + _2bz * q0) * fmy + (_2bx * q3 - _4bz * q1) * fmz;
+    s2 = -_2q0 * fax + _2q3 * fay - 4.0f * q2 * faz +
+         (-_4bx * q2 - _2bz * q0) * fmx + (_2bx * q1 + _2bz * q3) * fmy +
+         (_2bx * q0 - _4bz * q2) * fmz;
+    s3 = _2q1 * fax + _2q2 * fay + (-_4bx * q3 + _2bz * q1) * fmx +
+         (-_2bx * q0 + _2bz * q2) * fmy + _2bx * q1 * fmz;
+  } else {
+    // 6軸 (加速度 + ジャイロ) 版。ヨーはジャイロ積分のみになる。
+    const float _4q0 = 4.0f * q0, _4q1 = 4.0f * q1, _4q2 = 4.0f * q2;
+    const float _8q1 = 8.0f * q1, _8q2 = 8.0f * q2;
+    s0 = _4q0 * q2q2 + _2q2 * ax + _4q0 * q1q1 - _2q1 * ay;
+    s1 = _4q1 * q3q3 - _2q3 * ax + 4.0f * q0q0 * q1 - _2q0 * ay - _4q1 +
+         _8q1 * q1q1 + _8q1 * q2q2 + _4q1 * az;
+    s2 = 4.0f * q0q0 * q2 + _2q0 * ax + _4q2 * q3q3 - _2q3 * ay - _4q2 +
+         _8q2 * q1q1 + _8q2 * q2q2 + _4q2 * az;
+    s3 = 4.0f * q1q1 * q3 - _2q1 * ax + 4.0f * q2q2 * q3 - _2q2 * ay;
+  }
+
+  float s_norm = inv_sqrt(s0 * s0 + s1 * s1 + s2 * s2 + s3 * s3);
+  s0 *= s_norm;
+  s1 *= s_norm;
+  s2 *= s_norm;
+  s3 *= s_norm;
+
+  // --- ジャイロバイアスの推定 (勾配方向を角速度誤差に変換して積分) ---
+  float wex = 2.0f * (q0 * s1 - q1 * s0 - q2 * s3 + q3 * s2);
+  float wey = 2.0f * (q0 * s2 + q1 * s3 - q2 * s0 - q3 * s1);
+  float wez = 2.0f * (q0 * s3 - q1 * s2 + q2 * s1 - q3 * s0);
+  estimate.gyro_bias[0] += wex * dt_s * zeta;
+  estimate.gyro_bias[1] += wey * dt_s * zeta;
+  estimate.gyro_bias[2] += wez * dt_s * zeta;
+
+  // 生のジャイロ値を rad/s に変換し、バイアスを差し引く
+  const float scale = g_config.ahrs_gyro_scale;
+  float gx = gyro.x * scale - estimate.gyro_bias[0];
+  float gy = gyro.y * scale - estimate.gyro_bias[1];
+  float gz = gyro.z * scale - estimate.gyro_bias[2];
+
+  // --- クォータニオンの時間微分 (ジャイロ積分 - 勾配補正) ---
+  float qdot0 = 0.5f * (-q1 * gx - q2 * gy - q3 * gz) - beta * s0;
+  float qdot1 = 0.5f * (q0 * gx + q2 * gz - q3 * gy) - beta * s1;
+  float qdot2 = 0.5f * (q0 * gy - q1 * gz + q3 * gx) - beta * s2;
+  float qdot3 = 0.5f * (q0 * gz + q1 * gy - q2 * gx) - beta * s3;
+
+  q0 += qdot0 * dt_s;
+  q1 += qdot1 * dt_s;
+  q2 += qdot2 * dt_s;
+  q3 += qdot3 * dt_s;
+
+  float q_norm = inv_sqrt(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
+  if (q_norm == 0.0f) {
+    // 数値的に破綻した場合は次のサンプルで再初期化する
+    attitude_init();
+    return;
+  }
+  estimate.q[0] = q0 * q_norm;
+  estimate.q[1] = q1 * q_norm;
+  estimate.q[2] = q2 * q_norm;
+  estimate.q[3] = q3 * q_norm;
+
+  update_euler();
+}
+
+const AttitudeEstimate &attitude_get() { return estimate; }
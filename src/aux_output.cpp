@@ -0,0 +1,162 @@
+#include "aux_output.h"
+#include "config.h"           // グローバル設定オブジェクト g_config を使用するため
+#include "thruster_control.h" // thruster_write_pwm を使用するため
+#include <algorithm>          // std::equal のため
+#include <cstdio>             // std::remove
+#include <fstream>            // std::ofstream, std::ifstream
+#include <stdio.h>            // printf, snprintf のため
+
+// 段階の保存ファイル (systemd による再起動をまたいで状態を保持する)
+static const char *STATE_FILE = "/tmp/rov_led_state.dat";
+// 保存ファイルの先頭に置く識別子 (旧形式のファイルは読み捨てる)
+static const char STATE_FILE_MAGIC[4] = {'A', 'U', 'X', '1'};
+
+// 各出力の現在の段階 (ファイルスコープ、メインスレッド専用)
+static uint8_t current_level[CONFIG_MAX_AUX_OUTPUTS];
+// 最後にハードウェアへ書き込んだチャンネルと PWM 値 (-1 は未書き込み)
+static int written_channel[CONFIG_MAX_AUX_OUTPUTS];
+static int written_pwm[CONFIG_MAX_AUX_OUTPUTS];
+// 前回のボタン状態 (全ボタンの立ち上がりを1回の XOR で検出するため)
+static uint16_t previous_buttons = 0;
+
+// 現在の段階の PWM 値が前回の書き込みと異なる場合だけ出力する
+static void write_if_changed(int index, bool force) {
+  const AuxOutputConfig &aux = g_config.aux_outputs[index];
+  if (current_level[index] >= aux.level_count) {
+    current_level[index] = 0; // 設定の再読み込みで段階数が減った場合
+  }
+  int pwm = aux.levels[current_level[index]];
+  if (force || written_channel[index] != aux.channel ||
+      written_pwm[index] != pwm) {
+    thruster_write_pwm(aux.channel, pwm);
+    written_channel[index] = aux.channel;
+    written_pwm[index] = pwm;
+  }
+}
+
+// 段階を同期用の名前に変換する (従来の LED の状態名と互換)
+static void level_to_string(const AuxOutputConfig &aux, int level,
+                            char *buffer, size_t size) {
+  if (level == 0) {
+    snprintf(buffer, size, "pwm_off");
+  } else if (level == aux.level_count - 1) {
+    snprintf(buffer, size, aux.level_count == 2 ? "pwm_on" : "pwm_max");
+  } else {
+    snprintf(buffer, size, "pwm_on%d", level);
+  }
+}
+
+// --- モジュール関数 ---
+
+void aux_output_init() {
+  for (int i = 0; i < CONFIG_MAX_AUX_OUTPUTS; ++i) {
+    current_level[i] = 0;
+    written_channel[i] = -1;
+    written_pwm[i] = -1;
+  }
+  previous_buttons = 0;
+
+  // --- 保存された段階があれば読み込む ---
+  std::ifstream ifs(STATE_FILE, std::ios::binary);
+  if (ifs) {
+    printf("Restoring LED state from %s...\n", STATE_FILE);
+    char magic[sizeof(STATE_FILE_MAGIC)];
+    uint8_t levels[CONFIG_MAX_AUX_OUTPUTS];
+    if (ifs.read(magic, sizeof(magic)) &&
+        std::equal(magic, magic + sizeof(magic), STATE_FILE_MAGIC) &&
+        ifs.read(reinterpret_cast<char *>(levels), sizeof(levels))) {
+      for (int i = 0; i < CONFIG_MAX_AUX_OUTPUTS; ++i) {
+        current_level[i] = levels[i];
+      }
+    } else {
+      printf("LED state file has an unknown format. Ignored.\n");
+    }
+    ifs.close();
+    // 読み込み後はファイルを削除
+    std::remove(STATE_FILE);
+  }
+
+  // 決定した段階に基づいてすべての出力を書き込む
+  for (int i = 0; i < CONFIG_MAX_AUX_OUTPUTS; ++i) {
+    if (g_config.aux_outputs[i].channel >= 0) {
+      write_if_changed(i, true);
+    }
+  }
+}
+
+void aux_output_update(uint16_t buttons) {
+  // 今回新たに押されたボタンだけを取り出す (立ち上がりエッジ)
+  uint16_t pressed = buttons & (buttons ^ previous_buttons);
+  previous_buttons = buttons;
+
+  for (int i = 0; i < CONFIG_MAX_AUX_OUTPUTS; ++i) {
+    const AuxOutputConfig &aux = g_config.aux_outputs[i];
+    if (aux.channel < 0) {
+      continue;
+    }
+    if (pressed & aux.button_mask) {
+      current_level[i] = static_cast<uint8_t>((current_level[i] + 1) %
+                                              aux.level_count);
+    }
+    write_if_changed(i, false);
+  }
+}
+
+void aux_output_disable() {
+  for (int i = 0; i < CONFIG_MAX_AUX_OUTPUTS; ++i) {
+    const AuxOutputConfig &aux = g_config.aux_outputs[i];
+    if (aux.channel < 0) {
+      continue;
+    }
+    thruster_write_pwm(aux.channel, aux.levels[0]);
+    written_channel[i] = aux.channel;
+    written_pwm[i] = aux.levels[0];
+  }
+}
+
+std::string aux_output_state_string() {
+  std::string result = "led_status:";
+  bool first = true;
+  char state[16];
+  for (int i = 0; i < CONFIG_MAX_AUX_OUTPUTS; ++i) {
+    const AuxOutputConfig &aux = g_config.aux_outputs[i];
+    if (aux.channel < 0) {
+      continue;
+    }
+    level_to_string(aux, current_level[i] % aux.level_count, state,
+                    sizeof(state));
+    if (!first) {
+      result += ',';
+    }
+    result += aux.name + "=" + state;
+    first = false;
+  }
+  return result;
+}
+
+void aux_output_save_state_to_file() {
+  std::ofstream ofs(STATE_FILE, std::ios::binary | std::ios::trunc);
+  if (ofs) {
+    ofs.write(STATE_FILE_MAGIC, sizeof(STATE_FILE_MAGIC));
+    ofs.write(reinterpret_cast<const char *>(current_level),
+              sizeof(current_level));
+    printf("LED State saved to %s\n", STATE_FILE);
+  } else {
+    perror("Failed to save LED state");
+  }
+}
+
+void aux_output_get_levels(uint8_t levels[CONFIG_MAX_AUX_OUTPUTS]) {
+  for (int i = 0; i < CONFIG_MAX_AUX_OUTPUTS; ++i) {
+    levels[i] = current_level[i];
+  }
+}
+
+void aux_output_set_levels(const uint8_t levels[CONFIG_MAX_AUX_OUTPUTS]) {
+  for (int i = 0; i < CONFIG_MAX_AUX_OUTPUTS; ++i) {
+    current_level[i] = levels[i];
+    if (g_config.aux_outputs[i].channel >= 0) {
+      write_if_changed(i, true);
+    }
+  }
+}
@@ -1,10 +1,19 @@
 #include "config.h"
+#include "config_schema.h" // 設定項目の表 (パース・検証)
+#include "gamepad.h" // GamepadButton (既定のボタン) のため
 #include <fstream>
+#include <iostream>
 #include <sstream>
-#include <algorithm> // for std::transform
-#include <cctype>    // for std::isspace
+#include <algorithm> // for std::copy, std::fill
 #include <atomic>    // for std::atomic
 #include <mutex>     // for std::mutex
+#include <errno.h>
+#include <fcntl.h>     // open
+#include <stdio.h>     // rename
+#include <stdlib.h>    // mkostemp
+#include <string.h>    // strerror
+#include <sys/stat.h>  // stat, fchmod (元のファイルの権限を引き継ぐため)
+#include <unistd.h>    // write, fsync, close, unlink
 
 // グローバル設定オブジェクトの実体
 AppConfig g_config;
@@ -13,43 +22,108 @@ std::mutex g_config_mutex;
 
 // 設定ファイルが更新されたことをメインスレッドに通知するためのフラグ
 std::atomic<bool> g_config_updated_flag(false);
+// g_config を変更するたびに増やすカウンタ (設定同期スレッドが機体側の変更を検出するため)
+std::atomic<unsigned> g_config_change_count(0);
 
 // AppConfig コンストラクタの実装 (デフォルト値の設定)
 AppConfig::AppConfig() :
     pwm_min(1100), pwm_neutral(1500), pwm_normal_max(1900), pwm_boost_max(1900), pwm_frequency(50.0f),
     joystick_deadzone(6500),
-    led_pwm_channel(9), led_pwm_on(1900), led_pwm_off(1100),
-    led2_pwm_channel(10), led2_pwm_off(1100), led2_pwm_on1(1300), led2_pwm_on2(1600), led2_pwm_max(1900),
-    led3_pwm_channel(11), led3_pwm_off(1100), led3_pwm_on1(1300), led3_pwm_on2(1600), led3_pwm_max(1900),
-    led4_pwm_channel(12), led4_pwm_off(1100), led4_pwm_on1(1300), led4_pwm_on2(1600), led4_pwm_max(1900),
-    led5_pwm_channel(13), led5_pwm_off(1100), led5_pwm_on1(1300), led5_pwm_on2(1600), led5_pwm_max(1900),
     smoothing_factor_horizontal(0.08f), smoothing_factor_vertical(0.04f),
     kp_roll(0.2f), kp_yaw(0.15f), yaw_threshold_dps(0.5f), yaw_gain(1000.0f),
+    ahrs_beta(0.1f), ahrs_zeta(0.015f), ahrs_gyro_scale(0.0174533f), ahrs_use_mag(true),
+    depth_hold_button(0x0010), depth_water_density(1025.0f), depth_pressure_to_pa(1000.0f),
+    depth_surface_pressure_pa(0.0f), depth_calibration_samples(50), depth_filter_alpha(0.2f),
+    depth_kp(200.0f), depth_ki(20.0f), depth_kd(100.0f), depth_integral_limit(10.0f),
+    depth_max_output(400), depth_output_sign(1),
+    heading_hold_enabled(true), heading_hold_kp(8.0f), heading_hold_kd(4.0f),
+    heading_hold_max_output(400), heading_hold_rate_limit(2000.0f), heading_hold_latch_rate_dps(5.0f),
+    thrust_curve_enabled(false), thrust_curve_csv("thrust_curves/t200_example.csv"),
+    power_limit_enabled(false), power_budget_a(60.0f), power_thruster_full_current_a(17.0f),
+    power_current_exponent(2.0f), power_base_current_a(1.0f),
+    power_voltage_adc_channel(0), power_voltage_scale(11.0f),
+    power_current_adc_channel(1), power_current_scale(37.8788f), power_current_offset(0.33f),
+    power_low_voltage_v(14.0f), power_cutoff_voltage_v(12.0f),
+    inversion_response(InversionResponse::RESTART), inversion_filter_tau_s(0.2f),
+    inversion_enter_angle_deg(120.0f), inversion_exit_angle_deg(60.0f), inversion_dwell_s(0.5f),
+    inversion_calibration_samples(20), inversion_spike_ratio(2.5f), inversion_reference_z_sign(0),
+    recorder_enabled(false), recorder_directory("recordings"), recorder_buffer_kb(1024), recorder_max_file_mb(1024),
+    trace_enabled(false), trace_buffer_events(16384), trace_directory("traces"),
+    latency_window_s(10.0f),
+    metrics_enabled(true), metrics_bind("127.0.0.1"), metrics_port(9100),
+    live_state_enabled(true), live_state_shm_name("/rov_live_state"),
     network_recv_port(12345), network_send_port(12346), client_host("192.168.4.10"), connection_timeout_seconds(0.2),
     sensor_send_interval(10), loop_delay_us(10000),
-    gst1_device("/dev/video2"), gst1_port(5000),
-    gst1_width(1280), gst1_height(720), gst1_framerate_num(30), gst1_framerate_den(1),
-    gst1_is_h264_native_source(true), gst1_rtp_payload_type(96), gst1_rtp_config_interval(1),
-    gst2_device("/dev/video6"), gst2_port(5001),
-    gst2_width(1280), gst2_height(720), gst2_framerate_num(30), gst2_framerate_den(1),
-    gst2_is_h264_native_source(false), gst2_rtp_payload_type(96), gst2_rtp_config_interval(1),
-    gst2_x264_bitrate(5000), gst2_x264_tune("zerolatency"), gst2_x264_speed_preset("superfast"),
-    config_sync_cpp_recv_port(12348), config_sync_wpf_host("192.168.4.10"), config_sync_wpf_recv_port(12347)
-{}
+    video_bitrate_adaptive(false), video_bitrate_min_kbps(800), video_bitrate_max_kbps(5000),
+    video_bitrate_control_gap_ms(100),
+    config_sync_cpp_recv_port(12348), config_sync_wpf_host("192.168.4.10"), config_sync_wpf_recv_port(12347),
+    config_watch_file(true), config_watch_debounce_ms(300), config_generation(0)
+{
+    // 補助出力: 従来の LED1 (Yボタン, ON/OFF) と LED2~5 (十字キー, 4段階) を既定値とする
+    static const int ON_OFF_LEVELS[] = {1100, 1900};
+    static const int DIMMER_LEVELS[] = {1100, 1300, 1600, 1900};
+    for (int i = 0; i < CONFIG_MAX_AUX_OUTPUTS; ++i) {
+        AuxOutputConfig& aux = aux_outputs[i];
+        aux.name = (i == 0) ? "led" : ((i < 5) ? "led" : "aux") + std::to_string(i + 1);
+        aux.channel = -1;
+        aux.button_mask = 0;
+        aux.level_count = 2;
+        std::copy(ON_OFF_LEVELS, ON_OFF_LEVELS + 2, aux.levels);
+        std::fill(aux.levels + 2, aux.levels + CONFIG_MAX_AUX_LEVELS, 1100);
+    }
+    // カメラ: 従来のカメラ1 (H.264 出力) とカメラ2 (MJPEG を x264enc でエンコード) を既定値とする
+    for (int i = 0; i < CONFIG_MAX_CAMERAS; ++i) {
+        CameraConfig& camera = cameras[i];
+        camera.device = (i == 0) ? "/dev/video2" : ((i == 1) ? "/dev/video6" : "");
+        camera.port = 5000 + i;
+        camera.width = 1280;
+        camera.height = 720;
+        camera.framerate_num = 30;
+        camera.framerate_den = 1;
+        camera.is_h264_native_source = (i == 0);
+        camera.rtp_payload_type = 96;
+        camera.rtp_config_interval = 1;
+        camera.low_latency = true;
+        camera.key_int_max = 30;
+        camera.x264_bitrate = 5000;
+        camera.x264_tune = "zerolatency";
+        camera.x264_speed_preset = "superfast";
+        camera.x264_slices = 0;
+    }
+    static const int DEFAULT_BUTTONS[] = {GamepadButton::Y, GamepadButton::DPadUp, GamepadButton::DPadDown,
+                                          GamepadButton::DPadLeft, GamepadButton::DPadRight};
+    for (int i = 0; i < 5; ++i) {
+        aux_outputs[i].channel = 9 + i;
+        aux_outputs[i].button_mask = DEFAULT_BUTTONS[i];
+        if (i > 0) {
+            aux_outputs[i].level_count = 4;
+            std::copy(DIMMER_LEVELS, DIMMER_LEVELS + 4, aux_outputs[i].levels);
+        }
+    }
+}
 
-// ヘルパー関数: 文字列の前後の空白を削除
-static std::string trim(const std::string& str) {
-    size_t first = str.find_first_not_of(" \t\n\r\f\v");
-    if (std::string::npos == first) return str;
-    size_t last = str.find_last_not_of(" \t\n\r\f\v");
-    return str.substr(first, (last - first + 1));
+bool parseConfig(std::istream& input, const std::string& filename, AppConfig& out) {
+    // 項目の解釈と検証は config_schema.cpp の表に従う (ConfigSynchronizer と共通)
+    IniDocument doc;
+    doc.parse(input);
+    return config_from_document(doc, filename, out);
 }
 
-// ヘルパー関数: 文字列を小文字に変換
-static std::string toLower(std::string s) {
-    std::transform(s.begin(), s.end(), s.begin(),
-                   [](unsigned char c){ return static_cast<unsigned char>(std::tolower(c)); });
-    return s;
+// パース済みの設定を g_config に反映する (loadConfig と loadConfigWithFallback で共通)
+static bool apply_config(std::istream& input, const std::string& filename) {
+    AppConfig temp_config;
+    if (!parseConfig(input, filename, temp_config)) {
+        return false;
+    }
+
+    // すべてのパースが成功したら、ロックを取得してグローバル設定をアトミックに更新
+    {
+        std::lock_guard<std::mutex> lock(g_config_mutex);
+        g_config = temp_config;
+    }
+
+    std::cout << "設定ファイル '" << filename << "' を正常に読み込み、適用しました。" << std::endl;
+    return true;
 }
 
 bool loadConfig(const std::string& filename) {
@@ -58,123 +132,108 @@ bool loadConfig(const std::string& filename) {
         std::cerr << "エラー: 設定ファイル '" << filename << "' を開けません。デフォルト値を使用します。" << std::endl;
         return false;
     }
+    return apply_config(file, filename);
+}
 
-    // 一時的な設定オブジェクトを作成し、パースがすべて成功した場合にのみ
-    // グローバル設定オブジェクトを更新する。
-    AppConfig temp_config;
+std::string config_last_good_path(const std::string& path) {
+    return path + ".last-good";
+}
 
-    std::string line;
-    std::string current_section;
-    int line_num = 0;
+static bool read_file(const std::string& path, std::string& contents) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::stringstream ss;
+    ss << file.rdbuf();
+    contents = ss.str();
+    return true;
+}
 
-    while (std::getline(file, line)) {
-        line_num++;
-        line = trim(line);
+// rename を確定させるため、ファイルのあるディレクトリを fsync する
+static void sync_parent_directory(const std::string& path) {
+    size_t slash = path.rfind('/');
+    std::string directory = slash == std::string::npos ? "." : (slash == 0 ? "/" : path.substr(0, slash));
+    int fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+}
 
-        if (line.empty() || line[0] == '#' || line[0] == ';') {
+bool config_write_file_atomic(const std::string& path, const std::string& contents) {
+    // 同じディレクトリに書く (rename が同じファイルシステム内で完結するように)
+    // 一時ファイル名は書き込みごとに変える (複数のスレッドが同時に保存しても互いの一時ファイルを壊さない)
+    std::string temp_path = path + ".XXXXXX";
+    mode_t mode = 0644;
+    struct stat st;
+    if (stat(path.c_str(), &st) == 0) {
+        mode = st.st_mode & 07777;
+    }
+    int fd = mkostemp(&temp_path[0], O_CLOEXEC);
+    if (fd < 0) {
+        std::cerr << "エラー: '" << temp_path << "' を作成できません: " << strerror(errno) << std::endl;
+        return false;
+    }
+    // mkostemp は 0600 で作るので、元のファイルの権限に合わせる
+    fchmod(fd, mode);
+    size_t written = 0;
+    while (written < contents.size()) {
+        ssize_t n = write(fd, contents.data() + written, contents.size() - written);
+        if (n < 0 && errno == EINTR) {
             continue;
         }
-
-        if (line[0] == '[' && line.back() == ']') {
-            current_section = toLower(line.substr(1, line.length() - 2));
-            continue;
+        if (n <= 0) {
+            break;
         }
-
-        size_t eq_pos = line.find('=');
-        if (eq_pos == std::string::npos) {
-            std::cerr << "警告: " << filename << " の " << line_num << " 行目: '=' が見つかりません。スキップします。" << std::endl;
-            continue;
+        written += static_cast<size_t>(n);
+    }
+    // 内容がディスクに届いてから置き換える (先に rename すると、電源断で空のファイルが残りうる)
+    bool ok = written == contents.size() && fsync(fd) == 0;
+    int saved_errno = errno;
+    close(fd);
+    if (!ok || rename(temp_path.c_str(), path.c_str()) != 0) {
+        if (ok) {
+            saved_errno = errno;
         }
+        std::cerr << "エラー: '" << path << "' を保存できません: " << strerror(saved_errno) << std::endl;
+        unlink(temp_path.c_str());
+        return false;
+    }
+    sync_parent_directory(path);
+    return true;
+}
 
-        std::string key = toLower(trim(line.substr(0, eq_pos)));
-        std::string value = trim(line.substr(eq_pos + 1));
-
-        try {
-            if (current_section == "pwm") {
-                if (key == "pwm_min") temp_config.pwm_min = std::stoi(value);
-                else if (key == "pwm_neutral") temp_config.pwm_neutral = std::stoi(value);
-                else if (key == "pwm_normal_max") temp_config.pwm_normal_max = std::stoi(value);
-                else if (key == "pwm_boost_max") temp_config.pwm_boost_max = std::stoi(value);
-                else if (key == "pwm_frequency") temp_config.pwm_frequency = std::stof(value);
-            } else if (current_section == "joystick") {
-                if (key == "deadzone") temp_config.joystick_deadzone = std::stoi(value);
-            } else if (current_section == "led") {
-                if (key == "channel") temp_config.led_pwm_channel = std::stoi(value);
-                else if (key == "on_value") temp_config.led_pwm_on = std::stoi(value);
-                else if (key == "off_value") temp_config.led_pwm_off = std::stoi(value);
-            } else if (current_section == "led2") {
-                if (key == "channel") temp_config.led2_pwm_channel = std::stoi(value);
-                else if (key == "off_value") temp_config.led2_pwm_off = std::stoi(value);
-                else if (key == "on1_value") temp_config.led2_pwm_on1 = std::stoi(value);
-                else if (key == "on2_value") temp_config.led2_pwm_on2 = std::stoi(value);
-                else if (key == "max_value") temp_config.led2_pwm_max = std::stoi(value);
-            } else if (current_section == "led3") {
-                if (key == "channel") temp_config.led3_pwm_channel = std::stoi(value);
-                else if (key == "off_value") temp_config.led3_pwm_off = std::stoi(value);
-                else if (key == "on1_value") temp_config.led3_pwm_on1 = std::stoi(value);
-                else if (key == "on2_value") temp_config.led3_pwm_on2 = std::stoi(value);
-                else if (key == "max_value") temp_config.led3_pwm_max = std::stoi(value);
-            } else if (current_section == "led4") {
-                if (key == "channel") temp_config.led4_pwm_channel = std::stoi(value);
-                else if (key == "off_value") temp_config.led4_pwm_off = std::stoi(value);
-                else if (key == "on1_value") temp_config.led4_pwm_on1 = std::stoi(value);
-                else if (key == "on2_value") temp_config.led4_pwm_on2 = std::stoi(value);
-                else if (key == "max_value") temp_config.led4_pwm_max = std::stoi(value);
-            } else if (current_section == "led5") {
-                if (key == "channel") temp_config.led5_pwm_channel = std::stoi(value);
-                else if (key == "off_value") temp_config.led5_pwm_off = std::stoi(value);
-                else if (key == "on1_value") temp_config.led5_pwm_on1 = std::stoi(value);
-                else if (key == "on2_value") temp_config.led5_pwm_on2 = std::stoi(value);
-                else if (key == "max_value") temp_config.led5_pwm_max = std::stoi(value);
-            } else if (current_section == "thruster_control") {
-                if (key == "smoothing_factor_horizontal") temp_config.smoothing_factor_horizontal = std::stof(value);
-                else if (key == "smoothing_factor_vertical") temp_config.smoothing_factor_vertical = std::stof(value);
-                else if (key == "kp_roll") temp_config.kp_roll = std::stof(value);
-                else if (key == "kp_yaw") temp_config.kp_yaw = std::stof(value);
-                else if (key == "yaw_threshold_dps") temp_config.yaw_threshold_dps = std::stof(value);
-                else if (key == "yaw_gain") temp_config.yaw_gain = std::stof(value);
-            } else if (current_section == "network") {
-                if (key == "recv_port") temp_config.network_recv_port = std::stoi(value);
-                else if (key == "send_port") temp_config.network_send_port = std::stoi(value);
-                else if (key == "client_host") temp_config.client_host = value;
-                else if (key == "connection_timeout_seconds") temp_config.connection_timeout_seconds = std::stod(value);
-            } else if (current_section == "application") {
-                if (key == "sensor_send_interval") temp_config.sensor_send_interval = std::stoul(value);
-                else if (key == "loop_delay_us") temp_config.loop_delay_us = std::stoul(value);
-            } else if (current_section == "gstreamer_camera_1") {
-                if (key == "port") temp_config.gst1_port = std::stoi(value);
-                else if (key == "width") temp_config.gst1_width = std::stoi(value);
-                else if (key == "height") temp_config.gst1_height = std::stoi(value); else if (key == "framerate_num") temp_config.gst1_framerate_num = std::stoi(value);
-                else if (key == "framerate_den") temp_config.gst1_framerate_den = std::stoi(value); else if (key == "is_h264_native_source") temp_config.gst1_is_h264_native_source = (toLower(value) == "true");
-                else if (key == "rtp_payload_type") temp_config.gst1_rtp_payload_type = std::stoi(value); else if (key == "rtp_config_interval") temp_config.gst1_rtp_config_interval = std::stoi(value);
-            } else if (current_section == "gstreamer_camera_2") {
-                if (key == "port") temp_config.gst2_port = std::stoi(value);
-                else if (key == "width") temp_config.gst2_width = std::stoi(value);
-                else if (key == "height") temp_config.gst2_height = std::stoi(value); else if (key == "framerate_num") temp_config.gst2_framerate_num = std::stoi(value);
-                else if (key == "framerate_den") temp_config.gst2_framerate_den = std::stoi(value); else if (key == "is_h264_native_source") temp_config.gst2_is_h264_native_source = (toLower(value) == "true");
-                else if (key == "rtp_payload_type") temp_config.gst2_rtp_payload_type = std::stoi(value); else if (key == "rtp_config_interval") temp_config.gst2_rtp_config_interval = std::stoi(value);
-                else if (key == "x264_bitrate") temp_config.gst2_x264_bitrate = std::stoi(value); else if (key == "x264_tune") temp_config.gst2_x264_tune = value;
-                else if (key == "x264_speed_preset") temp_config.gst2_x264_speed_preset = value;
-            } else if (current_section == "config_sync") {
-                if (key == "cpp_recv_port") temp_config.config_sync_cpp_recv_port = std::stoi(value);
-                else if (key == "wpf_host") temp_config.config_sync_wpf_host = value;
-                else if (key == "wpf_recv_port") temp_config.config_sync_wpf_recv_port = std::stoi(value);
-            }
-        } catch (const std::invalid_argument& e) {
-            std::cerr << "エラー: " << filename << " の " << line_num << " 行目: 数値変換エラー (" << key << "=" << value << ") - " << e.what() << std::endl;
-            return false; // パース失敗
-        } catch (const std::out_of_range& e) {
-            std::cerr << "エラー: " << filename << " の " << line_num << " 行目: 数値が範囲外 (" << key << "=" << value << ") - " << e.what() << std::endl;
-            return false; // パース失敗
+bool loadConfigWithFallback(const std::string& filename) {
+    std::string last_good_path = config_last_good_path(filename);
+    std::string contents;
+    std::string last_good;
+    bool have_last_good = read_file(last_good_path, last_good);
+    bool have_contents = read_file(filename, contents);
+    if (!have_contents) {
+        std::cerr << "エラー: 設定ファイル '" << filename << "' を開けません。" << std::endl;
+    }
+    std::istringstream input(contents);
+    // 読み込んだ内容をそのままパースする (控えと比べる内容と、適用する内容を一致させるため)
+    if (have_contents && apply_config(input, filename)) {
+        // 次に読み込めなかったときのために、正常に読み込めた内容を控えておく
+        if (!have_last_good || last_good != contents) {
+            config_write_file_atomic(last_good_path, contents);
         }
+        return true;
     }
 
-    // すべてのパースが成功したら、ロックを取得してグローバル設定をアトミックに更新
-    {
-        std::lock_guard<std::mutex> lock(g_config_mutex);
-        g_config = temp_config;
+    std::istringstream last_good_input(last_good);
+    if (!have_last_good || !apply_config(last_good_input, last_good_path)) {
+        return false;
     }
-
-    std::cout << "設定ファイル '" << filename << "' を正常に読み込み、適用しました。" << std::endl;
+    std::cerr << "警告: 設定ファイル '" << filename << "' を読み込めないため、最後に正常に読み込めた設定 (世代 "
+              << g_config.config_generation << ") で起動します。" << std::endl;
+    // 壊れたファイルは調査できるよう残し、他のスレッドが読む設定ファイルを控えの内容に戻す
+    std::string broken_path = filename + ".broken";
+    if (rename(filename.c_str(), broken_path.c_str()) == 0) {
+        std::cerr << "  読み込めなかったファイルは '" << broken_path << "' に移しました。" << std::endl;
+    }
+    config_write_file_atomic(filename, last_good);
     return true;
-}
\ No newline at end of file
+}
@@ -0,0 +1,324 @@
+// config_reloader.cpp
+#include "config_reloader.h"
+#include "config_schema.h"       // 変更された項目の検出のため
+#include "config_synchronizer.h" // g_config_updated_flag, g_config_change_count を使用するため
+#include "flight_recorder.h"     // 適用した設定を記録するため
+#include "metrics.h"             // リロードの回数と所要時間を記録するため
+#include <errno.h>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <poll.h>
+#include <sstream>
+#include <string.h>      // strerror
+#include <sys/inotify.h> // 設定ファイルの直接の編集を検知するため
+#include <time.h>
+#include <unistd.h>      // read, close
+#include <utility>
+
+// 更新フラグを確認する間隔 (設定ファイルの監視中は、書き換えがあればすぐに起きる)
+static const int RELOAD_POLL_INTERVAL_MS = 50;
+
+static int64_t monotonic_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+void config_record_apply(ConfigApplyTarget target, int64_t elapsed_ns) {
+    g_metrics.config_apply_target_ns[target].store(elapsed_ns, std::memory_order_relaxed);
+    metrics_increment(g_metrics.config_apply_target_count[target]);
+}
+
+ConfigReloader::ConfigReloader(const std::string& config_path)
+    : m_config_path(config_path), m_shutdown_flag(false), m_pending(nullptr), m_retired(nullptr),
+      m_watch_fd(-1), m_watch_debounce_ns(0), m_watch_event_ns(0) {
+    {
+        std::lock_guard<std::mutex> lock(g_config_mutex);
+        m_base = g_config;
+    }
+    for (int i = 0; i < CONFIG_APPLY_TARGET_COUNT; ++i) {
+        m_handlers[i] = nullptr;
+    }
+}
+
+ConfigReloader::~ConfigReloader() {
+    stop();
+}
+
+void ConfigReloader::set_handler(ConfigApplyTarget target, ConfigApplyHandler handler) {
+    m_handlers[target] = handler;
+}
+
+void ConfigReloader::start() {
+    m_shutdown_flag.store(false);
+    m_thread = std::thread(&ConfigReloader::run, this);
+}
+
+void ConfigReloader::stop() {
+    m_shutdown_flag.store(true);
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    free_snapshot(m_pending.exchange(nullptr));
+    free_snapshot(m_retired.exchange(nullptr));
+}
+
+void ConfigReloader::run() {
+    {
+        std::lock_guard<std::mutex> lock(g_config_mutex);
+        m_watch_debounce_ns = static_cast<int64_t>(g_config.config_watch_debounce_ms) * 1000000LL;
+    }
+    // 起動時に読み込んだ内容 (直接の編集で中身が変わったかの判定に使う)
+    read_config_file(m_loaded_contents);
+    open_watch();
+
+    while (!m_shutdown_flag.load()) {
+        // 制御スレッドが適用を終えた設定の残りの担当を反映し、古い設定を解放する
+        collect_retired();
+
+        if (g_config_updated_flag.exchange(false)) {
+            reload();
+        }
+        // エディタは保存時に何度も書き込むため、最後の書き込みから一定時間が過ぎてから読み込む
+        if (m_watch_event_ns != 0 && monotonic_ns() - m_watch_event_ns >= m_watch_debounce_ns) {
+            m_watch_event_ns = 0;
+            reload_if_changed();
+        }
+
+        // 待機中に設定ファイルが書き換えられたらすぐに起きる (監視しない場合は単に待つ)
+        struct pollfd pfd;
+        pfd.fd = m_watch_fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        if (poll(&pfd, m_watch_fd >= 0 ? 1 : 0, RELOAD_POLL_INTERVAL_MS) > 0) {
+            read_watch_events();
+        }
+    }
+    close_watch();
+}
+
+void ConfigReloader::open_watch() {
+    bool enabled;
+    {
+        std::lock_guard<std::mutex> lock(g_config_mutex);
+        enabled = g_config.config_watch_file;
+    }
+    if (!enabled) {
+        return;
+    }
+    // エディタは一時ファイルに書いてから rename で置き換えることが多く、その場合はファイル自体の
+    // 監視が古い inode に残ってしまう。ディレクトリを監視し、設定ファイルの名前で絞り込む
+    std::string directory = ".";
+    m_watch_name = m_config_path;
+    size_t slash = m_config_path.rfind('/');
+    if (slash != std::string::npos) {
+        directory = slash == 0 ? "/" : m_config_path.substr(0, slash);
+        m_watch_name = m_config_path.substr(slash + 1);
+    }
+    m_watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_watch_fd < 0) {
+        std::cerr << "警告: inotify を初期化できません (" << strerror(errno)
+                  << ")。設定ファイルの直接の編集は検知されません。" << std::endl;
+        return;
+    }
+    if (inotify_add_watch(m_watch_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0) {
+        std::cerr << "警告: '" << directory << "' を監視できません (" << strerror(errno)
+                  << ")。設定ファイルの直接の編集は検知されません。" << std::endl;
+        close_watch();
+        return;
+    }
+    std::cout << "設定ファイル '" << m_config_path << "' の変更を監視します。" << std::endl;
+}
+
+void ConfigReloader::close_watch() {
+    if (m_watch_fd >= 0) {
+        close(m_watch_fd);
+        m_watch_fd = -1;
+    }
+    m_watch_event_ns = 0;
+}
+
+void ConfigReloader::read_watch_events() {
+    alignas(struct inotify_event) char buffer[4096];
+    while (true) {
+        ssize_t n = read(m_watch_fd, buffer, sizeof(buffer));
+        if (n <= 0) {
+            return; // EAGAIN: 読み終えた
+        }
+        for (ssize_t offset = 0; offset < n;) {
+            const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(buffer + offset);
+            offset += sizeof(struct inotify_event) + event->len;
+            // イベントが溢れた場合は、設定ファイルが含まれていたものとして扱う
+            if ((event->mask & IN_Q_OVERFLOW) || (event->len > 0 && m_watch_name == event->name)) {
+                m_watch_event_ns = monotonic_ns();
+            }
+        }
+    }
+}
+
+bool ConfigReloader::read_config_file(std::string& contents) {
+    std::ifstream file(m_config_path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::stringstream ss;
+    ss << file.rdbuf();
+    contents = ss.str();
+    return true;
+}
+
+void ConfigReloader::reload() {
+    collect_retired();
+    std::cout << "設定ファイルが更新されました。リロードします..." << std::endl;
+    int64_t start_ns = monotonic_ns();
+
+    std::string contents;
+    if (!read_config_file(contents)) {
+        std::cerr << "警告: 設定ファイル '" << m_config_path
+                  << "' を開けません。古い設定で動作を継続します。" << std::endl;
+        metrics_increment(g_metrics.config_reload_failures);
+        return;
+    }
+    load(contents, start_ns);
+}
+
+void ConfigReloader::reload_if_changed() {
+    collect_retired();
+    int64_t start_ns = monotonic_ns();
+    std::string contents;
+    // 置き換えの途中でファイルが無い場合は、続くイベントで読み込む
+    // (設定同期による保存はすでにリロード済みなので、内容が同じなら読み直さない)
+    if (!read_config_file(contents) || contents == m_loaded_contents) {
+        return;
+    }
+    std::cout << "設定ファイルが直接編集されました。リロードします..." << std::endl;
+    load(contents, start_ns);
+}
+
+void ConfigReloader::load(const std::string& contents, int64_t start_ns) {
+    // 不正な内容でも記録しておき、同じ内容で何度も警告しないようにする
+    m_loaded_contents = contents;
+
+    ConfigSnapshot* snapshot = new ConfigSnapshot();
+    snapshot->thrust_curve = nullptr;
+    snapshot->changes = 0;
+    snapshot->contents = contents;
+    std::istringstream input(snapshot->contents);
+    if (!parseConfig(input, m_config_path, snapshot->config)) {
+        std::cerr << "警告: 設定ファイルのリロードに失敗しました。古い設定で動作を継続します。"
+                  << std::endl;
+        metrics_increment(g_metrics.config_reload_failures);
+        free_snapshot(snapshot);
+        return;
+    }
+    // 検証に通った内容を、起動時に読み込めなかった場合の控えとして残す
+    config_write_file_atomic(config_last_good_path(m_config_path), contents);
+    snapshot->thrust_curve_ok = thrust_curve_build(snapshot->config, &snapshot->thrust_curve);
+
+    // 適用待ちが無ければ、差分の基準を現在の g_config にする
+    // (パラメータ要求の live の変更はファイルを経由しないため、前回読み込んだ内容と異なることがある)
+    if (m_pending.load(std::memory_order_acquire) == nullptr) {
+        std::lock_guard<std::mutex> lock(g_config_mutex);
+        m_base = g_config;
+    }
+
+    // 変更された項目をログに残し、反映する担当をまとめる (比較は config_schema.cpp の表に従う)
+    std::vector<const ConfigField*> changed = config_diff(m_base, snapshot->config);
+    for (size_t i = 0; i < changed.size(); ++i) {
+        std::cout << "  " << config_field_name(*changed[i]) << ": "
+                  << config_format_field(*changed[i], m_base) << " -> "
+                  << config_format_field(*changed[i], snapshot->config)
+                  << ((changed[i]->apply & CONFIG_APPLY_BIT(CONFIG_APPLY_RESTART)) ? " (再起動後に反映)" : "")
+                  << std::endl;
+    }
+    unsigned changes = config_apply_targets(changed);
+    m_base = snapshot->config;
+
+    g_metrics.config_parse_ns.store(monotonic_ns() - start_ns, std::memory_order_relaxed);
+    // 制御スレッドがまだ適用していない設定があれば、新しい方で置き換える。
+    // 置き換えた設定の変更も未反映なので、担当を引き継ぐ
+    // (適用待ちの設定を解放するのはこのスレッドだけなので、読み出しても競合しない)
+    ConfigSnapshot* replaced = m_pending.load(std::memory_order_acquire);
+    do {
+        snapshot->changes = changes | (replaced ? replaced->changes : 0);
+    } while (!m_pending.compare_exchange_weak(replaced, snapshot, std::memory_order_acq_rel,
+                                              std::memory_order_acquire));
+    free_snapshot(replaced);
+}
+
+unsigned ConfigReloader::apply_pending() {
+    // 前回の古い設定が解放されるまでは次の設定を適用しない (次の周期で再確認)
+    if (m_retired.load(std::memory_order_acquire) != nullptr) {
+        return 0;
+    }
+    ConfigSnapshot* snapshot = m_pending.exchange(nullptr, std::memory_order_acq_rel);
+    if (snapshot == nullptr) {
+        return 0;
+    }
+    int64_t start_ns = monotonic_ns();
+    {
+        // 文字列はムーブで交換されるため、メモリの確保・解放は発生しない
+        std::lock_guard<std::mutex> lock(g_config_mutex);
+        std::swap(g_config, snapshot->config);
+        // 読み込み後にパラメータ要求で live に変更された項目は、差分の基準 (m_base) に含まれていない。
+        // 実際に適用していた設定と比べ、ファイルの値に戻る項目の担当も反映する
+        snapshot->changes |= config_scalar_apply_targets(g_config, snapshot->config);
+    }
+    g_config_change_count.fetch_add(1, std::memory_order_release);
+    if (snapshot->thrust_curve_ok) {
+        snapshot->thrust_curve = thrust_curve_install(snapshot->thrust_curve);
+    }
+    flight_recorder_note_config_contents(snapshot->contents);
+    int64_t elapsed_ns = monotonic_ns() - start_ns;
+    g_metrics.config_apply_ns.store(elapsed_ns, std::memory_order_relaxed);
+    metrics_increment(g_metrics.config_reloads);
+    if (snapshot->changes & CONFIG_APPLY_BIT(CONFIG_APPLY_CONTROL)) {
+        config_record_apply(CONFIG_APPLY_CONTROL, elapsed_ns);
+    }
+    if (snapshot->changes & CONFIG_APPLY_BIT(CONFIG_APPLY_RESTART)) {
+        config_record_apply(CONFIG_APPLY_RESTART, 0); // 再起動を待つ変更があったことだけを数える
+    }
+
+    // 交換した古い設定と推力曲線テーブルはリロード用スレッドで解放する
+    // (リロード用スレッドが担当する反映もそのときに行う)
+    unsigned changes = snapshot->changes;
+    m_retired.store(snapshot, std::memory_order_release);
+    return changes;
+}
+
+void ConfigReloader::collect_retired() {
+    ConfigSnapshot* retired = m_retired.exchange(nullptr, std::memory_order_acquire);
+    if (retired == nullptr) {
+        return;
+    }
+    // 交換後の retired->config は適用前の設定
+    AppConfig current;
+    bool have_current = false;
+    for (int target = 0; target < CONFIG_APPLY_TARGET_COUNT; ++target) {
+        if (m_handlers[target] == nullptr || !(retired->changes & CONFIG_APPLY_BIT(target))) {
+            continue;
+        }
+        if (!have_current) {
+            std::lock_guard<std::mutex> lock(g_config_mutex);
+            current = g_config;
+            have_current = true;
+        }
+        int64_t start_ns = monotonic_ns();
+        if (m_handlers[target](current, retired->config)) {
+            config_record_apply(static_cast<ConfigApplyTarget>(target), monotonic_ns() - start_ns);
+        } else {
+            std::cerr << "警告: 設定の変更を " << config_apply_target_name(target)
+                      << " に反映できませんでした。" << std::endl;
+        }
+    }
+    free_snapshot(retired);
+}
+
+void ConfigReloader::free_snapshot(ConfigSnapshot* snapshot) {
+    if (snapshot == nullptr) {
+        return;
+    }
+    thrust_curve_free(snapshot->thrust_curve);
+    delete snapshot;
+}
@@ -0,0 +1,723 @@
+// config_schema.cpp
+#include "config_schema.h"
+#include "gamepad.h" // GamepadButton (ボタン名の解釈) のため
+#include <algorithm> // std::copy, std::sort のため
+#include <cmath>     // std::isfinite のため
+#include <cstdio>    // snprintf のため
+#include <cstdlib>   // strtod, atoi のため
+#include <cstring>   // strlen, strspn, memcmp のため
+#include <limits>    // std::numeric_limits のため
+#include <strings.h> // strcasecmp のため
+#include <sstream>
+#include <stdexcept>
+
+// 範囲の制限が無い数値
+static const double ANY = std::numeric_limits<double>::infinity();
+
+// 単純なメンバーの項目を定義するマクロ (格納先はラムダで返す)
+#define CONFIG_FIELD(section, key, type, member, lo, hi) \
+    {section, key, type, lo, hi, [](AppConfig& c, int) -> void* { return &c.member; }, 0, 0, 0}
+
+// 補助出力 (AUX_1 ~ AUX_8) と推力曲線のチャンネル別 CSV のセクション名・キー
+static const char* const AUX_SECTIONS[CONFIG_MAX_AUX_OUTPUTS] = {
+    "AUX_1", "AUX_2", "AUX_3", "AUX_4", "AUX_5", "AUX_6", "AUX_7", "AUX_8"};
+// カメラ (CAMERA_1 ~ CAMERA_4。従来の GSTREAMER_CAMERA_n は別名)
+static const char* const CAMERA_SECTIONS[CONFIG_MAX_CAMERAS] = {"CAMERA_1", "CAMERA_2", "CAMERA_3", "CAMERA_4"};
+static const char* const CHANNEL_CSV_KEYS[CONFIG_THRUSTER_CHANNELS] = {
+    "CH0_CSV", "CH1_CSV", "CH2_CSV", "CH3_CSV", "CH4_CSV", "CH5_CSV"};
+
+// ボタン名 (config.ini の表記) とビットマスク
+static const struct { const char* name; int mask; } BUTTONS[] = {
+    {"DPadUp", GamepadButton::DPadUp}, {"DPadDown", GamepadButton::DPadDown},
+    {"DPadLeft", GamepadButton::DPadLeft}, {"DPadRight", GamepadButton::DPadRight},
+    {"Start", GamepadButton::Start}, {"Back", GamepadButton::Back},
+    {"LeftShoulder", GamepadButton::LeftShoulder}, {"RightShoulder", GamepadButton::RightShoulder},
+    {"A", GamepadButton::A}, {"B", GamepadButton::B}, {"X", GamepadButton::X}, {"Y", GamepadButton::Y},
+};
+
+// 項目の変更を反映する担当。表に無いセクションは制御スレッドが毎周期参照するものとして扱う
+static unsigned apply_targets_of(const char* section, const char* key) {
+    if (strcmp(section, "CONFIG_SYNC") == 0 && strcmp(key, "GENERATION") == 0) {
+        return 0; // 保存した版を示すだけで、反映する処理は無い (テレメトリは毎回 g_config から読む)
+    }
+    if (strcmp(section, "PWM") == 0 && strcmp(key, "PWM_FREQUENCY") == 0) {
+        return CONFIG_APPLY_BIT(CONFIG_APPLY_PWM);
+    }
+    if (strcmp(section, "NETWORK") == 0) {
+        if (strcmp(key, "RECV_PORT") == 0 || strcmp(key, "SEND_PORT") == 0) {
+            return CONFIG_APPLY_BIT(CONFIG_APPLY_NETWORK);
+        }
+        if (strcmp(key, "CLIENT_HOST") == 0) {
+            // 受信の許可 (毎回参照) に加えて、映像の送信先でもある
+            return CONFIG_APPLY_BIT(CONFIG_APPLY_CONTROL) | CONFIG_APPLY_BIT(CONFIG_APPLY_CAMERA);
+        }
+        return CONFIG_APPLY_BIT(CONFIG_APPLY_CONTROL);
+    }
+    if (strncmp(section, "CAMERA_", 7) == 0 || strcmp(section, "VIDEO_BITRATE") == 0) {
+        return CONFIG_APPLY_BIT(CONFIG_APPLY_CAMERA);
+    }
+    if (strcmp(section, "RECORDER") == 0 || strcmp(section, "METRICS") == 0 ||
+        strcmp(section, "LIVE_STATE") == 0 || strcmp(section, "CONFIG_SYNC") == 0 ||
+        (strcmp(section, "TRACE") == 0 && strcmp(key, "BUFFER_EVENTS") == 0)) {
+        return CONFIG_APPLY_BIT(CONFIG_APPLY_RESTART);
+    }
+    return CONFIG_APPLY_BIT(CONFIG_APPLY_CONTROL);
+}
+
+static std::vector<ConfigField> build_schema() {
+    std::vector<ConfigField> fields = {
+        CONFIG_FIELD("PWM", "PWM_MIN", CONFIG_INT, pwm_min, 500, 2500),
+        CONFIG_FIELD("PWM", "PWM_NEUTRAL", CONFIG_INT, pwm_neutral, 500, 2500),
+        CONFIG_FIELD("PWM", "PWM_NORMAL_MAX", CONFIG_INT, pwm_normal_max, 500, 2500),
+        CONFIG_FIELD("PWM", "PWM_BOOST_MAX", CONFIG_INT, pwm_boost_max, 500, 2500),
+        CONFIG_FIELD("PWM", "PWM_FREQUENCY", CONFIG_FLOAT, pwm_frequency, 1, 1000),
+        CONFIG_FIELD("JOYSTICK", "DEADZONE", CONFIG_INT, joystick_deadzone, 0, 32767),
+
+        CONFIG_FIELD("THRUSTER_CONTROL", "SMOOTHING_FACTOR_HORIZONTAL", CONFIG_FLOAT, smoothing_factor_horizontal, 0, 1),
+        CONFIG_FIELD("THRUSTER_CONTROL", "SMOOTHING_FACTOR_VERTICAL", CONFIG_FLOAT, smoothing_factor_vertical, 0, 1),
+        CONFIG_FIELD("THRUSTER_CONTROL", "KP_ROLL", CONFIG_FLOAT, kp_roll, -ANY, ANY),
+        CONFIG_FIELD("THRUSTER_CONTROL", "KP_YAW", CONFIG_FLOAT, kp_yaw, -ANY, ANY),
+        CONFIG_FIELD("THRUSTER_CONTROL", "YAW_THRESHOLD_DPS", CONFIG_FLOAT, yaw_threshold_dps, 0, ANY),
+        CONFIG_FIELD("THRUSTER_CONTROL", "YAW_GAIN", CONFIG_FLOAT, yaw_gain, -ANY, ANY),
+
+        CONFIG_FIELD("AHRS", "BETA", CONFIG_FLOAT, ahrs_beta, 0, ANY),
+        CONFIG_FIELD("AHRS", "ZETA", CONFIG_FLOAT, ahrs_zeta, 0, ANY),
+        CONFIG_FIELD("AHRS", "GYRO_SCALE", CONFIG_FLOAT, ahrs_gyro_scale, -ANY, ANY),
+        CONFIG_FIELD("AHRS", "USE_MAG", CONFIG_BOOL, ahrs_use_mag, 0, 0),
+
+        CONFIG_FIELD("DEPTH_HOLD", "BUTTON", CONFIG_BUTTON, depth_hold_button, 0, 0xFFFF),
+        CONFIG_FIELD("DEPTH_HOLD", "WATER_DENSITY", CONFIG_FLOAT, depth_water_density, 1, ANY),
+        CONFIG_FIELD("DEPTH_HOLD", "PRESSURE_TO_PA", CONFIG_FLOAT, depth_pressure_to_pa, -ANY, ANY),
+        CONFIG_FIELD("DEPTH_HOLD", "SURFACE_PRESSURE_PA", CONFIG_FLOAT, depth_surface_pressure_pa, -ANY, ANY),
+        CONFIG_FIELD("DEPTH_HOLD", "CALIBRATION_SAMPLES", CONFIG_INT, depth_calibration_samples, 1, 100000),
+        CONFIG_FIELD("DEPTH_HOLD", "FILTER_ALPHA", CONFIG_FLOAT, depth_filter_alpha, 0, 1),
+        CONFIG_FIELD("DEPTH_HOLD", "KP", CONFIG_FLOAT, depth_kp, -ANY, ANY),
+        CONFIG_FIELD("DEPTH_HOLD", "KI", CONFIG_FLOAT, depth_ki, -ANY, ANY),
+        CONFIG_FIELD("DEPTH_HOLD", "KD", CONFIG_FLOAT, depth_kd, -ANY, ANY),
+        CONFIG_FIELD("DEPTH_HOLD", "INTEGRAL_LIMIT", CONFIG_FLOAT, depth_integral_limit, 0, ANY),
+        CONFIG_FIELD("DEPTH_HOLD", "MAX_OUTPUT", CONFIG_INT, depth_max_output, 0, 2000),
+        CONFIG_FIELD("DEPTH_HOLD", "OUTPUT_SIGN", CONFIG_SIGN, depth_output_sign, 0, 0),
+
+        CONFIG_FIELD("HEADING_HOLD", "ENABLED", CONFIG_BOOL, heading_hold_enabled, 0, 0),
+        CONFIG_FIELD("HEADING_HOLD", "KP", CONFIG_FLOAT, heading_hold_kp, -ANY, ANY),
+        CONFIG_FIELD("HEADING_HOLD", "KD", CONFIG_FLOAT, heading_hold_kd, -ANY, ANY),
+        CONFIG_FIELD("HEADING_HOLD", "MAX_OUTPUT", CONFIG_INT, heading_hold_max_output, 0, 2000),
+        CONFIG_FIELD("HEADING_HOLD", "RATE_LIMIT", CONFIG_FLOAT, heading_hold_rate_limit, 0, ANY),
+        CONFIG_FIELD("HEADING_HOLD", "LATCH_RATE_DPS", CONFIG_FLOAT, heading_hold_latch_rate_dps, 0, ANY),
+
+        CONFIG_FIELD("THRUST_CURVE", "ENABLED", CONFIG_BOOL, thrust_curve_enabled, 0, 0),
+        CONFIG_FIELD("THRUST_CURVE", "CSV", CONFIG_STRING, thrust_curve_csv, 0, 0),
+
+        CONFIG_FIELD("POWER_LIMIT", "ENABLED", CONFIG_BOOL, power_limit_enabled, 0, 0),
+        CONFIG_FIELD("POWER_LIMIT", "BUDGET_A", CONFIG_FLOAT, power_budget_a, 0, ANY),
+        CONFIG_FIELD("POWER_LIMIT", "THRUSTER_FULL_CURRENT_A", CONFIG_FLOAT, power_thruster_full_current_a, 0, ANY),
+        CONFIG_FIELD("POWER_LIMIT", "CURRENT_EXPONENT", CONFIG_FLOAT, power_current_exponent, 0, 10),
+        CONFIG_FIELD("POWER_LIMIT", "BASE_CURRENT_A", CONFIG_FLOAT, power_base_current_a, 0, ANY),
+        CONFIG_FIELD("POWER_LIMIT", "VOLTAGE_ADC_CHANNEL", CONFIG_INT, power_voltage_adc_channel, -1, 3),
+        CONFIG_FIELD("POWER_LIMIT", "VOLTAGE_SCALE", CONFIG_FLOAT, power_voltage_scale, -ANY, ANY),
+        CONFIG_FIELD("POWER_LIMIT", "CURRENT_ADC_CHANNEL", CONFIG_INT, power_current_adc_channel, -1, 3),
+        CONFIG_FIELD("POWER_LIMIT", "CURRENT_SCALE", CONFIG_FLOAT, power_current_scale, -ANY, ANY),
+        CONFIG_FIELD("POWER_LIMIT", "CURRENT_OFFSET", CONFIG_FLOAT, power_current_offset, -ANY, ANY),
+        CONFIG_FIELD("POWER_LIMIT", "LOW_VOLTAGE_V", CONFIG_FLOAT, power_low_voltage_v, 0, ANY),
+        CONFIG_FIELD("POWER_LIMIT", "CUTOFF_VOLTAGE_V", CONFIG_FLOAT, power_cutoff_voltage_v, 0, ANY),
+
+        CONFIG_FIELD("INVERSION", "RESPONSE", CONFIG_INVERSION_RESPONSE, inversion_response, 0, 0),
+        CONFIG_FIELD("INVERSION", "FILTER_TAU_S", CONFIG_FLOAT, inversion_filter_tau_s, 0, ANY),
+        CONFIG_FIELD("INVERSION", "ENTER_ANGLE_DEG", CONFIG_FLOAT, inversion_enter_angle_deg, 0, 180),
+        CONFIG_FIELD("INVERSION", "EXIT_ANGLE_DEG", CONFIG_FLOAT, inversion_exit_angle_deg, 0, 180),
+        CONFIG_FIELD("INVERSION", "DWELL_S", CONFIG_FLOAT, inversion_dwell_s, 0, ANY),
+        CONFIG_FIELD("INVERSION", "CALIBRATION_SAMPLES", CONFIG_INT, inversion_calibration_samples, 1, 100000),
+        CONFIG_FIELD("INVERSION", "SPIKE_RATIO", CONFIG_FLOAT, inversion_spike_ratio, 0, ANY),
+        CONFIG_FIELD("INVERSION", "REFERENCE_Z_SIGN", CONFIG_INT, inversion_reference_z_sign, -1, 1),
+
+        CONFIG_FIELD("RECORDER", "ENABLED", CONFIG_BOOL, recorder_enabled, 0, 0),
+        CONFIG_FIELD("RECORDER", "DIRECTORY", CONFIG_STRING, recorder_directory, 0, 0),
+        CONFIG_FIELD("RECORDER", "BUFFER_KB", CONFIG_INT, recorder_buffer_kb, 1, 1048576),
+        CONFIG_FIELD("RECORDER", "MAX_FILE_MB", CONFIG_INT, recorder_max_file_mb, 0, 1048576),
+
+        CONFIG_FIELD("TRACE", "ENABLED", CONFIG_BOOL, trace_enabled, 0, 0),
+        CONFIG_FIELD("TRACE", "BUFFER_EVENTS", CONFIG_INT, trace_buffer_events, 1, 16777216),
+        CONFIG_FIELD("TRACE", "DIRECTORY", CONFIG_STRING, trace_directory, 0, 0),
+
+        CONFIG_FIELD("LATENCY", "WINDOW_S", CONFIG_FLOAT, latency_window_s, 0.1, 86400),
+
+        CONFIG_FIELD("METRICS", "ENABLED", CONFIG_BOOL, metrics_enabled, 0, 0),
+        CONFIG_FIELD("METRICS", "BIND", CONFIG_STRING, metrics_bind, 0, 0),
+        CONFIG_FIELD("METRICS", "PORT", CONFIG_INT, metrics_port, 1, 65535),
+
+        CONFIG_FIELD("LIVE_STATE", "ENABLED", CONFIG_BOOL, live_state_enabled, 0, 0),
+        CONFIG_FIELD("LIVE_STATE", "SHM_NAME", CONFIG_STRING, live_state_shm_name, 0, 0),
+
+        CONFIG_FIELD("NETWORK", "RECV_PORT", CONFIG_INT, network_recv_port, 0, 65535),
+        CONFIG_FIELD("NETWORK", "SEND_PORT", CONFIG_INT, network_send_port, 0, 65535),
+        CONFIG_FIELD("NETWORK", "CLIENT_HOST", CONFIG_STRING, client_host, 0, 0),
+        CONFIG_FIELD("NETWORK", "CONNECTION_TIMEOUT_SECONDS", CONFIG_DOUBLE, connection_timeout_seconds, 0, 3600),
+
+        CONFIG_FIELD("APPLICATION", "SENSOR_SEND_INTERVAL", CONFIG_UINT, sensor_send_interval, 1, 1000000),
+        CONFIG_FIELD("APPLICATION", "LOOP_DELAY_US", CONFIG_UINT, loop_delay_us, 1, 10000000),
+
+        CONFIG_FIELD("VIDEO_BITRATE", "ADAPTIVE", CONFIG_BOOL, video_bitrate_adaptive, 0, 0),
+        CONFIG_FIELD("VIDEO_BITRATE", "MIN_KBPS", CONFIG_INT, video_bitrate_min_kbps, 1, 100000),
+        CONFIG_FIELD("VIDEO_BITRATE", "MAX_KBPS", CONFIG_INT, video_bitrate_max_kbps, 1, 100000),
+        CONFIG_FIELD("VIDEO_BITRATE", "CONTROL_GAP_MS", CONFIG_INT, video_bitrate_control_gap_ms, 1, 10000),
+
+        CONFIG_FIELD("CONFIG_SYNC", "WPF_HOST", CONFIG_STRING, config_sync_wpf_host, 0, 0),
+        CONFIG_FIELD("CONFIG_SYNC", "WPF_RECV_PORT", CONFIG_INT, config_sync_wpf_recv_port, 1, 65535),
+        CONFIG_FIELD("CONFIG_SYNC", "CPP_RECV_PORT", CONFIG_INT, config_sync_cpp_recv_port, 1, 65535),
+        CONFIG_FIELD("CONFIG_SYNC", "WATCH_FILE", CONFIG_BOOL, config_watch_file, 0, 0),
+        CONFIG_FIELD("CONFIG_SYNC", "WATCH_DEBOUNCE_MS", CONFIG_INT, config_watch_debounce_ms, 0, 10000),
+        CONFIG_FIELD("CONFIG_SYNC", "GENERATION", CONFIG_UINT, config_generation, 0, 4294967295.0),
+    };
+
+    // 推力曲線のチャンネル別 CSV
+    for (int ch = 0; ch < CONFIG_THRUSTER_CHANNELS; ++ch) {
+        ConfigField field = {"THRUST_CURVE", CHANNEL_CSV_KEYS[ch], CONFIG_STRING, 0, 0,
+                             [](AppConfig& c, int i) -> void* { return &c.thrust_curve_channel_csv[i]; },
+                             ch, 0, 0};
+        fields.push_back(field);
+    }
+
+    // 補助出力 (従来の [LED] 形式のキーは段階1つ分を書き換える別名として扱う)
+    static const struct { const char* key; ConfigFieldType type; int arg; } AUX_KEYS[] = {
+        {"NAME", CONFIG_STRING, 0}, {"CHANNEL", CONFIG_INT, 0}, {"BUTTON", CONFIG_BUTTON, 0},
+        {"LEVELS", CONFIG_AUX_LEVELS, 0}, {"OFF_VALUE", CONFIG_AUX_LEVEL, 0},
+        {"ON_VALUE", CONFIG_AUX_LEVEL, 1}, {"ON1_VALUE", CONFIG_AUX_LEVEL, 1},
+        {"ON2_VALUE", CONFIG_AUX_LEVEL, 2}, {"MAX_VALUE", CONFIG_AUX_LEVEL, -1},
+    };
+    for (int i = 0; i < CONFIG_MAX_AUX_OUTPUTS; ++i) {
+        for (const auto& aux_key : AUX_KEYS) {
+            ConfigField field = {AUX_SECTIONS[i], aux_key.key, aux_key.type, 0, 3000, nullptr, i, aux_key.arg, 0};
+            if (aux_key.type == CONFIG_STRING) {
+                field.member = [](AppConfig& c, int index) -> void* { return &c.aux_outputs[index].name; };
+            } else if (aux_key.type == CONFIG_INT) {
+                field.min = -1;
+                field.max = 15;
+                field.member = [](AppConfig& c, int index) -> void* { return &c.aux_outputs[index].channel; };
+            } else if (aux_key.type == CONFIG_BUTTON) {
+                field.max = 0xFFFF;
+                field.member = [](AppConfig& c, int index) -> void* { return &c.aux_outputs[index].button_mask; };
+            } else {
+                field.member = [](AppConfig& c, int index) -> void* { return &c.aux_outputs[index]; };
+            }
+            fields.push_back(field);
+        }
+    }
+
+    // カメラ
+    static const struct {
+        const char* key;
+        ConfigFieldType type;
+        double min, max;
+        void* (*member)(AppConfig& c, int index);
+    } CAMERA_KEYS[] = {
+        {"DEVICE", CONFIG_STRING, 0, 0, [](AppConfig& c, int i) -> void* { return &c.cameras[i].device; }},
+        {"PORT", CONFIG_INT, 1, 65535, [](AppConfig& c, int i) -> void* { return &c.cameras[i].port; }},
+        {"WIDTH", CONFIG_INT, 1, 7680, [](AppConfig& c, int i) -> void* { return &c.cameras[i].width; }},
+        {"HEIGHT", CONFIG_INT, 1, 4320, [](AppConfig& c, int i) -> void* { return &c.cameras[i].height; }},
+        {"FRAMERATE_NUM", CONFIG_INT, 1, 1000, [](AppConfig& c, int i) -> void* { return &c.cameras[i].framerate_num; }},
+        {"FRAMERATE_DEN", CONFIG_INT, 1, 1000, [](AppConfig& c, int i) -> void* { return &c.cameras[i].framerate_den; }},
+        {"IS_H264_NATIVE_SOURCE", CONFIG_BOOL, 0, 0,
+         [](AppConfig& c, int i) -> void* { return &c.cameras[i].is_h264_native_source; }},
+        {"RTP_PAYLOAD_TYPE", CONFIG_INT, 96, 127, [](AppConfig& c, int i) -> void* { return &c.cameras[i].rtp_payload_type; }},
+        {"RTP_CONFIG_INTERVAL", CONFIG_INT, -1, 3600,
+         [](AppConfig& c, int i) -> void* { return &c.cameras[i].rtp_config_interval; }},
+        {"LOW_LATENCY", CONFIG_BOOL, 0, 0, [](AppConfig& c, int i) -> void* { return &c.cameras[i].low_latency; }},
+        {"KEY_INT_MAX", CONFIG_INT, 0, 1000, [](AppConfig& c, int i) -> void* { return &c.cameras[i].key_int_max; }},
+        {"X264_BITRATE", CONFIG_INT, 1, 100000, [](AppConfig& c, int i) -> void* { return &c.cameras[i].x264_bitrate; }},
+        {"X264_TUNE", CONFIG_STRING, 0, 0, [](AppConfig& c, int i) -> void* { return &c.cameras[i].x264_tune; }},
+        {"X264_SPEED_PRESET", CONFIG_STRING, 0, 0,
+         [](AppConfig& c, int i) -> void* { return &c.cameras[i].x264_speed_preset; }},
+        {"X264_SLICES", CONFIG_INT, 0, 32, [](AppConfig& c, int i) -> void* { return &c.cameras[i].x264_slices; }},
+    };
+    for (int i = 0; i < CONFIG_MAX_CAMERAS; ++i) {
+        for (const auto& camera_key : CAMERA_KEYS) {
+            ConfigField field = {CAMERA_SECTIONS[i], camera_key.key, camera_key.type, camera_key.min, camera_key.max,
+                                 camera_key.member, i, 0, 0};
+            fields.push_back(field);
+        }
+    }
+
+    for (size_t i = 0; i < fields.size(); ++i) {
+        fields[i].apply = apply_targets_of(fields[i].section, fields[i].key);
+    }
+    return fields;
+}
+
+const std::vector<ConfigField>& config_schema() {
+    static const std::vector<ConfigField> schema = build_schema();
+    return schema;
+}
+
+// ヘルパー関数: セクション名から補助出力の番号を求める ([LED]=0, [LED2]~=1~, [AUX_1]~=0~)。該当しなければ -1
+static int aux_section_index(const char* section) {
+    const char* digits;
+    if (strcasecmp(section, "LED") == 0) {
+        return 0;
+    } else if (strncasecmp(section, "LED", 3) == 0) {
+        digits = section + 3;
+    } else if (strncasecmp(section, "AUX_", 4) == 0) {
+        digits = section + 4;
+    } else {
+        return -1;
+    }
+    if (*digits == '\0' || strspn(digits, "0123456789") != strlen(digits) || strlen(digits) > 2) {
+        return -1;
+    }
+    int index = atoi(digits) - 1;
+    return (index >= 0 && index < CONFIG_MAX_AUX_OUTPUTS) ? index : -1;
+}
+
+// ヘルパー関数: セクション名からカメラの番号を求める ([CAMERA_1]~=0~, [GSTREAMER_CAMERA_1]~=0~)。該当しなければ -1
+static int camera_section_index(const char* section) {
+    const char* digits;
+    if (strncasecmp(section, "CAMERA_", 7) == 0) {
+        digits = section + 7;
+    } else if (strncasecmp(section, "GSTREAMER_CAMERA_", 17) == 0) {
+        digits = section + 17;
+    } else {
+        return -1;
+    }
+    if (*digits == '\0' || strspn(digits, "0123456789") != strlen(digits) || strlen(digits) > 2) {
+        return -1;
+    }
+    int index = atoi(digits) - 1;
+    return (index >= 0 && index < CONFIG_MAX_CAMERAS) ? index : -1;
+}
+
+// 項目の並び順 (セクション、キーの順に大文字・小文字を区別せず比較)
+static int compare_field(const char* section_a, const char* key_a, const char* section_b, const char* key_b) {
+    int result = strcasecmp(section_a, section_b);
+    return result != 0 ? result : strcasecmp(key_a, key_b);
+}
+
+const ConfigField* config_find_field(const std::string& section, const std::string& key) {
+    // 表の添字をセクションとキーで整列しておき、二分探索する (文字列の確保は行わない)
+    static const std::vector<size_t> sorted = [] {
+        const std::vector<ConfigField>& schema = config_schema();
+        std::vector<size_t> order(schema.size());
+        for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+        std::sort(order.begin(), order.end(), [&schema](size_t a, size_t b) {
+            return compare_field(schema[a].section, schema[a].key, schema[b].section, schema[b].key) < 0;
+        });
+        return order;
+    }();
+
+    const std::vector<ConfigField>& schema = config_schema();
+    int aux = aux_section_index(section.c_str());
+    int camera = camera_section_index(section.c_str());
+    const char* canonical_section =
+        (aux >= 0) ? AUX_SECTIONS[aux] : ((camera >= 0) ? CAMERA_SECTIONS[camera] : section.c_str());
+    size_t lo = 0, hi = sorted.size();
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        const ConfigField& field = schema[sorted[mid]];
+        int result = compare_field(field.section, field.key, canonical_section, key.c_str());
+        if (result == 0) return &field;
+        if (result < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return nullptr;
+}
+
+std::string config_field_name(const ConfigField& field) {
+    return std::string("[") + field.section + "] " + field.key;
+}
+
+// ヘルパー関数: 文字列全体が数値かを確認する (std::stoi などは "0.3xyz" の先頭だけを読むため、
+// 読み終えた位置 pos より後ろに空白以外が残っていれば不正な値として扱う)
+static void require_whole_number(const std::string& value, size_t pos) {
+    if (value.find_first_not_of(" \t", pos) != std::string::npos) {
+        throw std::invalid_argument("数値の後ろに余分な文字があります: " + value);
+    }
+}
+
+static int parse_int(const std::string& value, int base = 10) {
+    size_t pos = 0;
+    int parsed = std::stoi(value, &pos, base);
+    require_whole_number(value, pos);
+    return parsed;
+}
+
+static unsigned long parse_ulong(const std::string& value) {
+    size_t pos = 0;
+    unsigned long parsed = std::stoul(value, &pos);
+    require_whole_number(value, pos);
+    return parsed;
+}
+
+static float parse_float(const std::string& value) {
+    size_t pos = 0;
+    float parsed = std::stof(value, &pos);
+    require_whole_number(value, pos);
+    return parsed;
+}
+
+static double parse_double(const std::string& value) {
+    size_t pos = 0;
+    double parsed = std::stod(value, &pos);
+    require_whole_number(value, pos);
+    return parsed;
+}
+
+// ヘルパー関数: ボタン指定をビットマスクに変換 ("Y", "DPadUp" などの名前、または 0x8000 などの数値)
+static int parse_button_mask(const std::string& value) {
+    for (const auto& button : BUTTONS) {
+        if (ini_equal(value, button.name)) return button.mask;
+    }
+    return parse_int(value, 0);
+}
+
+// ヘルパー関数: 数値が範囲内か確認する
+// (nan は大小比較が常に偽で範囲判定をすり抜けるため、nan/inf は先に拒否する)
+static bool check_range(const ConfigField& field, double value, std::string& error) {
+    if (!std::isfinite(value)) {
+        error = "有限の数値ではありません (nan/inf は指定できません)";
+        return false;
+    }
+    if (value < field.min || value > field.max) {
+        std::ostringstream ss;
+        ss << "値が許容範囲 (" << field.min << " ~ " << field.max << ") の外です";
+        error = ss.str();
+        return false;
+    }
+    return true;
+}
+
+bool config_set_field(const ConfigField& field, const std::string& value, AppConfig& config,
+                      std::string& error) {
+    void* target = field.member(config, field.index);
+    try {
+        switch (field.type) {
+        case CONFIG_INT: {
+            int parsed = parse_int(value);
+            if (!check_range(field, parsed, error)) return false;
+            *static_cast<int*>(target) = parsed;
+            break;
+        }
+        case CONFIG_UINT: {
+            unsigned long parsed = parse_ulong(value);
+            if (!check_range(field, static_cast<double>(parsed), error)) return false;
+            *static_cast<unsigned int*>(target) = static_cast<unsigned int>(parsed);
+            break;
+        }
+        case CONFIG_FLOAT: {
+            float parsed = parse_float(value);
+            if (!check_range(field, parsed, error)) return false;
+            *static_cast<float*>(target) = parsed;
+            break;
+        }
+        case CONFIG_DOUBLE: {
+            double parsed = parse_double(value);
+            if (!check_range(field, parsed, error)) return false;
+            *static_cast<double*>(target) = parsed;
+            break;
+        }
+        case CONFIG_BOOL:
+            *static_cast<bool*>(target) = ini_equal(value, "true");
+            break;
+        case CONFIG_STRING:
+            *static_cast<std::string*>(target) = value;
+            break;
+        case CONFIG_SIGN:
+            *static_cast<int*>(target) = (parse_int(value) < 0) ? -1 : 1;
+            break;
+        case CONFIG_BUTTON: {
+            int parsed = parse_button_mask(value);
+            if (!check_range(field, parsed, error)) return false;
+            *static_cast<int*>(target) = parsed;
+            break;
+        }
+        case CONFIG_INVERSION_RESPONSE: {
+            InversionResponse& response = *static_cast<InversionResponse*>(target);
+            if (ini_equal(value, "NEUTRAL")) response = InversionResponse::NEUTRAL;
+            else if (ini_equal(value, "ALERT")) response = InversionResponse::ALERT;
+            else if (ini_equal(value, "RESTART")) response = InversionResponse::RESTART;
+            else {
+                error = "RESPONSE は NEUTRAL, ALERT, RESTART のいずれかです";
+                return false;
+            }
+            break;
+        }
+        case CONFIG_AUX_LEVELS: {
+            AuxOutputConfig& aux = *static_cast<AuxOutputConfig*>(target);
+            int levels[CONFIG_MAX_AUX_LEVELS];
+            int count = 0;
+            std::stringstream ss(value);
+            std::string item;
+            while (std::getline(ss, item, ',')) {
+                if (count >= CONFIG_MAX_AUX_LEVELS) {
+                    error = "段階が多すぎます";
+                    return false;
+                }
+                levels[count] = parse_int(ini_trim(item));
+                if (!check_range(field, levels[count], error)) return false;
+                count++;
+            }
+            if (count < 2) {
+                error = "段階は2つ以上必要です";
+                return false;
+            }
+            std::copy(levels, levels + count, aux.levels);
+            aux.level_count = count;
+            break;
+        }
+        case CONFIG_AUX_LEVEL: {
+            AuxOutputConfig& aux = *static_cast<AuxOutputConfig*>(target);
+            int parsed = parse_int(value);
+            if (!check_range(field, parsed, error)) return false;
+            aux.levels[field.arg < 0 ? aux.level_count - 1 : field.arg] = parsed;
+            break;
+        }
+        }
+    } catch (const std::invalid_argument& e) {
+        error = std::string("数値変換エラー - ") + e.what();
+        return false;
+    } catch (const std::out_of_range& e) {
+        error = std::string("数値が範囲外 - ") + e.what();
+        return false;
+    }
+    return true;
+}
+
+// ヘルパー関数: 読み戻して同じ値になる最短の表記
+template <typename T>
+static std::string format_real(T value, int max_digits) {
+    char buffer[64];
+    for (int digits = 6; digits <= max_digits; ++digits) {
+        snprintf(buffer, sizeof(buffer), "%.*g", digits, static_cast<double>(value));
+        if (static_cast<T>(strtod(buffer, nullptr)) == value) {
+            break;
+        }
+    }
+    return buffer;
+}
+
+std::string config_format_field(const ConfigField& field, const AppConfig& config) {
+    // 読み取りのみ (格納先を返す関数が非 const の AppConfig を受け取るため)
+    void* target = field.member(const_cast<AppConfig&>(config), field.index);
+    switch (field.type) {
+    case CONFIG_INT:
+    case CONFIG_SIGN:
+        return std::to_string(*static_cast<int*>(target));
+    case CONFIG_UINT:
+        return std::to_string(*static_cast<unsigned int*>(target));
+    case CONFIG_FLOAT:
+        return format_real(*static_cast<float*>(target), 9);
+    case CONFIG_DOUBLE:
+        return format_real(*static_cast<double*>(target), 17);
+    case CONFIG_BOOL:
+        return *static_cast<bool*>(target) ? "true" : "false";
+    case CONFIG_STRING:
+        return *static_cast<std::string*>(target);
+    case CONFIG_BUTTON: {
+        int mask = *static_cast<int*>(target);
+        for (const auto& button : BUTTONS) {
+            if (button.mask == mask) return button.name;
+        }
+        char buffer[16];
+        snprintf(buffer, sizeof(buffer), "0x%04x", mask);
+        return buffer;
+    }
+    case CONFIG_INVERSION_RESPONSE:
+        switch (*static_cast<InversionResponse*>(target)) {
+        case InversionResponse::NEUTRAL: return "NEUTRAL";
+        case InversionResponse::ALERT: return "ALERT";
+        case InversionResponse::RESTART: return "RESTART";
+        }
+        return "";
+    case CONFIG_AUX_LEVELS: {
+        const AuxOutputConfig& aux = *static_cast<AuxOutputConfig*>(target);
+        std::string levels;
+        for (int i = 0; i < aux.level_count; ++i) {
+            levels += (i ? "," : "") + std::to_string(aux.levels[i]);
+        }
+        return levels;
+    }
+    case CONFIG_AUX_LEVEL: {
+        const AuxOutputConfig& aux = *static_cast<AuxOutputConfig*>(target);
+        return std::to_string(aux.levels[field.arg < 0 ? aux.level_count - 1 : field.arg]);
+    }
+    }
+    return "";
+}
+
+std::vector<const ConfigField*> config_diff(const AppConfig& a, const AppConfig& b) {
+    std::vector<const ConfigField*> changed;
+    const std::vector<ConfigField>& schema = config_schema();
+    for (size_t i = 0; i < schema.size(); ++i) {
+        if (schema[i].type == CONFIG_AUX_LEVEL) {
+            continue; // LEVELS と同じ値の別名
+        }
+        if (config_format_field(schema[i], a) != config_format_field(schema[i], b)) {
+            changed.push_back(&schema[i]);
+        }
+    }
+    return changed;
+}
+
+// ヘルパー関数: 数値・真偽値の格納先の大きさ (それ以外の型は 0)
+static size_t scalar_field_size(ConfigFieldType type) {
+    switch (type) {
+    case CONFIG_INT:
+    case CONFIG_SIGN:
+    case CONFIG_BUTTON:
+        return sizeof(int);
+    case CONFIG_UINT:
+        return sizeof(unsigned int);
+    case CONFIG_FLOAT:
+        return sizeof(float);
+    case CONFIG_DOUBLE:
+        return sizeof(double);
+    case CONFIG_BOOL:
+        return sizeof(bool);
+    case CONFIG_INVERSION_RESPONSE:
+        return sizeof(InversionResponse);
+    default:
+        return 0;
+    }
+}
+
+unsigned config_scalar_apply_targets(const AppConfig& a, const AppConfig& b) {
+    unsigned targets = 0;
+    const std::vector<ConfigField>& schema = config_schema();
+    for (size_t i = 0; i < schema.size(); ++i) {
+        const ConfigField& field = schema[i];
+        size_t size = scalar_field_size(field.type);
+        if (size == 0 || (targets & field.apply) == field.apply) {
+            continue;
+        }
+        // 読み取りのみ (格納先を返す関数が非 const の AppConfig を受け取るため)
+        const void* value_a = field.member(const_cast<AppConfig&>(a), field.index);
+        const void* value_b = field.member(const_cast<AppConfig&>(b), field.index);
+        if (memcmp(value_a, value_b, size) != 0) {
+            targets |= field.apply;
+        }
+    }
+    return targets;
+}
+
+unsigned config_apply_targets(const std::vector<const ConfigField*>& fields) {
+    unsigned targets = 0;
+    for (size_t i = 0; i < fields.size(); ++i) {
+        targets |= fields[i]->apply;
+    }
+    return targets;
+}
+
+const char* config_apply_target_name(int target) {
+    static const char* const NAMES[CONFIG_APPLY_TARGET_COUNT] = {
+        "control", "pwm", "network", "camera", "restart"};
+    return (target >= 0 && target < CONFIG_APPLY_TARGET_COUNT) ? NAMES[target] : "unknown";
+}
+
+// ドキュメントの内容を順に適用する。verbose が false なら誤りを表示せずに読み飛ばし、
+// true なら最初の誤りの内容を error に入れて false を返す
+static bool apply_document(const IniDocument& doc, const std::string& filename, AppConfig& config,
+                           bool verbose, std::string& error) {
+    const std::vector<IniLine>& lines = doc.lines();
+    for (size_t i = 0; i < lines.size(); ++i) {
+        const IniLine& line = lines[i];
+        if (line.kind == IniLine::INVALID) {
+            if (verbose) {
+                std::cerr << "警告: " << filename << " の " << i + 1
+                          << " 行目: '=' が見つかりません。スキップします。" << std::endl;
+            }
+            continue;
+        }
+        if (line.kind != IniLine::ENTRY) {
+            continue;
+        }
+        const ConfigField* field = config_find_field(line.section, line.key);
+        if (field == nullptr) {
+            continue; // このプロセスでは使わない項目
+        }
+        std::string field_error;
+        if (!config_set_field(*field, line.value, config, field_error)) {
+            if (!verbose) {
+                continue;
+            }
+            error = std::to_string(i + 1) + " 行目: " + field_error + " (" + line.key + "=" +
+                    line.value + ")";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool config_validate(const AppConfig& config, std::string& error) {
+    // 使用するカメラの送信先のポートが重ならないことを確認
+    for (int i = 0; i < CONFIG_MAX_CAMERAS; ++i) {
+        for (int j = i + 1; j < CONFIG_MAX_CAMERAS; ++j) {
+            if (!config.cameras[i].device.empty() && !config.cameras[j].device.empty() &&
+                config.cameras[i].port == config.cameras[j].port) {
+                error = "カメラ" + std::to_string(i + 1) + " とカメラ" + std::to_string(j + 1) + " の PORT (" +
+                        std::to_string(config.cameras[i].port) + ") が同じです。";
+                return false;
+            }
+        }
+    }
+    if (config.video_bitrate_min_kbps > config.video_bitrate_max_kbps) {
+        error = "[VIDEO_BITRATE] MIN_KBPS が MAX_KBPS より大きくなっています。";
+        return false;
+    }
+    // 補助出力がスラスターのチャンネルを上書きしないことを確認
+    for (int i = 0; i < CONFIG_MAX_AUX_OUTPUTS; ++i) {
+        int ch = config.aux_outputs[i].channel;
+        if (ch >= 0 && ch < CONFIG_THRUSTER_CHANNELS) {
+            error = "補助出力 '" + config.aux_outputs[i].name + "' のチャンネル " + std::to_string(ch) +
+                    " はスラスター用です。";
+            return false;
+        }
+    }
+    if (!(config.pwm_min <= config.pwm_neutral && config.pwm_neutral <= config.pwm_normal_max &&
+          config.pwm_normal_max <= config.pwm_boost_max)) {
+        error = "PWM_MIN <= PWM_NEUTRAL <= PWM_NORMAL_MAX <= PWM_BOOST_MAX を満たしていません。";
+        return false;
+    }
+    return true;
+}
+
+bool config_from_document(const IniDocument& doc, const std::string& filename, AppConfig& out,
+                          std::string* error) {
+    AppConfig temp_config;
+    std::string message;
+    if (!apply_document(doc, filename, temp_config, true, message) ||
+        !config_validate(temp_config, message)) {
+        std::cerr << "エラー: " << filename << ": " << message << std::endl;
+        if (error) {
+            *error = message;
+        }
+        return false;
+    }
+    std::swap(out, temp_config);
+    return true;
+}
+
+std::string config_document_section(const IniDocument& doc, const ConfigField& field) {
+    if (camera_section_index(field.section) >= 0) {
+        std::string legacy = "GSTREAMER_" + std::string(field.section);
+        if (!doc.has_section(field.section) && doc.has_section(legacy)) {
+            return legacy;
+        }
+        return field.section;
+    }
+    if (aux_section_index(field.section) < 0) {
+        return field.section;
+    }
+    std::string legacy = (field.index == 0) ? "LED" : "LED" + std::to_string(field.index + 1);
+    if (!doc.has_section(field.section) && doc.has_section(legacy)) {
+        return legacy;
+    }
+    return field.section;
+}
+
+void config_to_document(const AppConfig& config, IniDocument& doc) {
+    AppConfig current;
+    std::string ignored;
+    apply_document(doc, "", current, false, ignored);
+    std::vector<const ConfigField*> changed = config_diff(current, config);
+    for (size_t i = 0; i < changed.size(); ++i) {
+        const ConfigField& field = *changed[i];
+        doc.set(config_document_section(doc, field), field.key, config_format_field(field, config));
+    }
+}
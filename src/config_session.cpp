@@ -0,0 +1,156 @@
+// config_session.cpp
+#include "config_session.h"
+
+// --- 書き込み ---
+static void put_u8(std::string& out, uint8_t value) {
+    out.push_back(static_cast<char>(value));
+}
+
+static void put_u16(std::string& out, uint16_t value) {
+    put_u8(out, static_cast<uint8_t>(value >> 8));
+    put_u8(out, static_cast<uint8_t>(value));
+}
+
+static void put_u32(std::string& out, uint32_t value) {
+    put_u16(out, static_cast<uint16_t>(value >> 16));
+    put_u16(out, static_cast<uint16_t>(value));
+}
+
+static void put_u64(std::string& out, uint64_t value) {
+    put_u32(out, static_cast<uint32_t>(value >> 32));
+    put_u32(out, static_cast<uint32_t>(value));
+}
+
+// 長さの上限を超える文字列は切り詰める (セクション名・キーは 255 文字、値は 65535 文字まで)
+static void put_string(std::string& out, const std::string& value, bool long_length) {
+    size_t limit = long_length ? 0xFFFF : 0xFF;
+    size_t len = value.size() < limit ? value.size() : limit;
+    if (long_length) {
+        put_u16(out, static_cast<uint16_t>(len));
+    } else {
+        put_u8(out, static_cast<uint8_t>(len));
+    }
+    out.append(value, 0, len);
+}
+
+void config_session_encode(const ConfigFrame& frame, std::string& out) {
+    std::string body;
+    put_u8(body, static_cast<uint8_t>(frame.type));
+    switch (frame.type) {
+    case CONFIG_FRAME_HELLO:
+    case CONFIG_FRAME_ACK:
+        put_u32(body, frame.epoch);
+        put_u64(body, frame.version);
+        break;
+    case CONFIG_FRAME_SNAPSHOT:
+    case CONFIG_FRAME_DELTA: {
+        put_u32(body, frame.epoch);
+        put_u64(body, frame.version);
+        size_t count = frame.entries.size() < 0xFFFF ? frame.entries.size() : 0xFFFF;
+        put_u16(body, static_cast<uint16_t>(count));
+        for (size_t i = 0; i < count; ++i) {
+            put_string(body, frame.entries[i].section, false);
+            put_string(body, frame.entries[i].key, false);
+            put_string(body, frame.entries[i].value, true);
+        }
+        break;
+    }
+    default:
+        body.append(frame.message);
+        break;
+    }
+    put_u32(out, static_cast<uint32_t>(body.size()));
+    out.append(body);
+}
+
+// --- 読み出し ---
+// 本体を先頭から読み進める (範囲外の読み出しは ok を false にして 0 を返す)
+struct FrameCursor {
+    const unsigned char* data;
+    size_t len;
+    size_t pos;
+    bool ok;
+
+    uint64_t take(size_t bytes) {
+        if (!ok || len - pos < bytes) {
+            ok = false;
+            return 0;
+        }
+        uint64_t value = 0;
+        for (size_t i = 0; i < bytes; ++i) {
+            value = (value << 8) | data[pos++];
+        }
+        return value;
+    }
+
+    std::string take_string(size_t length_bytes) {
+        size_t n = static_cast<size_t>(take(length_bytes));
+        if (!ok || len - pos < n) {
+            ok = false;
+            return std::string();
+        }
+        std::string value(reinterpret_cast<const char*>(data + pos), n);
+        pos += n;
+        return value;
+    }
+};
+
+ConfigDecodeResult config_session_decode(const char* data, size_t len, ConfigFrame& frame,
+                                         size_t& consumed, std::string& error) {
+    if (len < 4) {
+        return CONFIG_DECODE_INCOMPLETE;
+    }
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+    uint32_t body_len = (static_cast<uint32_t>(bytes[0]) << 24) | (static_cast<uint32_t>(bytes[1]) << 16) |
+                        (static_cast<uint32_t>(bytes[2]) << 8) | bytes[3];
+    if (body_len == 0 || body_len > CONFIG_SESSION_MAX_FRAME) {
+        error = "invalid frame length " + std::to_string(body_len);
+        return CONFIG_DECODE_ERROR;
+    }
+    if (len - 4 < body_len) {
+        return CONFIG_DECODE_INCOMPLETE;
+    }
+
+    FrameCursor cursor = {bytes + 4, body_len, 0, true};
+    frame.type = static_cast<int>(cursor.take(1));
+    frame.epoch = 0;
+    frame.version = 0;
+    frame.entries.clear();
+    frame.message.clear();
+    switch (frame.type) {
+    case CONFIG_FRAME_HELLO:
+    case CONFIG_FRAME_ACK:
+        frame.epoch = static_cast<uint32_t>(cursor.take(4));
+        frame.version = cursor.take(8);
+        break;
+    case CONFIG_FRAME_SNAPSHOT:
+    case CONFIG_FRAME_DELTA: {
+        frame.epoch = static_cast<uint32_t>(cursor.take(4));
+        frame.version = cursor.take(8);
+        size_t count = static_cast<size_t>(cursor.take(2));
+        for (size_t i = 0; i < count && cursor.ok; ++i) {
+            ConfigEntry entry;
+            entry.section = cursor.take_string(1);
+            entry.key = cursor.take_string(1);
+            entry.value = cursor.take_string(2);
+            frame.entries.push_back(entry);
+        }
+        break;
+    }
+    case CONFIG_FRAME_ERROR:
+    case CONFIG_FRAME_PING:
+    case CONFIG_FRAME_PONG:
+        frame.message.assign(reinterpret_cast<const char*>(bytes + 5), body_len - 1);
+        cursor.pos = body_len;
+        break;
+    default:
+        error = "unknown frame type " + std::to_string(frame.type);
+        return CONFIG_DECODE_ERROR;
+    }
+    if (!cursor.ok || cursor.pos != body_len) {
+        error = "malformed frame body (type " + std::to_string(frame.type) + ")";
+        return CONFIG_DECODE_ERROR;
+    }
+    consumed = 4 + body_len;
+    return CONFIG_DECODE_OK;
+}
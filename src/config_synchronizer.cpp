@@ -1,6 +1,9 @@
 // ConfigSynchronizer.cpp
 #include "config_synchronizer.h"
 #include "config.h" // g_configとloadConfigを使用するため
+#include "config_schema.h" // 受信した設定の検証のため
+#include "ini_document.h"  // コメントを保持したまま config.ini を読み書きするため
+#include <algorithm>
 #include <iostream>
 #include <string>
 #include <map>
@@ -16,24 +19,45 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <cstdlib>
 #include <cstring>
 #include <signal.h>
-
-// 文字列の前後から空白をトリムするヘルパー関数
-static std::string trim(const std::string& str) {
-    size_t first = str.find_first_not_of(" \t\n\r\f\v");
-    if (std::string::npos == first) {
-        return str;
-    }
-    size_t last = str.find_last_not_of(" \t\n\r\f\v");
-    return str.substr(first, (last - first + 1));
+#include <sys/epoll.h>
+#include <time.h>
+
+// シンクロナイザ用の config.ini の内容 (コメントと順序を含む)
+static IniDocument g_sync_document;
+// g_sync_document を保護するミューテックス (ファイルの書き込み中に制御スレッドの g_config_mutex を待たせないよう分ける)
+static std::mutex g_sync_document_mutex;
+
+// 地上局へ従来形式の設定を送る接続の再試行間隔
+static const int64_t WPF_RETRY_INTERVAL_NS = 5000000000LL;
+// セッションのハートビート: 送信が途絶えたら PING を送り、受信が途絶えたら切断する
+static const int64_t SESSION_HEARTBEAT_NS = 2000000000LL;
+static const int64_t SESSION_TIMEOUT_NS = 6000000000LL;
+// 再接続した地上局に差分で送れる版の数 (これより古い版からは全項目を送る)
+static const size_t SESSION_HISTORY_LENGTH = 64;
+// 送信待ちがこれを超えたら、地上局が受信していないものとして切断する
+static const size_t SESSION_MAX_TX_BYTES = 1024 * 1024;
+// 同時に受け付ける接続の数 (超えた接続はすぐに切断する)
+static const size_t MAX_CONNECTIONS = 16;
+// 従来形式の更新の上限: 長さのヘッダー (10進の桁数) と本体のバイト数
+static const size_t LEGACY_HEADER_MAX_DIGITS = 10;
+static const size_t LEGACY_MAX_BODY_BYTES = 64 * 1024;
+// 従来形式の接続と、種類が決まる前の接続の無通信タイムアウト
+static const int64_t LEGACY_TIMEOUT_NS = 5000000000LL;
+// 1回の受信で読み出す量 (一度に読み切れない分は次のイベントで読む)
+static const size_t RECV_CHUNK_BYTES = 16 * 1024;
+
+static int64_t monotonic_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
 }
 
-// シンクロナイザ用の設定データを保持するグローバルマップ
-static std::map<std::string, std::map<std::string, std::string>> g_sync_config_data;
-
 ConfigSynchronizer::ConfigSynchronizer(const std::string& config_path)
-    : m_config_path(config_path), m_shutdown_flag(false) {}
+    : m_config_path(config_path), m_shutdown_flag(false), m_epoch(0), m_version(1),
+      m_seen_change_count(0), m_epoll_fd(-1) {}
 
 ConfigSynchronizer::~ConfigSynchronizer() {
     stop();
@@ -56,137 +80,361 @@ void ConfigSynchronizer::run() {
         std::cerr << "Failed to load config for synchronizer." << std::endl;
         return;
     }
-
-    // 成功するまで接続と初期設定の送信を試行し続ける
-    while (!m_shutdown_flag.load()) {
-        std::cout << "Attempting to connect to WPF to send initial configuration..." << std::endl;
-        if (send_config_to_wpf()) {
-            std::cout << "Initial configuration sent successfully." << std::endl;
-            break; // 成功、ループを抜ける
-        }
-        std::cerr << "Failed to send initial configuration. Retrying in 5 seconds..." << std::endl;
-        
-        // 5秒待ってから再試行するが、シャットダウンフラグを定期的に確認する
-        for (int i = 0; i < 5; ++i) {
-            if (m_shutdown_flag.load()) break;
-            std::this_thread::sleep_for(std::chrono::seconds(1));
-        }
+    // 版の系列は起動ごとに変える (前回の起動で受け取った版からは差分を送れない)
+    m_epoch = static_cast<uint32_t>(time(nullptr)) ^ (static_cast<uint32_t>(getpid()) << 16);
+    m_version = 1;
+    m_seen_change_count = g_config_change_count.load(std::memory_order_acquire);
+    {
+        std::lock_guard<std::mutex> lock(g_config_mutex);
+        m_published = g_config;
     }
 
-    // シャットダウン中でなければ、更新のリスニングに進む
-    if (!m_shutdown_flag.load()) {
-        receive_config_updates();
-    }
+    // 従来形式の地上局への初期設定の送信は、待ち受けのループの中で成功するまで再試行する
+    receive_config_updates();
 
     std::cout << "ConfigSynchronizer thread finished." << std::endl;
 }
 
 bool ConfigSynchronizer::load_config() {
-    std::ifstream file(m_config_path);
-    if (!file.is_open()) {
+    IniDocument doc;
+    if (!doc.load(m_config_path)) {
         std::cerr << "Error: Cannot open config file '" << m_config_path << "'" << std::endl;
         return false;
     }
 
-    std::lock_guard<std::mutex> lock(g_config_mutex);
-    g_sync_config_data.clear();
-    std::string current_section;
+    std::lock_guard<std::mutex> lock(g_sync_document_mutex);
+    g_sync_document = doc;
+    return true;
+}
+
+// doc を config.ini に保存し、保存した内容を同期用のドキュメントにする。
+// 書き出すバイト列そのものを読み直して検証し、通らなければどちらのファイルも書かずに false を返す
+bool ConfigSynchronizer::save_config(const IniDocument& doc, std::string& error) {
+    IniDocument saved = doc;
+    // 保存するたびに世代を1つ進める (地上局はテレメトリの CFG_GEN で機体が使っている版を確認できる)
+    unsigned long generation = 0;
+    const std::string* current = saved.find("CONFIG_SYNC", "GENERATION");
+    if (current) {
+        generation = strtoul(current->c_str(), nullptr, 10);
+    }
+    generation = (generation + 1) & 0xffffffffUL;
+    saved.set("CONFIG_SYNC", "GENERATION", std::to_string(generation));
+    // コメントや項目の順序は読み込んだときのまま書き戻す
+    std::string contents = saved.to_string();
+
+    // メモリ上のドキュメントではなく、ファイルに書く内容を起動時と同じように読み直して検証する
+    // (壊れた内容を config.ini と控えの両方に書くと、次の起動で復元できなくなる)
+    std::istringstream written(contents);
+    IniDocument reparsed;
+    reparsed.parse(written);
+    AppConfig validated;
+    if (!config_from_document(reparsed, m_config_path, validated, &error)) {
+        std::cerr << "Refusing to save " << m_config_path << ": " << error << std::endl;
+        return false;
+    }
+    // 一時ファイルを fsync してから置き換えるので、途中で電源が切れても壊れたファイルは残らない
+    if (!config_write_file_atomic(m_config_path, contents)) {
+        error = "failed to write " + m_config_path;
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(g_sync_document_mutex);
+        g_sync_document = saved;
+    }
+    std::cout << "Configuration saved to " << m_config_path << " (generation " << generation << ")"
+              << std::endl;
+    // 起動時に読み込めなかった場合の控えも同じ内容に更新する
+    config_write_file_atomic(config_last_good_path(m_config_path), contents);
+    return true;
+}
+
+std::string ConfigSynchronizer::serialize_config() {
+    IniDocument doc = effective_document();
+    std::stringstream ss;
+    const std::vector<IniLine>& lines = doc.lines();
+    for (size_t i = 0; i < lines.size(); ++i) {
+        if (lines[i].kind == IniLine::ENTRY) {
+            ss << "[" << lines[i].section << "]" << lines[i].key << "=" << lines[i].value << "\n";
+        }
+    }
+    std::string content = ss.str();
+    return std::to_string(content.length()) + "\n" + content;
+}
+
+// 従来形式の本体 ("[SECTION]KEY=VALUE" の行) を項目に分解する。空行以外で形式に合わない行があれば全体を拒否する
+bool ConfigSynchronizer::update_config_from_string(const std::string& data, std::vector<ConfigEntry>& entries,
+                                                   std::string& error) {
+    std::stringstream ss(data);
     std::string line;
+    int line_number = 0;
+
+    while (std::getline(ss, line, '\n')) {
+        ++line_number;
+        std::string trimmed = ini_trim(line);
+        if (trimmed.empty()) continue;
+
+        size_t section_end = trimmed.find(']');
+        size_t equals_pos = section_end == std::string::npos ? std::string::npos : trimmed.find('=', section_end);
+        if (trimmed[0] != '[' || section_end == std::string::npos || section_end == 1 ||
+            equals_pos == std::string::npos) {
+            error = "line " + std::to_string(line_number) + ": expected [SECTION]KEY=VALUE";
+            return false;
+        }
+        ConfigEntry entry;
+        entry.section = trimmed.substr(1, section_end - 1);
+        entry.key = ini_trim(trimmed.substr(section_end + 1, equals_pos - (section_end + 1)));
+        entry.value = ini_trim(trimmed.substr(equals_pos + 1));
+        if (entry.key.empty()) {
+            error = "line " + std::to_string(line_number) + ": empty key";
+            return false;
+        }
+        entries.push_back(entry);
+    }
+    if (entries.empty()) {
+        error = "no config entries in update";
+        return false;
+    }
+    return true;
+}
 
-    while (std::getline(file, line)) {
-        line = trim(line);
-        if (line.empty() || line[0] == '#' || line[0] == ';') {
-            continue;
+// 1行の INI として書き出せない文字を含むか。値に改行があると別のセクションや項目として保存されてしまい、
+// メモリ上の検証をすり抜ける。セクション名とキーは "[", "]", "=" も区切りとして解釈されるため拒否する
+static bool has_control_character(const std::string& text) {
+    for (size_t i = 0; i < text.size(); ++i) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if (c < 0x20 || c == 0x7f) {
+            return true;
         }
-        if (line[0] == '[' && line.back() == ']') {
-            current_section = line.substr(1, line.length() - 2);
-        } else {
-            size_t eq_pos = line.find('=');
-            if (eq_pos != std::string::npos) {
-                std::string key = trim(line.substr(0, eq_pos));
-                std::string value = trim(line.substr(eq_pos + 1));
-                g_sync_config_data[current_section][key] = value;
+    }
+    return false;
+}
+
+static bool check_entry_text(const ConfigEntry& entry, std::string& error) {
+    const char* part = nullptr;
+    if (has_control_character(entry.section) || entry.section.find_first_of("[]=") != std::string::npos) {
+        part = "section";
+    } else if (has_control_character(entry.key) || entry.key.find_first_of("[]=") != std::string::npos) {
+        part = "key";
+    } else if (has_control_character(entry.value)) {
+        part = "value";
+    }
+    if (part) {
+        error = std::string("invalid character in ") + part + " of [" + entry.section + "]" + entry.key;
+        // 応答は1行で送るため、理由に含める制御文字は置き換える
+        for (size_t i = 0; i < error.size(); ++i) {
+            if (static_cast<unsigned char>(error[i]) < 0x20 || error[i] == 0x7f) {
+                error[i] = '?';
             }
         }
+        return false;
     }
     return true;
 }
 
-void ConfigSynchronizer::save_config() {
-    std::lock_guard<std::mutex> lock(g_config_mutex);
-    std::ofstream file(m_config_path);
-    if (!file.is_open()) {
-        std::cerr << "Error: Could not open config file for writing." << std::endl;
-        return;
+bool ConfigSynchronizer::apply_remote_entries(const std::vector<ConfigEntry>& entries, std::string& error) {
+    // 書き出したときに別の行として解釈される項目を含む更新は、何も変更せずに拒否する
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (!check_entry_text(entries[i], error)) {
+            return false;
+        }
+    }
+    // 保存していない live の変更は含めず、ファイルの内容に受け取った項目だけを重ねる
+    IniDocument updated = disk_document();
+    for (size_t i = 0; i < entries.size(); ++i) {
+        updated.set(entries[i].section, entries[i].key, entries[i].value);
     }
 
-    for (const auto& section_pair : g_sync_config_data) {
-        file << "[" << section_pair.first << "]" << std::endl;
-        for (const auto& key_value_pair : section_pair.second) {
-            file << key_value_pair.first << " = " << key_value_pair.second << std::endl;
+    // 制御プロセスと同じ表で検証し、不正な値を含む更新は保存しない (save_config が書き出す内容で検証する)
+    if (!save_config(updated, error)) {
+        return false;
+    }
+    drop_live_entries(entries);
+
+    std::cout << "Updated " << entries.size() << " config items from WPF." << std::endl;
+    // 設定のリロードを通知する (読み込みは ConfigReloader のスレッドが行う)
+    g_config_updated_flag.store(true);
+    return true;
+}
+
+void ConfigSynchronizer::record_change(const std::vector<ConfigEntry>& entries, int origin_sock) {
+    ++m_version;
+    ConfigChange change;
+    change.version = m_version;
+    change.entries = entries;
+    m_history.push_back(change);
+    if (m_history.size() > SESSION_HISTORY_LENGTH) {
+        m_history.pop_front();
+    }
+
+    // 変更を送ってきた接続 (origin_sock) には ACK で知らせるので、それ以外のセッションへ送る
+    ConfigFrame frame;
+    frame.type = CONFIG_FRAME_DELTA;
+    frame.epoch = m_epoch;
+    frame.version = m_version;
+    frame.entries = entries;
+    for (std::map<int, Connection>::iterator it = m_connections.begin(); it != m_connections.end(); ++it) {
+        Connection& conn = it->second;
+        if (conn.kind == CONNECTION_SESSION && conn.hello_received && !conn.dead && conn.sock != origin_sock) {
+            send_frame(conn, frame);
         }
-        file << std::endl;
     }
-    std::cout << "Configuration saved to " << m_config_path << std::endl;
 }
 
-std::string ConfigSynchronizer::serialize_config() {
-    std::lock_guard<std::mutex> lock(g_config_mutex);
-    std::stringstream ss;
-    for (const auto& section_pair : g_sync_config_data) {
-        for (const auto& key_value_pair : section_pair.second) {
-            ss << "[" << section_pair.first << "]"
-               << key_value_pair.first << "=" << key_value_pair.second << "\n";
+void ConfigSynchronizer::persist(const std::vector<ConfigEntry>& entries) {
+    std::lock_guard<std::mutex> lock(m_persist_mutex);
+    m_persist_queue.insert(m_persist_queue.end(), entries.begin(), entries.end());
+}
+
+void ConfigSynchronizer::save_persisted() {
+    std::vector<ConfigEntry> entries;
+    {
+        std::lock_guard<std::mutex> lock(m_persist_mutex);
+        entries.swap(m_persist_queue);
+    }
+    if (entries.empty()) {
+        return;
+    }
+    // 依頼された項目の変更を先に地上局へ送る (保存した後はファイルと同じ値になり、差分として検出できない)
+    unsigned change_count = g_config_change_count.load(std::memory_order_acquire);
+    if (change_count != m_seen_change_count) {
+        m_seen_change_count = change_count;
+        publish_local_changes();
+    }
+    // 依頼された項目だけをファイルの内容に重ねる (他の項目の live の変更は保存しない)
+    IniDocument updated = disk_document();
+    for (size_t i = 0; i < entries.size(); ++i) {
+        const ConfigField* field = config_find_field(entries[i].section, entries[i].key);
+        std::string section = field ? config_document_section(updated, *field) : entries[i].section;
+        updated.set(section, entries[i].key, entries[i].value);
+    }
+    std::cout << "Persisting " << entries.size() << " parameter changes." << std::endl;
+    std::string error;
+    if (!save_config(updated, error)) {
+        // 保存できなかった項目は live の変更として残る (次のリロードでファイルの値に戻る)
+        std::cerr << "Failed to persist parameter changes: " << error << std::endl;
+        return;
+    }
+    drop_live_entries(entries);
+    // 新しい世代を g_config に読み込む (保存していない live の変更はファイルの値に戻り、
+    // 戻った項目の担当 (PWM 周波数など) もリロード時に反映し直す)
+    g_config_updated_flag.store(true);
+}
+
+// 現在の config.ini の内容を読み込む (直接の編集も含める)。読めなければ最後に読み書きした内容を使う
+IniDocument ConfigSynchronizer::disk_document() {
+    IniDocument doc;
+    if (!doc.load(m_config_path)) {
+        std::cerr << "Warning: Cannot reread config file '" << m_config_path
+                  << "'; using the last known contents." << std::endl;
+        std::lock_guard<std::mutex> lock(g_sync_document_mutex);
+        doc = g_sync_document;
+    }
+    return doc;
+}
+
+// 地上局に見せる設定 (ファイルの内容に、保存していない live の変更を重ねたもの)
+IniDocument ConfigSynchronizer::effective_document() {
+    IniDocument doc;
+    {
+        std::lock_guard<std::mutex> lock(g_sync_document_mutex);
+        doc = g_sync_document;
+    }
+    for (size_t i = 0; i < m_live_entries.size(); ++i) {
+        doc.set(m_live_entries[i].section, m_live_entries[i].key, m_live_entries[i].value);
+    }
+    return doc;
+}
+
+// ファイルに書いた (または地上局が上書きした) 項目を live の変更から外す
+void ConfigSynchronizer::drop_live_entries(const std::vector<ConfigEntry>& entries) {
+    for (size_t i = 0; i < entries.size(); ++i) {
+        for (size_t j = 0; j < m_live_entries.size(); ++j) {
+            const ConfigField* field = config_find_field(entries[i].section, entries[i].key);
+            bool same = field ? config_find_field(m_live_entries[j].section, m_live_entries[j].key) == field
+                              : ini_equal(m_live_entries[j].section, entries[i].section) &&
+                                    ini_equal(m_live_entries[j].key, entries[i].key);
+            if (same) {
+                m_live_entries.erase(m_live_entries.begin() + j);
+                break;
+            }
         }
     }
-    std::string content = ss.str();
-    return std::to_string(content.length()) + "\n" + content;
 }
 
-void ConfigSynchronizer::update_config_from_string(const std::string& data) {
-    std::stringstream ss(data);
-    std::string line;
-    int updates_count = 0;
+// 同じ値か (表記の違いは表に従って正規化してから比べる)
+static bool same_field_value(const ConfigField& field, const std::string& text, const std::string& formatted) {
+    AppConfig parsed;
+    std::string error;
+    if (!config_set_field(field, text, parsed, error)) {
+        return false;
+    }
+    return config_format_field(field, parsed) == formatted;
+}
 
+void ConfigSynchronizer::publish_local_changes() {
+    AppConfig current;
     {
         std::lock_guard<std::mutex> lock(g_config_mutex);
-        while (std::getline(ss, line, '\n')) {
-            if (line.empty() || line[0] != '[') continue;
-
-            size_t section_end = line.find(']');
-            size_t equals_pos = line.find('=', section_end);
-
-            if (section_end != std::string::npos && equals_pos != std::string::npos) {
-                std::string section = line.substr(1, section_end - 1);
-                std::string key = line.substr(section_end + 1, equals_pos - (section_end + 1));
-                std::string value = line.substr(equals_pos + 1);
-                g_sync_config_data[section][key] = value;
-                updates_count++;
+        current = g_config;
+    }
+    std::vector<const ConfigField*> changed = config_diff(m_published, current);
+    m_published = current;
+
+    // 地上局から受け取った変更を適用しただけの項目 (地上局に見せている値と同じ) は送り返さない。
+    // 機体側の変更は m_live_entries に残し、g_sync_document (ファイルの内容) は変えない。
+    // ファイルの値に戻った項目 (リロード後など) は m_live_entries から外す
+    std::vector<ConfigEntry> entries;
+    {
+        std::lock_guard<std::mutex> lock(g_sync_document_mutex);
+        for (size_t i = 0; i < changed.size(); ++i) {
+            const ConfigField& field = *changed[i];
+            ConfigEntry entry;
+            entry.section = config_document_section(g_sync_document, field);
+            entry.key = field.key;
+            entry.value = config_format_field(field, current);
+            const std::string* on_disk = g_sync_document.find(entry.section, entry.key);
+            bool matches_disk = on_disk && same_field_value(field, *on_disk, entry.value);
+            size_t live = 0;
+            while (live < m_live_entries.size() && config_find_field(m_live_entries[live].section,
+                                                                     m_live_entries[live].key) != &field) {
+                ++live;
+            }
+            const std::string* known = live < m_live_entries.size() ? &m_live_entries[live].value : on_disk;
+            if (known && same_field_value(field, *known, entry.value)) {
+                continue;
+            }
+            if (matches_disk) {
+                m_live_entries.erase(m_live_entries.begin() + live);
+            } else if (live < m_live_entries.size()) {
+                m_live_entries[live].value = entry.value;
+            } else {
+                m_live_entries.push_back(entry);
             }
+            entries.push_back(entry);
         }
     }
-
-    if (updates_count > 0) {
-        std::cout << "Updated " << updates_count << " config items from WPF." << std::endl;
-        save_config();
-        // メインスレッドに設定のリロードを通知する
-        g_config_updated_flag.store(true);
+    if (entries.empty()) {
+        return;
     }
+    std::cout << "Publishing " << entries.size() << " config changes made on the vehicle." << std::endl;
+    record_change(entries, -1);
 }
 
 bool ConfigSynchronizer::send_config_to_wpf() {
     std::string host;
     int port = 0;
     {
-        std::lock_guard<std::mutex> lock(g_config_mutex);
-        if (g_sync_config_data.count("CONFIG_SYNC") && g_sync_config_data["CONFIG_SYNC"].count("WPF_HOST")) {
-            host = g_sync_config_data["CONFIG_SYNC"]["WPF_HOST"];
+        std::lock_guard<std::mutex> lock(g_sync_document_mutex);
+        const std::string* wpf_host = g_sync_document.find("CONFIG_SYNC", "WPF_HOST");
+        if (wpf_host) {
+            host = *wpf_host;
         } else {
             std::cerr << "WPF_HOST not found in config." << std::endl;
             return false;
         }
-        if (g_sync_config_data.count("CONFIG_SYNC") && g_sync_config_data["CONFIG_SYNC"].count("WPF_RECV_PORT")) {
-            port = std::stoi(g_sync_config_data["CONFIG_SYNC"]["WPF_RECV_PORT"]);
+        const std::string* wpf_port = g_sync_document.find("CONFIG_SYNC", "WPF_RECV_PORT");
+        if (wpf_port) {
+            port = std::stoi(*wpf_port);
         } else {
             std::cerr << "WPF_RECV_PORT not found in config." << std::endl;
             return false;
@@ -200,6 +448,12 @@ bool ConfigSynchronizer::send_config_to_wpf() {
         return false;
     }
 
+    // 接続できない場合にセッションの処理を長く止めないよう、接続と送信の待ち時間を制限する
+    struct timeval tv;
+    tv.tv_sec = 1;
+    tv.tv_usec = 0;
+    setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, (const char*)&tv, sizeof tv);
+
     struct sockaddr_in server_addr;
     memset(&server_addr, 0, sizeof(server_addr));
     server_addr.sin_family = AF_INET;
@@ -213,68 +467,20 @@ bool ConfigSynchronizer::send_config_to_wpf() {
     }
 
     std::string config_str = serialize_config();
-    send(sock, config_str.c_str(), config_str.length(), 0);
+    send(sock, config_str.c_str(), config_str.length(), MSG_NOSIGNAL);
     std::cout << "Sent config to WPF." << std::endl;
 
     close(sock);
     return true;
 }
 
-void ConfigSynchronizer::handle_client_connection(int client_sock) {
-    // クライアントソケットに受信タイムアウトを設定します。これは、クライアントが
-    // 接続してもデータを送信しない場合に、スレッドが recv() 呼び出しで
-    // 無期限にブロックされるのを防ぐために重要です。無期限のブロックは、
-    // アプリケーションのクリーンなシャットダウンを妨げます。
-    struct timeval tv;
-    tv.tv_sec = 1;  // 1秒のタイムアウト
-    tv.tv_usec = 0;
-    setsockopt(client_sock, SOL_SOCKET, SO_RCVTIMEO, (const char*)&tv, sizeof tv);
-
-    char buffer[4096] = {0};
-    std::string header;
-    char c;
-
-    // ヘッダーを読み込む
-    while (recv(client_sock, &c, 1, 0) > 0) {
-        if (c == '\n') break;
-        header += c;
-    }
-
-    if (header.empty()) {
-        close(client_sock);
-        return;
-    }
-
-    size_t expected_length = std::stoull(header);
-    std::string received_data;
-    received_data.reserve(expected_length);
-    size_t total_received = 0;
-
-    while (total_received < expected_length) {
-        ssize_t bytes_received = recv(client_sock, buffer, sizeof(buffer), 0);
-        if (bytes_received <= 0) {
-            std::cerr << "Error receiving config data body: connection closed, timed out, or error." << std::endl;
-            close(client_sock);
-            return;
-        }
-        received_data.append(buffer, bytes_received);
-        total_received += bytes_received;
-    }
-
-    if (!m_shutdown_flag.load()) {
-        std::cout << "Received config data from WPF." << std::endl;
-        update_config_from_string(received_data);
-    }
-
-    close(client_sock);
-}
-
 void ConfigSynchronizer::receive_config_updates() {
     int port = 0;
     {
-        std::lock_guard<std::mutex> lock(g_config_mutex);
-        if (g_sync_config_data.count("CONFIG_SYNC") && g_sync_config_data["CONFIG_SYNC"].count("CPP_RECV_PORT")) {
-            port = std::stoi(g_sync_config_data["CONFIG_SYNC"]["CPP_RECV_PORT"]);
+        std::lock_guard<std::mutex> lock(g_sync_document_mutex);
+        const std::string* cpp_port = g_sync_document.find("CONFIG_SYNC", "CPP_RECV_PORT");
+        if (cpp_port) {
+            port = std::stoi(*cpp_port);
         } else {
             std::cerr << "CPP_RECV_PORT not found in config." << std::endl;
             return;
@@ -302,36 +508,470 @@ void ConfigSynchronizer::receive_config_updates() {
         return;
     }
 
-    if (listen(listen_sock, 5) < 0) {
+    if (listen(listen_sock, static_cast<int>(MAX_CONNECTIONS)) < 0) {
         std::cerr << "Listen failed." << std::endl;
         close(listen_sock);
         return;
     }
 
+    int flags = fcntl(listen_sock, F_GETFL, 0);
+    fcntl(listen_sock, F_SETFL, flags | O_NONBLOCK);
+
+    m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (m_epoll_fd < 0) {
+        std::cerr << "epoll_create1 failed: " << strerror(errno) << std::endl;
+        close(listen_sock);
+        return;
+    }
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = listen_sock;
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, listen_sock, &ev);
+
     std::cout << "Listening for config updates on port " << port << std::endl;
 
+    bool wpf_sent = false;
+    int64_t next_wpf_attempt_ns = 0;
+    struct epoll_event events[32];
     while (!m_shutdown_flag.load()) {
-        fd_set readfds;
-        FD_ZERO(&readfds);
-        FD_SET(listen_sock, &readfds);
+        int64_t now_ns = monotonic_ns();
+        if (!wpf_sent && now_ns >= next_wpf_attempt_ns) {
+            std::cout << "Attempting to connect to WPF to send initial configuration..." << std::endl;
+            wpf_sent = send_config_to_wpf();
+            if (wpf_sent) {
+                std::cout << "Initial configuration sent successfully." << std::endl;
+            } else {
+                std::cerr << "Failed to send initial configuration. Retrying in 5 seconds..." << std::endl;
+                next_wpf_attempt_ns = now_ns + WPF_RETRY_INTERVAL_NS;
+            }
+        }
 
-        struct timeval timeout;
-        timeout.tv_sec = 1;
-        timeout.tv_usec = 0;
+        // 機体側で g_config が変わっていれば、地上局へ差分を送る
+        unsigned change_count = g_config_change_count.load(std::memory_order_acquire);
+        if (change_count != m_seen_change_count) {
+            m_seen_change_count = change_count;
+            publish_local_changes();
+        }
+        // 制御スレッドから依頼された項目を保存する (差分の送信より後に行い、保存した項目を live の変更から外す)
+        save_persisted();
 
-        int activity = select(listen_sock + 1, &readfds, nullptr, nullptr, &timeout);
+        check_timeouts(monotonic_ns());
+        close_dead_connections();
 
-        if (activity < 0 && errno != EINTR) {
+        // 200ms: 機体側の変更とハートビートを確認する間隔
+        int count = epoll_wait(m_epoll_fd, events, sizeof(events) / sizeof(events[0]), 200);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "epoll_wait failed: " << strerror(errno) << std::endl;
             break;
         }
 
-        if (activity > 0 && FD_ISSET(listen_sock, &readfds)) {
-            int client_sock = accept(listen_sock, nullptr, nullptr);
-            if (client_sock >= 0) {
-                handle_client_connection(client_sock);
+        for (int i = 0; i < count; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == listen_sock) {
+                accept_connections(listen_sock);
+                continue;
+            }
+            std::map<int, Connection>::iterator it = m_connections.find(fd);
+            if (it == m_connections.end()) continue;
+            Connection& conn = it->second;
+            if (!conn.dead && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+                read_connection(conn);
+            }
+            if (!conn.dead && (events[i].events & EPOLLOUT)) {
+                flush_connection(conn);
             }
         }
+        close_dead_connections();
     }
 
+    close_all_connections();
+    close(m_epoll_fd);
+    m_epoll_fd = -1;
     close(listen_sock);
 }
+
+void ConfigSynchronizer::accept_connections(int listen_sock) {
+    while (true) {
+        int sock = accept4(listen_sock, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (sock < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                std::cerr << "accept failed: " << strerror(errno) << std::endl;
+            }
+            return;
+        }
+        if (m_connections.size() >= MAX_CONNECTIONS) {
+            std::cerr << "Too many config sync connections; rejecting a new one." << std::endl;
+            close(sock);
+            continue;
+        }
+
+        Connection& conn = m_connections[sock];
+        conn.sock = sock;
+        conn.kind = CONNECTION_UNKNOWN;
+        conn.hello_received = false;
+        conn.close_after_flush = false;
+        conn.dead = false;
+        conn.last_rx_ns = monotonic_ns();
+        conn.last_tx_ns = conn.last_rx_ns;
+        conn.epoll_events = EPOLLIN;
+
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = conn.epoll_events;
+        ev.data.fd = sock;
+        if (epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, sock, &ev) < 0) {
+            std::cerr << "epoll_ctl failed: " << strerror(errno) << std::endl;
+            close(sock);
+            m_connections.erase(sock);
+        }
+    }
+}
+
+void ConfigSynchronizer::read_connection(Connection& conn) {
+    char buffer[RECV_CHUNK_BYTES];
+    ssize_t n = recv(conn.sock, buffer, sizeof(buffer), 0);
+    if (n < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            mark_dead(conn, strerror(errno));
+        }
+        return;
+    }
+    if (n == 0) {
+        if (conn.kind == CONNECTION_LEGACY && !conn.close_after_flush) {
+            std::cerr << "Error receiving config data body: connection closed before the full update." << std::endl;
+        }
+        mark_dead(conn, "connection closed");
+        return;
+    }
+    conn.last_rx_ns = monotonic_ns();
+    if (conn.close_after_flush) {
+        return; // 応答済み (切断待ち) の接続に届いたものは読み捨てる
+    }
+    conn.rx.append(buffer, n);
+
+    if (conn.kind == CONNECTION_UNKNOWN) {
+        // 先頭で接続の種類を判別する (セッションは CONFIG_SESSION_MAGIC、従来形式は長さの数字)
+        if (conn.rx[0] == CONFIG_SESSION_MAGIC[0]) {
+            if (conn.rx.size() < CONFIG_SESSION_MAGIC_LEN) {
+                return;
+            }
+            if (conn.rx.compare(0, CONFIG_SESSION_MAGIC_LEN, CONFIG_SESSION_MAGIC) == 0) {
+                conn.rx.erase(0, CONFIG_SESSION_MAGIC_LEN);
+                conn.kind = CONNECTION_SESSION;
+                std::cout << "Config session connected (" << m_connections.size() << " connections)." << std::endl;
+            }
+        }
+        if (conn.kind == CONNECTION_UNKNOWN) {
+            conn.kind = CONNECTION_LEGACY;
+        }
+    }
+
+    if (conn.kind == CONNECTION_SESSION) {
+        process_session_input(conn);
+    } else {
+        process_legacy_input(conn);
+    }
+}
+
+void ConfigSynchronizer::process_session_input(Connection& conn) {
+    // 受信したフレームを順に処理し、処理した分をまとめて捨てる
+    size_t offset = 0;
+    while (!conn.dead && !conn.close_after_flush) {
+        ConfigFrame frame;
+        size_t consumed = 0;
+        std::string error;
+        ConfigDecodeResult result = config_session_decode(conn.rx.data() + offset, conn.rx.size() - offset,
+                                                          frame, consumed, error);
+        if (result == CONFIG_DECODE_INCOMPLETE) {
+            break;
+        }
+        if (result == CONFIG_DECODE_ERROR) {
+            std::cerr << "Config session: " << error << std::endl;
+            send_error(conn, error);
+            break;
+        }
+        offset += consumed;
+        handle_session_frame(conn, frame);
+    }
+    conn.rx.erase(0, offset);
+}
+
+void ConfigSynchronizer::process_legacy_input(Connection& conn) {
+    size_t newline = conn.rx.find('\n');
+    if (newline == std::string::npos) {
+        // 改行の無い長いヘッダーは、本体の到着を待たずに拒否する
+        if (conn.rx.size() > LEGACY_HEADER_MAX_DIGITS + 1) {
+            send_error(conn, "length header too long");
+        }
+        return;
+    }
+    std::string header = conn.rx.substr(0, newline);
+    if (!header.empty() && header[header.size() - 1] == '\r') {
+        header.erase(header.size() - 1);
+    }
+    if (header.empty() || header.size() > LEGACY_HEADER_MAX_DIGITS ||
+        header.find_first_not_of("0123456789") != std::string::npos) {
+        send_error(conn, "invalid length header");
+        return;
+    }
+    unsigned long long expected_length = strtoull(header.c_str(), nullptr, 10);
+    if (expected_length > LEGACY_MAX_BODY_BYTES) {
+        send_error(conn, "update too large (" + header + " bytes, limit " +
+                             std::to_string(LEGACY_MAX_BODY_BYTES) + ")");
+        return;
+    }
+    size_t received = conn.rx.size() - newline - 1;
+    if (received < expected_length) {
+        return; // 本体の続きを待つ
+    }
+    if (received > expected_length) {
+        send_error(conn, "unexpected data after the update body");
+        return;
+    }
+
+    std::string body = conn.rx.substr(newline + 1);
+    conn.rx.clear();
+    std::cout << "Received config data from WPF." << std::endl;
+
+    std::vector<ConfigEntry> entries;
+    std::string error;
+    if (!update_config_from_string(body, entries, error) || !apply_remote_entries(entries, error)) {
+        std::cerr << "Rejected config update from WPF: " << error << std::endl;
+        send_error(conn, error);
+        return;
+    }
+    // 従来形式で受け取った変更もセッション中の地上局へ送る
+    record_change(entries, -1);
+    conn.tx.append("OK\n");
+    conn.close_after_flush = true;
+    flush_connection(conn);
+}
+
+void ConfigSynchronizer::handle_session_frame(Connection& conn, const ConfigFrame& frame) {
+    if (!conn.hello_received && frame.type != CONFIG_FRAME_HELLO && frame.type != CONFIG_FRAME_PING) {
+        send_error(conn, "expected HELLO");
+        return;
+    }
+
+    switch (frame.type) {
+    case CONFIG_FRAME_HELLO:
+        conn.hello_received = true;
+        send_hello_reply(conn, frame);
+        break;
+    case CONFIG_FRAME_DELTA: {
+        std::string error;
+        if (apply_remote_entries(frame.entries, error)) {
+            // 送ってきた地上局には ACK で新しい版だけを知らせる
+            record_change(frame.entries, conn.sock);
+            ConfigFrame reply;
+            reply.type = CONFIG_FRAME_ACK;
+            reply.epoch = m_epoch;
+            reply.version = m_version;
+            send_frame(conn, reply);
+        } else {
+            // 拒否した差分は ERROR で理由を返す (セッションは続ける)
+            ConfigFrame reply;
+            reply.type = CONFIG_FRAME_ERROR;
+            reply.message = error;
+            send_frame(conn, reply);
+        }
+        break;
+    }
+    case CONFIG_FRAME_PING: {
+        ConfigFrame reply;
+        reply.type = CONFIG_FRAME_PONG;
+        reply.message = frame.message;
+        send_frame(conn, reply);
+        break;
+    }
+    case CONFIG_FRAME_PONG:
+        break; // 受信時刻の更新のみ
+    default: {
+        // SNAPSHOT / ACK / ERROR は機体から送るものなので受け付けない
+        ConfigFrame reply;
+        reply.type = CONFIG_FRAME_ERROR;
+        reply.message = "unexpected frame type " + std::to_string(frame.type);
+        send_frame(conn, reply);
+        break;
+    }
+    }
+}
+
+void ConfigSynchronizer::send_hello_reply(Connection& conn, const ConfigFrame& hello) {
+    ConfigFrame reply;
+    reply.epoch = m_epoch;
+    reply.version = m_version;
+
+    // 同じ系列で、保持している変更から続きを作れる版なら差分だけを送る
+    bool resumable = hello.epoch == m_epoch && hello.version <= m_version &&
+                     (hello.version == m_version ||
+                      (!m_history.empty() && hello.version + 1 >= m_history.front().version));
+    if (resumable) {
+        reply.type = CONFIG_FRAME_DELTA;
+        for (size_t i = 0; i < m_history.size(); ++i) {
+            if (m_history[i].version <= hello.version) {
+                continue;
+            }
+            const std::vector<ConfigEntry>& entries = m_history[i].entries;
+            for (size_t j = 0; j < entries.size(); ++j) {
+                // 同じ項目が何度も変わっていれば最後の値だけを送る
+                size_t k = 0;
+                while (k < reply.entries.size() &&
+                       !(ini_equal(reply.entries[k].section, entries[j].section) &&
+                         ini_equal(reply.entries[k].key, entries[j].key))) {
+                    ++k;
+                }
+                if (k < reply.entries.size()) {
+                    reply.entries[k].value = entries[j].value;
+                } else {
+                    reply.entries.push_back(entries[j]);
+                }
+            }
+        }
+        std::cout << "Config session resumed from version " << hello.version << " ("
+                  << reply.entries.size() << " changed items)." << std::endl;
+    } else {
+        reply.type = CONFIG_FRAME_SNAPSHOT;
+        IniDocument doc = effective_document();
+        const std::vector<IniLine>& lines = doc.lines();
+        for (size_t i = 0; i < lines.size(); ++i) {
+            if (lines[i].kind == IniLine::ENTRY) {
+                ConfigEntry entry;
+                entry.section = lines[i].section;
+                entry.key = lines[i].key;
+                entry.value = lines[i].value;
+                reply.entries.push_back(entry);
+            }
+        }
+        std::cout << "Config session started with a full snapshot (" << reply.entries.size()
+                  << " items)." << std::endl;
+    }
+    send_frame(conn, reply);
+}
+
+void ConfigSynchronizer::send_frame(Connection& conn, const ConfigFrame& frame) {
+    if (conn.dead) {
+        return;
+    }
+    config_session_encode(frame, conn.tx);
+    conn.last_tx_ns = monotonic_ns();
+    flush_connection(conn);
+}
+
+// 回復できない誤りを相手の形式で知らせ、送り終えたら切断する
+void ConfigSynchronizer::send_error(Connection& conn, const std::string& message) {
+    if (conn.kind == CONNECTION_SESSION) {
+        ConfigFrame reply;
+        reply.type = CONFIG_FRAME_ERROR;
+        reply.message = message;
+        send_frame(conn, reply);
+    } else {
+        std::string line = message;
+        std::replace(line.begin(), line.end(), '\n', ' ');
+        conn.tx.append("ERROR " + line + "\n");
+    }
+    conn.rx.clear();
+    conn.close_after_flush = true;
+    flush_connection(conn);
+}
+
+void ConfigSynchronizer::flush_connection(Connection& conn) {
+    while (!conn.tx.empty() && !conn.dead) {
+        ssize_t n = send(conn.sock, conn.tx.data(), conn.tx.size(), MSG_NOSIGNAL);
+        if (n > 0) {
+            conn.tx.erase(0, n);
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break; // 残りは書き込み可能になってから送る
+        }
+        mark_dead(conn, "send failed");
+        return;
+    }
+    if (conn.tx.size() > SESSION_MAX_TX_BYTES) {
+        mark_dead(conn, "peer is not reading");
+        return;
+    }
+    if (conn.tx.empty() && conn.close_after_flush) {
+        mark_dead(conn, "request completed");
+        return;
+    }
+    update_epoll_events(conn);
+}
+
+void ConfigSynchronizer::check_timeouts(int64_t now_ns) {
+    for (std::map<int, Connection>::iterator it = m_connections.begin(); it != m_connections.end(); ++it) {
+        Connection& conn = it->second;
+        if (conn.dead) continue;
+        if (conn.kind != CONNECTION_SESSION) {
+            if (now_ns - conn.last_rx_ns > LEGACY_TIMEOUT_NS) {
+                if (conn.close_after_flush) {
+                    mark_dead(conn, "reply not read");
+                } else {
+                    send_error(conn, "timed out waiting for the update");
+                    mark_dead(conn, "timeout");
+                }
+            }
+        } else if (now_ns - conn.last_rx_ns > SESSION_TIMEOUT_NS) {
+            mark_dead(conn, "heartbeat timeout");
+        } else if (now_ns - conn.last_tx_ns > SESSION_HEARTBEAT_NS) {
+            // セッションのハートビート
+            ConfigFrame ping;
+            ping.type = CONFIG_FRAME_PING;
+            send_frame(conn, ping);
+        }
+    }
+}
+
+void ConfigSynchronizer::update_epoll_events(Connection& conn) {
+    uint32_t events = EPOLLIN;
+    if (!conn.tx.empty()) {
+        events |= EPOLLOUT;
+    }
+    if (events == conn.epoll_events) {
+        return;
+    }
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.fd = conn.sock;
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_MOD, conn.sock, &ev);
+    conn.epoll_events = events;
+}
+
+void ConfigSynchronizer::mark_dead(Connection& conn, const std::string& reason) {
+    if (!conn.dead) {
+        conn.dead = true;
+        conn.close_reason = reason;
+    }
+}
+
+void ConfigSynchronizer::close_dead_connections() {
+    std::map<int, Connection>::iterator it = m_connections.begin();
+    while (it != m_connections.end()) {
+        Connection& conn = it->second;
+        if (!conn.dead) {
+            ++it;
+            continue;
+        }
+        if (conn.kind == CONNECTION_SESSION) {
+            std::cout << "Config session closed (" << conn.close_reason << ")." << std::endl;
+        }
+        epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, conn.sock, nullptr);
+        close(conn.sock);
+        m_connections.erase(it++);
+    }
+}
+
+void ConfigSynchronizer::close_all_connections() {
+    for (std::map<int, Connection>::iterator it = m_connections.begin(); it != m_connections.end(); ++it) {
+        mark_dead(it->second, "shutdown");
+    }
+    close_dead_connections();
+}
@@ -0,0 +1,69 @@
+#include "control_loop.h"
+#include "attitude_estimator.h" // 姿勢推定 (AHRS)
+#include "config.h"             // グローバル設定オブジェクト g_config を使用するため
+#include "depth_hold.h"         // 深度保持モード
+#include "gamepad.h"            // ゲームパッドデータ構造体とパース関数
+#include "heading_hold.h"       // 方位保持制御
+#include "power_limiter.h"      // 電力制限
+#include "thruster_control.h"   // スラスター制御
+#include "trace.h"              // 周期内の処理時間のトレース
+
+// 最後に受信したゲームパッドの状態 (メインスレッド専用)
+static GamepadData latest_gamepad_data;
+
+void control_init() {
+  attitude_init(); // 姿勢推定器の初期化 (最初のIMUサンプルで姿勢を初期化する)
+  depth_hold_init(); // 深度推定器の初期化 (水面気圧のキャリブレーションを開始)
+  heading_hold_init(); // 方位保持制御器の初期化
+  inversion_detector_init(); // 反転検出器の初期化 (基準の重力方向を取得する)
+  power_limiter_init(); // 電力制限器の初期化
+  latest_gamepad_data = GamepadData{};
+}
+
+ControlOutputs control_step(const ControlInputs &inputs) {
+  ControlOutputs outputs = {InversionEvent::NONE, false};
+
+  // --- 姿勢推定と反転検出の更新 (毎周期 = IMUレートで実行) ---
+  {
+    TRACE_SCOPE("attitude_update");
+    attitude_update(inputs.accel, inputs.gyro, inputs.mag, inputs.dt_s);
+    outputs.inversion_event = inversion_detector_update(inputs.accel, inputs.dt_s);
+  }
+  // --- 電圧・電流の計測値を電力制限器に反映 (フェイルセーフ中も計測値は更新する) ---
+  if (inputs.adc_valid) {
+    power_limiter_update_measurements(inputs.adc, 4);
+  }
+
+  if (inputs.packet_len > 0) {
+    TRACE_SCOPE("parse_gamepad");
+    std::string received_str(inputs.packet, inputs.packet_len);
+    latest_gamepad_data = parseGamepadData(received_str);
+  }
+
+  {
+    TRACE_SCOPE("hold_controllers");
+    // --- 深度推定と深度保持制御 (制御レートで実行) ---
+    depth_hold_update(latest_gamepad_data, inputs.pressure, inputs.dt_s);
+    // --- 方位保持制御 (姿勢推定器のヨー角を使用) ---
+    heading_hold_update(latest_gamepad_data, inputs.gyro, inputs.dt_s);
+  }
+
+  if (!inputs.control_enabled) {
+    return outputs;
+  }
+
+  bool inverted = inversion_detector_is_inverted();
+  if (inverted && g_config.inversion_response == InversionResponse::NEUTRAL) {
+    thruster_set_all_pwm(g_config.pwm_min); // 反転中は推力を出さない
+  } else {
+    TRACE_SCOPE("thruster_update");
+    thruster_update(latest_gamepad_data, inputs.gyro);
+  }
+  outputs.restart_requested =
+      inverted && g_config.inversion_response == InversionResponse::RESTART;
+  return outputs;
+}
+
+void control_reset_gamepad() { latest_gamepad_data = GamepadData{}; }
+
+const GamepadData &control_get_gamepad() { return latest_gamepad_data; }
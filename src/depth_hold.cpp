@@ -0,0 +1,141 @@
+#include "depth_hold.h"
+#include "config.h"  // グローバル設定オブジェクト g_config を使用するため
+#include <algorithm> // std::max, std::min のため
+#include <cmath>     // std::abs のため
+#include <stdio.h>   // printf のため
+
+// 重力加速度 (m/s^2)
+static const float GRAVITY = 9.80665f;
+
+// --- 深度推定の状態 ---
+static float surface_pressure_pa = 0.0f; // 水面 (深度0) の気圧
+static double calibration_sum_pa = 0.0;  // 自動キャリブレーション用の積算値
+static int calibration_count = 0;
+static bool calibrated = false;
+static float filtered_depth_m = 0.0f;
+static float depth_rate_mps = 0.0f; // 深度の変化率 (D項用、下向き正)
+
+// --- 制御器の状態 ---
+static bool hold_active = false;
+static bool button_previously_pressed = false;
+static bool manual_override = false; // パイロットがスティックで上書き中か
+static float setpoint_m = 0.0f;
+static float integral = 0.0f;
+static float output_pwm = 0.0f; // pwm_min からの加算量
+
+void depth_hold_init() {
+  surface_pressure_pa = g_config.depth_surface_pressure_pa;
+  calibration_sum_pa = 0.0;
+  calibration_count = 0;
+  calibrated = surface_pressure_pa > 0.0f; // 0 以下なら起動時に自動計測
+  filtered_depth_m = 0.0f;
+  depth_rate_mps = 0.0f;
+  hold_active = false;
+  button_previously_pressed = false;
+  manual_override = false;
+  setpoint_m = 0.0f;
+  integral = 0.0f;
+  output_pwm = 0.0f;
+}
+
+// 目標深度を現在深度に合わせ、積分項をリセットする
+static void latch_setpoint() {
+  setpoint_m = filtered_depth_m;
+  integral = 0.0f;
+}
+
+void depth_hold_update(const GamepadData &gamepad_data, float pressure,
+                       float dt_s) {
+  float pressure_pa = pressure * g_config.depth_pressure_to_pa;
+
+  // --- 水面気圧のキャリブレーション (起動直後の数サンプルを平均) ---
+  if (!calibrated) {
+    calibration_sum_pa += pressure_pa;
+    calibration_count++;
+    if (calibration_count >= g_config.depth_calibration_samples) {
+      surface_pressure_pa =
+          static_cast<float>(calibration_sum_pa / calibration_count);
+      calibrated = true;
+      printf("Depth: surface pressure calibrated to %.1f Pa\n",
+             surface_pressure_pa);
+    }
+    return;
+  }
+
+  // --- 深度推定 (一次ローパスフィルタ) ---
+  float raw_depth = (pressure_pa - surface_pressure_pa) /
+                    (g_config.depth_water_density * GRAVITY);
+  float prev_depth = filtered_depth_m;
+  const float alpha = g_config.depth_filter_alpha;
+  filtered_depth_m += (raw_depth - filtered_depth_m) * alpha;
+  if (dt_s > 0.0f) {
+    float rate = (filtered_depth_m - prev_depth) / dt_s;
+    depth_rate_mps += (rate - depth_rate_mps) * alpha;
+  }
+
+  // --- ボタンによるモード切替 (立ち上がりエッジ) ---
+  bool button_currently_pressed =
+      (gamepad_data.buttons & g_config.depth_hold_button) != 0;
+  if (button_currently_pressed && !button_previously_pressed) {
+    hold_active = !hold_active;
+    if (hold_active) {
+      latch_setpoint();
+    }
+    output_pwm = 0.0f;
+    printf("Depth hold %s (setpoint %.2f m)\n", hold_active ? "ON" : "OFF",
+           setpoint_m);
+  }
+  button_previously_pressed = button_currently_pressed;
+
+  if (!hold_active) {
+    return;
+  }
+
+  // --- パイロットによる上書き: スティック操作中は制御を止め、離したら再ラッチ ---
+  bool stick_active =
+      std::abs(gamepad_data.rightThumbY) > g_config.joystick_deadzone;
+  if (stick_active) {
+    manual_override = true;
+    return;
+  }
+  if (manual_override) {
+    manual_override = false;
+    latch_setpoint();
+  }
+
+  // --- PID 制御 (誤差: 目標より浅い = 正 = 潜航方向の推力が必要) ---
+  float error = setpoint_m - filtered_depth_m;
+  float max_out = static_cast<float>(g_config.depth_max_output);
+  float u = g_config.depth_kp * error + g_config.depth_ki * integral -
+            g_config.depth_kd * depth_rate_mps;
+  u *= static_cast<float>(g_config.depth_output_sign);
+
+  // 飽和方向へさらに積分しないようにする (アンチワインドアップ)
+  float signed_error = error * static_cast<float>(g_config.depth_output_sign);
+  bool saturated_high = u >= max_out && signed_error > 0.0f;
+  bool saturated_low = u <= 0.0f && signed_error < 0.0f;
+  if (!saturated_high && !saturated_low && dt_s > 0.0f) {
+    integral += error * dt_s;
+    integral = std::max(-g_config.depth_integral_limit,
+                        std::min(g_config.depth_integral_limit, integral));
+  }
+
+  // 垂直スラスターは単方向 (pwm_min で停止) なので負の出力は 0 に丸める
+  output_pwm = std::max(0.0f, std::min(max_out, u));
+}
+
+int depth_hold_vertical_pwm(int manual_pwm) {
+  if (!hold_active || manual_override || !calibrated) {
+    return manual_pwm;
+  }
+  return g_config.pwm_min + static_cast<int>(output_pwm);
+}
+
+DepthHoldStatus depth_hold_get_status() {
+  DepthHoldStatus status;
+  status.depth_m = filtered_depth_m;
+  status.setpoint_m = setpoint_m;
+  status.calibrated = calibrated;
+  status.active = hold_active;
+  return status;
+}
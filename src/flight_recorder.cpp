@@ -0,0 +1,280 @@
+#include "flight_recorder.h"
+#include "aux_output.h"       // 補助出力の段階をヘッダーに記録するため
+#include "thruster_control.h" // thruster_get_output_pwm を使用するため
+#include <algorithm>          // std::min, std::max のため
+#include <atomic>             // std::atomic のため
+#include <chrono>             // std::chrono::milliseconds のため
+#include <cstring>            // memcpy, strerror のため
+#include <errno.h>            // errno のため
+#include <fstream>            // 設定ファイルの読み込みのため
+#include <iostream>           // std::cerr のため
+#include <sstream>            // std::stringstream のため
+#include <stdio.h>            // FILE, fopen, fwrite, snprintf のため
+#include <sys/stat.h>         // mkdir のため
+#include <thread>             // std::thread のため
+#include <time.h>             // localtime_r, strftime のため
+#include <vector>             // std::vector のため
+
+// --- リングバッファ (制御スレッドが書き込み、書き込みスレッドが読み出す単一生産者/単一消費者) ---
+// 位置は単調増加するバイト数で保持し、添字は容量で割った余りで求める
+static std::vector<char> ring;
+static std::atomic<size_t> write_pos(0);
+static std::atomic<size_t> read_pos(0);
+
+static std::thread writer_thread;
+static std::atomic<bool> writer_running(false);
+static FILE *record_file = nullptr;
+static unsigned long long max_file_bytes = 0;
+// 書き込みスレッド専用の状態 (記録の開始時に初期化する)
+static unsigned long long written_bytes = 0; // ファイルに書いたバイト数 (ヘッダーを含む)
+static bool file_full = false;               // ファイルサイズの上限に達した
+
+// 制御スレッド専用の状態
+static bool recording = false;
+static uint32_t tick_counter = 0;
+static std::atomic<unsigned int> dropped_count(0);
+
+// リングバッファにレコードを追加する。空きが足りなければ破棄する (制御周期を止めないため)
+static bool ring_push(uint16_t type, const void *part1, size_t len1,
+                      const void *part2, size_t len2) {
+  FlightRecordHeader header = {type, 0, static_cast<uint32_t>(len1 + len2)};
+  size_t total = sizeof(header) + len1 + len2;
+  size_t capacity = ring.size();
+  size_t wpos = write_pos.load(std::memory_order_relaxed);
+  size_t used = wpos - read_pos.load(std::memory_order_acquire);
+  if (capacity - used < total) {
+    dropped_count++;
+    return false;
+  }
+  const void *parts[3] = {&header, part1, part2};
+  size_t lens[3] = {sizeof(header), len1, len2};
+  for (int p = 0; p < 3; ++p) {
+    const char *src = static_cast<const char *>(parts[p]);
+    size_t len = lens[p];
+    while (len > 0) {
+      size_t index = wpos % capacity;
+      size_t chunk = std::min(len, capacity - index);
+      memcpy(&ring[index], src, chunk);
+      src += chunk;
+      len -= chunk;
+      wpos += chunk;
+    }
+  }
+  write_pos.store(wpos, std::memory_order_release);
+  return true;
+}
+
+// リングバッファの pos から len バイトを dst にコピーする (末尾で折り返す)
+static void ring_copy(size_t pos, void *dst, size_t len) {
+  size_t capacity = ring.size();
+  char *out = static_cast<char *>(dst);
+  while (len > 0) {
+    size_t index = pos % capacity;
+    size_t chunk = std::min(len, capacity - index);
+    memcpy(out, &ring[index], chunk);
+    out += chunk;
+    len -= chunk;
+    pos += chunk;
+  }
+}
+
+// リングバッファの pos から len バイトをファイルへ書き出す (末尾で折り返す)
+static bool ring_write(size_t pos, size_t len) {
+  size_t capacity = ring.size();
+  while (len > 0) {
+    size_t index = pos % capacity;
+    size_t chunk = std::min(len, capacity - index);
+    if (fwrite(&ring[index], 1, chunk, record_file) != chunk) {
+      return false;
+    }
+    len -= chunk;
+    pos += chunk;
+  }
+  return true;
+}
+
+// リングバッファの内容をファイルへ書き出す (書き込みスレッド)。
+// ファイルサイズの上限はレコード単位で判定し、途中で切れたレコードを書かない。
+// 上限に達した後のレコードは破棄した数に含める
+static void drain_ring() {
+  size_t rpos = read_pos.load(std::memory_order_relaxed);
+  size_t wpos = write_pos.load(std::memory_order_acquire);
+  while (rpos != wpos) {
+    FlightRecordHeader header;
+    ring_copy(rpos, &header, sizeof(header));
+    size_t total = sizeof(header) + header.length;
+    if (!file_full && max_file_bytes != 0 && written_bytes + total > max_file_bytes) {
+      std::cerr << "フライトレコーダー: ファイルサイズの上限に達したため記録を停止します。"
+                << std::endl;
+      file_full = true;
+    }
+    if (file_full) {
+      dropped_count++;
+    } else {
+      if (!ring_write(rpos, total)) {
+        std::cerr << "フライトレコーダー: 書き込みエラー: " << strerror(errno)
+                  << std::endl;
+      }
+      written_bytes += total;
+    }
+    rpos += total;
+  }
+  read_pos.store(rpos, std::memory_order_release);
+  fflush(record_file);
+}
+
+static void writer_loop() {
+  while (writer_running.load()) {
+    drain_ring();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+  drain_ring(); // 停止前に残りを書き出す
+}
+
+// 設定ファイルの全文を読み込む
+static bool read_file(const std::string &path, std::string &contents) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    return false;
+  }
+  std::stringstream ss;
+  ss << file.rdbuf();
+  contents = ss.str();
+  return true;
+}
+
+// --- モジュール関数 ---
+
+bool flight_recorder_start(const std::string &config_path) {
+  if (!g_config.recorder_enabled || recording) {
+    return true;
+  }
+
+  // 出力先ディレクトリ (無ければ作成) とファイル名 (開始時刻)
+  const std::string &dir = g_config.recorder_directory;
+  if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+    std::cerr << "フライトレコーダー: ディレクトリ '" << dir
+              << "' を作成できません: " << strerror(errno) << std::endl;
+    return false;
+  }
+  char name[64];
+  time_t now = time(nullptr);
+  struct tm local_tm;
+  localtime_r(&now, &local_tm);
+  strftime(name, sizeof(name), "flight_%Y%m%d_%H%M%S.rec", &local_tm);
+  std::string path = dir + "/" + name;
+  record_file = fopen(path.c_str(), "wb");
+  if (!record_file) {
+    std::cerr << "フライトレコーダー: '" << path
+              << "' を開けません: " << strerror(errno) << std::endl;
+    return false;
+  }
+
+  FlightRecordFileHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, FLIGHT_RECORD_MAGIC, sizeof(header.magic));
+  header.version = FLIGHT_RECORD_VERSION;
+  header.tick_size = sizeof(FlightRecordTick);
+  aux_output_get_levels(header.aux_levels);
+  fwrite(&header, sizeof(header), 1, record_file);
+
+  // リングバッファは開始時に一度だけ確保する (制御周期中にヒープ確保を行わない)
+  ring.assign(static_cast<size_t>(std::max(64, g_config.recorder_buffer_kb)) *
+                  1024,
+              0);
+  write_pos.store(0);
+  read_pos.store(0);
+  max_file_bytes =
+      static_cast<unsigned long long>(std::max(0, g_config.recorder_max_file_mb)) *
+      1024ULL * 1024ULL;
+  written_bytes = sizeof(header);
+  file_full = false;
+  tick_counter = 0;
+  dropped_count.store(0);
+  recording = true;
+
+  flight_recorder_note_config(config_path);
+
+  writer_running.store(true);
+  writer_thread = std::thread(writer_loop);
+  std::cout << "フライトレコーダー: " << path << " に記録します。" << std::endl;
+  return true;
+}
+
+void flight_recorder_stop() {
+  if (!recording) {
+    return;
+  }
+  recording = false;
+  writer_running.store(false);
+  if (writer_thread.joinable()) {
+    writer_thread.join();
+  }
+  fclose(record_file);
+  record_file = nullptr;
+  std::cout << "フライトレコーダー: " << tick_counter << " 周期を記録しました (破棄したレコード "
+            << dropped_count.load() << ")。" << std::endl;
+}
+
+void flight_recorder_note_config(const std::string &config_path) {
+  if (!recording) {
+    return;
+  }
+  std::string contents;
+  if (!read_file(config_path, contents)) {
+    std::cerr << "フライトレコーダー: 設定ファイル '" << config_path
+              << "' を記録できません。" << std::endl;
+    return;
+  }
+  flight_recorder_note_config_contents(contents);
+}
+
+void flight_recorder_note_config_contents(const std::string &contents) {
+  if (!recording) {
+    return;
+  }
+  ring_push(FLIGHT_RECORD_CONFIG, contents.data(), contents.size(), nullptr, 0);
+}
+
+void flight_recorder_note_param(const char *section, const char *key,
+                                const std::string &value) {
+  if (!recording) {
+    return;
+  }
+  char text[256];
+  int len = snprintf(text, sizeof(text), "%s.%s=%s", section, key, value.c_str());
+  if (len < 0 || static_cast<size_t>(len) >= sizeof(text)) {
+    // 切り詰めた値を再生すると結果が変わるため、記録できなかったものとして数える
+    dropped_count++;
+    return;
+  }
+  ring_push(FLIGHT_RECORD_PARAM, text, static_cast<size_t>(len), nullptr, 0);
+}
+
+void flight_recorder_record_tick(const ControlInputs &inputs,
+                                 bool failsafe_entered, int64_t time_ns) {
+  if (!recording) {
+    return;
+  }
+  FlightRecordTick tick;
+  memset(&tick, 0, sizeof(tick));
+  tick.tick = tick_counter++;
+  tick.flags = (inputs.control_enabled ? FLIGHT_TICK_CONTROL_ENABLED : 0) |
+               (inputs.adc_valid ? FLIGHT_TICK_ADC_VALID : 0) |
+               (failsafe_entered ? FLIGHT_TICK_FAILSAFE_ENTERED : 0);
+  tick.time_ns = time_ns;
+  tick.dt_s = inputs.dt_s;
+  tick.gyro = inputs.gyro;
+  tick.accel = inputs.accel;
+  tick.mag = inputs.mag;
+  tick.pressure = inputs.pressure;
+  memcpy(tick.adc, inputs.adc, sizeof(tick.adc));
+  for (int ch = 0; ch < FLIGHT_RECORD_PWM_CHANNELS; ++ch) {
+    tick.pwm_us[ch] = static_cast<uint16_t>(thruster_get_output_pwm(ch));
+  }
+  tick.packet_len = static_cast<uint32_t>(inputs.packet_len);
+  ring_push(FLIGHT_RECORD_TICK, &tick, sizeof(tick), inputs.packet,
+            static_cast<size_t>(inputs.packet_len));
+}
+
+unsigned int flight_recorder_dropped() { return dropped_count.load(); }
@@ -1,32 +1,27 @@
 #include "gstPipeline.h"
 #include "config.h" // g_config を使用するため
+#include "metrics.h" // パイプラインの状態とフレーム数の計数のため
+#include "video_bitrate.h" // 回線の混雑に合わせたビットレートの調整のため
+#include <atomic>
 #include <iostream>
+#include <mutex>  // パイプラインの差し替えと停止の排他のため
+#include <stdlib.h> // atoi
+#include <stdint.h>
 #include <string> // std::stringとstd::to_stringのため
 #include <thread> // std::threadのため
+#include <time.h> // clock_gettime (最初のフレームまでの時間の計測)
 
+// パイプラインがエラーや EOS で止まったときの再起動の間隔 (失敗が続くたびに倍にする)
+static const guint RESTART_DELAY_MIN_MS = 500;
+static const guint RESTART_DELAY_MAX_MS = 30000;
+// 最初のフレームからこの時間以上動作していれば、連続した失敗の回数を数え直す
+static const int64_t RESTART_STABLE_NS = 10LL * 1000000000LL;
 
-// --- グローバル変数 ---
-// GStreamerパイプラインのインスタンス (カメラ1用)
-static GstElement *pipeline1 = nullptr;
-// GStreamerパイプラインのインスタンス (カメラ2用)
-static GstElement *pipeline2 = nullptr;
-// GStreamerのメインループ (カメラ1用)。イベント処理やメッセージ処理を行う。
-static GMainLoop *main_loop1 = nullptr;
-// GStreamerのメインループ (カメラ2用)
-static GMainLoop *main_loop2 = nullptr;
-// main_loop1を実行するためのスレッド
-static std::thread loop_thread1;
-// main_loop2を実行するためのスレッド
-static std::thread loop_thread2;
-
-// GMainLoopを指定されたスレッドで実行するための関数
-static void run_main_loop(GMainLoop *loop) { g_main_loop_run(loop); }
-
-static bool create_pipeline(const AppConfig &app_config, int camera_idx,
-                            GstElement **pipeline_ptr, GMainLoop **loop_ptr) {
+// カメラ1台分のパイプラインの設定 (AppConfig から取り出したもの)
+struct CameraSettings {
   std::string device;
+  std::string host; // 共通のホストIPを使用
   int port;
-  const std::string &host = app_config.client_host; // 共通のホストIPを使用
   int width;
   int height;
   int framerate_num;
@@ -34,72 +29,478 @@ static bool create_pipeline(const AppConfig &app_config, int camera_idx,
   bool is_h264_native_source;
   int rtp_payload_type;
   int rtp_config_interval;
-  int x264_bitrate = 0;          // カメラ2のみ
-  std::string x264_tune;         // カメラ2のみ
-  std::string x264_speed_preset; // カメラ2のみ
-
-  if (camera_idx == 1) {
-    device = app_config.gst1_device;
-    port = app_config.gst1_port;
-    width = app_config.gst1_width;
-    height = app_config.gst1_height;
-    framerate_num = app_config.gst1_framerate_num;
-    framerate_den = app_config.gst1_framerate_den;
-    is_h264_native_source = app_config.gst1_is_h264_native_source;
-    rtp_payload_type = app_config.gst1_rtp_payload_type;
-    rtp_config_interval = app_config.gst1_rtp_config_interval;
-  } else if (camera_idx == 2) {
-    device = app_config.gst2_device;
-    port = app_config.gst2_port;
-    width = app_config.gst2_width;
-    height = app_config.gst2_height;
-    framerate_num = app_config.gst2_framerate_num;
-    framerate_den = app_config.gst2_framerate_den;
-    is_h264_native_source = app_config.gst2_is_h264_native_source;
-    rtp_payload_type = app_config.gst2_rtp_payload_type;
-    rtp_config_interval = app_config.gst2_rtp_config_interval;
-    x264_bitrate = app_config.gst2_x264_bitrate;
-    x264_tune = app_config.gst2_x264_tune;
-    x264_speed_preset = app_config.gst2_x264_speed_preset;
+  bool low_latency;
+  int key_int_max;
+  int x264_bitrate;              // エンコードする場合のビットレート (自動調整の上限)
+  std::string x264_tune;         // エンコードする場合のみ
+  std::string x264_speed_preset; // エンコードする場合のみ
+  int x264_slices;               // エンコードする場合のみ
+};
+
+// 指定したカメラ (1 ~ CONFIG_MAX_CAMERAS) の設定を取り出す。使わないカメラ (DEVICE が空) なら false
+static bool get_camera_settings(const AppConfig &app_config, int camera_idx,
+                                CameraSettings &settings) {
+  const CameraConfig &camera = app_config.cameras[camera_idx - 1];
+  settings.device = camera.device;
+  settings.host = app_config.client_host;
+  settings.port = camera.port;
+  settings.width = camera.width;
+  settings.height = camera.height;
+  settings.framerate_num = camera.framerate_num;
+  settings.framerate_den = camera.framerate_den;
+  settings.is_h264_native_source = camera.is_h264_native_source;
+  settings.rtp_payload_type = camera.rtp_payload_type;
+  settings.rtp_config_interval = camera.rtp_config_interval;
+  settings.low_latency = camera.low_latency;
+  settings.key_int_max = camera.key_int_max;
+  settings.x264_bitrate = camera.x264_bitrate;
+  settings.x264_tune = camera.x264_tune;
+  settings.x264_speed_preset = camera.x264_speed_preset;
+  settings.x264_slices = camera.x264_slices;
+  return !settings.device.empty();
+}
+
+// 設定がすべて同じか (同じなら反映する必要が無い)
+static bool same_settings(const CameraSettings &a, const CameraSettings &b) {
+  return a.device == b.device && a.host == b.host && a.port == b.port &&
+         a.width == b.width && a.height == b.height &&
+         a.framerate_num == b.framerate_num &&
+         a.framerate_den == b.framerate_den &&
+         a.is_h264_native_source == b.is_h264_native_source &&
+         a.rtp_payload_type == b.rtp_payload_type &&
+         a.rtp_config_interval == b.rtp_config_interval &&
+         a.low_latency == b.low_latency && a.key_int_max == b.key_int_max &&
+         a.x264_bitrate == b.x264_bitrate && a.x264_tune == b.x264_tune &&
+         a.x264_speed_preset == b.x264_speed_preset &&
+         a.x264_slices == b.x264_slices;
+}
+
+// 再生を止めずに変更できない項目 (送信先と x264enc のビットレート以外) が同じか
+static bool same_pipeline_structure(const CameraSettings &a,
+                                    const CameraSettings &b) {
+  return a.device == b.device && a.width == b.width && a.height == b.height &&
+         a.framerate_num == b.framerate_num &&
+         a.framerate_den == b.framerate_den &&
+         a.is_h264_native_source == b.is_h264_native_source &&
+         a.rtp_payload_type == b.rtp_payload_type &&
+         a.rtp_config_interval == b.rtp_config_interval &&
+         a.low_latency == b.low_latency && a.key_int_max == b.key_int_max &&
+         a.x264_tune == b.x264_tune &&
+         a.x264_speed_preset == b.x264_speed_preset &&
+         a.x264_slices == b.x264_slices;
+}
+
+// --- グローバル変数 ---
+// カメラ1台分のパイプライン (添字はカメラ番号 - 1)
+struct CameraPipeline {
+  GstElement *pipeline;    // 使わないカメラ・作成に失敗したカメラは nullptr
+  GSource *bus_watch;      // camera_context に登録したバスの監視
+  GSource *restart_timer;  // 予定している再起動 (無ければ nullptr)
+  CameraSettings settings; // 作成したときの設定 (再起動で使う)
+  bool enabled;            // 設定でこのカメラを使う (再起動の対象)
+  int applied_kbps;        // 直前に設定したビットレート (0: 設定していない)
+  int failures;            // 連続して止まった回数 (再起動の間隔の計算用)
+  // 以下はストリーミングスレッドのパッドプローブからも参照する
+  std::atomic<int64_t> started_ns;     // パイプラインを起動した時刻
+  std::atomic<int64_t> first_frame_ns; // 最初のフレームが届いた時刻 (0: まだ届いていない)
+  // 撮影から udpsink までの遅延の集計 (udpsink のストリーミングスレッドが加算し、
+  // 1秒ごとに camera_context のタイマーが締めて metrics に公開する)
+  std::atomic<uint64_t> last_sent_pts;   // 直前に計測したフレームの PTS (RTP パケットの重複を除く)
+  std::atomic<int64_t> latency_sum_ns;
+  std::atomic<uint32_t> latency_frames;
+  std::atomic<int64_t> latency_max_ns;
+};
+static CameraPipeline cameras[CONFIG_MAX_CAMERAS];
+
+// 全カメラのバスの監視を処理する GMainContext と、それを回すループ・スレッド
+// (カメラの台数によらずスレッドは1本。再起動のタイマーもこの context で動く)
+static GMainContext *camera_context = nullptr;
+static GMainLoop *camera_loop = nullptr;
+static std::thread camera_thread;
+static bool stopping = false; // stop_gstreamer_pipelines() の開始後は再起動しない
+static GSource *periodic_timer = nullptr; // 遅延の集計とビットレートの見直しを1秒ごとに行うタイマー
+// ビットレートの自動調整の目標 (kbps、0: 調整しない)。各カメラには X264_BITRATE を超えない範囲で設定する
+static int video_target_kbps = 0;
+
+// パイプラインの作成・差し替え・再起動・停止の排他
+// (差し替えはリロード用スレッド、再起動はバスの監視用のスレッドから行われる)
+static std::mutex pipeline_mutex;
+
+static int64_t monotonic_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+// camera_context を専用スレッドで回す
+static void run_camera_loop() {
+  g_main_context_push_thread_default(camera_context);
+  g_main_loop_run(camera_loop);
+  g_main_context_pop_thread_default(camera_context);
+}
+
+// カメラのフレームごとに呼ばれるパッドプローブ (フレーム数の計数と、起動から最初のフレームまでの時間)
+static GstPadProbeReturn on_camera_frame(GstPad *, GstPadProbeInfo *,
+                                         gpointer user_data) {
+  int metrics_idx = GPOINTER_TO_INT(user_data);
+  metrics_increment(g_metrics.camera_frames[metrics_idx]);
+  CameraPipeline &camera = cameras[metrics_idx];
+  if (camera.first_frame_ns.load(std::memory_order_relaxed) == 0) {
+    int64_t now_ns = monotonic_ns();
+    int64_t expected = 0;
+    if (camera.first_frame_ns.compare_exchange_strong(expected, now_ns)) {
+      g_metrics.camera_first_frame_ns[metrics_idx].store(
+          now_ns - camera.started_ns.load(std::memory_order_relaxed),
+          std::memory_order_relaxed);
+    }
+  }
+  return GST_PAD_PROBE_OK;
+}
+
+// udpsink に届いたバッファごとに呼ばれるパッドプローブ (撮影から送信までの遅延の計測)。
+// PTS はソースが撮影時刻から付けた running time で、デコード・エンコード・RTP 化でも保たれるため、
+// パイプラインの時計の現在時刻 - (base_time + PTS) が撮影から送信までの遅延になる
+static GstPadProbeReturn on_camera_sent(GstPad *pad, GstPadProbeInfo *info,
+                                        gpointer user_data) {
+  GstBuffer *buffer = nullptr;
+  if (GST_PAD_PROBE_INFO_TYPE(info) & GST_PAD_PROBE_TYPE_BUFFER_LIST) {
+    // rtph264pay は分割した NAL をリストでまとめて送る (先頭のパケットで計測する)
+    GstBufferList *list = GST_PAD_PROBE_INFO_BUFFER_LIST(info);
+    if (gst_buffer_list_length(list) > 0)
+      buffer = gst_buffer_list_get(list, 0);
   } else {
-    std::cerr << "エラー: 不明なカメラインデックス " << camera_idx << std::endl;
+    buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+  }
+  if (!buffer || !GST_CLOCK_TIME_IS_VALID(GST_BUFFER_PTS(buffer)))
+    return GST_PAD_PROBE_OK;
+
+  CameraPipeline &camera = cameras[GPOINTER_TO_INT(user_data)];
+  GstClockTime pts = GST_BUFFER_PTS(buffer);
+  // 1フレームは複数の RTP パケットになる (最初のパケットだけを数える)
+  if (camera.last_sent_pts.exchange(pts, std::memory_order_relaxed) == pts)
+    return GST_PAD_PROBE_OK;
+
+  GstElement *sink = GST_ELEMENT(GST_PAD_PARENT(pad));
+  GstClock *clock = gst_element_get_clock(sink);
+  if (!clock)
+    return GST_PAD_PROBE_OK;
+  GstClockTime now = gst_clock_get_time(clock);
+  gst_object_unref(clock);
+  GstClockTime captured = gst_element_get_base_time(sink) + pts;
+  if (now < captured)
+    return GST_PAD_PROBE_OK;
+
+  int64_t latency_ns = static_cast<int64_t>(now - captured);
+  camera.latency_sum_ns.fetch_add(latency_ns, std::memory_order_relaxed);
+  camera.latency_frames.fetch_add(1, std::memory_order_relaxed);
+  // 書き込むのはこのストリーミングスレッドだけなので、比較と書き込みは分けてよい
+  if (latency_ns > camera.latency_max_ns.load(std::memory_order_relaxed))
+    camera.latency_max_ns.store(latency_ns, std::memory_order_relaxed);
+  return GST_PAD_PROBE_OK;
+}
+
+// 直近の区間の遅延 (平均と最大) を metrics に公開し、区間をリセットする (フレームが無ければ 0)
+static void publish_camera_latency() {
+  for (int i = 0; i < CONFIG_MAX_CAMERAS; ++i) {
+    CameraPipeline &camera = cameras[i];
+    int64_t sum_ns = camera.latency_sum_ns.exchange(0, std::memory_order_relaxed);
+    uint32_t frames = camera.latency_frames.exchange(0, std::memory_order_relaxed);
+    int64_t max_ns = camera.latency_max_ns.exchange(0, std::memory_order_relaxed);
+    g_metrics.camera_latency_ns[i].store(frames > 0 ? sum_ns / frames : 0,
+                                         std::memory_order_relaxed);
+    g_metrics.camera_latency_max_ns[i].store(max_ns, std::memory_order_relaxed);
+  }
+}
+
+static void destroy_pipeline(GstElement **pipeline_ptr, int camera_idx);
+static bool create_pipeline(const CameraSettings &settings, int camera_idx,
+                            GstElement **pipeline_ptr);
+static void schedule_restart(int camera_idx);
+
+// 予定している再起動を取り消す (pipeline_mutex を保持して呼ぶ)
+static void cancel_restart(int camera_idx) {
+  CameraPipeline &camera = cameras[camera_idx - 1];
+  if (camera.restart_timer) {
+    g_source_destroy(camera.restart_timer);
+    g_source_unref(camera.restart_timer);
+    camera.restart_timer = nullptr;
+  }
+}
+
+// 再起動のタイマー (バスの監視用のスレッドで呼ばれる)。このカメラのパイプラインだけを作り直す
+static gboolean on_restart_timer(gpointer user_data) {
+  int camera_idx = GPOINTER_TO_INT(user_data) + 1;
+  std::lock_guard<std::mutex> lock(pipeline_mutex);
+  CameraPipeline &camera = cameras[camera_idx - 1];
+  // 取り消された後に呼ばれた場合 (差し替えや停止と競合した場合) は何もしない
+  if (g_source_is_destroyed(g_main_current_source()) || stopping ||
+      !camera.enabled) {
+    return G_SOURCE_REMOVE;
+  }
+  g_source_unref(camera.restart_timer);
+  camera.restart_timer = nullptr;
+
+  std::cout << "カメラ" << camera_idx << "のパイプラインを再起動します ("
+            << camera.failures << "回目)..." << std::endl;
+  metrics_increment(g_metrics.camera_restarts[camera_idx - 1]);
+  destroy_pipeline(&camera.pipeline, camera_idx);
+  CameraSettings settings = camera.settings;
+  if (!create_pipeline(settings, camera_idx, &camera.pipeline)) {
+    schedule_restart(camera_idx);
+  }
+  return G_SOURCE_REMOVE;
+}
+
+// パイプラインが止まったので、間隔を空けて再起動する (pipeline_mutex を保持して呼ぶ)。
+// 他のカメラと制御ループには影響しない
+static void schedule_restart(int camera_idx) {
+  CameraPipeline &camera = cameras[camera_idx - 1];
+  if (stopping || !camera.enabled || camera.restart_timer) {
+    return; // 停止中、または再起動を予定済み (同じ障害でメッセージが続いた場合)
+  }
+  // しばらく正常に動作していた場合は、最短の間隔から数え直す
+  int64_t first_frame_ns = camera.first_frame_ns.load(std::memory_order_relaxed);
+  if (first_frame_ns != 0 && monotonic_ns() - first_frame_ns >= RESTART_STABLE_NS) {
+    camera.failures = 0;
+  }
+  guint delay_ms = RESTART_DELAY_MIN_MS;
+  for (int i = 0; i < camera.failures && delay_ms < RESTART_DELAY_MAX_MS; ++i) {
+    delay_ms *= 2;
+  }
+  if (delay_ms > RESTART_DELAY_MAX_MS) {
+    delay_ms = RESTART_DELAY_MAX_MS;
+  }
+  camera.failures++;
+  std::cerr << "カメラ" << camera_idx << "のパイプラインが停止しました。"
+            << delay_ms << "ms 後に再起動します。" << std::endl;
+
+  camera.restart_timer = g_timeout_source_new(delay_ms);
+  g_source_set_callback(camera.restart_timer, on_restart_timer,
+                        GINT_TO_POINTER(camera_idx - 1), nullptr);
+  g_source_attach(camera.restart_timer, camera_context);
+}
+
+// パイプラインのバスメッセージを処理する (バスの監視用のスレッドで呼ばれる)。
+// エラーと EOS ではこのカメラのパイプラインを再起動し、警告と状態遷移は記録する
+static gboolean on_bus_message(GstBus *, GstMessage *msg, gpointer user_data) {
+  int metrics_idx = GPOINTER_TO_INT(user_data);
+  switch (GST_MESSAGE_TYPE(msg)) {
+  case GST_MESSAGE_STATE_CHANGED:
+    // パイプライン自体の状態のみ (差し替え中でもポインタを参照しない)
+    if (GST_IS_PIPELINE(GST_MESSAGE_SRC(msg))) {
+      GstState old_state, new_state, pending_state;
+      gst_message_parse_state_changed(msg, &old_state, &new_state,
+                                      &pending_state);
+      g_metrics.camera_state[metrics_idx].store(static_cast<int>(new_state),
+                                                std::memory_order_relaxed);
+    }
+    break;
+  case GST_MESSAGE_WARNING: {
+    GError *error = nullptr;
+    gchar *debug = nullptr;
+    gst_message_parse_warning(msg, &error, &debug);
+    std::cerr << "GStreamer警告 (カメラ" << metrics_idx + 1
+              << "): " << error->message << std::endl;
+    g_error_free(error);
+    g_free(debug);
+    metrics_increment(g_metrics.camera_warnings[metrics_idx]);
+    break;
+  }
+  case GST_MESSAGE_ERROR:
+  case GST_MESSAGE_EOS: {
+    if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_ERROR) {
+      GError *error = nullptr;
+      gchar *debug = nullptr;
+      gst_message_parse_error(msg, &error, &debug);
+      std::cerr << "GStreamerエラー (カメラ" << metrics_idx + 1
+                << "): " << error->message << std::endl;
+      g_error_free(error);
+      g_free(debug);
+    } else {
+      // ライブのカメラは EOS を送らない (デバイスが外れた場合など)
+      std::cerr << "GStreamer: カメラ" << metrics_idx + 1
+                << "のストリームが終了しました (EOS)。" << std::endl;
+    }
+    metrics_increment(g_metrics.camera_errors[metrics_idx]);
+    std::lock_guard<std::mutex> lock(pipeline_mutex);
+    // 差し替え・停止で監視を解除したパイプラインの残りのメッセージは無視する
+    if (!g_source_is_destroyed(g_main_current_source())) {
+      schedule_restart(metrics_idx + 1);
+    }
+    break;
+  }
+  default:
+    break;
+  }
+  return TRUE;
+}
+
+// カメラのフレーム数・パイプラインの状態・撮影から送信までの遅延を監視用カウンタに反映する
+static void attach_pipeline_metrics(GstElement *pipeline, int camera_idx) {
+  int metrics_idx = camera_idx - 1;
+  // バスの監視は既定の GMainContext ではなく camera_context に登録する
+  GstBus *bus = gst_element_get_bus(pipeline);
+  GSource *watch = gst_bus_create_watch(bus);
+  g_source_set_callback(watch, G_SOURCE_FUNC(on_bus_message),
+                        GINT_TO_POINTER(metrics_idx), nullptr);
+  g_source_attach(watch, camera_context);
+  cameras[metrics_idx].bus_watch = watch;
+  gst_object_unref(bus);
+
+  GstElement *source = gst_bin_get_by_name(GST_BIN(pipeline), "camera_src");
+  if (source) {
+    GstPad *pad = gst_element_get_static_pad(source, "src");
+    if (pad) {
+      gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, on_camera_frame,
+                        GINT_TO_POINTER(metrics_idx), nullptr);
+      gst_object_unref(pad);
+    }
+    gst_object_unref(source);
+  }
+
+  GstElement *sink = gst_bin_get_by_name(GST_BIN(pipeline), "sink");
+  if (sink) {
+    GstPad *pad = gst_element_get_static_pad(sink, "sink");
+    if (pad) {
+      gst_pad_add_probe(pad,
+                        static_cast<GstPadProbeType>(
+                            GST_PAD_PROBE_TYPE_BUFFER |
+                            GST_PAD_PROBE_TYPE_BUFFER_LIST),
+                        on_camera_sent, GINT_TO_POINTER(metrics_idx), nullptr);
+      gst_object_unref(pad);
+    }
+    gst_object_unref(sink);
+  }
+}
+
+// バスの監視を解除する (パイプラインの解放前に呼び出す)
+static void detach_pipeline_metrics(int camera_idx) {
+  CameraPipeline &camera = cameras[camera_idx - 1];
+  if (camera.bus_watch) {
+    g_source_destroy(camera.bus_watch);
+    g_source_unref(camera.bus_watch);
+    camera.bus_watch = nullptr;
+  }
+  g_metrics.camera_state[camera_idx - 1].store(0, std::memory_order_relaxed);
+}
+
+// DEVICE が "videotestsrc" または "videotestsrc:<フレーム数>" なら、カメラの代わりにテスト映像を送る。
+// フレーム数を指定すると、その数だけ送った後に EOS になる (自動の再起動の確認用)
+static bool is_test_source(const std::string &device, int &num_buffers) {
+  static const std::string prefix = "videotestsrc";
+  if (device.compare(0, prefix.size(), prefix) != 0)
     return false;
+  num_buffers = -1;
+  if (device.size() > prefix.size()) {
+    if (device[prefix.size()] != ':')
+      return false;
+    num_buffers = atoi(device.c_str() + prefix.size() + 1);
   }
+  return true;
+}
+
+// このカメラのビットレートをこのプロセスが設定するか
+// (H.264 カメラは自動調整が有効な場合のみ、v4l2 のコントロールで設定する)
+static bool controls_bitrate(const CameraSettings &settings) {
+  int num_buffers;
+  return !settings.is_h264_native_source ||
+         is_test_source(settings.device, num_buffers) || video_target_kbps > 0;
+}
 
-  std::string pipeline_str = "v4l2src device=" + device + " ! ";
+// 自動調整の目標を反映したビットレート (kbps)
+static int effective_bitrate_kbps(const CameraSettings &settings) {
+  if (video_target_kbps > 0 && video_target_kbps < settings.x264_bitrate)
+    return video_target_kbps;
+  return settings.x264_bitrate;
+}
 
-  if (is_h264_native_source) {
+static std::string build_pipeline_string(const CameraSettings &settings) {
+  std::string pipeline_str;
+  int num_buffers;
+  std::string caps_size =
+      "width=" + std::to_string(settings.width) +
+      ",height=" + std::to_string(settings.height) +
+      ",framerate=" + std::to_string(settings.framerate_num) + "/" +
+      std::to_string(settings.framerate_den);
+  std::string encoder = "x264enc name=encoder tune=" + settings.x264_tune +
+                        " bitrate=" + std::to_string(effective_bitrate_kbps(settings)) +
+                        " speed-preset=" + settings.x264_speed_preset;
+  if (settings.key_int_max > 0)
+    encoder += " key-int-max=" + std::to_string(settings.key_int_max);
+  if (settings.low_latency) {
+    // フレーム単位のスレッド (数フレームの遅延) ではなくスライス単位で並列化し、B フレームを使わない
+    // (tune=zerolatency に任せず明示する)
+    encoder += " sliced-threads=true bframes=0";
+  }
+  if (settings.x264_slices > 0)
+    encoder += " option-string=\"slices=" + std::to_string(settings.x264_slices) + "\"";
+  // 遅延を優先する場合は、エンコードが追いつかないときに古いフレームから捨てる
+  // (エンコード前のフレームは1枚ずつ独立しているため、捨てても後のフレームは壊れない)
+  std::string capture_queue =
+      settings.low_latency ? "queue max-size-buffers=1 max-size-bytes=0 "
+                             "max-size-time=0 leaky=downstream ! "
+                           : "";
+
+  if (is_test_source(settings.device, num_buffers)) {
+    // テスト映像 (H264_NATIVE によらずエンコードする)
+    // videotestsrc -> video/x-raw caps -> videoconvert -> x264enc
+    pipeline_str = "videotestsrc name=camera_src is-live=true";
+    if (num_buffers > 0)
+      pipeline_str += " num-buffers=" + std::to_string(num_buffers);
+    pipeline_str += " ! video/x-raw," + caps_size + " ! " + capture_queue +
+                    "videoconvert ! " + encoder;
+  } else if (settings.is_h264_native_source) {
     // カメラがH.264ネイティブ出力の場合のパイプライン文字列を構築
     // v4l2src -> video/x-h264 caps -> h264parse
-    pipeline_str += "video/x-h264,width=" + std::to_string(width) +
-                    ",height=" + std::to_string(height) +
-                    ",framerate=" + std::to_string(framerate_num) + "/" +
-                    std::to_string(framerate_den) +
-                    " ! "
-                    "h264parse config-interval=" +
-                    std::to_string(rtp_config_interval);
+    // (H.264 のフレームは捨てると次のキーフレームまで映像が壊れるため、キューは入れない)
+    pipeline_str = "v4l2src name=camera_src device=" + settings.device;
+    // カメラ内のエンコーダーの設定 (ビットレートは bps、キーフレームの間隔はフレーム数)
+    std::string controls;
+    if (controls_bitrate(settings))
+      controls += ",video_bitrate=" +
+                  std::to_string(effective_bitrate_kbps(settings) * 1000);
+    if (settings.key_int_max > 0)
+      controls += ",h264_i_frame_period=" + std::to_string(settings.key_int_max);
+    if (!controls.empty())
+      pipeline_str += " extra-controls=\"controls" + controls + "\"";
+    pipeline_str += " ! video/x-h264," + caps_size +
+                   " ! "
+                   "h264parse config-interval=" +
+                   std::to_string(settings.rtp_config_interval);
   } else {
     // カメラがJPEG出力など、H.264へのエンコードが必要な場合のパイプライン文字列を構築
     // v4l2src -> image/jpeg caps -> jpegdec -> videoconvert -> x264enc
-    pipeline_str += "image/jpeg,width=" + std::to_string(width) +
-                    ",height=" + std::to_string(height) +
-                    ",framerate=" + std::to_string(framerate_num) + "/" +
-                    std::to_string(framerate_den) +
-                    " ! "
-                    "jpegdec ! videoconvert ! "
-                    "x264enc tune=" +
-                    x264_tune + " bitrate=" + std::to_string(x264_bitrate) +
-                    " speed-preset=" + x264_speed_preset;
+    pipeline_str = "v4l2src name=camera_src device=" + settings.device +
+                   " ! image/jpeg," + caps_size + " ! " + capture_queue +
+                   "jpegdec ! videoconvert ! " + encoder;
   }
 
   // 共通のパイプライン末尾部分 (RTPパッキングとUDP送信) を追加
+  // (映像は DSCP AF41 で送り、EF で送る操縦・テレメトリより後回しにさせる)
   // ... ! rtph264pay ! udpsink
-  pipeline_str +=
-      " ! rtph264pay config-interval=" + std::to_string(rtp_config_interval) +
-      " pt=" + std::to_string(rtp_payload_type) +
-      " ! "
-      "udpsink host=" +
-      host + " port=" + std::to_string(port);
+  pipeline_str += " ! rtph264pay config-interval=" +
+                  std::to_string(settings.rtp_config_interval) +
+                  " pt=" + std::to_string(settings.rtp_payload_type) +
+                  " ! "
+                  "udpsink name=sink qos-dscp=34 host=" +
+                  settings.host + " port=" + std::to_string(settings.port);
+  if (settings.low_latency) {
+    // 送信をバッファの時刻まで待たない (ライブのソースでは待つ分だけ遅延が増える)
+    pipeline_str += " sync=false async=false";
+  }
+  return pipeline_str;
+}
+
+static bool create_pipeline(const CameraSettings &settings, int camera_idx,
+                            GstElement **pipeline_ptr) {
+  CameraPipeline &camera = cameras[camera_idx - 1];
+  camera.settings = settings;
+  camera.started_ns.store(monotonic_ns(), std::memory_order_relaxed);
+  camera.first_frame_ns.store(0, std::memory_order_relaxed);
+  camera.last_sent_pts.store(GST_CLOCK_TIME_NONE, std::memory_order_relaxed);
+  camera.applied_kbps =
+      controls_bitrate(settings) ? effective_bitrate_kbps(settings) : 0;
+  std::string pipeline_str = build_pipeline_string(settings);
 
   GError *error = nullptr;
   // 構築したパイプライン文字列からGStreamerパイプラインをパース(作成)
@@ -107,22 +508,110 @@ static bool create_pipeline(const AppConfig &app_config, int camera_idx,
   if (!*pipeline_ptr) {
     // パイプライン作成失敗時のエラー処理
     std::cerr << "GStreamerパイプライン作成失敗 (カメラ" << camera_idx << " - "
-              << device << "): " << error->message << std::endl;
+              << settings.device << "): " << error->message << std::endl;
     g_error_free(error);
     return false;
   }
   // 作成されたパイプライン文字列をデバッグ出力
-  std::cout << "GStreamer pipeline for camera " << camera_idx << " (" << device
-            << "): " << pipeline_str << std::endl;
+  std::cout << "GStreamer pipeline for camera " << camera_idx << " ("
+            << settings.device << "): " << pipeline_str << std::endl;
+
+  // 監視用カウンタ (状態, フレーム数, エラー数) の更新と、エラー時の再起動を登録
+  attach_pipeline_metrics(*pipeline_ptr, camera_idx);
 
-  // パイプライン用のGMainLoopを作成
-  *loop_ptr = g_main_loop_new(nullptr, FALSE);
   // パイプラインをPLAYING状態に遷移させる
+  // (デバイスを開けない場合などはバスに ERROR が届き、再起動の対象になる)
   gst_element_set_state(*pipeline_ptr, GST_STATE_PLAYING);
 
   return true;
 }
 
+// パイプラインを停止して解放する
+static void destroy_pipeline(GstElement **pipeline_ptr, int camera_idx) {
+  if (!*pipeline_ptr)
+    return;
+  // パイプラインをNULL状態に遷移させて停止
+  gst_element_set_state(*pipeline_ptr, GST_STATE_NULL);
+  detach_pipeline_metrics(camera_idx);
+  // パイプラインオブジェクトの参照カウントを減らす (不要になれば解放される)
+  gst_object_unref(*pipeline_ptr);
+  *pipeline_ptr = nullptr;
+}
+
+// 再生中のパイプラインのビットレートを、自動調整の目標と X264_BITRATE に合わせる
+// (pipeline_mutex を保持して呼ぶ)
+static void apply_bitrate(int camera_idx) {
+  CameraPipeline &camera = cameras[camera_idx - 1];
+  if (!camera.pipeline || !controls_bitrate(camera.settings))
+    return;
+  int kbps = effective_bitrate_kbps(camera.settings);
+  if (kbps == camera.applied_kbps)
+    return;
+  GstElement *encoder = gst_bin_get_by_name(GST_BIN(camera.pipeline), "encoder");
+  if (encoder) {
+    g_object_set(encoder, "bitrate", static_cast<guint>(kbps), nullptr);
+    gst_object_unref(encoder);
+  } else {
+    // H.264 カメラはカメラ内のエンコーダーのビットレートを v4l2 のコントロールで変更する
+    // (v4l2src はデバイスを開いている間に設定した extra-controls をすぐに適用する)
+    GstElement *source =
+        gst_bin_get_by_name(GST_BIN(camera.pipeline), "camera_src");
+    if (!source)
+      return;
+    GstStructure *controls = gst_structure_new(
+        "controls", "video_bitrate", G_TYPE_INT, kbps * 1000, nullptr);
+    g_object_set(source, "extra-controls", controls, nullptr);
+    gst_structure_free(controls);
+    gst_object_unref(source);
+  }
+  camera.applied_kbps = kbps;
+}
+
+// 再生中のパイプラインの送信先とビットレートを変更する (pipeline_mutex を保持して呼ぶ)
+static void update_pipeline_live(int camera_idx, const CameraSettings &settings,
+                                 const CameraSettings &previous) {
+  CameraPipeline &camera = cameras[camera_idx - 1];
+  if (settings.host != previous.host || settings.port != previous.port) {
+    GstElement *sink = gst_bin_get_by_name(GST_BIN(camera.pipeline), "sink");
+    if (sink) {
+      g_object_set(sink, "host", settings.host.c_str(), "port", settings.port,
+                   nullptr);
+      gst_object_unref(sink);
+    }
+  }
+  camera.settings = settings;
+  apply_bitrate(camera_idx);
+}
+
+// 一定間隔で遅延の集計を公開し、回線の状態からビットレートの目標を見直して全カメラに反映する
+// (バスの監視用のスレッドで呼ばれる)
+static gboolean on_periodic_timer(gpointer) {
+  publish_camera_latency();
+
+  VideoBitrateSettings settings;
+  {
+    std::lock_guard<std::mutex> lock(g_config_mutex);
+    settings.adaptive = g_config.video_bitrate_adaptive;
+    settings.min_kbps = g_config.video_bitrate_min_kbps;
+    settings.max_kbps = g_config.video_bitrate_max_kbps;
+    settings.control_gap_ms = g_config.video_bitrate_control_gap_ms;
+  }
+  int target_kbps = video_bitrate_update(settings);
+
+  std::lock_guard<std::mutex> lock(pipeline_mutex);
+  if (g_source_is_destroyed(g_main_current_source()) || stopping)
+    return G_SOURCE_REMOVE;
+  if (target_kbps < video_target_kbps) {
+    std::cout << "回線の混雑を検出しました。映像のビットレートを " << target_kbps
+              << "kbps に下げます。" << std::endl;
+  }
+  video_target_kbps = target_kbps;
+  for (int camera_idx = 1; camera_idx <= CONFIG_MAX_CAMERAS; ++camera_idx) {
+    apply_bitrate(camera_idx);
+  }
+  return G_SOURCE_CONTINUE;
+}
+
 // GStreamerパイプラインを開始するメイン関数
 bool start_gstreamer_pipelines() {
   // GStreamerライブラリの初期化 (アプリケーション開始時に一度だけ呼び出す)
@@ -135,60 +624,126 @@ bool start_gstreamer_pipelines() {
     current_config = g_config;
   }
 
-  // カメラ1のパイプラインを作成・起動
-  if (!create_pipeline(current_config, 1, &pipeline1, &main_loop1))
-    return false;
-
-  // カメラ2のパイプラインを作成・起動
-  if (!create_pipeline(current_config, 2, &pipeline2, &main_loop2))
-    return false;
+  std::lock_guard<std::mutex> lock(pipeline_mutex);
+  // バスの監視用のスレッドを先に起動する (カメラを追加してもスレッドは増えない)
+  stopping = false;
+  camera_context = g_main_context_new();
+  camera_loop = g_main_loop_new(camera_context, FALSE);
+  camera_thread = std::thread(run_camera_loop);
+  // 遅延の集計と映像のビットレートの自動調整も同じスレッドで行う
+  periodic_timer = g_timeout_source_new(VIDEO_BITRATE_INTERVAL_MS);
+  g_source_set_callback(periodic_timer, on_periodic_timer, nullptr, nullptr);
+  g_source_attach(periodic_timer, camera_context);
 
-  // 各パイプラインのGMainLoopを別々のスレッドで実行開始
-  loop_thread1 = std::thread(run_main_loop, main_loop1);
-  loop_thread2 = std::thread(run_main_loop, main_loop2);
+  // 使うカメラごとにパイプラインを作成・起動する (1台が失敗しても他のカメラは起動する)
+  bool ok = true;
+  int started = 0;
+  for (int camera_idx = 1; camera_idx <= CONFIG_MAX_CAMERAS; ++camera_idx) {
+    CameraPipeline &camera = cameras[camera_idx - 1];
+    CameraSettings settings;
+    camera.enabled = get_camera_settings(current_config, camera_idx, settings);
+    camera.failures = 0;
+    if (!camera.enabled)
+      continue;
+    if (create_pipeline(settings, camera_idx, &camera.pipeline)) {
+      started++;
+    } else {
+      ok = false;
+      schedule_restart(camera_idx);
+    }
+  }
 
-  std::cout << "GStreamerパイプラインを非同期で起動しました。" << std::endl;
-  return true;
+  std::cout << "GStreamerパイプラインを非同期で起動しました (" << started
+            << "台)。" << std::endl;
+  return ok;
 }
 // GStreamerパイプラインを停止し、リソースを解放する関数
 void stop_gstreamer_pipelines() {
   std::cout << "GStreamerパイプラインを停止します..." << std::endl;
+  {
+    std::lock_guard<std::mutex> lock(pipeline_mutex);
+    stopping = true;
+    if (periodic_timer) {
+      g_source_destroy(periodic_timer);
+      g_source_unref(periodic_timer);
+      periodic_timer = nullptr;
+    }
+    // 全カメラの再起動の予定を取り消し、パイプラインを停止・解放
+    for (int camera_idx = 1; camera_idx <= CONFIG_MAX_CAMERAS; ++camera_idx) {
+      cancel_restart(camera_idx);
+      destroy_pipeline(&cameras[camera_idx - 1].pipeline, camera_idx);
+    }
+  }
 
-  if (pipeline1) {
-    // パイプライン1をNULL状態に遷移させて停止
-    gst_element_set_state(pipeline1, GST_STATE_NULL);
-    // パイプライン1オブジェクトの参照カウントを減らす (不要になれば解放される)
-    gst_object_unref(pipeline1);
-    pipeline1 = nullptr;
-  }
-  if (main_loop1) {
-    // メインループ1に終了を要求
-    g_main_loop_quit(main_loop1);
-    // メインループ1を実行しているスレッドが終了するのを待つ
-    if (loop_thread1.joinable())
-      loop_thread1.join();
-    // メインループ1オブジェクトの参照カウントを減らす
-    g_main_loop_unref(main_loop1);
-    main_loop1 = nullptr;
-  }
-
-  if (pipeline2) {
-    // パイプライン2をNULL状態に遷移させて停止
-    gst_element_set_state(pipeline2, GST_STATE_NULL);
-    // パイプライン2オブジェクトの参照カウントを減らす
-    gst_object_unref(pipeline2);
-    pipeline2 = nullptr;
-  }
-  if (main_loop2) {
-    // メインループ2に終了を要求
-    g_main_loop_quit(main_loop2);
-    // メインループ2を実行しているスレッドが終了するのを待つ
-    if (loop_thread2.joinable())
-      loop_thread2.join();
-    // メインループ2オブジェクトの参照カウントを減らす
-    g_main_loop_unref(main_loop2);
-    main_loop2 = nullptr;
+  // バスの監視用のスレッドは pipeline_mutex を取ることがあるため、ロックを放してから待つ
+  if (camera_loop) {
+    g_main_loop_quit(camera_loop);
+    if (camera_thread.joinable())
+      camera_thread.join();
+    g_main_loop_unref(camera_loop);
+    camera_loop = nullptr;
+    g_main_context_unref(camera_context);
+    camera_context = nullptr;
   }
 
   std::cout << "GStreamerパイプラインを停止しました。" << std::endl;
 }
+
+// 設定の変更を1台のカメラのパイプラインに反映する (pipeline_mutex を保持して呼ぶ)
+static bool reconfigure_camera(int camera_idx, const CameraSettings &settings,
+                               bool enabled,
+                               const CameraSettings &previous_settings,
+                               bool was_enabled) {
+  CameraPipeline &camera = cameras[camera_idx - 1];
+  GstElement **pipeline_ptr = &camera.pipeline;
+  camera.enabled = enabled;
+  if (enabled && was_enabled && *pipeline_ptr && !camera.restart_timer &&
+      same_pipeline_structure(settings, previous_settings)) {
+    // 送信先とビットレートは再生を止めずに変更する
+    update_pipeline_live(camera_idx, settings, previous_settings);
+    std::cout << "カメラ" << camera_idx
+              << "の送信先・ビットレートを再生中のまま変更しました。"
+              << std::endl;
+    return true;
+  }
+
+  // それ以外の変更はこのカメラのパイプラインだけを作り直す (他のカメラは止めない)。
+  // 新しい設定で作り直すので、予定していた再起動は取り消して数え直す
+  cancel_restart(camera_idx);
+  camera.failures = 0;
+  destroy_pipeline(pipeline_ptr, camera_idx);
+  if (!enabled) {
+    std::cout << "カメラ" << camera_idx << "の配信を停止しました。" << std::endl;
+    return true;
+  }
+  std::cout << "カメラ" << camera_idx << "のパイプラインを再構成します..."
+            << std::endl;
+  if (!create_pipeline(settings, camera_idx, pipeline_ptr)) {
+    schedule_restart(camera_idx);
+    return false;
+  }
+  return true;
+}
+
+// 設定の変更を、設定が変わったカメラのパイプラインだけに反映する関数
+bool reconfigure_gstreamer_cameras(const AppConfig &config,
+                                   const AppConfig &previous) {
+  std::lock_guard<std::mutex> lock(pipeline_mutex);
+  if (!camera_context || stopping)
+    return false; // start_gstreamer_pipelines() の前、または停止中
+  bool ok = true;
+  for (int camera_idx = 1; camera_idx <= CONFIG_MAX_CAMERAS; ++camera_idx) {
+    CameraSettings settings, previous_settings;
+    bool enabled = get_camera_settings(config, camera_idx, settings);
+    bool was_enabled = get_camera_settings(previous, camera_idx, previous_settings);
+    if (!enabled && !was_enabled)
+      continue;
+    // 設定が同じカメラはそのまま (止まっていれば自動の再起動に任せる)
+    if (enabled == was_enabled && same_settings(settings, previous_settings))
+      continue;
+    if (!reconfigure_camera(camera_idx, settings, enabled, previous_settings,
+                            was_enabled))
+      ok = false;
+  }
+  return ok;
+}
@@ -0,0 +1,84 @@
+#include "heading_hold.h"
+#include "attitude_estimator.h" // 融合済みのヨー角を使用するため
+#include "config.h"  // グローバル設定オブジェクト g_config を使用するため
+#include <algorithm> // std::max, std::min のため
+#include <cmath>     // std::abs, std::fmod のため
+
+// ラジアン -> 度 変換係数
+static const float RAD_TO_DEG = 57.2957795f;
+
+// --- 制御器の状態 (ファイルスコープ、メインスレッド専用) ---
+static bool heading_latched = false; // 目標方位が確定しているか
+static float heading_setpoint_deg = 0.0f;
+static float heading_error_deg = 0.0f;
+static float output_pwm = 0.0f; // レート制限後の補正量
+
+// 角度差を -180 ~ 180 deg に正規化する
+static float wrap_deg(float angle) {
+  angle = std::fmod(angle + 180.0f, 360.0f);
+  if (angle < 0.0f) {
+    angle += 360.0f;
+  }
+  return angle - 180.0f;
+}
+
+void heading_hold_init() {
+  heading_latched = false;
+  heading_setpoint_deg = 0.0f;
+  heading_error_deg = 0.0f;
+  output_pwm = 0.0f;
+}
+
+bool heading_hold_available() {
+  return g_config.heading_hold_enabled && attitude_get().valid;
+}
+
+void heading_hold_update(const GamepadData &gamepad_data,
+                         const AxisData &gyro_data, float dt_s) {
+  if (!heading_hold_available()) {
+    heading_hold_init();
+    return;
+  }
+
+  const AttitudeEstimate &att = attitude_get();
+  // バイアス補正済みのヨーレート (deg/s、正: 右旋回)
+  float yaw_rate_dps =
+      (gyro_data.z * g_config.ahrs_gyro_scale - att.gyro_bias[2]) * RAD_TO_DEG;
+
+  // 旋回スティック操作中はパイロットに任せ、目標方位を解除する
+  bool lx_active =
+      std::abs(gamepad_data.leftThumbX) > g_config.joystick_deadzone;
+  if (lx_active) {
+    heading_latched = false;
+    heading_error_deg = 0.0f;
+    output_pwm = 0.0f;
+    return;
+  }
+
+  // スティックを離した後、旋回の惰性が収まった時点の方位をラッチする
+  if (!heading_latched &&
+      std::abs(yaw_rate_dps) < g_config.heading_hold_latch_rate_dps) {
+    heading_setpoint_deg = att.yaw_deg;
+    heading_latched = true;
+  }
+
+  // PD 制御: 右にずれた (誤差が負) なら左旋回方向 (正) の補正を出す
+  float target = g_config.heading_hold_kd * yaw_rate_dps;
+  if (heading_latched) {
+    heading_error_deg = wrap_deg(heading_setpoint_deg - att.yaw_deg);
+    target -= g_config.heading_hold_kp * heading_error_deg;
+  } else {
+    heading_error_deg = 0.0f;
+  }
+  const float max_output = static_cast<float>(g_config.heading_hold_max_output);
+  target = std::max(-max_output, std::min(max_output, target));
+
+  // 出力の変化速度を制限する (急激な推力変化によるオーバーシュート防止)
+  float max_step = g_config.heading_hold_rate_limit * dt_s;
+  float step = std::max(-max_step, std::min(max_step, target - output_pwm));
+  output_pwm += step;
+}
+
+int heading_hold_output() { return static_cast<int>(output_pwm); }
+
+float heading_hold_error_deg() { return heading_error_deg; }
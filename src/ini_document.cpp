@@ -0,0 +1,151 @@
+// ini_document.cpp
+#include "ini_document.h"
+#include <fstream>
+#include <sstream>
+#include <strings.h> // strcasecmp のため
+#include <utility>
+
+std::string ini_trim(const std::string& str) {
+    size_t first = str.find_first_not_of(" \t\n\r\f\v");
+    if (std::string::npos == first) return "";
+    size_t last = str.find_last_not_of(" \t\n\r\f\v");
+    return str.substr(first, (last - first + 1));
+}
+
+bool ini_equal(const std::string& a, const std::string& b) {
+    return a.size() == b.size() && strcasecmp(a.c_str(), b.c_str()) == 0;
+}
+
+bool IniDocument::load(const std::string& path) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        return false;
+    }
+    parse(file);
+    return true;
+}
+
+void IniDocument::parse(std::istream& input) {
+    m_lines.clear();
+    std::string text;
+    std::string current_section;
+    while (std::getline(input, text)) {
+        if (!text.empty() && text.back() == '\r') {
+            text.erase(text.size() - 1); // CRLF のファイルも同じように扱う
+        }
+        IniLine line;
+        line.kind = IniLine::OTHER;
+        std::string trimmed = ini_trim(text);
+        if (trimmed.empty() || trimmed[0] == '#' || trimmed[0] == ';') {
+            // コメントと空行
+        } else if (trimmed[0] == '[' && trimmed.back() == ']') {
+            line.kind = IniLine::SECTION;
+            current_section = ini_trim(trimmed.substr(1, trimmed.length() - 2));
+        } else {
+            size_t eq_pos = trimmed.find('=');
+            if (eq_pos == std::string::npos) {
+                line.kind = IniLine::INVALID;
+            } else {
+                line.kind = IniLine::ENTRY;
+                line.key = ini_trim(trimmed.substr(0, eq_pos));
+                line.value = ini_trim(trimmed.substr(eq_pos + 1));
+            }
+        }
+        line.section = current_section;
+        line.text.swap(text);
+        m_lines.push_back(std::move(line));
+    }
+}
+
+void IniDocument::write(std::ostream& out) const {
+    for (size_t i = 0; i < m_lines.size(); ++i) {
+        out << m_lines[i].text << "\n";
+    }
+}
+
+std::string IniDocument::to_string() const {
+    std::ostringstream out;
+    write(out);
+    return out.str();
+}
+
+const std::string* IniDocument::find(const std::string& section, const std::string& key) const {
+    const std::string* found = nullptr;
+    for (size_t i = 0; i < m_lines.size(); ++i) {
+        const IniLine& line = m_lines[i];
+        if (line.kind == IniLine::ENTRY && ini_equal(line.section, section) && ini_equal(line.key, key)) {
+            found = &line.value;
+        }
+    }
+    return found;
+}
+
+std::string IniDocument::get(const std::string& section, const std::string& key,
+                             const std::string& fallback) const {
+    const std::string* value = find(section, key);
+    return value ? *value : fallback;
+}
+
+bool IniDocument::has_section(const std::string& section) const {
+    for (size_t i = 0; i < m_lines.size(); ++i) {
+        if (m_lines[i].kind == IniLine::SECTION && ini_equal(m_lines[i].section, section)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void IniDocument::set(const std::string& section, const std::string& key, const std::string& value) {
+    // 既存のキーは、キーと '=' の前後の書式を残したまま値だけを置き換える
+    int last_match = -1;
+    int insert_after = -1; // セクション内の最後のエントリ (無ければセクションの見出し)
+    for (size_t i = 0; i < m_lines.size(); ++i) {
+        const IniLine& line = m_lines[i];
+        if (!ini_equal(line.section, section)) {
+            continue;
+        }
+        if (line.kind == IniLine::SECTION || line.kind == IniLine::ENTRY) {
+            insert_after = static_cast<int>(i);
+        }
+        if (line.kind == IniLine::ENTRY && ini_equal(line.key, key)) {
+            last_match = static_cast<int>(i);
+        }
+    }
+
+    if (last_match >= 0) {
+        IniLine& line = m_lines[last_match];
+        size_t eq_pos = line.text.find('=');
+        size_t value_pos = line.text.find_first_not_of(" \t", eq_pos + 1);
+        if (value_pos == std::string::npos) {
+            value_pos = line.text.size();
+        }
+        line.text = line.text.substr(0, value_pos) + value;
+        line.value = value;
+        return;
+    }
+
+    IniLine entry;
+    entry.kind = IniLine::ENTRY;
+    entry.text = key + "=" + value;
+    entry.key = key;
+    entry.value = value;
+    if (insert_after >= 0) {
+        entry.section = m_lines[insert_after].section;
+        m_lines.insert(m_lines.begin() + insert_after + 1, entry);
+        return;
+    }
+
+    IniLine blank;
+    blank.kind = IniLine::OTHER;
+    blank.section = m_lines.empty() ? "" : m_lines.back().section;
+    if (!m_lines.empty() && !ini_trim(m_lines.back().text).empty()) {
+        m_lines.push_back(blank);
+    }
+    IniLine header;
+    header.kind = IniLine::SECTION;
+    header.text = "[" + section + "]";
+    header.section = section;
+    m_lines.push_back(header);
+    entry.section = section;
+    m_lines.push_back(entry);
+}
@@ -0,0 +1,134 @@
+#include "inversion_detector.h"
+#include "config.h"  // グローバル設定オブジェクト g_config を使用するため
+#include <algorithm> // std::max, std::min のため
+#include <cmath>     // std::sqrt, std::acos のため
+#include <stdio.h>   // printf のため
+
+// ラジアン -> 度 変換係数
+static const float RAD_TO_DEG = 57.2957795f;
+
+// --- 基準の重力方向 (起動直後の数サンプルを平均、または設定で固定) ---
+static double reference_sum[3] = {0.0, 0.0, 0.0};
+static double magnitude_sum = 0.0;
+static int calibration_count = 0;
+static bool calibrated = false;
+static float reference[3] = {0.0f, 0.0f, 1.0f}; // 単位ベクトル
+static float reference_magnitude = 0.0f;        // 静止時の加速度の大きさ
+
+// --- 検出器の状態 ---
+static float filtered[3] = {0.0f, 0.0f, 1.0f}; // ローパス済みの重力方向
+static float tilt_deg = 0.0f;
+static bool inverted = false;
+static float dwell_timer_s = 0.0f; // 状態切替の条件が継続している時間
+static unsigned event_count = 0;
+static unsigned rejected_count = 0;
+
+void inversion_detector_init() {
+  reference_sum[0] = reference_sum[1] = reference_sum[2] = 0.0;
+  magnitude_sum = 0.0;
+  calibration_count = 0;
+  calibrated = false;
+  tilt_deg = 0.0f;
+  inverted = false;
+  dwell_timer_s = 0.0f;
+  event_count = 0;
+  rejected_count = 0;
+}
+
+// 基準方向の決定。INVERSION の REFERENCE_Z_SIGN が 0 なら起動時の姿勢を基準にする
+static void finish_calibration() {
+  reference_magnitude = static_cast<float>(magnitude_sum / calibration_count);
+  if (g_config.inversion_reference_z_sign != 0) {
+    reference[0] = reference[1] = 0.0f;
+    reference[2] = (g_config.inversion_reference_z_sign > 0) ? 1.0f : -1.0f;
+  } else {
+    double n = std::sqrt(reference_sum[0] * reference_sum[0] +
+                         reference_sum[1] * reference_sum[1] +
+                         reference_sum[2] * reference_sum[2]);
+    for (int i = 0; i < 3; ++i) {
+      reference[i] = static_cast<float>(reference_sum[i] / n);
+    }
+  }
+  for (int i = 0; i < 3; ++i) {
+    filtered[i] = reference[i];
+  }
+  calibrated = true;
+  printf("Inversion detector: reference gravity (%.2f, %.2f, %.2f), |a|=%.3f\n",
+         reference[0], reference[1], reference[2], reference_magnitude);
+}
+
+InversionEvent inversion_detector_update(const AxisData &accel, float dt_s) {
+  float magnitude =
+      std::sqrt(accel.x * accel.x + accel.y * accel.y + accel.z * accel.z);
+  if (magnitude == 0.0f) {
+    return InversionEvent::NONE; // 読み取り失敗
+  }
+
+  if (!calibrated) {
+    reference_sum[0] += accel.x / magnitude;
+    reference_sum[1] += accel.y / magnitude;
+    reference_sum[2] += accel.z / magnitude;
+    magnitude_sum += magnitude;
+    calibration_count++;
+    if (calibration_count >= std::max(1, g_config.inversion_calibration_samples)) {
+      finish_calibration();
+    }
+    return InversionEvent::NONE;
+  }
+
+  // 衝突やスラスターの急加速で大きさが大きく外れたサンプルは重力方向の推定に使わない
+  const float spike_ratio = g_config.inversion_spike_ratio;
+  if (spike_ratio > 1.0f && (magnitude > reference_magnitude * spike_ratio ||
+                             magnitude * spike_ratio < reference_magnitude)) {
+    rejected_count++;
+    return InversionEvent::NONE;
+  }
+
+  // --- 重力方向の一次ローパスフィルタ (時定数 FILTER_TAU_S) ---
+  const float tau = g_config.inversion_filter_tau_s;
+  float alpha = (tau > 0.0f && dt_s > 0.0f) ? dt_s / (tau + dt_s) : 1.0f;
+  filtered[0] += (accel.x / magnitude - filtered[0]) * alpha;
+  filtered[1] += (accel.y / magnitude - filtered[1]) * alpha;
+  filtered[2] += (accel.z / magnitude - filtered[2]) * alpha;
+  float n = std::sqrt(filtered[0] * filtered[0] + filtered[1] * filtered[1] +
+                      filtered[2] * filtered[2]);
+  if (n == 0.0f) {
+    return InversionEvent::NONE;
+  }
+  float cos_tilt = (filtered[0] * reference[0] + filtered[1] * reference[1] +
+                    filtered[2] * reference[2]) /
+                   n;
+  cos_tilt = std::max(-1.0f, std::min(1.0f, cos_tilt));
+  tilt_deg = std::acos(cos_tilt) * RAD_TO_DEG;
+
+  // --- ヒステリシスと最小継続時間による状態遷移 ---
+  bool condition = inverted ? (tilt_deg < g_config.inversion_exit_angle_deg)
+                            : (tilt_deg > g_config.inversion_enter_angle_deg);
+  if (!condition) {
+    dwell_timer_s = 0.0f;
+    return InversionEvent::NONE;
+  }
+  dwell_timer_s += std::max(0.0f, dt_s);
+  if (dwell_timer_s < g_config.inversion_dwell_s) {
+    return InversionEvent::NONE;
+  }
+  dwell_timer_s = 0.0f;
+  inverted = !inverted;
+  if (inverted) {
+    event_count++;
+    return InversionEvent::ENTERED;
+  }
+  return InversionEvent::CLEARED;
+}
+
+bool inversion_detector_is_inverted() { return inverted; }
+
+InversionStatus inversion_detector_get_status() {
+  InversionStatus status;
+  status.tilt_deg = tilt_deg;
+  status.calibrated = calibrated;
+  status.inverted = inverted;
+  status.events = event_count;
+  status.rejected = rejected_count;
+  return status;
+}
@@ -0,0 +1,114 @@
+#include "latency_stats.h"
+#include "config.h" // グローバル設定オブジェクト g_config を使用するため
+#include <string.h> // memset のため
+
+// --- 対数バケットのヒストグラム (HDR Histogram と同じ考え方) ---
+// 2のべき乗ごとの区間を SUB_BUCKETS 個に等分するため、相対誤差は 1/SUB_BUCKETS 以下 (有効数字約2桁)。
+// 値の範囲は 0 ns ~ 2^MAX_EXPONENT ns (約 18 分)。それを超える値は最後のバケットに入れる。
+static const int SUB_BUCKET_BITS = 7;
+static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS; // 128 (誤差 0.8% 以下)
+static const int MAX_EXPONENT = 40;
+static const int BUCKET_COUNT = (MAX_EXPONENT - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+struct Histogram {
+  uint32_t counts[BUCKET_COUNT];
+  uint32_t total;
+  int64_t max_ns;
+};
+
+static Histogram histograms[LATENCY_METRIC_COUNT];
+static LatencySummary summaries[LATENCY_METRIC_COUNT];
+static int64_t window_start_ns = 0;
+
+static int bucket_index(uint64_t ns) {
+  if (ns < static_cast<uint64_t>(SUB_BUCKETS)) {
+    return static_cast<int>(ns);
+  }
+  int msb = 63 - __builtin_clzll(ns);
+  int shift = msb - SUB_BUCKET_BITS;
+  int index = (shift + 1) * SUB_BUCKETS +
+              static_cast<int>((ns >> shift) & (SUB_BUCKETS - 1));
+  return index < BUCKET_COUNT ? index : BUCKET_COUNT - 1;
+}
+
+// バケットに入る最大の値 (パーセンタイルは安全側に丸める)
+static uint64_t bucket_upper_ns(int index) {
+  if (index < SUB_BUCKETS) {
+    return static_cast<uint64_t>(index);
+  }
+  int shift = index / SUB_BUCKETS - 1;
+  uint64_t lower = static_cast<uint64_t>(SUB_BUCKETS + index % SUB_BUCKETS) << shift;
+  return lower + (1ULL << shift) - 1;
+}
+
+static float percentile_us(const Histogram &h, double fraction) {
+  // fraction * total 番目 (切り上げ) のサンプルが入っているバケットを探す
+  uint64_t rank = static_cast<uint64_t>(fraction * h.total);
+  if (rank < fraction * h.total || rank == 0) {
+    rank++;
+  }
+  uint64_t cumulative = 0;
+  for (int i = 0; i < BUCKET_COUNT; ++i) {
+    cumulative += h.counts[i];
+    if (cumulative >= rank) {
+      uint64_t upper = bucket_upper_ns(i);
+      // 最大値より大きい値は報告しない
+      if (upper > static_cast<uint64_t>(h.max_ns)) {
+        upper = static_cast<uint64_t>(h.max_ns);
+      }
+      return upper / 1000.0f;
+    }
+  }
+  return h.max_ns / 1000.0f;
+}
+
+static void close_window() {
+  for (int m = 0; m < LATENCY_METRIC_COUNT; ++m) {
+    Histogram &h = histograms[m];
+    LatencySummary &s = summaries[m];
+    s.count = h.total;
+    if (h.total == 0) {
+      s.p50_us = s.p99_us = s.p999_us = s.max_us = 0.0f;
+    } else {
+      s.p50_us = percentile_us(h, 0.50);
+      s.p99_us = percentile_us(h, 0.99);
+      s.p999_us = percentile_us(h, 0.999);
+      s.max_us = h.max_ns / 1000.0f;
+    }
+    memset(&h, 0, sizeof(h));
+  }
+}
+
+// --- モジュール関数 ---
+
+void latency_stats_init() {
+  memset(histograms, 0, sizeof(histograms));
+  memset(summaries, 0, sizeof(summaries));
+  window_start_ns = 0;
+}
+
+void latency_stats_record(LatencyMetric metric, int64_t ns) {
+  if (ns < 0) {
+    ns = 0; // 時計の補正などで負になった場合
+  }
+  Histogram &h = histograms[metric];
+  h.counts[bucket_index(static_cast<uint64_t>(ns))]++;
+  h.total++;
+  if (ns > h.max_ns) {
+    h.max_ns = ns;
+  }
+}
+
+void latency_stats_tick(int64_t now_ns) {
+  if (window_start_ns == 0) {
+    window_start_ns = now_ns;
+    return;
+  }
+  int64_t window_ns = static_cast<int64_t>(g_config.latency_window_s * 1e9);
+  if (now_ns - window_start_ns >= window_ns) {
+    close_window();
+    window_start_ns = now_ns;
+  }
+}
+
+LatencySummary latency_stats_get(LatencyMetric metric) { return summaries[metric]; }
@@ -0,0 +1,73 @@
+#include "live_state.h"
+#include "config.h"   // グローバル設定オブジェクト g_config を使用するため
+#include <cstring>    // memcpy, strerror のため
+#include <errno.h>    // errno のため
+#include <fcntl.h>    // O_CREAT, O_RDWR のため
+#include <iostream>   // std::cout, std::cerr のため
+#include <new>        // placement new のため
+#include <sys/mman.h> // shm_open, mmap のため
+#include <unistd.h>   // ftruncate, close, getpid のため
+
+static LiveStateSegment *segment = nullptr;
+static std::string segment_name;
+
+bool live_state_open() {
+  if (!g_config.live_state_enabled || segment != nullptr) {
+    return true;
+  }
+  segment_name = g_config.live_state_shm_name;
+  int fd = shm_open(segment_name.c_str(), O_CREAT | O_RDWR, 0644);
+  if (fd < 0) {
+    std::cerr << "共有メモリ '" << segment_name << "' を作成できません: "
+              << strerror(errno) << std::endl;
+    return false;
+  }
+  if (ftruncate(fd, sizeof(LiveStateSegment)) != 0) {
+    std::cerr << "共有メモリのサイズを設定できません: " << strerror(errno)
+              << std::endl;
+    close(fd);
+    return false;
+  }
+  void *mapped = mmap(nullptr, sizeof(LiveStateSegment), PROT_READ | PROT_WRITE,
+                      MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    std::cerr << "共有メモリをマップできません: " << strerror(errno) << std::endl;
+    return false;
+  }
+
+  // 前回のプロセスが書き込み途中で終了していても、ここで初期化し直す
+  memset(mapped, 0, sizeof(LiveStateSegment));
+  segment = new (mapped) LiveStateSegment();
+  segment->seq.store(0);
+  segment->version = LIVE_STATE_VERSION;
+  segment->data_size = sizeof(LiveStateData);
+  segment->writer_pid = static_cast<uint32_t>(getpid());
+  memcpy(segment->magic, LIVE_STATE_MAGIC, sizeof(segment->magic));
+  std::cout << "稼働状態を共有メモリ " << segment_name << " に公開します。"
+            << std::endl;
+  return true;
+}
+
+void live_state_close() {
+  if (segment == nullptr) {
+    return;
+  }
+  munmap(segment, sizeof(LiveStateSegment));
+  shm_unlink(segment_name.c_str());
+  segment = nullptr;
+}
+
+void live_state_publish(const LiveStateData &data) {
+  if (segment == nullptr) {
+    return;
+  }
+  // 書き込みは制御スレッドのみ (単一の書き込み側)
+  uint32_t seq = segment->seq.load(std::memory_order_relaxed);
+  segment->seq.store(seq + 1, std::memory_order_relaxed); // 奇数: 書き込み中
+  std::atomic_thread_fence(std::memory_order_release);
+  segment->data = data;
+  segment->seq.store(seq + 2, std::memory_order_release);
+}
+
+bool live_state_active() { return segment != nullptr; }
@@ -1,13 +1,25 @@
 // --- インクルード ---
+#include "attitude_estimator.h" // 姿勢推定値 (稼働状態の公開用)
+#include "aux_output.h"         // LED などの補助出力の状態同期
 #include "config.h" // 設定ファイル読み込みとグローバル設定オブジェクト
+#include "config_reloader.h" // 設定のリロード (制御スレッドの外で読み込む)
 #include "config_synchronizer.h" // 設定同期用
-#include "gamepad.h"             // ゲームパッドデータ構造体とパース関数
+#include "control_loop.h"        // 1周期分の制御 (姿勢推定、各制御器、スラスター出力)
+#include "depth_hold.h"          // 深度推定値 (稼働状態の公開用)
+#include "flight_recorder.h"     // フライトレコーダー
 #include "gstPipeline.h"         // GStreamerパイプライン起動用
+#include "inversion_detector.h"  // 機体の反転検出
+#include "latency_stats.h"       // 周期・遅延のヒストグラム
+#include "live_state.h"          // 稼働状態の共有メモリ公開
+#include "metrics.h"             // 監視用のカウンタと HTTP エンドポイント
 #include "network.h"             // ネットワーク通信関連 (UDP送受信)
+#include "param_protocol.h"      // 操縦用 UDP でのパラメータの読み書き
 #include "sensor_data.h"         // センサーデータ読み取り・フォーマット関連
+#include "thrust_curve.h"        // 推力曲線テーブル
 #include "thruster_control.h"    // スラスター制御関連
+#include "trace.h"               // 周期内の処理時間のトレース
+#include "video_bitrate.h"       // 通信の途切れを映像のビットレートの調整に知らせるため
 
-#include <cmath>    // std::copysign を使用するため
 #include <csignal>  // シグナルハンドリング用
 #include <iostream> // 標準入出力 (std::cout, std::cerr)
 #include <mutex>    // std::mutex, std::lock_guard
@@ -18,13 +30,93 @@
 // --- グローバル変数 ---
 // AppConfig g_config; // config.cpp で定義
 // std::mutex g_config_mutex; // config.cpp で定義
-static float prev_accel_z_sign = 0.0f; // 前回の accel.z の符号を保存
+
+// timespec を ns に変換する
+static int64_t timespec_to_ns(const struct timespec &ts) {
+  return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+// 1周期分の状態を共有メモリに公開する (読み出しツールは tools/rov_state.cpp)
+static void publish_live_state(const ControlInputs &inputs, int64_t tick_start_ns,
+                               int64_t tick_period_ns, int64_t tick_work_ns,
+                               bool failsafe) {
+  LiveStateData data;
+  memset(&data, 0, sizeof(data));
+  data.tick = g_metrics.ticks.load(std::memory_order_relaxed);
+  data.time_ns = tick_start_ns;
+  const GamepadData &gamepad = control_get_gamepad();
+  data.left_thumb_x = gamepad.leftThumbX;
+  data.left_thumb_y = gamepad.leftThumbY;
+  data.right_thumb_x = gamepad.rightThumbX;
+  data.right_thumb_y = gamepad.rightThumbY;
+  data.lt = gamepad.LT;
+  data.rt = gamepad.RT;
+  data.buttons = gamepad.buttons;
+  for (int ch = 0; ch < LIVE_STATE_PWM_CHANNELS; ++ch) {
+    data.pwm_us[ch] = static_cast<uint16_t>(thruster_get_output_pwm(ch));
+  }
+  aux_output_get_levels(data.aux_levels);
+  data.gyro[0] = inputs.gyro.x;
+  data.gyro[1] = inputs.gyro.y;
+  data.gyro[2] = inputs.gyro.z;
+  data.accel[0] = inputs.accel.x;
+  data.accel[1] = inputs.accel.y;
+  data.accel[2] = inputs.accel.z;
+  data.mag[0] = inputs.mag.x;
+  data.mag[1] = inputs.mag.y;
+  data.mag[2] = inputs.mag.z;
+  data.pressure = inputs.pressure;
+  const AttitudeEstimate &att = attitude_get();
+  data.roll_deg = att.roll_deg;
+  data.pitch_deg = att.pitch_deg;
+  data.yaw_deg = att.yaw_deg;
+  DepthHoldStatus depth = depth_hold_get_status();
+  data.depth_m = depth.depth_m;
+  data.depth_setpoint_m = depth.setpoint_m;
+  data.tick_period_us = tick_period_ns / 1000.0f;
+  data.tick_work_us = tick_work_ns / 1000.0f;
+  data.loop_overruns = static_cast<uint32_t>(g_metrics.loop_overruns.load(std::memory_order_relaxed));
+  data.failsafe_entries = static_cast<uint32_t>(g_metrics.failsafe_entries.load(std::memory_order_relaxed));
+  data.failsafe = failsafe ? 1 : 0;
+  data.control_enabled = inputs.control_enabled ? 1 : 0;
+  data.depth_hold_active = depth.active ? 1 : 0;
+  data.inverted = inversion_detector_is_inverted() ? 1 : 0;
+  live_state_publish(data);
+}
+
+// 制御スレッドが担当する設定の変更を反映する (適用した周期の最初に呼ぶ)
+static void apply_config_changes(unsigned changes, NetworkContext *net_ctx) {
+  if (changes & CONFIG_APPLY_BIT(CONFIG_APPLY_CONTROL)) {
+    // 制御のゲインなどは毎周期 g_config を参照するため、この周期から反映される
+    trace_set_enabled(g_config.trace_enabled);
+  }
+  if (changes & CONFIG_APPLY_BIT(CONFIG_APPLY_PWM)) {
+    struct timespec start_ts, end_ts;
+    clock_gettime(CLOCK_MONOTONIC, &start_ts);
+    thruster_apply_frequency();
+    clock_gettime(CLOCK_MONOTONIC, &end_ts);
+    config_record_apply(CONFIG_APPLY_PWM,
+                        timespec_to_ns(end_ts) - timespec_to_ns(start_ts));
+  }
+  if (changes & CONFIG_APPLY_BIT(CONFIG_APPLY_NETWORK)) {
+    // 接続中のクライアントと最終受信時刻は保持したままポートだけを変更する
+    struct timespec start_ts, end_ts;
+    clock_gettime(CLOCK_MONOTONIC, &start_ts);
+    if (network_rebind(net_ctx, g_config.network_recv_port,
+                       g_config.network_send_port)) {
+      clock_gettime(CLOCK_MONOTONIC, &end_ts);
+      config_record_apply(CONFIG_APPLY_NETWORK,
+                          timespec_to_ns(end_ts) - timespec_to_ns(start_ts));
+    }
+  }
+}
 
 // --- メイン関数 ---
 int main() {
   printf("Navigator C++ Control Application\n");
   // --- 設定ファイルの読み込み ---
-  if (!loadConfig("config.ini")) {
+  // (読み込めない場合は最後に正常に読み込めた控えから復元する)
+  if (!loadConfigWithFallback("config.ini")) {
     std::cerr
         << "致命的エラー: "
            "設定ファイルの初期読み込みに失敗しました。プログラムを終了します。"
@@ -32,12 +124,21 @@ int main() {
     return -1;
   }
 
-  // --- 設定同期スレッドの準備 ---
+  // --- トレースの準備 (制御スレッドのリングバッファを確保) ---
+  trace_register_thread("control");
+  trace_set_enabled(g_config.trace_enabled);
+
+  // --- 設定同期スレッドとリロード用スレッドの準備 ---
   ConfigSynchronizer config_sync("config.ini");
+  ConfigReloader config_reloader("config.ini");
+  // カメラの設定の変更は、変わったカメラのパイプラインだけに反映する
+  config_reloader.set_handler(CONFIG_APPLY_CAMERA, reconfigure_gstreamer_cameras);
 
   // --- 初期化 ---
   printf("Initiating navigator module.\n");
   init(); // Navigator ハードウェアライブラリの初期化 (bindings.h 経由)
+  control_init(); // 姿勢推定・深度保持・方位保持・反転検出・電力制限の初期化
+  latency_stats_init(); // 周期・遅延のヒストグラムの初期化
 
   NetworkContext net_ctx;
   if (!network_init(&net_ctx)) {
@@ -45,6 +146,11 @@ int main() {
     return -1;
   }
 
+  if (!thrust_curve_load()) {
+    std::cerr << "推力曲線の読み込みに失敗しました。線形化なしで動作します。"
+              << std::endl;
+  }
+
   if (!thruster_init()) {
     std::cerr << "スラスター初期化失敗。終了します。" << std::endl;
     network_close(&net_ctx);
@@ -60,15 +166,25 @@ int main() {
   // --- 設定同期スレッドの開始 ---
   std::cout << "設定同期スレッドを開始します..." << std::endl;
   config_sync.start();
+  config_reloader.start();
+  param_protocol_init();
+
+  // --- 監視用エンドポイントの開始 ([METRICS] ENABLED=true の場合) ---
+  MetricsServer metrics_server;
+  if (!metrics_server.start()) {
+    std::cerr << "監視用エンドポイントを開始できません。処理を続行します..."
+              << std::endl;
+  }
 
   // --- メインループ変数 ---
-  GamepadData latest_gamepad_data;
   char recv_buffer[NET_BUFFER_SIZE];
-  AxisData current_gyro_data = {0.0f, 0.0f, 0.0f};
+  struct timespec prev_imu_time_ts;
+  clock_gettime(CLOCK_MONOTONIC, &prev_imu_time_ts);
   char sensor_buffer[SENSOR_BUFFER_SIZE];
   unsigned int loop_counter = 0;
   bool running = true;
   bool currently_in_failsafe = true;
+  g_metrics.failsafe_active.store(true, std::memory_order_relaxed);
 
   int initial_pwm_min;
   {
@@ -81,14 +197,42 @@ int main() {
             << initial_pwm_min << ")" << std::endl;
   thruster_set_all_pwm(initial_pwm_min);
 
+  // --- フライトレコーダーの開始 ([RECORDER] ENABLED=true の場合) ---
+  if (!flight_recorder_start("config.ini")) {
+    std::cerr << "フライトレコーダーを開始できません。記録なしで動作します。"
+              << std::endl;
+  }
+
+  // --- トレースの書き出し用スレッドの開始 (SIGUSR1 で書き出す) ---
+  trace_start();
+
+  // --- 稼働状態の共有メモリ公開 ([LIVE_STATE] ENABLED=true の場合) ---
+  if (!live_state_open()) {
+    std::cerr << "稼働状態を公開できません。処理を続行します..." << std::endl;
+  }
+
   while (running) {
     // --- 設定のローカルコピーを取得 ---
     double current_connection_timeout;
     unsigned int current_sensor_send_interval;
     unsigned int current_loop_delay_us;
     int current_pwm_min;
+    TRACE_SCOPE("tick"); // 次の周期の開始まで (スリープを含む周期全体)
 
+    // 設定ファイルが外部から更新されていれば、リロード用スレッドが読み込み済みの設定と交換する
+    // (ファイルの読み込みとパースは ConfigReloader のスレッドで完了している)。
+    // 変更された項目のうち制御スレッドの担当分だけをここで反映し、カメラはリロード用スレッドが反映する。
+    // 周期のローカルコピーより先に行い、同じ周期の中で新旧の設定が混ざらないようにする
     {
+      TRACE_SCOPE("config_apply");
+      unsigned changes = config_reloader.apply_pending();
+      if (changes != 0) {
+        apply_config_changes(changes, &net_ctx);
+      }
+    }
+
+    {
+      TRACE_SCOPE("config_check");
       std::lock_guard<std::mutex> lock(g_config_mutex);
       current_connection_timeout = g_config.connection_timeout_seconds;
       current_sensor_send_interval = g_config.sensor_send_interval;
@@ -96,21 +240,17 @@ int main() {
       current_pwm_min = g_config.pwm_min;
     }
 
-    // 設定ファイルが外部から更新されたかチェックし、リロードする
-    if (g_config_updated_flag.load()) {
-      std::cout << "設定ファイルが更新されました。リロードします..."
-                << std::endl;
-      if (!loadConfig("config.ini")) {
-        std::cerr << "警告: "
-                     "設定ファイルのリロードに失敗しました。古い設定で動作を継"
-                     "続します。"
-                  << std::endl;
-      }
-      g_config_updated_flag.store(false); // フラグをリセット
-    }
-
     struct timespec current_time_ts;
     clock_gettime(CLOCK_MONOTONIC, &current_time_ts);
+    const int64_t tick_start_ns = timespec_to_ns(current_time_ts);
+    const int64_t tick_period_ns = tick_start_ns - timespec_to_ns(prev_imu_time_ts);
+    latency_stats_record(LATENCY_TICK_PERIOD, tick_period_ns);
+    latency_stats_tick(tick_start_ns);
+    metrics_increment(g_metrics.ticks);
+    g_metrics.last_tick_period_ns.store(tick_period_ns, std::memory_order_relaxed);
+    if (tick_period_ns > static_cast<int64_t>(current_loop_delay_us) * 1500) {
+      metrics_increment(g_metrics.loop_overruns); // 周期が LOOP_DELAY_US の 1.5 倍を超えた
+    }
 
     double time_since_last_packet = 0.0;
     if (net_ctx.client_addr_known) {
@@ -121,24 +261,72 @@ int main() {
               1000000000.0;
     }
 
-    ssize_t recv_len =
-        network_receive(&net_ctx, recv_buffer, sizeof(recv_buffer));
+    // --- センサーの読み取り (制御への入力はすべて ControlInputs にまとめる) ---
+    ControlInputs control_inputs;
+    struct timespec sensor_start_ts, sensor_end_ts;
+    clock_gettime(CLOCK_MONOTONIC, &sensor_start_ts);
+    {
+      TRACE_SCOPE("read_gyro");
+      control_inputs.gyro = read_gyro();
+    }
+    {
+      TRACE_SCOPE("read_accel");
+      control_inputs.accel = read_accel();
+    }
+    {
+      TRACE_SCOPE("read_mag");
+      control_inputs.mag = read_mag();
+    }
+    {
+      TRACE_SCOPE("read_pressure");
+      control_inputs.pressure = read_pressure();
+    }
+    {
+      TRACE_SCOPE("read_adc");
+      read_adc_all(control_inputs.adc, 4); // 電力制限器の電圧・電流 (テレメトリもこの値を送る)
+      control_inputs.adc_valid = true;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &sensor_end_ts);
+    latency_stats_record(LATENCY_SENSOR_READ, timespec_to_ns(sensor_end_ts) -
+                                                  timespec_to_ns(sensor_start_ts));
+    control_inputs.dt_s =
+        (current_time_ts.tv_sec - prev_imu_time_ts.tv_sec) +
+        (current_time_ts.tv_nsec - prev_imu_time_ts.tv_nsec) / 1000000000.0f;
+    prev_imu_time_ts = current_time_ts;
+
+    ssize_t recv_len;
+    {
+      TRACE_SCOPE("network_receive");
+      recv_len = network_receive(&net_ctx, recv_buffer, sizeof(recv_buffer));
+    }
+    // パラメータ要求 (param:get/set/list) に応答し、変更された項目を反映する
+    {
+      TRACE_SCOPE("param_protocol");
+      unsigned param_changes = param_protocol_process(&net_ctx, &config_sync);
+      if (param_changes != 0) {
+        apply_config_changes(param_changes, &net_ctx);
+      }
+    }
     bool just_received_packet = (recv_len > 0);
+    bool failsafe_entered = false;
 
     if (just_received_packet) {
       if (currently_in_failsafe) {
         std::cout << "接続確立/再確立。通常動作を再開します。" << std::endl;
         currently_in_failsafe = false;
+        g_metrics.failsafe_active.store(false, std::memory_order_relaxed);
 
         // --- LED状態の同期パケットを送信 ---
-        std::string led_state_str = get_led_state_string();
+        std::string led_state_str = aux_output_state_string();
         network_send(&net_ctx, led_state_str.c_str(), led_state_str.length());
         std::cout << "LED状態同期パケットを送信しました: " << led_state_str
                   << std::endl;
       }
-      std::string received_str(recv_buffer, recv_len);
-      latest_gamepad_data = parseGamepadData(received_str);
     } else {
+      if (time_since_last_packet > current_connection_timeout) {
+        // 途切れていた間隔を、映像のビットレートの調整で混雑と誤認しないようにする
+        video_bitrate_note_connection_lost();
+      }
       if (net_ctx.client_addr_known &&
           time_since_last_packet > current_connection_timeout) {
         if (!currently_in_failsafe) {
@@ -146,13 +334,16 @@ int main() {
                        "(スラスターPWM: "
                     << current_pwm_min << ") に移行します。" << std::endl;
           thruster_set_all_pwm(current_pwm_min);
-          latest_gamepad_data = GamepadData{};
+          control_reset_gamepad();
           currently_in_failsafe = true;
+          failsafe_entered = true;
+          metrics_increment(g_metrics.failsafe_entries);
+          g_metrics.failsafe_active.store(true, std::memory_order_relaxed);
           // GStreamerのクリーンな再確立のため、プロセスを終了してsystemdによる再起動に任せる
           std::cout << "フェイルセーフ起動のためプログラムを終了します。"
                     << std::endl;
           // LED状態を保存してから終了
-          thruster_save_led_state_to_file();
+          aux_output_save_state_to_file();
           running = false;
         }
       }
@@ -161,36 +352,66 @@ int main() {
       }
     }
 
-    if (!currently_in_failsafe && running) {
-      current_gyro_data = read_gyro();
-      thruster_update(latest_gamepad_data, current_gyro_data);
+    // --- 1周期分の制御 (姿勢推定 -> ゲームパッド解析 -> 各制御器 -> スラスター出力) ---
+    control_inputs.packet = just_received_packet ? recv_buffer : nullptr;
+    control_inputs.packet_len = just_received_packet ? static_cast<int>(recv_len) : 0;
+    control_inputs.control_enabled = !currently_in_failsafe && running;
+    ControlOutputs control_outputs;
+    {
+      TRACE_SCOPE("control_step");
+      control_outputs = control_step(control_inputs);
+    }
+    // カーネルがパケットを受信してから、その内容で PWM を出力し終えるまで
+    if (just_received_packet && control_inputs.control_enabled &&
+        net_ctx.last_packet_kernel_time.tv_sec != 0) {
+      struct timespec pwm_done_ts;
+      clock_gettime(CLOCK_REALTIME, &pwm_done_ts); // SO_TIMESTAMPNS と同じ時計
+      latency_stats_record(LATENCY_PACKET_TO_PWM,
+                           timespec_to_ns(pwm_done_ts) -
+                               timespec_to_ns(net_ctx.last_packet_kernel_time));
+    }
 
-      // accel.z の符号反転チェック
-      AxisData current_accel = read_accel();
-      float current_accel_z_sign = std::copysign(1.0f, current_accel.z);
-      if (prev_accel_z_sign == 0.0f) {
-        prev_accel_z_sign = current_accel_z_sign; // 初回は符号を保存
-      } else if (current_accel_z_sign != prev_accel_z_sign &&
-                 current_accel.z != 0.0f) {
-        std::cout << "致命的エラー: accel.z "
-                     "の符号が反転しました。プログラムを終了します。"
+    if (control_inputs.control_enabled) {
+      // --- 機体の反転検出 (フィルタ済み重力方向 + ヒステリシス + 継続時間) ---
+      if (control_outputs.inversion_event != InversionEvent::NONE) {
+        InversionStatus inversion = inversion_detector_get_status();
+        char alert[64];
+        snprintf(alert, sizeof(alert), "alert:inversion=%s,tilt=%.1f",
+                 control_outputs.inversion_event == InversionEvent::ENTERED
+                     ? "entered"
+                     : "cleared",
+                 inversion.tilt_deg);
+        network_send(&net_ctx, alert, strlen(alert));
+        std::cout << "反転検出: " << alert << std::endl;
+        if (control_outputs.inversion_event == InversionEvent::ENTERED) {
+          metrics_increment(g_metrics.inversion_events);
+        }
+      }
+      if (control_outputs.restart_requested) {
+        std::cout << "致命的エラー: "
+                     "機体の反転を検出しました。プログラムを終了します。"
                   << std::endl;
         // LED状態を保存し、PWM出力を保持して再起動させる
-        thruster_save_led_state_to_file();
+        aux_output_save_state_to_file();
         currently_in_failsafe =
             true; // クリーンアップ時のPWM無効化をスキップさせるため
         running = false;
       }
-      prev_accel_z_sign = current_accel_z_sign; // 現在の符号を保存
 
       if (loop_counter >= current_sensor_send_interval) {
         loop_counter = 0;
-        if (read_and_format_sensor_data(sensor_buffer, sizeof(sensor_buffer))) {
+        bool formatted;
+        {
+          TRACE_SCOPE("sensor_format");
+          formatted = read_and_format_sensor_data(sensor_buffer, sizeof(sensor_buffer));
+        }
+        if (formatted) {
+          TRACE_SCOPE("send_telemetry");
           std::cout << "[SENSOR LOG] " << sensor_buffer << std::endl;
           network_send(&net_ctx, sensor_buffer, strlen(sensor_buffer));
 
           // LEDのUIがずれるのを防ぐため、定期的に状態を送信する
-          std::string led_state_str = get_led_state_string();
+          std::string led_state_str = aux_output_state_string();
           network_send(&net_ctx, led_state_str.c_str(), led_state_str.length());
         } else {
           std::cerr << "センサーデータの読み取り/フォーマットに失敗。"
@@ -203,6 +424,25 @@ int main() {
       loop_counter = 0;
     }
 
+    // --- この周期の入出力を記録 (書き込みは別スレッド) ---
+    {
+      TRACE_SCOPE("flight_recorder");
+      flight_recorder_record_tick(control_inputs, failsafe_entered, tick_start_ns);
+    }
+
+    struct timespec work_end_ts;
+    clock_gettime(CLOCK_MONOTONIC, &work_end_ts);
+    const int64_t tick_work_ns = timespec_to_ns(work_end_ts) - tick_start_ns;
+    latency_stats_record(LATENCY_TICK_WORK, tick_work_ns);
+
+    // --- 稼働状態の公開 (読み出し側はこのプロセスを待たせない) ---
+    if (live_state_active()) {
+      TRACE_SCOPE("live_state");
+      publish_live_state(control_inputs, tick_start_ns, tick_period_ns,
+                         tick_work_ns, currently_in_failsafe);
+    }
+
+    TRACE_SCOPE("sleep");
     usleep(current_loop_delay_us);
   }
 
@@ -210,6 +450,11 @@ int main() {
   std::cout << "クリーンアップ処理を開始します..." << std::endl;
   config_sync.stop();
   std::cout << "設定同期スレッドを停止しました..." << std::endl;
+  config_reloader.stop();
+  metrics_server.stop();
+  live_state_close();
+  flight_recorder_stop();
+  trace_stop();
 
   int final_pwm_min;
   {
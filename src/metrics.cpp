@@ -0,0 +1,291 @@
+// metrics.cpp
+#include "metrics.h"
+#include "config.h"          // g_config を使用するため
+#include "config_schema.h"   // config_apply_target_name を使用するため
+#include "flight_recorder.h" // flight_recorder_dropped を使用するため
+#include <arpa/inet.h>
+#include <cstring>
+#include <errno.h>
+#include <fstream>
+#include <iostream>
+#include <netinet/in.h>
+#include <sstream>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+Metrics g_metrics;
+
+static_assert(METRICS_CONFIG_APPLY_TARGETS == CONFIG_APPLY_TARGET_COUNT,
+              "METRICS_CONFIG_APPLY_TARGETS must match ConfigApplyTarget");
+static_assert(METRICS_MAX_CAMERAS == CONFIG_MAX_CAMERAS, "METRICS_MAX_CAMERAS must match CONFIG_MAX_CAMERAS");
+
+// Raspberry Pi の SoC 温度 (取得できなければ false)
+static bool read_cpu_temperature(double& celsius) {
+    std::ifstream file("/sys/class/thermal/thermal_zone0/temp");
+    long millidegrees;
+    if (!(file >> millidegrees)) {
+        return false;
+    }
+    celsius = millidegrees / 1000.0;
+    return true;
+}
+
+// Prometheus テキスト形式の1項目 (HELP, TYPE, 値)。カウンタは整数のまま出力する
+template <typename T>
+static void write_metric(std::ostringstream& out, const char* name, const char* type,
+                         const char* help, T value) {
+    out << "# HELP " << name << " " << help << "\n";
+    out << "# TYPE " << name << " " << type << "\n";
+    out << name << " " << value << "\n";
+}
+
+static uint64_t load(const std::atomic<uint64_t>& counter) {
+    return counter.load(std::memory_order_relaxed);
+}
+
+MetricsServer::MetricsServer() : m_listen_sock(-1), m_shutdown_flag(false) {}
+
+MetricsServer::~MetricsServer() {
+    stop();
+}
+
+bool MetricsServer::start() {
+    std::string bind_host;
+    int port;
+    {
+        std::lock_guard<std::mutex> lock(g_config_mutex);
+        if (!g_config.metrics_enabled) {
+            return true;
+        }
+        bind_host = g_config.metrics_bind;
+        port = g_config.metrics_port;
+    }
+
+    m_listen_sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (m_listen_sock < 0) {
+        std::cerr << "Metrics: error creating listening socket." << std::endl;
+        return false;
+    }
+    int opt = 1;
+    setsockopt(m_listen_sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    struct sockaddr_in server_addr;
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, bind_host.c_str(), &server_addr.sin_addr) != 1) {
+        std::cerr << "Metrics: invalid BIND address '" << bind_host << "'" << std::endl;
+        close(m_listen_sock);
+        m_listen_sock = -1;
+        return false;
+    }
+    if (bind(m_listen_sock, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0 ||
+        listen(m_listen_sock, 4) < 0) {
+        std::cerr << "Metrics: bind/listen failed on " << bind_host << ":" << port
+                  << " (" << strerror(errno) << ")" << std::endl;
+        close(m_listen_sock);
+        m_listen_sock = -1;
+        return false;
+    }
+
+    std::cout << "Metrics endpoint: http://" << bind_host << ":" << port << "/metrics" << std::endl;
+    m_shutdown_flag.store(false);
+    m_thread = std::thread(&MetricsServer::run, this);
+    return true;
+}
+
+void MetricsServer::stop() {
+    m_shutdown_flag.store(true);
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    if (m_listen_sock >= 0) {
+        close(m_listen_sock);
+        m_listen_sock = -1;
+    }
+}
+
+void MetricsServer::run() {
+    while (!m_shutdown_flag.load()) {
+        fd_set readfds;
+        FD_ZERO(&readfds);
+        FD_SET(m_listen_sock, &readfds);
+
+        struct timeval timeout;
+        timeout.tv_sec = 0;
+        timeout.tv_usec = 500000;
+
+        int activity = select(m_listen_sock + 1, &readfds, nullptr, nullptr, &timeout);
+        if (activity < 0 && errno != EINTR) {
+            break;
+        }
+        if (activity > 0 && FD_ISSET(m_listen_sock, &readfds)) {
+            int client_sock = accept(m_listen_sock, nullptr, nullptr);
+            if (client_sock >= 0) {
+                handle_client(client_sock);
+                close(client_sock);
+            }
+        }
+    }
+}
+
+void MetricsServer::handle_client(int client_sock) {
+    // 応答の遅いクライアントでこのスレッドが止まらないよう、送受信にタイムアウトを設定する
+    struct timeval io_timeout;
+    io_timeout.tv_sec = 1;
+    io_timeout.tv_usec = 0;
+    setsockopt(client_sock, SOL_SOCKET, SO_RCVTIMEO, &io_timeout, sizeof(io_timeout));
+    setsockopt(client_sock, SOL_SOCKET, SO_SNDTIMEO, &io_timeout, sizeof(io_timeout));
+
+    // リクエスト行だけを読む (ヘッダーと本文は使わない)
+    char request[1024];
+    ssize_t len = recv(client_sock, request, sizeof(request) - 1, 0);
+    if (len <= 0) {
+        return;
+    }
+    request[len] = '\0';
+
+    std::string response;
+    if (strncmp(request, "GET /metrics", 12) == 0 || strncmp(request, "GET / ", 6) == 0) {
+        std::string body = render();
+        response = "HTTP/1.0 200 OK\r\n"
+                   "Content-Type: text/plain; version=0.0.4\r\n"
+                   "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                   "Connection: close\r\n\r\n" + body;
+    } else {
+        response = "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+    }
+    size_t sent = 0;
+    while (sent < response.size()) {
+        ssize_t n = send(client_sock, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) {
+            break;
+        }
+        sent += static_cast<size_t>(n);
+    }
+}
+
+std::string MetricsServer::render() {
+    std::ostringstream out;
+    write_metric(out, "rov_packets_received_total", "counter",
+                 "Control packets used by the control loop.", load(g_metrics.packets_received));
+    write_metric(out, "rov_packets_superseded_total", "counter",
+                 "Control packets dropped because a newer one arrived in the same tick.",
+                 load(g_metrics.packets_superseded));
+    write_metric(out, "rov_packets_rejected_total", "counter",
+                 "Control packets from a host other than CLIENT_HOST.", load(g_metrics.packets_rejected));
+    write_metric(out, "rov_send_errors_total", "counter",
+                 "UDP sends to the operator PC that failed.", load(g_metrics.send_errors));
+    write_metric(out, "rov_param_requests_total", "counter",
+                 "Parameter get/set/list requests handled.", load(g_metrics.param_requests));
+    write_metric(out, "rov_param_sets_total", "counter",
+                 "Parameters changed through the control link.", load(g_metrics.param_sets));
+    write_metric(out, "rov_param_rejected_total", "counter",
+                 "Parameter requests answered with a nack.", load(g_metrics.param_rejected));
+    write_metric(out, "rov_param_dropped_total", "counter",
+                 "Parameter requests dropped because too many arrived in one tick.",
+                 load(g_metrics.param_dropped));
+    write_metric(out, "rov_ticks_total", "counter", "Control loop iterations.", load(g_metrics.ticks));
+    write_metric(out, "rov_loop_overruns_total", "counter",
+                 "Ticks whose period exceeded 1.5x LOOP_DELAY_US.", load(g_metrics.loop_overruns));
+    write_metric(out, "rov_tick_period_seconds", "gauge", "Period of the last control loop tick.",
+                 g_metrics.last_tick_period_ns.load(std::memory_order_relaxed) / 1e9);
+    write_metric(out, "rov_failsafe_entries_total", "counter",
+                 "Communication timeouts that put the thrusters into failsafe.",
+                 load(g_metrics.failsafe_entries));
+    write_metric(out, "rov_failsafe_active", "gauge", "1 while in failsafe.",
+                 g_metrics.failsafe_active.load(std::memory_order_relaxed) ? 1 : 0);
+    write_metric(out, "rov_config_reloads_total", "counter", "Successful config reloads.",
+                 load(g_metrics.config_reloads));
+    write_metric(out, "rov_config_reload_failures_total", "counter", "Failed config reloads.",
+                 load(g_metrics.config_reload_failures));
+    write_metric(out, "rov_config_parse_seconds", "gauge",
+                 "Time spent reading, parsing and validating the last reload (reload thread).",
+                 g_metrics.config_parse_ns.load(std::memory_order_relaxed) / 1e9);
+    write_metric(out, "rov_config_apply_seconds", "gauge",
+                 "Time the control thread spent swapping in the last reload.",
+                 g_metrics.config_apply_ns.load(std::memory_order_relaxed) / 1e9);
+    out << "# HELP rov_config_apply_target_seconds Time spent applying the last change, per subsystem.\n"
+        << "# TYPE rov_config_apply_target_seconds gauge\n";
+    for (int i = 0; i < METRICS_CONFIG_APPLY_TARGETS; ++i) {
+        out << "rov_config_apply_target_seconds{target=\"" << config_apply_target_name(i) << "\"} "
+            << g_metrics.config_apply_target_ns[i].load(std::memory_order_relaxed) / 1e9 << "\n";
+    }
+    out << "# HELP rov_config_apply_target_total Config changes applied, per subsystem.\n"
+        << "# TYPE rov_config_apply_target_total counter\n";
+    for (int i = 0; i < METRICS_CONFIG_APPLY_TARGETS; ++i) {
+        out << "rov_config_apply_target_total{target=\"" << config_apply_target_name(i) << "\"} "
+            << load(g_metrics.config_apply_target_count[i]) << "\n";
+    }
+    write_metric(out, "rov_inversion_events_total", "counter", "Detected vehicle inversions.",
+                 load(g_metrics.inversion_events));
+    write_metric(out, "rov_recorder_dropped_records_total", "counter",
+                 "Flight recorder records (ticks, config and parameter changes) dropped because the "
+                 "ring buffer was full, the file size limit was reached or a record was too long.",
+                 flight_recorder_dropped());
+
+    out << "# HELP rov_camera_state GStreamer pipeline state (0 none, 1 NULL, 2 READY, 3 PAUSED, 4 PLAYING).\n"
+        << "# TYPE rov_camera_state gauge\n";
+    for (int i = 0; i < METRICS_MAX_CAMERAS; ++i) {
+        out << "rov_camera_state{camera=\"" << i + 1 << "\"} "
+            << g_metrics.camera_state[i].load(std::memory_order_relaxed) << "\n";
+    }
+    out << "# HELP rov_camera_frames_total Frames captured from the camera.\n"
+        << "# TYPE rov_camera_frames_total counter\n";
+    for (int i = 0; i < METRICS_MAX_CAMERAS; ++i) {
+        out << "rov_camera_frames_total{camera=\"" << i + 1 << "\"} "
+            << load(g_metrics.camera_frames[i]) << "\n";
+    }
+    out << "# HELP rov_camera_errors_total Error and EOS messages posted by the pipeline.\n"
+        << "# TYPE rov_camera_errors_total counter\n";
+    for (int i = 0; i < METRICS_MAX_CAMERAS; ++i) {
+        out << "rov_camera_errors_total{camera=\"" << i + 1 << "\"} "
+            << load(g_metrics.camera_errors[i]) << "\n";
+    }
+    out << "# HELP rov_camera_warnings_total Warning messages posted by the pipeline.\n"
+        << "# TYPE rov_camera_warnings_total counter\n";
+    for (int i = 0; i < METRICS_MAX_CAMERAS; ++i) {
+        out << "rov_camera_warnings_total{camera=\"" << i + 1 << "\"} "
+            << load(g_metrics.camera_warnings[i]) << "\n";
+    }
+    out << "# HELP rov_camera_restarts_total Automatic pipeline restarts after an error or EOS.\n"
+        << "# TYPE rov_camera_restarts_total counter\n";
+    for (int i = 0; i < METRICS_MAX_CAMERAS; ++i) {
+        out << "rov_camera_restarts_total{camera=\"" << i + 1 << "\"} "
+            << load(g_metrics.camera_restarts[i]) << "\n";
+    }
+    out << "# HELP rov_camera_first_frame_seconds Time from the last pipeline start to its first frame.\n"
+        << "# TYPE rov_camera_first_frame_seconds gauge\n";
+    for (int i = 0; i < METRICS_MAX_CAMERAS; ++i) {
+        out << "rov_camera_first_frame_seconds{camera=\"" << i + 1 << "\"} "
+            << g_metrics.camera_first_frame_ns[i].load(std::memory_order_relaxed) / 1e9 << "\n";
+    }
+    out << "# HELP rov_camera_latency_seconds Mean capture-to-udpsink latency over the last second.\n"
+        << "# TYPE rov_camera_latency_seconds gauge\n";
+    for (int i = 0; i < METRICS_MAX_CAMERAS; ++i) {
+        out << "rov_camera_latency_seconds{camera=\"" << i + 1 << "\"} "
+            << g_metrics.camera_latency_ns[i].load(std::memory_order_relaxed) / 1e9 << "\n";
+    }
+    out << "# HELP rov_camera_latency_max_seconds Largest capture-to-udpsink latency over the last second.\n"
+        << "# TYPE rov_camera_latency_max_seconds gauge\n";
+    for (int i = 0; i < METRICS_MAX_CAMERAS; ++i) {
+        out << "rov_camera_latency_max_seconds{camera=\"" << i + 1 << "\"} "
+            << g_metrics.camera_latency_max_ns[i].load(std::memory_order_relaxed) / 1e9 << "\n";
+    }
+    write_metric(out, "rov_video_bitrate_target_kbps", "gauge",
+                 "Per-camera video bitrate chosen by the adaptive controller (0 when disabled).",
+                 g_metrics.video_bitrate_kbps.load(std::memory_order_relaxed));
+    write_metric(out, "rov_video_bitrate_decreases_total", "counter",
+                 "Times the video bitrate was lowered because the control link was congested.",
+                 load(g_metrics.video_bitrate_decreases));
+    write_metric(out, "rov_control_packet_gap_seconds", "gauge",
+                 "Largest gap between control packets in the last bitrate interval.",
+                 g_metrics.control_gap_max_ns.load(std::memory_order_relaxed) / 1e9);
+
+    double celsius;
+    if (read_cpu_temperature(celsius)) {
+        write_metric(out, "rov_cpu_temperature_celsius", "gauge", "SoC temperature.", celsius);
+    }
+    return out.str();
+}
@@ -1,14 +1,74 @@
 #include "network.h"
 #include "config.h" // g_config を使用するため
+#include "metrics.h" // 受信・破棄したパケット数の計数のため
+#include "video_bitrate.h" // 操縦パケットの間隔を映像のビットレートの調整に渡すため
 #include <arpa/inet.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/socket.h> // recvmsg, SO_TIMESTAMPNS のため
 #include <time.h> // clock_gettime のため
 #include <unistd.h>
 
+// 受信ソケットを作成し、ノンブロッキング・受信時刻の取得を設定して recv_port にバインドする。
+// 失敗した場合は -1 を返す
+static int open_recv_socket(int recv_port, struct sockaddr_in *server_addr) {
+  int sock = socket(AF_INET, SOCK_DGRAM, 0);
+  if (sock < 0) {
+    perror("受信ソケット作成失敗");
+    return -1;
+  }
+
+  // ノンブロッキング設定
+  int flags = fcntl(sock, F_GETFL, 0);
+  if (flags == -1 || fcntl(sock, F_SETFL, flags | O_NONBLOCK) ==
+                         -1) // 現在のフラグを取得し、O_NONBLOCK を追加
+  {
+    perror("受信ソケットのノンブロッキング設定失敗");
+    close(sock);
+    return -1;
+  }
+
+  // パケットごとにカーネルの受信時刻を取得する (受信からPWM出力までの遅延計測用)
+  int timestamp_on = 1;
+  if (setsockopt(sock, SOL_SOCKET, SO_TIMESTAMPNS, &timestamp_on,
+                 sizeof(timestamp_on)) < 0) {
+    perror("受信ソケットのタイムスタンプ設定失敗 (遅延計測なしで続行)");
+  }
+
+  // サーバー（このプログラム）のアドレス情報を設定
+  memset(server_addr, 0, sizeof(*server_addr));
+  server_addr->sin_family = AF_INET;
+  server_addr->sin_addr.s_addr = INADDR_ANY;
+  server_addr->sin_port = htons(recv_port);
+
+  // ソケットにアドレス情報を割り当て (バインド)
+  if (bind(sock, (const struct sockaddr *)server_addr, sizeof(*server_addr)) <
+      0) {
+    perror("受信ソケットのバインド失敗");
+    close(sock);
+    return -1;
+  }
+  return sock;
+}
+
+// 送信ソケットの DSCP を EF にし、このプロセスの送信キューでも優先させる。
+// 映像 (gstPipeline.cpp の udpsink) は AF41 で送るため、回線が混んでいても操縦側のパケットが先に出る
+static void set_control_priority(int sock) {
+  int tos = 46 << 2; // DSCP EF (Expedited Forwarding)
+  if (setsockopt(sock, IPPROTO_IP, IP_TOS, &tos, sizeof(tos)) < 0) {
+    perror("送信ソケットの DSCP 設定失敗 (優先度なしで続行)");
+  }
+  // IP_TOS で変わる優先度を上書きする (6: CAP_NET_ADMIN なしで設定できる最大値)
+  int priority = 6;
+  if (setsockopt(sock, SOL_SOCKET, SO_PRIORITY, &priority, sizeof(priority)) <
+      0) {
+    perror("送信ソケットの優先度設定失敗 (優先度なしで続行)");
+  }
+}
+
 // ネットワーク送受信コンテキストを初期化する関数
 bool network_init(NetworkContext *ctx) {
   if (!ctx)
@@ -28,35 +88,8 @@ bool network_init(NetworkContext *ctx) {
                 &ctx->last_successful_recv_time); // 現在時刻で初期化
 
   // --- 受信ソケット設定 ---
-  ctx->recv_socket = socket(AF_INET, SOCK_DGRAM, 0);
+  ctx->recv_socket = open_recv_socket(recv_port, &ctx->server_addr);
   if (ctx->recv_socket < 0) {
-    perror("受信ソケット作成失敗");
-    return false;
-  }
-
-  // ノンブロッキング設定
-  int flags = fcntl(ctx->recv_socket, F_GETFL, 0);
-  if (flags == -1 || fcntl(ctx->recv_socket, F_SETFL, flags | O_NONBLOCK) ==
-                         -1) // 現在のフラグを取得し、O_NONBLOCK を追加
-  {
-    perror("受信ソケットのノンブロッキング設定失敗");
-    close(ctx->recv_socket);
-    ctx->recv_socket = -1;
-    return false;
-  }
-
-  // サーバー（このプログラム）のアドレス情報を設定
-  memset(&ctx->server_addr, 0, sizeof(ctx->server_addr));
-  ctx->server_addr.sin_family = AF_INET;
-  ctx->server_addr.sin_addr.s_addr = INADDR_ANY;
-  ctx->server_addr.sin_port = htons(recv_port);
-
-  // ソケットにアドレス情報を割り当て (バインド)
-  if (bind(ctx->recv_socket, (const struct sockaddr *)&ctx->server_addr,
-           sizeof(ctx->server_addr)) < 0) {
-    perror("受信ソケットのバインド失敗");
-    close(ctx->recv_socket);
-    ctx->recv_socket = -1;
     return false;
   }
   printf("UDPサーバー起動 (受信ポート: %d)\n", recv_port);
@@ -69,6 +102,7 @@ bool network_init(NetworkContext *ctx) {
     ctx->recv_socket = -1;
     return false;
   }
+  set_control_priority(ctx->send_socket);
 
   // 送信先アドレスの初期設定 (ポートのみ)
   memset(&ctx->client_addr_send, 0, sizeof(ctx->client_addr_send));
@@ -81,6 +115,33 @@ bool network_init(NetworkContext *ctx) {
   return true;
 }
 
+// 受信・送信ポートを変更する関数。クライアントのアドレスや最終受信時刻は保持したまま、
+// 新しいポートでのバインドに成功した場合のみ受信ソケットを差し替える
+bool network_rebind(NetworkContext *ctx, int recv_port, int send_port) {
+  if (!ctx || ctx->recv_socket < 0)
+    return false;
+
+  if (ntohs(ctx->server_addr.sin_port) != recv_port) {
+    struct sockaddr_in server_addr;
+    int sock = open_recv_socket(recv_port, &server_addr);
+    if (sock < 0) {
+      fprintf(stderr, "警告: 受信ポート %d にバインドできません。ポート %d で受信を継続します。\n",
+              recv_port, ntohs(ctx->server_addr.sin_port));
+      return false;
+    }
+    close(ctx->recv_socket);
+    ctx->recv_socket = sock;
+    ctx->server_addr = server_addr;
+    printf("UDP受信ポートを変更しました (受信ポート: %d)\n", recv_port);
+  }
+
+  if (ntohs(ctx->client_addr_send.sin_port) != send_port) {
+    ctx->client_addr_send.sin_port = htons(send_port);
+    printf("UDP送信先ポートを変更しました (送信先ポート: %d)\n", send_port);
+  }
+  return true;
+}
+
 // ネットワーク関連のリソースを解放する関数
 void network_close(NetworkContext *ctx) {
   if (ctx) {
@@ -104,17 +165,35 @@ ssize_t network_receive(NetworkContext *ctx, char *buffer, size_t buffer_size) {
 
   ssize_t final_recv_len = -1;
   bool valid_packet_received = false;
+  unsigned valid_packet_count = 0;
   static struct timespec last_warning_time = {0, 0};
 
+  // recvmsg 用の構造体 (補助データで SO_TIMESTAMPNS の受信時刻を受け取る)
+  struct iovec iov;
+  char control[CMSG_SPACE(sizeof(struct timespec))];
+  struct msghdr msg;
+  // 操縦パケットを受け取った後は別の領域に受信する
+  // (続くパケットがパラメータ要求だった場合に、操縦パケットを上書きしないため)
+  char scratch[NET_BUFFER_SIZE];
+  size_t scratch_len = buffer_size < sizeof(scratch) ? buffer_size : sizeof(scratch);
+
   // OSの受信バッファに溜まっているパケットをすべて読み切るループ (ドレイン)
   while (true) {
-    ctx->client_addr_len = sizeof(ctx->client_addr_recv);
+    iov.iov_base = valid_packet_received ? scratch : buffer;
+    iov.iov_len = (valid_packet_received ? scratch_len : buffer_size) - 1;
+    char *packet = static_cast<char *>(iov.iov_base);
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = &ctx->client_addr_recv;
+    msg.msg_namelen = sizeof(ctx->client_addr_recv);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
 
-    // recvfrom は O_NONBLOCK により、データがない場合は -1 (errno = EAGAIN)
+    // recvmsg は O_NONBLOCK により、データがない場合は -1 (errno = EAGAIN)
     // を返す
-    ssize_t current_recv_len = recvfrom(
-        ctx->recv_socket, buffer, buffer_size - 1, 0,
-        (struct sockaddr *)&ctx->client_addr_recv, &ctx->client_addr_len);
+    ssize_t current_recv_len = recvmsg(ctx->recv_socket, &msg, 0);
+    ctx->client_addr_len = msg.msg_namelen;
 
     if (current_recv_len > 0) {
       // --- セキュリティチェック: 許可されたIPアドレスからのパケットか検証 ---
@@ -148,12 +227,49 @@ ssize_t network_receive(NetworkContext *ctx, char *buffer, size_t buffer_size) {
           last_warning_time = now;
         }
         // このパケットは無視して次のパケットを読み取る
+        metrics_increment(g_metrics.packets_rejected);
+        continue;
+      }
+
+      // パラメータ要求は操縦パケットとして扱わず (上書きもしない)、周期の中で順に処理する
+      if (current_recv_len >= NET_PARAM_PREFIX_LEN &&
+          memcmp(packet, NET_PARAM_PREFIX, NET_PARAM_PREFIX_LEN) == 0) {
+        if (ctx->param_queue_count < NET_PARAM_QUEUE_SIZE) {
+          NetworkMessage *message = &ctx->param_queue[ctx->param_queue_count++];
+          memcpy(message->data, packet, current_recv_len);
+          message->data[current_recv_len] = '\0';
+          message->len = static_cast<size_t>(current_recv_len);
+          message->from = ctx->client_addr_recv;
+        } else {
+          metrics_increment(g_metrics.param_dropped);
+        }
         continue;
       }
 
       // 有効なパケットとして記録 (上書き)
+      if (packet != buffer) {
+        memcpy(buffer, packet, current_recv_len);
+      }
       final_recv_len = current_recv_len;
       valid_packet_received = true;
+      valid_packet_count++;
+      ctx->last_packet_kernel_time.tv_sec = 0;
+      ctx->last_packet_kernel_time.tv_nsec = 0;
+      for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL;
+           cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+          memcpy(&ctx->last_packet_kernel_time, CMSG_DATA(cmsg),
+                 sizeof(struct timespec));
+        }
+      }
+      // 操縦パケットの間隔 (映像のビットレートの自動調整で回線の混雑の判断に使う。
+      // 上書きされるパケットも含め、カーネルが受信した時刻で数える)
+      struct timespec arrival = ctx->last_packet_kernel_time;
+      if (arrival.tv_sec == 0 && arrival.tv_nsec == 0) {
+        clock_gettime(CLOCK_REALTIME, &arrival);
+      }
+      video_bitrate_note_control_packet(
+          static_cast<int64_t>(arrival.tv_sec) * 1000000000LL + arrival.tv_nsec);
 
       // 送信先の更新処理 (最新のパケットのIP情報を使う)
       clock_gettime(CLOCK_MONOTONIC,
@@ -183,6 +299,10 @@ ssize_t network_receive(NetworkContext *ctx, char *buffer, size_t buffer_size) {
   // ループ終了後、有効なパケットを1つでも受信していれば、最後に書き込んだバッファを返す
   if (valid_packet_received) {
     buffer[final_recv_len] = '\0'; // Null終端
+    // 最後の1つだけを制御に使い、それより前のパケットは上書きされたものとして数える
+    metrics_increment(g_metrics.packets_received);
+    g_metrics.packets_superseded.fetch_add(valid_packet_count - 1,
+                                           std::memory_order_relaxed);
   }
   // 有効なパケットを受信していない、かつエラーでもない場合は 0 を返す
   else if (final_recv_len == -1) {
@@ -207,6 +327,7 @@ bool network_send(NetworkContext *ctx, const char *data, size_t data_len) {
   if (sent_len < 0) {
     // クライアント切断時などにログが溢れるのを避けるため、頻繁なエラー出力は避ける
     // perror("送信エラー");
+    metrics_increment(g_metrics.send_errors);
     return false;
   } else if ((size_t)sent_len < data_len) {
     fprintf(stderr, "警告: データが部分的にしか送信されませんでした。\n");
@@ -216,6 +337,24 @@ bool network_send(NetworkContext *ctx, const char *data, size_t data_len) {
   return true;
 }
 
+// 受け取ったメッセージの送信元 (IPアドレス) の送信ポートへ応答する関数
+// (操縦パケットを受信する前でも応答できるよう、client_addr_send は変更しない)
+bool network_reply(NetworkContext *ctx, const NetworkMessage *request,
+                   const char *data, size_t data_len) {
+  if (!ctx || ctx->send_socket < 0 || !request || !data) {
+    return false;
+  }
+  struct sockaddr_in addr = ctx->client_addr_send;
+  addr.sin_addr = request->from.sin_addr;
+  ssize_t sent_len = sendto(ctx->send_socket, data, data_len, 0,
+                            (const struct sockaddr *)&addr, sizeof(addr));
+  if (sent_len < 0) {
+    metrics_increment(g_metrics.send_errors);
+    return false;
+  }
+  return true;
+}
+
 // 最後にデータを受信したクライアントのIPアドレスを送信先として設定/更新する関数
 bool network_update_send_address(NetworkContext *ctx) {
   if (!ctx)
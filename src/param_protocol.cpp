@@ -0,0 +1,322 @@
+#include "param_protocol.h"
+#include "config.h"              // g_config, g_config_mutex
+#include "config_schema.h"       // 項目の表、値の検証と文字列化
+#include "config_synchronizer.h" // persist の保存, g_config_change_count
+#include "flight_recorder.h"     // 変更をリプレイで再現できるよう記録する
+#include "metrics.h"             // 要求数の計数のため
+#include <cmath>  // std::isfinite
+#include <mutex>
+#include <stdio.h>  // snprintf
+#include <stdlib.h> // strtod, strtoul
+#include <string.h> // memcpy, strchr, strcmp
+#include <strings.h> // strcasecmp
+#include <string>
+#include <vector>
+
+// list の応答を1周期に送る数 (全項目を一度に送って制御周期を延ばさないため)
+#define PARAM_LIST_BATCH 8
+
+// 読み書きできる項目 (config_schema() の順。別名の CONFIG_AUX_LEVEL は含まない)
+static std::vector<const ConfigField *> params;
+
+// 送信中の list (1つだけ。新しい list が届いたら置き換える)
+static bool list_active = false;
+static unsigned long list_seq = 0;
+static size_t list_next = 0;
+static NetworkMessage list_request; // 応答の宛先
+
+static const char *type_name(ConfigFieldType type) {
+  switch (type) {
+  case CONFIG_INT:
+    return "int";
+  case CONFIG_UINT:
+    return "uint";
+  case CONFIG_FLOAT:
+    return "float";
+  case CONFIG_DOUBLE:
+    return "double";
+  case CONFIG_BOOL:
+    return "bool";
+  case CONFIG_STRING:
+    return "string";
+  case CONFIG_SIGN:
+    return "sign";
+  case CONFIG_BUTTON:
+    return "button";
+  case CONFIG_INVERSION_RESPONSE:
+    return "enum";
+  default:
+    return "levels";
+  }
+}
+
+// set で変更できる項目か (制御スレッドで反映でき、再構成を伴わない数値・真偽値のみ)
+static bool is_tunable(const ConfigField &field) {
+  const unsigned live_targets = CONFIG_APPLY_BIT(CONFIG_APPLY_CONTROL) |
+                                CONFIG_APPLY_BIT(CONFIG_APPLY_PWM);
+  if (field.apply == 0 || (field.apply & ~live_targets) != 0) {
+    return false;
+  }
+  // 推力曲線のテーブルはリロード用スレッドが作るため、ここでは変更しない
+  if (strcmp(field.section, "THRUST_CURVE") == 0) {
+    return false;
+  }
+  switch (field.type) {
+  case CONFIG_INT:
+  case CONFIG_UINT:
+  case CONFIG_FLOAT:
+  case CONFIG_DOUBLE:
+  case CONFIG_BOOL:
+  case CONFIG_SIGN:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// set で変更できる型の格納先の大きさ
+static size_t scalar_size(ConfigFieldType type) {
+  switch (type) {
+  case CONFIG_UINT:
+    return sizeof(unsigned int);
+  case CONFIG_FLOAT:
+    return sizeof(float);
+  case CONFIG_DOUBLE:
+    return sizeof(double);
+  case CONFIG_BOOL:
+    return sizeof(bool);
+  default:
+    return sizeof(int); // CONFIG_INT, CONFIG_SIGN
+  }
+}
+
+// 値の表記が型に合っているか (config.ini の読み込みより厳しく、末尾の余分な文字も拒否する)
+static bool is_well_formed(const ConfigField &field, const std::string &value) {
+  if (value.empty()) {
+    return false;
+  }
+  const char *text = value.c_str();
+  char *end = nullptr;
+  switch (field.type) {
+  case CONFIG_BOOL:
+    return strcasecmp(text, "true") == 0 || strcasecmp(text, "false") == 0;
+  case CONFIG_UINT:
+    if (text[0] == '-') {
+      return false;
+    }
+    strtoul(text, &end, 10);
+    return *end == '\0';
+  case CONFIG_INT:
+  case CONFIG_SIGN:
+    strtol(text, &end, 10);
+    return *end == '\0';
+  default: {
+    // nan/inf は strtod が受け付けるが、範囲の比較をすり抜けるので形式エラーにする
+    double parsed = strtod(text, &end);
+    return *end == '\0' && std::isfinite(parsed);
+  }
+  }
+}
+
+static void reply(NetworkContext *ctx, const NetworkMessage *request,
+                  const char *text) {
+  network_reply(ctx, request, text, strlen(text));
+}
+
+static void send_nack(NetworkContext *ctx, const NetworkMessage *request,
+                      unsigned long seq, const std::string &reason) {
+  char buffer[NET_BUFFER_SIZE];
+  snprintf(buffer, sizeof(buffer), "param:nack,%lu,%s", seq, reason.c_str());
+  reply(ctx, request, buffer);
+  metrics_increment(g_metrics.param_rejected);
+}
+
+static void send_value(NetworkContext *ctx, const NetworkMessage *request,
+                       unsigned long seq, size_t index) {
+  const ConfigField &field = *params[index];
+  std::string value;
+  {
+    std::lock_guard<std::mutex> lock(g_config_mutex);
+    value = config_format_field(field, g_config);
+  }
+  char buffer[NET_BUFFER_SIZE];
+  snprintf(buffer, sizeof(buffer), "param:value,%lu,%zu,%zu,%s.%s,%s,%s", seq,
+           index, params.size(), field.section, field.key,
+           type_name(field.type), value.c_str());
+  reply(ctx, request, buffer);
+}
+
+// "SECTION.KEY" から項目の番号を求める。見つからなければ -1
+static int find_param(const std::string &name) {
+  size_t dot = name.find('.');
+  if (dot == std::string::npos || dot == 0 || dot + 1 == name.size()) {
+    return -1;
+  }
+  const ConfigField *field =
+      config_find_field(name.substr(0, dot), name.substr(dot + 1));
+  for (size_t i = 0; field && i < params.size(); ++i) {
+    if (params[i] == field) {
+      return static_cast<int>(i);
+    }
+  }
+  return -1;
+}
+
+// 先頭から ',' までを切り出して text を進める。',' が無ければ残り全部
+static std::string next_token(const char **text) {
+  const char *comma = strchr(*text, ',');
+  std::string token;
+  if (comma) {
+    token.assign(*text, comma - *text);
+    *text = comma + 1;
+  } else {
+    token = *text;
+    *text += token.size();
+  }
+  return token;
+}
+
+static bool parse_number(const std::string &token, unsigned long *value) {
+  if (token.empty() || token.size() > 10 ||
+      token.find_first_not_of("0123456789") != std::string::npos) {
+    return false;
+  }
+  *value = strtoul(token.c_str(), nullptr, 10);
+  return true;
+}
+
+// set を処理する。変更した場合は反映先を返す
+static unsigned handle_set(NetworkContext *ctx, const NetworkMessage *request,
+                           unsigned long seq, const char *args,
+                           ConfigSynchronizer *sync) {
+  std::string mode = next_token(&args);
+  std::string name = next_token(&args);
+  std::string value = args; // 値は残り全体
+  bool persist = mode == "persist";
+  if (!persist && mode != "live") {
+    send_nack(ctx, request, seq, "mode must be live or persist");
+    return 0;
+  }
+  int index = find_param(name);
+  if (index < 0) {
+    send_nack(ctx, request, seq, "unknown parameter " + name);
+    return 0;
+  }
+  const ConfigField &field = *params[index];
+  if (!is_tunable(field)) {
+    send_nack(ctx, request, seq, name + " cannot be changed live; use config sync");
+    return 0;
+  }
+  if (!is_well_formed(field, value)) {
+    send_nack(ctx, request, seq,
+              "invalid " + std::string(type_name(field.type)) + " value '" + value + "'");
+    return 0;
+  }
+
+  // 範囲と項目間の整合性を満たす場合だけ g_config に残す (満たさなければ元の値に戻す)
+  std::string error;
+  std::string formatted;
+  {
+    std::lock_guard<std::mutex> lock(g_config_mutex);
+    void *target = field.member(g_config, field.index);
+    unsigned char previous[sizeof(double)];
+    memcpy(previous, target, scalar_size(field.type));
+    if (!config_set_field(field, value, g_config, error) ||
+        !config_validate(g_config, error)) {
+      memcpy(target, previous, scalar_size(field.type));
+    } else {
+      error.clear();
+    }
+    formatted = config_format_field(field, g_config);
+  }
+  if (!error.empty()) {
+    send_nack(ctx, request, seq, error);
+    return 0;
+  }
+  // 記録にも残す (リプレイでは同じ周期の制御の前に同じ値を適用する)
+  flight_recorder_note_param(field.section, field.key, formatted);
+  // 設定同期のセッションにも変更を知らせる
+  g_config_change_count.fetch_add(1, std::memory_order_release);
+  metrics_increment(g_metrics.param_sets);
+  if (persist && sync) {
+    ConfigEntry entry;
+    entry.section = field.section;
+    entry.key = field.key;
+    entry.value = formatted;
+    sync->persist(std::vector<ConfigEntry>(1, entry));
+  }
+  printf("パラメータ変更: [%s] %s = %s (%s)\n", field.section, field.key,
+         formatted.c_str(), persist ? "保存" : "一時");
+
+  char buffer[NET_BUFFER_SIZE];
+  snprintf(buffer, sizeof(buffer), "param:ack,%lu,%s.%s,%s,%s,%s", seq,
+           field.section, field.key, type_name(field.type), formatted.c_str(),
+           persist ? "persist" : "live");
+  reply(ctx, request, buffer);
+  return field.apply;
+}
+
+void param_protocol_init() {
+  params.clear();
+  const std::vector<ConfigField> &schema = config_schema();
+  for (size_t i = 0; i < schema.size(); ++i) {
+    if (schema[i].type != CONFIG_AUX_LEVEL) {
+      params.push_back(&schema[i]);
+    }
+  }
+  list_active = false;
+}
+
+unsigned param_protocol_process(NetworkContext *ctx, ConfigSynchronizer *sync) {
+  unsigned changes = 0;
+  for (int i = 0; i < ctx->param_queue_count; ++i) {
+    const NetworkMessage *request = &ctx->param_queue[i];
+    const char *args = request->data + NET_PARAM_PREFIX_LEN;
+    std::string command = next_token(&args);
+    unsigned long seq = 0;
+    metrics_increment(g_metrics.param_requests);
+    if (!parse_number(next_token(&args), &seq)) {
+      send_nack(ctx, request, 0, "missing or invalid sequence number");
+      continue;
+    }
+
+    if (command == "get") {
+      std::string name = args;
+      int index = find_param(name);
+      if (index < 0) {
+        send_nack(ctx, request, seq, "unknown parameter " + name);
+      } else {
+        send_value(ctx, request, seq, static_cast<size_t>(index));
+      }
+    } else if (command == "set") {
+      changes |= handle_set(ctx, request, seq, args, sync);
+    } else if (command == "list") {
+      unsigned long start = 0;
+      if (*args != '\0' && !parse_number(args, &start)) {
+        send_nack(ctx, request, seq, "invalid start index");
+        continue;
+      }
+      if (start >= params.size()) {
+        send_nack(ctx, request, seq, "start index out of range");
+        continue;
+      }
+      list_active = true;
+      list_seq = seq;
+      list_next = start;
+      list_request = *request;
+    } else {
+      send_nack(ctx, request, seq, "unknown command " + command);
+    }
+  }
+  ctx->param_queue_count = 0;
+
+  // list の続き
+  for (int sent = 0; list_active && sent < PARAM_LIST_BATCH; ++sent) {
+    if (list_next >= params.size()) {
+      list_active = false;
+      break;
+    }
+    send_value(ctx, &list_request, list_seq, list_next++);
+  }
+  return changes;
+}
@@ -0,0 +1,122 @@
+#include "power_limiter.h"
+#include "config.h"  // グローバル設定オブジェクト g_config を使用するため
+#include <algorithm> // std::max, std::min のため
+#include <cmath>     // std::pow のため
+#include <stdio.h>   // printf のため
+
+// 状態 (ファイルスコープ、メインスレッド専用)
+static PowerLimiterStatus status;
+static float model_correction = 1.0f;   // 計測電流 / モデル推定電流 (平滑化済み)
+static float last_model_current_a = 0.0f; // 実際に出力した PWM に対するモデル推定電流 (補正前)
+
+void power_limiter_init() {
+  for (int i = 0; i < 4; ++i) {
+    status.adc[i] = 0.0f;
+  }
+  status.voltage_v = 0.0f;
+  status.current_a = 0.0f;
+  status.estimated_current_a = 0.0f;
+  status.budget_a = g_config.power_budget_a;
+  status.headroom_a = g_config.power_budget_a;
+  status.scale = 1.0f;
+  status.limit_events = 0;
+  status.limiting = false;
+  model_correction = 1.0f;
+  last_model_current_a = 0.0f;
+}
+
+// 指令PWM から1チャンネル分のモデル電流を求める (電流 ∝ 指令率^指数)
+static float model_current(int pwm) {
+  const int range = g_config.pwm_boost_max - g_config.pwm_min;
+  if (range <= 0 || pwm <= g_config.pwm_min) {
+    return 0.0f;
+  }
+  float ratio = std::min(1.0f, static_cast<float>(pwm - g_config.pwm_min) / range);
+  return g_config.power_thruster_full_current_a *
+         std::pow(ratio, g_config.power_current_exponent);
+}
+
+void power_limiter_update_measurements(const float *adc, int count) {
+  const int v_ch = g_config.power_voltage_adc_channel;
+  const int i_ch = g_config.power_current_adc_channel;
+  for (int i = 0; i < 4; ++i) {
+    status.adc[i] = (i < count) ? adc[i] : 0.0f;
+  }
+  if (v_ch >= 0 && v_ch < count) {
+    status.voltage_v = adc[v_ch] * g_config.power_voltage_scale;
+  }
+  if (i_ch >= 0 && i_ch < count) {
+    status.current_a = (adc[i_ch] - g_config.power_current_offset) *
+                       g_config.power_current_scale;
+  }
+
+  // 計測電流と、実際に出力中の PWM に対するモデル推定を比較し、補正係数をゆっくり追従させる
+  // (スラスターがほぼ停止している時は比率が不安定なので更新しない)
+  if (i_ch >= 0 && i_ch < count && last_model_current_a > 1.0f) {
+    float thruster_current =
+        std::max(0.0f, status.current_a - g_config.power_base_current_a);
+    float ratio = thruster_current / last_model_current_a;
+    ratio = std::max(0.5f, std::min(2.0f, ratio));
+    model_correction += (ratio - model_correction) * 0.1f;
+  }
+}
+
+// 低電圧時は予算を縮小する (LOW_VOLTAGE_V で 100%、CUTOFF_VOLTAGE_V で 25%)
+static float effective_budget() {
+  float budget = g_config.power_budget_a;
+  const float low = g_config.power_low_voltage_v;
+  const float cutoff = g_config.power_cutoff_voltage_v;
+  if (status.voltage_v > 0.0f && low > cutoff && status.voltage_v < low) {
+    float ratio = (status.voltage_v - cutoff) / (low - cutoff);
+    budget *= std::max(0.25f, std::min(1.0f, ratio));
+  }
+  return budget;
+}
+
+void power_limiter_apply(int *target_pwm, int count) {
+  float model_total = 0.0f;
+  for (int i = 0; i < count; ++i) {
+    model_total += model_current(target_pwm[i]);
+  }
+
+  float estimated = model_total * model_correction;
+  float budget = effective_budget();
+  status.estimated_current_a = estimated;
+  status.budget_a = budget;
+  status.headroom_a = budget - estimated;
+
+  if (!g_config.power_limit_enabled || estimated <= budget || estimated <= 0.0f) {
+    status.scale = 1.0f;
+    status.limiting = false;
+    return;
+  }
+
+  // 電流 ∝ 指令率^指数 なので、指令率を s 倍すると電流は s^指数 倍になる
+  float scale = std::pow(budget / estimated, 1.0f / g_config.power_current_exponent);
+  for (int i = 0; i < count; ++i) {
+    if (target_pwm[i] > g_config.pwm_min) {
+      target_pwm[i] = g_config.pwm_min +
+                      static_cast<int>((target_pwm[i] - g_config.pwm_min) * scale);
+    }
+  }
+
+  if (!status.limiting) {
+    status.limit_events++;
+    printf("Power limit: estimated %.1f A > budget %.1f A, scaling thrust by %.2f\n",
+           estimated, budget, scale);
+  }
+  status.scale = scale;
+  status.limiting = true;
+}
+
+// 補正係数の当てはめには、スケール前の目標値ではなく実際に出力した PWM を使う
+// (スケール前の値を使うと、制限中は計測電流が常に小さく見えて補正が振動する)
+void power_limiter_note_output(const int *output_pwm, int count) {
+  float model_total = 0.0f;
+  for (int i = 0; i < count; ++i) {
+    model_total += model_current(output_pwm[i]);
+  }
+  last_model_current_a = model_total;
+}
+
+PowerLimiterStatus power_limiter_get_status() { return status; }
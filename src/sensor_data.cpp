@@ -1,6 +1,14 @@
 // --- インクルード ---
 #include "sensor_data.h" // このモジュールのヘッダーファイル
 #include "bindings.h"    // ハードウェア読み取り関数 (read_*) を使用するため
+#include "config.h"      // 使用中の設定の世代 (CFG_GEN) を送るため
+#include "attitude_estimator.h" // 姿勢推定値 (ロール/ピッチ/ヨー) を使用するため
+#include "depth_hold.h"  // 深度推定値と深度保持モードの状態を使用するため
+#include "heading_hold.h" // 方位保持の誤差を使用するため
+#include "inversion_detector.h" // 反転検出の状態を使用するため
+#include "latency_stats.h" // 周期・遅延のパーセンタイルを使用するため
+#include "metrics.h"     // カメラの撮影から送信までの遅延 (gstPipeline.cpp が公開) を使用するため
+#include "power_limiter.h" // 電力制限の状態と、制御周期で読み取った ADC 値を使用するため
 #include <stdio.h>       // 標準入出力関数 (snprintf) を使用するため
 #include <iostream>      // 標準エラー出力 (std::cerr) を使用するため
 
@@ -17,11 +25,23 @@ bool read_and_format_sensor_data(char *buffer, size_t buffer_size)
     float temperature = read_temp();  // 温度センサーの値を読み取る
     float pressure = read_pressure(); // 圧力センサーの値を読み取る
     bool leak = read_leak();          // リークセンサーの状態を読み取る (true: 漏れあり, false: 漏れなし)
-    float adc[4];                     // ADC (アナログ-デジタル変換器) の値を格納する配列
-    read_adc_all(adc, 4);             // すべてのADCチャンネルの値を読み取る (read_adc_all が効率的であると仮定)
     AxisData accel = read_accel();    // 加速度センサーの値を読み取る (X, Y, Z軸)
     AxisData gyro = read_gyro();      // ジャイロセンサーの値を読み取る (X, Y, Z軸)
     AxisData mag = read_mag();        // 磁力センサーの値を読み取る (X, Y, Z軸)
+    const AttitudeEstimate &att = attitude_get(); // メインループで更新された姿勢推定値
+    DepthHoldStatus depth = depth_hold_get_status(); // 深度推定値と深度保持モード
+    PowerLimiterStatus power = power_limiter_get_status(); // 電力制限の状態 (ADC 値は制御周期で読み取ったもの)
+    const float *adc = power.adc;
+    InversionStatus inversion = inversion_detector_get_status(); // 反転検出の状態
+    LatencySummary lat_period = latency_stats_get(LATENCY_TICK_PERIOD); // 直近の集計期間の遅延 (us)
+    LatencySummary lat_work = latency_stats_get(LATENCY_TICK_WORK);
+    LatencySummary lat_pkt = latency_stats_get(LATENCY_PACKET_TO_PWM);
+    LatencySummary lat_sensor = latency_stats_get(LATENCY_SENSOR_READ);
+    unsigned int config_generation;   // 使用中の設定ファイルの世代
+    {
+        std::lock_guard<std::mutex> lock(g_config_mutex);
+        config_generation = g_config.config_generation;
+    }
 
     // --- 文字列へのフォーマット ---
     // snprintf を使用して、取得したセンサーデータをカンマ区切りの文字列にフォーマットする
@@ -31,12 +51,47 @@ bool read_and_format_sensor_data(char *buffer, size_t buffer_size)
                            "ADC0:%.6f,ADC1:%.6f,ADC2:%.6f,ADC3:%.6f,"
                            "ACCX:%.6f,ACCY:%.6f,ACCZ:%.6f,"
                            "GYROX:%.6f,GYROY:%.6f,GYROZ:%.6f,"
-                           "MAGX:%.6f,MAGY:%.6f,MAGZ:%.6f",
+                           "MAGX:%.6f,MAGY:%.6f,MAGZ:%.6f,"
+                           "ROLL:%.3f,PITCH:%.3f,YAW:%.3f,"
+                           "QW:%.6f,QX:%.6f,QY:%.6f,QZ:%.6f,"
+                           "DEPTH:%.3f,DEPTH_HOLD:%d,DEPTH_SP:%.3f,"
+                           "HDG_ERR:%.2f,"
+                           "PWR_V:%.2f,PWR_I:%.2f,PWR_EST:%.2f,PWR_HEADROOM:%.2f,"
+                           "PWR_SCALE:%.3f,PWR_LIMIT_EVENTS:%u,"
+                           "TILT:%.1f,INVERTED:%d,INV_EVENTS:%u,INV_REJECTED:%u,"
+                           "LAT_PERIOD_P50:%.0f,LAT_PERIOD_P99:%.0f,LAT_PERIOD_P999:%.0f,LAT_PERIOD_MAX:%.0f,"
+                           "LAT_WORK_P50:%.0f,LAT_WORK_P99:%.0f,LAT_WORK_P999:%.0f,LAT_WORK_MAX:%.0f,"
+                           "LAT_PKT_PWM_P50:%.0f,LAT_PKT_PWM_P99:%.0f,LAT_PKT_PWM_P999:%.0f,LAT_PKT_PWM_MAX:%.0f,"
+                           "LAT_SENSOR_P50:%.0f,LAT_SENSOR_P99:%.0f,LAT_SENSOR_P999:%.0f,LAT_SENSOR_MAX:%.0f,"
+                           "CFG_GEN:%u",
                            temperature, pressure, leak ? 1 : 0,
                            adc[0], adc[1], adc[2], adc[3],
                            accel.x, accel.y, accel.z,
                            gyro.x, gyro.y, gyro.z,
-                           mag.x, mag.y, mag.z);
+                           mag.x, mag.y, mag.z,
+                           att.roll_deg, att.pitch_deg, att.yaw_deg,
+                           att.q[0], att.q[1], att.q[2], att.q[3],
+                           depth.depth_m, depth.active ? 1 : 0, depth.setpoint_m,
+                           heading_hold_error_deg(),
+                           power.voltage_v, power.current_a, power.estimated_current_a,
+                           power.headroom_a, power.scale, power.limit_events,
+                           inversion.tilt_deg, inversion.inverted ? 1 : 0,
+                           inversion.events, inversion.rejected,
+                           lat_period.p50_us, lat_period.p99_us, lat_period.p999_us, lat_period.max_us,
+                           lat_work.p50_us, lat_work.p99_us, lat_work.p999_us, lat_work.max_us,
+                           lat_pkt.p50_us, lat_pkt.p99_us, lat_pkt.p999_us, lat_pkt.max_us,
+                           lat_sensor.p50_us, lat_sensor.p99_us, lat_sensor.p999_us, lat_sensor.max_us,
+                           config_generation);
+
+    // カメラごとの撮影から送信までの遅延 (直近1秒の平均と最大、ms。使わないカメラは 0)
+    for (int i = 0; i < METRICS_MAX_CAMERAS && written >= 0 && (size_t)written < buffer_size; ++i)
+    {
+        int appended = snprintf(buffer + written, buffer_size - written, // NOLINT
+                                ",CAM%d_LAT:%.1f,CAM%d_LAT_MAX:%.1f",
+                                i + 1, g_metrics.camera_latency_ns[i].load(std::memory_order_relaxed) / 1e6,
+                                i + 1, g_metrics.camera_latency_max_ns[i].load(std::memory_order_relaxed) / 1e6);
+        written = (appended < 0) ? appended : written + appended;
+    }
 
     // --- エラーチェック ---
     // snprintf の戻り値を確認
@@ -0,0 +1,188 @@
+#include "thrust_curve.h"
+#include "config.h"  // グローバル設定オブジェクト g_config を使用するため
+#include <algorithm> // std::sort, std::max, std::min のため
+#include <fstream>   // std::ifstream のため
+#include <iostream>  // std::cerr のため
+#include <stdlib.h>  // strtod のため
+#include <string>
+#include <utility> // std::pair のため
+#include <vector>
+
+// 1チャンネル分の逆変換テーブル (推力を等間隔に分割し、各点の PWM を保持する)
+struct ThrustLut {
+  float thrust_lo;                   // テーブル下端の推力 (N)
+  float thrust_hi;                   // テーブル上端の推力 (N)
+  float inv_step;                    // 1 / (分割幅)
+  float pwm[THRUST_LUT_SIZE + 1];    // 各分割点の PWM (us)
+};
+
+// 全チャンネル分のテーブル (構築はリロード用のスレッド、参照は制御スレッド)
+struct ThrustCurveTables {
+  ThrustLut luts[CONFIG_THRUSTER_CHANNELS];
+};
+
+// 制御スレッドから参照するテーブル (nullptr: 無効)。thrust_curve_install でのみ差し替える
+static ThrustCurveTables *active_tables = nullptr;
+
+// CSV (pwm_us,thrust_N) を読み込む。コメント行やヘッダー行は読み飛ばす。
+static bool read_curve_csv(const std::string &path,
+                           std::vector<std::pair<float, float> > &points) {
+  std::ifstream file(path.c_str());
+  if (!file.is_open()) {
+    std::cerr << "エラー: 推力曲線ファイル '" << path << "' を開けません。"
+              << std::endl;
+    return false;
+  }
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.empty() || line[0] == '#' || line[0] == ';') {
+      continue;
+    }
+    const char *begin = line.c_str();
+    char *end = nullptr;
+    float pwm = static_cast<float>(strtod(begin, &end));
+    if (end == begin || *end != ',') {
+      continue; // ヘッダー行など数値でない行
+    }
+    const char *thrust_begin = end + 1;
+    float thrust = static_cast<float>(strtod(thrust_begin, &end));
+    if (end == thrust_begin) {
+      continue;
+    }
+    points.push_back(std::make_pair(pwm, thrust));
+  }
+  if (points.size() < 2) {
+    std::cerr << "エラー: 推力曲線ファイル '" << path
+              << "' の点数が不足しています (2点以上必要)。" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// 推力曲線から逆変換テーブルを構築する。曲線は PWM に対して単調非減少でなければならない。
+static bool build_lut(const std::string &path,
+                      std::vector<std::pair<float, float> > &points,
+                      ThrustLut &lut) {
+  std::sort(points.begin(), points.end());
+  for (size_t i = 1; i < points.size(); ++i) {
+    if (points[i].second < points[i - 1].second) {
+      std::cerr << "エラー: 推力曲線 '" << path << "' が単調ではありません ("
+                << points[i].first << "us)。" << std::endl;
+      return false;
+    }
+  }
+
+  lut.thrust_lo = points.front().second;
+  lut.thrust_hi = points.back().second;
+  if (lut.thrust_hi <= lut.thrust_lo) {
+    std::cerr << "エラー: 推力曲線 '" << path << "' の推力範囲が 0 です。"
+              << std::endl;
+    return false;
+  }
+  float step = (lut.thrust_hi - lut.thrust_lo) / THRUST_LUT_SIZE;
+  lut.inv_step = 1.0f / step;
+
+  // 各分割点の推力に対して、その推力に初めて到達する PWM を求める。
+  // 不感帯 (推力が平坦な区間) は、正の推力では不感帯の上端に飛ぶことになる。
+  size_t seg = 1;
+  for (int i = 0; i <= THRUST_LUT_SIZE; ++i) {
+    float target = lut.thrust_lo + step * i;
+    while (seg < points.size() - 1 && points[seg].second < target) {
+      seg++;
+    }
+    const std::pair<float, float> &a = points[seg - 1];
+    const std::pair<float, float> &b = points[seg];
+    if (target <= a.second) {
+      lut.pwm[i] = a.first;
+    } else if (b.second <= a.second) {
+      lut.pwm[i] = b.first;
+    } else {
+      float t = (target - a.second) / (b.second - a.second);
+      lut.pwm[i] = a.first + (b.first - a.first) * std::min(1.0f, t);
+    }
+  }
+  return true;
+}
+
+bool thrust_curve_build(const AppConfig &config, ThrustCurveTables **out) {
+  *out = nullptr;
+  if (!config.thrust_curve_enabled) {
+    return true;
+  }
+
+  ThrustCurveTables *tables = new ThrustCurveTables();
+  for (int ch = 0; ch < CONFIG_THRUSTER_CHANNELS; ++ch) {
+    // チャンネル個別の CSV が指定されていなければ共通の CSV を使う
+    const std::string &path = config.thrust_curve_channel_csv[ch].empty()
+                                  ? config.thrust_curve_csv
+                                  : config.thrust_curve_channel_csv[ch];
+    std::vector<std::pair<float, float> > points;
+    if (!read_curve_csv(path, points) || !build_lut(path, points, tables->luts[ch])) {
+      std::cerr << "警告: 推力曲線の読み込みに失敗したため、以前のテーブルを使用します。"
+                << std::endl;
+      delete tables;
+      return false;
+    }
+  }
+  std::cout << "推力曲線テーブルを構築しました。" << std::endl;
+  *out = tables;
+  return true;
+}
+
+ThrustCurveTables *thrust_curve_install(ThrustCurveTables *tables) {
+  ThrustCurveTables *previous = active_tables;
+  active_tables = tables;
+  return previous;
+}
+
+void thrust_curve_free(ThrustCurveTables *tables) { delete tables; }
+
+bool thrust_curve_load() {
+  ThrustCurveTables *tables;
+  if (!thrust_curve_build(g_config, &tables)) {
+    return false;
+  }
+  thrust_curve_free(thrust_curve_install(tables));
+  return true;
+}
+
+bool thrust_curve_enabled() {
+  return active_tables != nullptr && g_config.thrust_curve_enabled;
+}
+
+int thrust_curve_thrust_to_pwm(int channel, float thrust_n) {
+  // テーブルが無い、または範囲外のチャンネルは推力を出さない
+  if (active_tables == nullptr || channel < 0 ||
+      channel >= CONFIG_THRUSTER_CHANNELS) {
+    return g_config.pwm_min;
+  }
+  const ThrustLut &lut = active_tables->luts[channel];
+  float pos = (thrust_n - lut.thrust_lo) * lut.inv_step;
+  if (pos <= 0.0f) {
+    return static_cast<int>(lut.pwm[0]);
+  }
+  if (pos >= THRUST_LUT_SIZE) {
+    return static_cast<int>(lut.pwm[THRUST_LUT_SIZE]);
+  }
+  int idx = static_cast<int>(pos);
+  float frac = pos - idx;
+  return static_cast<int>(lut.pwm[idx] +
+                          (lut.pwm[idx + 1] - lut.pwm[idx]) * frac);
+}
+
+int thrust_curve_linearize(int channel, int linear_pwm) {
+  if (!thrust_curve_enabled() || channel < 0 ||
+      channel >= CONFIG_THRUSTER_CHANNELS) {
+    return linear_pwm;
+  }
+  const int range = g_config.pwm_boost_max - g_config.pwm_min;
+  if (range <= 0) {
+    return linear_pwm;
+  }
+  // 線形指令値を推力の割合 (0~1) とみなし、目標推力 (N) に変換する
+  float ratio = static_cast<float>(linear_pwm - g_config.pwm_min) / range;
+  ratio = std::max(0.0f, std::min(1.0f, ratio));
+  const ThrustLut &lut = active_tables->luts[channel];
+  float thrust = lut.thrust_lo + (lut.thrust_hi - lut.thrust_lo) * ratio;
+  return thrust_curve_thrust_to_pwm(channel, thrust);
+}
@@ -1,30 +1,22 @@
 #include "thruster_control.h"
 #include "config.h"  // グローバル設定オブジェクト g_config を使用するため
+#include "aux_output.h" // LED などの補助出力のため
+#include "depth_hold.h" // 深度保持モードの垂直推力を使用するため
+#include "heading_hold.h" // 方位保持のヨー補正量を使用するため
+#include "power_limiter.h" // 電流予算に応じた推力制限のため
+#include "thrust_curve.h" // 推力曲線による PWM の線形化のため
 #include <algorithm> // std::max, std::min のため
 #include <cmath>     // std::abs のため
-#include <cstdio>    // std::remove
-#include <fstream>   // std::ofstream, std::ifstream
 #include <stdio.h>   // printf のため
 
 
-// 現在のPWM値を保持する静的変数（実際に出力される値）
-static float current_pwm_values[NUM_THRUSTERS]; // 初期化は thruster_init で行う
+static_assert(NUM_THRUSTERS == CONFIG_THRUSTER_CHANNELS,
+              "NUM_THRUSTERS と CONFIG_THRUSTER_CHANNELS は一致している必要があります");
 
-// --- LED状態管理 ---
-enum class LedState {
-  OFF,
-  ON,  // 単純なON/OFF用 (LED 1)
-  ON1, // 多段調光用 (LED 2-5)
-  ON2,
-  MAX
-};
-
-// 各LEDの現在の状態を保持 (ファイルスコープ)
-static LedState current_led_state = LedState::OFF;
-static LedState current_led2_state = LedState::OFF;
-static LedState current_led3_state = LedState::OFF;
-static LedState current_led4_state = LedState::OFF;
-static LedState current_led5_state = LedState::OFF;
+// 現在のPWM値を保持する静的変数（平滑化後の線形な指令値。推力曲線が有効な場合は出力時に変換される）
+static float current_pwm_values[NUM_THRUSTERS]; // 初期化は thruster_init で行う
+// 各チャンネルに最後に出力した PWM 値 (フライトレコーダー用)
+static int output_pwm_values[NUM_PWM_CHANNELS];
 
 // --- 定数 (config.h から移動) ---
 // --- ヘルパー関数 ---
@@ -64,6 +56,9 @@ static void set_thruster_pwm(int channel, int pulse_width_us) {
 
   // 指定されたチャンネルのPWMデューティサイクルを設定
   set_pwm_channel_duty_cycle(channel, duty_cycle);
+  if (channel >= 0 && channel < NUM_PWM_CHANNELS) {
+    output_pwm_values[channel] = clamped_pwm;
+  }
 
   // デバッグ出力 (オプション)
   // printf("Ch%d: Set PWM = %d (Clamped: %d), Duty = %.4f\n", channel,
@@ -72,6 +67,28 @@ static void set_thruster_pwm(int channel, int pulse_width_us) {
 
 // --- モジュール関数 ---
 
+void thruster_write_pwm(int channel, int pulse_width_us) {
+  set_thruster_pwm(channel, pulse_width_us);
+}
+
+int thruster_get_output_pwm(int channel) {
+  if (channel < 0 || channel >= NUM_PWM_CHANNELS) {
+    return 0;
+  }
+  return output_pwm_values[channel];
+}
+
+void thruster_apply_frequency() {
+  printf("Setting PWM frequency to %.1f Hz\n", g_config.pwm_frequency);
+  set_pwm_freq_hz(g_config.pwm_frequency); // NOLINT
+  // デューティ比は周波数から計算するため、出力中のチャンネルを同じパルス幅で出し直す
+  for (int ch = 0; ch < NUM_PWM_CHANNELS; ++ch) {
+    if (output_pwm_values[ch] != 0) {
+      set_thruster_pwm(ch, output_pwm_values[ch]);
+    }
+  }
+}
+
 bool thruster_init() {
   printf("Enabling PWM\n");
   set_pwm_enable(true); // NOLINT
@@ -85,78 +102,8 @@ bool thruster_init() {
         static_cast<float>(g_config.pwm_min); // 平滑化用の現在値も初期化
   }
 
-  // LEDチャンネルを初期状態 (OFF) に設定
-  // (変数はOFFにするが、ハードウェアへの適用は後回し)
-  current_led_state = LedState::OFF;
-  current_led2_state = LedState::OFF;
-  current_led3_state = LedState::OFF;
-  current_led4_state = LedState::OFF;
-  current_led5_state = LedState::OFF;
-
-  // --- 保存されたLED状態があれば読み込む ---
-  const char *state_file = "/tmp/rov_led_state.dat";
-  std::ifstream ifs(state_file, std::ios::binary);
-  if (ifs) {
-    printf("Restoring LED state from %s...\n", state_file);
-    // 単純なバイナリ読み込み
-    LedState states[5];
-    if (ifs.read(reinterpret_cast<char *>(states), sizeof(states))) {
-      current_led_state = states[0];
-      current_led2_state = states[1];
-      current_led3_state = states[2];
-      current_led4_state = states[3];
-      current_led5_state = states[4];
-    }
-    ifs.close();
-    // 読み込み後はファイルを削除
-    std::remove(state_file);
-  }
-
-  // 決定した状態に基づいてPWM値を適用
-  // LED 1
-  int val1 = (current_led_state == LedState::ON) ? g_config.led_pwm_on
-                                                 : g_config.led_pwm_off;
-  set_thruster_pwm(g_config.led_pwm_channel, val1);
-
-  // LED 2
-  int val2 = g_config.led2_pwm_off;
-  if (current_led2_state == LedState::ON1)
-    val2 = g_config.led2_pwm_on1;
-  else if (current_led2_state == LedState::ON2)
-    val2 = g_config.led2_pwm_on2;
-  else if (current_led2_state == LedState::MAX)
-    val2 = g_config.led2_pwm_max;
-  set_thruster_pwm(g_config.led2_pwm_channel, val2);
-
-  // LED 3
-  int val3 = g_config.led3_pwm_off;
-  if (current_led3_state == LedState::ON1)
-    val3 = g_config.led3_pwm_on1;
-  else if (current_led3_state == LedState::ON2)
-    val3 = g_config.led3_pwm_on2;
-  else if (current_led3_state == LedState::MAX)
-    val3 = g_config.led3_pwm_max;
-  set_thruster_pwm(g_config.led3_pwm_channel, val3);
-
-  // LED 4
-  int val4 = g_config.led4_pwm_off;
-  if (current_led4_state == LedState::ON1)
-    val4 = g_config.led4_pwm_on1;
-  else if (current_led4_state == LedState::ON2)
-    val4 = g_config.led4_pwm_on2;
-  else if (current_led4_state == LedState::MAX)
-    val4 = g_config.led4_pwm_max;
-  set_thruster_pwm(g_config.led4_pwm_channel, val4);
-
-  // LED 5
-  int val5 = g_config.led5_pwm_off;
-  if (current_led5_state == LedState::ON1)
-    val5 = g_config.led5_pwm_on1;
-  else if (current_led5_state == LedState::ON2)
-    val5 = g_config.led5_pwm_on2;
-  else if (current_led5_state == LedState::MAX)
-    val5 = g_config.led5_pwm_max;
-  set_thruster_pwm(g_config.led5_pwm_channel, val5);
+  // LED などの補助出力 (保存された状態があれば復元)
+  aux_output_init();
 
   printf("Thrusters initialized to PWM %d. LEDs initialized.\n",
          g_config.pwm_min);
@@ -171,13 +118,8 @@ void thruster_disable() {
     current_pwm_values[i] =
         static_cast<float>(g_config.pwm_min); // 平滑化用の現在値もリセット
   }
-  // LEDチャンネルをOFFに設定
-  set_thruster_pwm(g_config.led_pwm_channel, g_config.led_pwm_off);
-  // 新しいLED2チャンネルをOFFに設定
-  set_thruster_pwm(g_config.led2_pwm_channel, g_config.led2_pwm_off);
-  set_thruster_pwm(g_config.led3_pwm_channel, g_config.led3_pwm_off);
-  set_thruster_pwm(g_config.led4_pwm_channel, g_config.led4_pwm_off);
-  set_thruster_pwm(g_config.led5_pwm_channel, g_config.led5_pwm_off);
+  // LED などの補助出力をOFFに設定
+  aux_output_disable();
   set_pwm_enable(false); // NOLINT
 }
 
@@ -296,17 +238,25 @@ static void update_horizontal_thrusters(const GamepadData &data,
     target_pwm_out[3] -= correction_pwm_yaw;
   }
 
-  // --- GyroによるYaw補正 (Rx入力時にZ軸回転しないよう補正) ---
+  // --- Yaw補正 (旋回スティックを離している間、方位を維持する) ---
   if (!lx_active) {
-    const float yaw_threshold_dps = g_config.yaw_threshold_dps;
-    const float yaw_gain = g_config.yaw_gain;
-    float yaw_rate = -gyro_data.z;
-
-    if (std::abs(yaw_rate) > yaw_threshold_dps) {
-      int yaw_pwm = static_cast<int>(yaw_rate * -yaw_gain);
-      yaw_pwm =
-          std::max(-400, std::min(400, yaw_pwm)); // 補正の最大値をクランプ
+    int yaw_pwm = 0;
+    if (heading_hold_available()) {
+      // 姿勢推定器の方位に対する方位保持制御 (heading_hold_update で計算済み)
+      yaw_pwm = heading_hold_output();
+    } else {
+      // 方位保持が無効な場合は従来のヨーレートしきい値制御を使用
+      const float yaw_threshold_dps = g_config.yaw_threshold_dps;
+      const float yaw_gain = g_config.yaw_gain;
+      float yaw_rate = -gyro_data.z;
+      if (std::abs(yaw_rate) > yaw_threshold_dps) {
+        yaw_pwm = static_cast<int>(yaw_rate * -yaw_gain);
+        yaw_pwm =
+            std::max(-400, std::min(400, yaw_pwm)); // 補正の最大値をクランプ
+      }
+    }
 
+    if (yaw_pwm != 0) {
       if (yaw_pwm < 0) {
         target_pwm_out[0] = std::min(g_config.pwm_boost_max,
                                      target_pwm_out[0] + std::abs(yaw_pwm));
@@ -345,9 +295,20 @@ void thruster_update(const GamepadData &gamepad_data,
   int target_horizontal_pwm[4];
   update_horizontal_thrusters(gamepad_data, gyro_data, target_horizontal_pwm);
 
-  // 前進/後退の目標PWM値
-  int target_forward_pwm =
-      calculate_forward_reverse_pwm(gamepad_data.rightThumbY);
+  // 前進/後退の目標PWM値 (深度保持中は制御器の出力で置き換える)
+  int target_forward_pwm = depth_hold_vertical_pwm(
+      calculate_forward_reverse_pwm(gamepad_data.rightThumbY));
+
+  // --- 電力制限: 全スラスターの推定電流が予算を超える場合は一律にスケール ---
+  int target_all_pwm[NUM_THRUSTERS] = {
+      target_horizontal_pwm[0], target_horizontal_pwm[1],
+      target_horizontal_pwm[2], target_horizontal_pwm[3],
+      target_forward_pwm,       target_forward_pwm};
+  power_limiter_apply(target_all_pwm, NUM_THRUSTERS);
+  for (int i = 0; i < 4; ++i) {
+    target_horizontal_pwm[i] = target_all_pwm[i];
+  }
+  target_forward_pwm = target_all_pwm[4];
 
   // --- 平滑化処理：現在値を目標値に向けて線形補間 ---
 
@@ -380,155 +341,30 @@ void thruster_update(const GamepadData &gamepad_data,
   // --- PWM信号をスラスターに送信 ---
   printf("--- Thruster and LED PWM (Smoothed) ---\n");
 
-  // 水平スラスター
+  // 水平スラスター (推力曲線が有効なら、線形な指令値を実際の PWM に変換して出力)
   for (int i = 0; i < 4; ++i) {
     int smoothed_pwm = static_cast<int>(current_pwm_values[i]);
-    set_thruster_pwm(i, smoothed_pwm);
+    set_thruster_pwm(i, thrust_curve_linearize(i, smoothed_pwm));
     printf("Ch%d: Target=%d, Smoothed=%d\n", i, target_horizontal_pwm[i],
            smoothed_pwm);
   }
 
   // 前進/後退スラスター
   int smoothed_forward_pwm = static_cast<int>(current_pwm_values[4]);
-  set_thruster_pwm(4, smoothed_forward_pwm);
-  set_thruster_pwm(5, smoothed_forward_pwm);
+  set_thruster_pwm(4, thrust_curve_linearize(4, smoothed_forward_pwm));
+  set_thruster_pwm(5, thrust_curve_linearize(5, smoothed_forward_pwm));
   printf("Ch4&5: Target=%d, Smoothed=%d\n", target_forward_pwm,
          smoothed_forward_pwm);
 
-  // --- LED制御 (平滑化なし) ---
-  // static int current_led_pwm = g_config.led_pwm_off; // 廃止:
-  // ファイルスコープ変数を使用
-  static bool y_button_previously_pressed = false;
-
-  bool y_button_currently_pressed = (gamepad_data.buttons & GamepadButton::Y);
-
-  if (y_button_currently_pressed && !y_button_previously_pressed) {
-    if (current_led_state == LedState::OFF) {
-      current_led_state = LedState::ON;
-    } else {
-      current_led_state = LedState::OFF;
-    }
-  }
-  y_button_previously_pressed = y_button_currently_pressed;
-
-  // 状態に基づいてPWM値を決定
-  int led_pwm_val = (current_led_state == LedState::ON) ? g_config.led_pwm_on
-                                                        : g_config.led_pwm_off;
-  set_thruster_pwm(g_config.led_pwm_channel, led_pwm_val);
-  // printf("Ch%d: LED State = %d, PWM = %d\n", g_config.led_pwm_channel,
-  // (int)current_led_state, led_pwm_val);
-
-  // --- LED 2 (十字キー上) 制御 ---
-  // static int current_led2_pwm = g_config.led2_pwm_off; // 廃止
-  static bool dpad_up_button_previously_pressed = false;
-  bool dpad_up_button_currently_pressed =
-      (gamepad_data.buttons & GamepadButton::DPadUp);
-
-  if (dpad_up_button_currently_pressed && !dpad_up_button_previously_pressed) {
-    if (current_led2_state == LedState::OFF)
-      current_led2_state = LedState::ON1;
-    else if (current_led2_state == LedState::ON1)
-      current_led2_state = LedState::ON2;
-    else if (current_led2_state == LedState::ON2)
-      current_led2_state = LedState::MAX;
-    else
-      current_led2_state = LedState::OFF;
-  }
-  dpad_up_button_previously_pressed = dpad_up_button_currently_pressed;
-
-  int led2_pwm_val = g_config.led2_pwm_off;
-  if (current_led2_state == LedState::ON1)
-    led2_pwm_val = g_config.led2_pwm_on1;
-  else if (current_led2_state == LedState::ON2)
-    led2_pwm_val = g_config.led2_pwm_on2;
-  else if (current_led2_state == LedState::MAX)
-    led2_pwm_val = g_config.led2_pwm_max;
-
-  set_thruster_pwm(g_config.led2_pwm_channel, led2_pwm_val);
-
-  // --- LED 3 (十字キー下) 制御 ---
-  static bool dpad_down_button_previously_pressed = false;
-  bool dpad_down_button_currently_pressed =
-      (gamepad_data.buttons & GamepadButton::DPadDown);
-
-  if (dpad_down_button_currently_pressed &&
-      !dpad_down_button_previously_pressed) {
-    if (current_led3_state == LedState::OFF)
-      current_led3_state = LedState::ON1;
-    else if (current_led3_state == LedState::ON1)
-      current_led3_state = LedState::ON2;
-    else if (current_led3_state == LedState::ON2)
-      current_led3_state = LedState::MAX;
-    else
-      current_led3_state = LedState::OFF;
-  }
-  dpad_down_button_previously_pressed = dpad_down_button_currently_pressed;
-
-  int led3_pwm_val = g_config.led3_pwm_off;
-  if (current_led3_state == LedState::ON1)
-    led3_pwm_val = g_config.led3_pwm_on1;
-  else if (current_led3_state == LedState::ON2)
-    led3_pwm_val = g_config.led3_pwm_on2;
-  else if (current_led3_state == LedState::MAX)
-    led3_pwm_val = g_config.led3_pwm_max;
-
-  set_thruster_pwm(g_config.led3_pwm_channel, led3_pwm_val);
-
-  // --- LED 4 (十字キー左) 制御 ---
-  static bool dpad_left_button_previously_pressed = false;
-  bool dpad_left_button_currently_pressed =
-      (gamepad_data.buttons & GamepadButton::DPadLeft);
-
-  if (dpad_left_button_currently_pressed &&
-      !dpad_left_button_previously_pressed) {
-    if (current_led4_state == LedState::OFF)
-      current_led4_state = LedState::ON1;
-    else if (current_led4_state == LedState::ON1)
-      current_led4_state = LedState::ON2;
-    else if (current_led4_state == LedState::ON2)
-      current_led4_state = LedState::MAX;
-    else
-      current_led4_state = LedState::OFF;
-  }
-  dpad_left_button_previously_pressed = dpad_left_button_currently_pressed;
-
-  int led4_pwm_val = g_config.led4_pwm_off;
-  if (current_led4_state == LedState::ON1)
-    led4_pwm_val = g_config.led4_pwm_on1;
-  else if (current_led4_state == LedState::ON2)
-    led4_pwm_val = g_config.led4_pwm_on2;
-  else if (current_led4_state == LedState::MAX)
-    led4_pwm_val = g_config.led4_pwm_max;
-
-  set_thruster_pwm(g_config.led4_pwm_channel, led4_pwm_val);
-
-  // --- LED 5 (十字キー右) 制御 ---
-  static bool dpad_right_button_previously_pressed = false;
-  bool dpad_right_button_currently_pressed =
-      (gamepad_data.buttons & GamepadButton::DPadRight);
-
-  if (dpad_right_button_currently_pressed &&
-      !dpad_right_button_previously_pressed) {
-    if (current_led5_state == LedState::OFF)
-      current_led5_state = LedState::ON1;
-    else if (current_led5_state == LedState::ON1)
-      current_led5_state = LedState::ON2;
-    else if (current_led5_state == LedState::ON2)
-      current_led5_state = LedState::MAX;
-    else
-      current_led5_state = LedState::OFF;
+  // 電力制限器の補正係数は、スケール・平滑化後に実際に出力した値に対して当てはめる
+  int output_all_pwm[NUM_THRUSTERS];
+  for (int i = 0; i < NUM_THRUSTERS; ++i) {
+    output_all_pwm[i] = static_cast<int>(current_pwm_values[i]);
   }
-  dpad_right_button_previously_pressed = dpad_right_button_currently_pressed;
+  power_limiter_note_output(output_all_pwm, NUM_THRUSTERS);
 
-  int led5_pwm_val = g_config.led5_pwm_off;
-  if (current_led5_state == LedState::ON1)
-    led5_pwm_val = g_config.led5_pwm_on1;
-  else if (current_led5_state == LedState::ON2)
-    led5_pwm_val = g_config.led5_pwm_on2;
-  else if (current_led5_state == LedState::MAX)
-    led5_pwm_val = g_config.led5_pwm_max;
-
-  set_thruster_pwm(g_config.led5_pwm_channel, led5_pwm_val);
+  // --- LED などの補助出力 (平滑化なし、値が変わった出力のみ書き込む) ---
+  aux_output_update(gamepad_data.buttons);
 
   printf("--------------------\n");
 }
@@ -536,63 +372,15 @@ void thruster_update(const GamepadData &gamepad_data,
 // すべてのスラスターを指定されたPWM値に設定し、LEDは変更しない関数
 void thruster_set_all_pwm(int pwm_value) {
   // スラスター (Ch0-5) のみ変更
+  int output_all_pwm[NUM_THRUSTERS];
   for (int i = 0; i < NUM_THRUSTERS; ++i) {
     set_thruster_pwm(i, pwm_value);
     current_pwm_values[i] =
         static_cast<float>(pwm_value); // 平滑化用の現在値も更新
+    output_all_pwm[i] = pwm_value;
   }
+  power_limiter_note_output(output_all_pwm, NUM_THRUSTERS);
   // LEDはそのまま保持
 }
 
-// 状態を文字列にするヘルパー
-static std::string led_state_to_string(LedState state) {
-  switch (state) {
-  case LedState::OFF:
-    return "pwm_off";
-  case LedState::ON:
-    return "pwm_on";
-  case LedState::ON1:
-    return "pwm_on1";
-  case LedState::ON2:
-    return "pwm_on2";
-  case LedState::MAX:
-    return "pwm_max";
-  default:
-    return "unknown";
-  }
-}
-
-// LEDの状態を文字列として取得する
-std::string get_led_state_string() {
-  // フォーマット: led_status:led=<state>,led2=<state>,...
-  // ユーザー要求: "pwm_off,pwm_on1,pwm_on2,pwm_max" を送る
-  // 複数のLEDがあるので、それぞれの状態を送る必要があると思われます。
-  // ここではカンマ区切りで各LEDの状態を送ります。
-
-  char buffer[256];
-  snprintf(buffer, sizeof(buffer),
-           "led_status:led=%s,led2=%s,led3=%s,led4=%s,led5=%s",
-           led_state_to_string(current_led_state).c_str(),
-           led_state_to_string(current_led2_state).c_str(),
-           led_state_to_string(current_led3_state).c_str(),
-           led_state_to_string(current_led4_state).c_str(),
-           led_state_to_string(current_led5_state).c_str());
-  return std::string(buffer);
-}
-
-// LEDの状態をファイルに保存する
-void thruster_save_led_state_to_file() {
-  const char *state_file = "/tmp/rov_led_state.dat";
-  std::ofstream ofs(state_file, std::ios::binary | std::ios::trunc);
-  if (ofs) {
-    LedState states[5] = {current_led_state, current_led2_state,
-                          current_led3_state, current_led4_state,
-                          current_led5_state};
-    ofs.write(reinterpret_cast<const char *>(states), sizeof(states));
-    printf("LED State saved to %s\n", state_file);
-  } else {
-    perror("Failed to save LED state");
-  }
-}
-
 // 平滑化係数を動的に変更する関数（オプション）
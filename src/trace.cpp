@@ -0,0 +1,228 @@
+#include "trace.h"
+#include "config.h"      // グローバル設定オブジェクト g_config を使用するため
+#include <algorithm>     // std::max のため
+#include <cerrno>        // errno のため
+#include <chrono>        // std::chrono::milliseconds のため
+#include <csignal>       // sigaction のため
+#include <cstring>       // strerror のため
+#include <iostream>      // std::cout, std::cerr のため
+#include <mutex>         // std::mutex のため
+#include <stdio.h>       // FILE, fopen, fprintf のため
+#include <sys/stat.h>    // mkdir のため
+#include <sys/syscall.h> // SYS_gettid のため
+#include <thread>        // std::thread のため
+#include <unistd.h>      // syscall のため
+#include <vector>        // std::vector のため
+
+std::atomic<bool> g_trace_enabled(false);
+
+// 1区間分の記録
+struct TraceEvent {
+  const char *name;
+  int64_t start_ns;
+  int64_t end_ns;
+};
+
+// リングバッファの1要素。所有スレッドの書き込み中に書き出し用スレッドが読むため、
+// 要素ごとのシーケンスロックで保護する。seq は書き込み中が奇数、n 番目 (0 始まり) の
+// イベントを書き終えたら 2n+2 になる (0 は未使用)。各値は relaxed のアトミック変数で持つ
+struct TraceSlot {
+  std::atomic<uint64_t> seq;
+  std::atomic<const char *> name;
+  std::atomic<int64_t> start_ns;
+  std::atomic<int64_t> end_ns;
+};
+
+// スレッドごとのリングバッファ。書き込みは所有スレッドのみ、読み出しは書き出し用スレッド
+// head は書き込んだイベントの総数 (単調増加)。添字は容量で割った余り
+struct TraceRing {
+  std::string thread_name;
+  long tid;
+  TraceSlot *slots; // capacity 個 (プロセス終了まで保持)
+  uint64_t capacity;
+  std::atomic<uint64_t> head;
+};
+
+static thread_local TraceRing *t_ring = nullptr;
+static std::mutex rings_mutex; // rings の追加と書き出し時の走査を保護する
+static std::vector<TraceRing *> rings; // 登録されたスレッドのバッファ (プロセス終了まで保持)
+
+static std::atomic<bool> dump_requested(false);
+static std::atomic<bool> writer_running(false);
+static std::thread writer_thread;
+
+static void handle_sigusr1(int) { trace_request_dump(); }
+
+// 記録を Chrome trace JSON (Trace Event Format) として書き出す
+static void write_trace_file() {
+  std::string dir;
+  {
+    std::lock_guard<std::mutex> lock(g_config_mutex);
+    dir = g_config.trace_directory;
+  }
+  if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+    std::cerr << "トレース: ディレクトリ '" << dir
+              << "' を作成できません: " << strerror(errno) << std::endl;
+    return;
+  }
+  char name[64];
+  time_t now = time(nullptr);
+  struct tm local_tm;
+  localtime_r(&now, &local_tm);
+  strftime(name, sizeof(name), "trace_%Y%m%d_%H%M%S.json", &local_tm);
+  std::string path = dir + "/" + name;
+  FILE *out = fopen(path.c_str(), "w");
+  if (!out) {
+    std::cerr << "トレース: '" << path << "' を開けません: " << strerror(errno)
+              << std::endl;
+    return;
+  }
+
+  unsigned long written = 0;
+  unsigned long torn = 0; // 読み出し中に上書きされて捨てた区間
+  fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+  {
+    std::lock_guard<std::mutex> lock(rings_mutex);
+    bool first = true;
+    std::vector<TraceEvent> snapshot;
+    for (size_t r = 0; r < rings.size(); ++r) {
+      TraceRing &ring = *rings[r];
+      fprintf(out,
+              "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%ld,"
+              "\"args\":{\"name\":\"%s\"}}",
+              first ? "" : ",\n", ring.tid, ring.thread_name.c_str());
+      first = false;
+
+      // 書き出し中も所有スレッドは書き込みを続けるため、先に範囲を決めてコピーする。
+      // 読んでいる間に書き換えられた要素 (シーケンスが期待値と異なる) は捨てる
+      uint64_t capacity = ring.capacity;
+      uint64_t head = ring.head.load(std::memory_order_acquire);
+      uint64_t count = std::min(head, capacity);
+      snapshot.clear();
+      for (uint64_t i = head - count; i < head; ++i) {
+        TraceSlot &slot = ring.slots[i % capacity];
+        const uint64_t expected = 2 * i + 2;
+        if (slot.seq.load(std::memory_order_acquire) != expected) {
+          torn++;
+          continue;
+        }
+        TraceEvent e;
+        e.name = slot.name.load(std::memory_order_relaxed);
+        e.start_ns = slot.start_ns.load(std::memory_order_relaxed);
+        e.end_ns = slot.end_ns.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.seq.load(std::memory_order_relaxed) != expected) {
+          torn++;
+          continue;
+        }
+        snapshot.push_back(e);
+      }
+      for (size_t i = 0; i < snapshot.size(); ++i) {
+        const TraceEvent &e = snapshot[i];
+        if (e.name == nullptr || e.end_ns < e.start_ns) {
+          continue;
+        }
+        fprintf(out,
+                ",\n{\"ph\":\"X\",\"cat\":\"loop\",\"name\":\"%s\",\"pid\":1,"
+                "\"tid\":%ld,\"ts\":%.3f,\"dur\":%.3f}",
+                e.name, ring.tid, e.start_ns / 1000.0,
+                (e.end_ns - e.start_ns) / 1000.0);
+        written++;
+      }
+    }
+  }
+  fprintf(out, "\n]}\n");
+  fclose(out);
+  std::cout << "トレース: " << written << " 区間を " << path
+            << " に書き出しました";
+  if (torn > 0) {
+    std::cout << " (書き出し中に上書きされた " << torn << " 区間を除く)";
+  }
+  std::cout << "。" << std::endl;
+}
+
+static void writer_loop() {
+  while (writer_running.load()) {
+    if (dump_requested.exchange(false)) {
+      write_trace_file();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+}
+
+// --- モジュール関数 ---
+
+void trace_start() {
+  if (writer_running.load()) {
+    return;
+  }
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = handle_sigusr1;
+  sigemptyset(&sa.sa_mask);
+  sa.sa_flags = SA_RESTART;
+  if (sigaction(SIGUSR1, &sa, nullptr) != 0) {
+    std::cerr << "トレース: SIGUSR1 のハンドラを設定できません: "
+              << strerror(errno) << std::endl;
+  }
+  writer_running.store(true);
+  writer_thread = std::thread(writer_loop);
+}
+
+void trace_stop() {
+  if (!writer_running.load()) {
+    return;
+  }
+  writer_running.store(false);
+  if (writer_thread.joinable()) {
+    writer_thread.join();
+  }
+}
+
+void trace_set_enabled(bool enabled) {
+  if (g_trace_enabled.exchange(enabled) != enabled) {
+    std::cout << "トレース: " << (enabled ? "有効" : "無効") << "にしました。"
+              << std::endl;
+  }
+}
+
+void trace_register_thread(const std::string &name) {
+  if (t_ring != nullptr) {
+    return;
+  }
+  TraceRing *ring = new TraceRing();
+  ring->thread_name = name;
+  ring->tid = syscall(SYS_gettid);
+  int capacity;
+  {
+    std::lock_guard<std::mutex> lock(g_config_mutex);
+    capacity = g_config.trace_buffer_events;
+  }
+  ring->capacity = static_cast<uint64_t>(std::max(256, capacity));
+  ring->slots = new TraceSlot[ring->capacity](); // 値初期化で seq = 0 (未使用)
+  ring->head.store(0);
+  {
+    std::lock_guard<std::mutex> lock(rings_mutex);
+    rings.push_back(ring);
+  }
+  t_ring = ring;
+}
+
+void trace_record(const char *name, int64_t start_ns, int64_t end_ns) {
+  TraceRing *ring = t_ring;
+  if (ring == nullptr) {
+    return;
+  }
+  uint64_t head = ring->head.load(std::memory_order_relaxed);
+  TraceSlot &slot = ring->slots[head % ring->capacity];
+  // 書き込み中は奇数 (書き出し用スレッドはこの要素を捨てる)
+  slot.seq.store(2 * head + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.name.store(name, std::memory_order_relaxed);
+  slot.start_ns.store(start_ns, std::memory_order_relaxed);
+  slot.end_ns.store(end_ns, std::memory_order_relaxed);
+  slot.seq.store(2 * head + 2, std::memory_order_release);
+  ring->head.store(head + 1, std::memory_order_release);
+}
+
+void trace_request_dump() { dump_requested.store(true); }
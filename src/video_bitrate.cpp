@@ -0,0 +1,84 @@
+#include "video_bitrate.h"
+#include "metrics.h" // 送信エラー数の参照と、目標・混雑の計数のため
+#include <atomic>
+
+// 混雑したときは目標をこの割合に下げ (AIMD の乗算的減少)、
+// 混雑の無い区間が RECOVER_INTERVALS 回続いてから、1区間ごとに上限の STEP_PERCENT % ずつ戻す
+static const int DECREASE_PERCENT = 70;
+static const int RECOVER_INTERVALS = 3;
+static const int STEP_PERCENT = 5;
+
+// 制御スレッドが書き込み、映像側のスレッドが区間ごとに読み出してリセットする
+static int64_t last_arrival_ns = 0; // 制御スレッドのみ参照
+static std::atomic<int64_t> window_max_gap_ns(0);
+static std::atomic<uint32_t> window_packets(0);
+
+// 映像側のスレッドのみ参照
+static int target_kbps = 0; // 0: 未初期化 (最初は上限から始める)
+static int healthy_intervals = 0;
+static uint64_t last_send_errors = 0;
+
+void video_bitrate_note_control_packet(int64_t arrival_ns) {
+  if (last_arrival_ns != 0) {
+    int64_t gap_ns = arrival_ns - last_arrival_ns;
+    // 書き込むのは制御スレッドだけなので、比較と書き込みは分けてよい
+    // (読み出し側のリセットと重なっても、失うのは1区間の1サンプルだけ)
+    if (gap_ns > window_max_gap_ns.load(std::memory_order_relaxed)) {
+      window_max_gap_ns.store(gap_ns, std::memory_order_relaxed);
+    }
+  }
+  last_arrival_ns = arrival_ns;
+  window_packets.fetch_add(1, std::memory_order_relaxed);
+}
+
+void video_bitrate_note_connection_lost() {
+  // 途切れた後の最初のパケットまでの間隔は回線の混雑ではないので、間隔の基準を捨てる
+  last_arrival_ns = 0;
+}
+
+int video_bitrate_update(const VideoBitrateSettings &settings) {
+  // 区間を締める
+  int64_t max_gap_ns = window_max_gap_ns.exchange(0, std::memory_order_relaxed);
+  uint32_t packets = window_packets.exchange(0, std::memory_order_relaxed);
+  uint64_t send_errors = g_metrics.send_errors.load(std::memory_order_relaxed);
+  bool new_send_errors = send_errors != last_send_errors;
+  last_send_errors = send_errors;
+  g_metrics.control_gap_max_ns.store(max_gap_ns, std::memory_order_relaxed);
+
+  if (!settings.adaptive) {
+    target_kbps = 0;
+    healthy_intervals = 0;
+    g_metrics.video_bitrate_kbps.store(0, std::memory_order_relaxed);
+    return 0;
+  }
+  if (target_kbps == 0 || target_kbps > settings.max_kbps) {
+    target_kbps = settings.max_kbps;
+  }
+  if (target_kbps < settings.min_kbps) {
+    target_kbps = settings.min_kbps;
+  }
+
+  // 操縦パケットが届いていない区間 (地上局が送っていない) では判断しない。
+  // 送信エラー (送信キューのあふれなど) はパケットが届いていなくても混雑とみなす
+  bool late_control = packets > 0 &&
+                      max_gap_ns > static_cast<int64_t>(settings.control_gap_ms) * 1000000LL;
+  if (late_control || new_send_errors) {
+    healthy_intervals = 0;
+    int reduced_kbps = target_kbps * DECREASE_PERCENT / 100;
+    if (reduced_kbps < settings.min_kbps) {
+      reduced_kbps = settings.min_kbps;
+    }
+    if (reduced_kbps != target_kbps) {
+      target_kbps = reduced_kbps;
+      metrics_increment(g_metrics.video_bitrate_decreases);
+    }
+  } else if (packets > 0 && ++healthy_intervals > RECOVER_INTERVALS) {
+    int step_kbps = settings.max_kbps * STEP_PERCENT / 100;
+    target_kbps += step_kbps > 0 ? step_kbps : 1;
+    if (target_kbps > settings.max_kbps) {
+      target_kbps = settings.max_kbps;
+    }
+  }
+  g_metrics.video_bitrate_kbps.store(target_kbps, std::memory_order_relaxed);
+  return target_kbps;
+}
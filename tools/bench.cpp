@@ -0,0 +1,505 @@
+// 制御ループのホットパスのマイクロベンチマーク。
+// tools/sim_hardware.cpp (ハードウェアのシミュレーション層) をリンクし、実機なしで
+// Raspberry Pi と x86 の両方で同じ計測を行う。
+//
+// 使い方: bench [--out <JSONファイル>] [--min-time <秒>] [名前の一部...]
+//   結果の表は標準エラー出力に、機械可読な結果 (JSON) は --out のファイルに書き出す。
+//   config.ini と推力曲線の CSV を読み込むため、リポジトリのルートで実行すること。
+//   ns/op は1回あたりの実行時間、allocs/op と bytes/op は1回あたりの operator new の回数とバイト数。
+//   attitude/update を計測した場合は推定の精度も確かめ、許容を超えれば終了コード1を返す。
+#include "attitude_estimator.h" // attitude_update
+#include "aux_output.h"       // aux_output_state_string
+#include "config.h"           // loadConfig, g_config
+#include "config_reloader.h"  // ConfigReloader
+#include "control_loop.h"     // control_init, control_step
+#include "gamepad.h"          // parseGamepadData
+#include "network.h"          // network_init, network_receive
+#include "sensor_data.h"      // read_and_format_sensor_data
+#include "sim_hardware.h"     // ハードウェアのシミュレーション層
+#include "thrust_curve.h"     // thrust_curve_load
+#include "thruster_control.h" // thruster_update
+
+#include <algorithm>     // std::max のため
+#include <arpa/inet.h>   // inet_pton のため
+#include <cmath>         // 合成した IMU の記録の計算のため
+#include <new>           // operator new / delete の置き換えのため
+#include <stdio.h>       // fprintf, fopen のため
+#include <stdlib.h>      // malloc, free, atof のため
+#include <string.h>      // strcmp, strstr, memcpy のため
+#include <sys/socket.h>  // socket, sendto, getsockname のため
+#include <sys/utsname.h> // uname のため (計測環境の記録)
+#include <time.h>        // clock_gettime のため
+#include <unistd.h>      // dup, dup2, close のため
+#include <string>
+#include <vector>
+
+// --- メモリ確保の計数 (operator new を置き換える。ベンチマークは単一スレッドで実行する) ---
+static unsigned long long alloc_count = 0;
+static unsigned long long alloc_bytes = 0;
+
+void *operator new(size_t size) {
+  alloc_count++;
+  alloc_bytes += size;
+  void *p = malloc(size == 0 ? 1 : size);
+  if (!p) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+
+static int64_t now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+// 計測区間の時間とメモリ確保を積算する。準備処理は pause() ~ resume() で計測から除く
+class BenchTimer {
+public:
+  BenchTimer() : m_elapsed_ns(0), m_allocs(0), m_bytes(0), m_running(false) {}
+  void resume() {
+    m_start_allocs = alloc_count;
+    m_start_bytes = alloc_bytes;
+    m_running = true;
+    m_start_ns = now_ns();
+  }
+  void pause() {
+    int64_t end = now_ns();
+    if (!m_running) {
+      return;
+    }
+    m_elapsed_ns += end - m_start_ns;
+    m_allocs += alloc_count - m_start_allocs;
+    m_bytes += alloc_bytes - m_start_bytes;
+    m_running = false;
+  }
+  int64_t elapsed_ns() const { return m_elapsed_ns; }
+  unsigned long long allocs() const { return m_allocs; }
+  unsigned long long bytes() const { return m_bytes; }
+
+private:
+  int64_t m_start_ns;
+  int64_t m_elapsed_ns;
+  unsigned long long m_start_allocs, m_start_bytes;
+  unsigned long long m_allocs, m_bytes;
+  bool m_running;
+};
+
+// 最適化で計算が消されないよう、結果をここに書き込む
+static volatile int sink;
+
+// --- ベンチマーク本体 (iters 回実行する。計測は呼び出し側で resume 済み) ---
+
+static const char *GAMEPAD_PACKET = "-12000,31000,4500,-32768,512,0,32768";
+
+static void bench_parse_gamepad(BenchTimer &, unsigned long iters) {
+  const std::string packet(GAMEPAD_PACKET);
+  for (unsigned long i = 0; i < iters; ++i) {
+    sink = parseGamepadData(packet).leftThumbY;
+  }
+}
+
+// スティックを動かし続け、平滑化・推力曲線・補助出力の処理を毎回通す
+static void bench_thruster_update(BenchTimer &, unsigned long iters) {
+  GamepadData gamepad;
+  AxisData gyro = {0.5f, -0.2f, 3.0f};
+  for (unsigned long i = 0; i < iters; ++i) {
+    gamepad.leftThumbX = static_cast<int>(i * 977 % 65536) - 32768;
+    gamepad.leftThumbY = static_cast<int>(i * 331 % 65536) - 32768;
+    gamepad.rightThumbX = static_cast<int>(i * 113 % 65536) - 32768;
+    gamepad.RT = static_cast<int>(i % 1024);
+    thruster_update(gamepad, gyro);
+  }
+  sink = thruster_get_output_pwm(0);
+}
+
+// 合成した IMU の記録 (ヨーを回しながらロールを揺らす 100 Hz の20秒分)。
+// 加速度と磁気は地球座標の重力・磁場を機体座標に回したもの、ジャイロは read_gyro() の単位に戻した角速度。
+// ヨーは2回転、ロールは4往復で元に戻るので、繰り返し流しても姿勢が飛ばない
+struct ImuSample {
+  AxisData accel;
+  AxisData gyro;
+  AxisData mag;
+  float roll_deg; // この時点の真の姿勢 (精度の確認用)
+  float yaw_deg;  // -180 ~ 180
+};
+
+static std::vector<ImuSample> make_rotating_imu_trace() {
+  const int samples = 2000;
+  const float dt = 0.01f;
+  const float two_pi = 6.2831853f;
+  const float yaw_rate = 2.0f * two_pi / (samples * dt); // rad/s
+  const float roll_amp = 0.35f;                          // rad
+  const float roll_freq = 4.0f * two_pi / (samples * dt); // rad/s
+  const float mag_x = 0.22f, mag_z = 0.42f; // 地球座標の磁場 (水平, 鉛直)
+  const float scale = g_config.ahrs_gyro_scale > 0.0f ? g_config.ahrs_gyro_scale : 1.0f;
+  std::vector<ImuSample> trace(samples);
+  for (int i = 0; i < samples; ++i) {
+    float t = i * dt;
+    float yaw = yaw_rate * t;
+    float roll = roll_amp * std::sin(roll_freq * t);
+    float roll_rate = roll_amp * roll_freq * std::cos(roll_freq * t);
+    float cy = std::cos(yaw), sy = std::sin(yaw);
+    float cr = std::cos(roll), sr = std::sin(roll);
+    // 機体の姿勢 R = Rz(yaw) Rx(roll)。地球座標のベクトル v の機体座標は R^T v
+    ImuSample &s = trace[i];
+    s.accel.x = 0.0f;
+    s.accel.y = sr;
+    s.accel.z = cr;
+    float hx = cy * mag_x, hy = -sy * mag_x; // Rz(yaw)^T (mag_x, 0, 0)
+    s.mag.x = hx;
+    s.mag.y = cr * hy + sr * mag_z;
+    s.mag.z = -sr * hy + cr * mag_z;
+    s.gyro.x = roll_rate / scale;
+    s.gyro.y = sr * yaw_rate / scale;
+    s.gyro.z = cr * yaw_rate / scale;
+    s.roll_deg = roll * 57.29578f;
+    s.yaw_deg = std::remainder(yaw, two_pi) * 57.29578f;
+  }
+  return trace;
+}
+
+// 姿勢推定1回分 (磁気を使う MARG の経路)。記録を繰り返し流し、収束と追従の計算を毎回通す
+static void bench_attitude_update(BenchTimer &timer, unsigned long iters) {
+  timer.pause();
+  const std::vector<ImuSample> trace = make_rotating_imu_trace();
+  bool saved_use_mag = g_config.ahrs_use_mag;
+  g_config.ahrs_use_mag = true;
+  attitude_init();
+  timer.resume();
+  size_t index = 0;
+  for (unsigned long i = 0; i < iters; ++i) {
+    const ImuSample &s = trace[index];
+    attitude_update(s.accel, s.gyro, s.mag, 0.01f);
+    index = index + 1 < trace.size() ? index + 1 : 0;
+  }
+  timer.pause();
+  sink = static_cast<int>(attitude_get().yaw_deg);
+  g_config.ahrs_use_mag = saved_use_mag;
+  attitude_init();
+  timer.resume();
+}
+
+// 姿勢推定の精度の確認 (速さだけを計測して、推定が合成した姿勢に追従しない変更を見逃さないため)。
+// 記録を1周流して収束させた後、次の1周の間の真の姿勢との差の最大値を求める
+static const float ATTITUDE_MAX_ERROR_DEG = 0.5f;
+
+static float angle_error_deg(float estimate, float truth) {
+  return std::fabs(std::remainder(estimate - truth, 360.0f));
+}
+
+static bool check_attitude_accuracy() {
+  const std::vector<ImuSample> trace = make_rotating_imu_trace();
+  bool saved_use_mag = g_config.ahrs_use_mag;
+  g_config.ahrs_use_mag = true;
+  attitude_init();
+  float max_roll = 0.0f, max_pitch = 0.0f, max_yaw = 0.0f;
+  for (int pass = 0; pass < 2; ++pass) {
+    for (size_t i = 0; i < trace.size(); ++i) {
+      const ImuSample &s = trace[i];
+      attitude_update(s.accel, s.gyro, s.mag, 0.01f);
+      if (pass == 0) {
+        continue;
+      }
+      const AttitudeEstimate &att = attitude_get();
+      max_roll = std::max(max_roll, angle_error_deg(att.roll_deg, s.roll_deg));
+      max_pitch = std::max(max_pitch, angle_error_deg(att.pitch_deg, 0.0f));
+      max_yaw = std::max(max_yaw, angle_error_deg(att.yaw_deg, s.yaw_deg));
+    }
+  }
+  g_config.ahrs_use_mag = saved_use_mag;
+  attitude_init();
+  bool ok = max_roll <= ATTITUDE_MAX_ERROR_DEG && max_pitch <= ATTITUDE_MAX_ERROR_DEG &&
+            max_yaw <= ATTITUDE_MAX_ERROR_DEG;
+  fprintf(stderr, "%s attitude/update の精度: 最大誤差 ロール %.2f° ピッチ %.2f° ヨー %.2f° (許容 %.1f°)\n",
+          ok ? "OK  " : "FAIL", max_roll, max_pitch, max_yaw, ATTITUDE_MAX_ERROR_DEG);
+  return ok;
+}
+
+// 制御周期1回分 (受信データのパースからスラスター出力まで)
+static void bench_control_step(BenchTimer &, unsigned long iters) {
+  const std::string packet(GAMEPAD_PACKET);
+  ControlInputs inputs;
+  inputs.packet = packet.c_str();
+  inputs.packet_len = static_cast<int>(packet.size());
+  inputs.gyro = g_sim_hardware.gyro;
+  inputs.accel = g_sim_hardware.accel;
+  inputs.mag = g_sim_hardware.mag;
+  inputs.pressure = g_sim_hardware.pressure;
+  memcpy(inputs.adc, g_sim_hardware.adc, sizeof(inputs.adc));
+  inputs.adc_valid = true;
+  inputs.dt_s = 0.01f;
+  inputs.control_enabled = true;
+  for (unsigned long i = 0; i < iters; ++i) {
+    sink = control_step(inputs).restart_requested;
+  }
+}
+
+static void bench_format_sensor_data(BenchTimer &, unsigned long iters) {
+  char buffer[SENSOR_BUFFER_SIZE];
+  for (unsigned long i = 0; i < iters; ++i) {
+    read_and_format_sensor_data(buffer, sizeof(buffer));
+  }
+  sink = buffer[0];
+}
+
+static void bench_aux_state_string(BenchTimer &, unsigned long iters) {
+  for (unsigned long i = 0; i < iters; ++i) {
+    sink = static_cast<int>(aux_output_state_string().size());
+  }
+}
+
+static void bench_load_config(BenchTimer &, unsigned long iters) {
+  for (unsigned long i = 0; i < iters; ++i) {
+    sink = loadConfig("config.ini");
+  }
+}
+
+// リロード用スレッドが読み込んだ設定を制御スレッドで適用する部分のみ (読み込みは計測しない)
+static void bench_config_apply(BenchTimer &timer, unsigned long iters) {
+  ConfigReloader reloader("config.ini");
+  for (unsigned long i = 0; i < iters; ++i) {
+    timer.pause();
+    reloader.reload();
+    timer.resume();
+    sink = reloader.apply_pending();
+  }
+}
+
+// config.ini で無効になっていても CSV の読み込みとテーブル構築を計測する
+static void bench_thrust_curve_load(BenchTimer &, unsigned long iters) {
+  bool saved_enabled = g_config.thrust_curve_enabled;
+  g_config.thrust_curve_enabled = true;
+  for (unsigned long i = 0; i < iters; ++i) {
+    sink = thrust_curve_load();
+  }
+  g_config.thrust_curve_enabled = saved_enabled;
+  thrust_curve_load();
+}
+
+// --- network_receive (ループバックの UDP で packets 個のパケットを溜めてから読み切る) ---
+static NetworkContext bench_net;
+static int bench_sender = -1;
+static struct sockaddr_in bench_net_addr;
+
+static bool bench_network_open() {
+  int saved_port = g_config.network_recv_port;
+  g_config.network_recv_port = 0; // 空いているポートを OS に選ばせる
+  bool ok = network_init(&bench_net);
+  g_config.network_recv_port = saved_port;
+  if (!ok) {
+    return false;
+  }
+  socklen_t len = sizeof(bench_net_addr);
+  getsockname(bench_net.recv_socket, (struct sockaddr *)&bench_net_addr, &len);
+  inet_pton(AF_INET, "127.0.0.1", &bench_net_addr.sin_addr);
+  bench_sender = socket(AF_INET, SOCK_DGRAM, 0);
+  return bench_sender >= 0;
+}
+
+static void bench_network_receive(BenchTimer &timer, unsigned long iters,
+                                  int packets) {
+  char buffer[NET_BUFFER_SIZE];
+  size_t packet_len = strlen(GAMEPAD_PACKET);
+  for (unsigned long i = 0; i < iters; ++i) {
+    timer.pause();
+    for (int p = 0; p < packets; ++p) {
+      sendto(bench_sender, GAMEPAD_PACKET, packet_len, 0,
+             (const struct sockaddr *)&bench_net_addr, sizeof(bench_net_addr));
+    }
+    timer.resume();
+    sink = static_cast<int>(network_receive(&bench_net, buffer, sizeof(buffer)));
+  }
+}
+
+static void bench_network_receive_empty(BenchTimer &timer, unsigned long iters) {
+  bench_network_receive(timer, iters, 0);
+}
+
+static void bench_network_receive_1(BenchTimer &timer, unsigned long iters) {
+  bench_network_receive(timer, iters, 1);
+}
+
+static void bench_network_receive_8(BenchTimer &timer, unsigned long iters) {
+  bench_network_receive(timer, iters, 8);
+}
+
+// --- ベンチマークの一覧 ---
+struct Benchmark {
+  const char *name;
+  void (*run)(BenchTimer &timer, unsigned long iters);
+  bool needs_network;
+};
+
+static const Benchmark BENCHMARKS[] = {
+    {"gamepad/parse", bench_parse_gamepad, false},
+    {"thruster/update", bench_thruster_update, false},
+    {"attitude/update", bench_attitude_update, false},
+    {"control/step", bench_control_step, false},
+    {"sensor/format", bench_format_sensor_data, false},
+    {"aux_output/state_string", bench_aux_state_string, false},
+    {"network/receive_empty", bench_network_receive_empty, true},
+    {"network/receive_drain_1", bench_network_receive_1, true},
+    {"network/receive_drain_8", bench_network_receive_8, true},
+    {"config/load_ini", bench_load_config, false},
+    {"config/apply_snapshot", bench_config_apply, false},
+    {"config/thrust_curve_load", bench_thrust_curve_load, false},
+};
+
+struct BenchResult {
+  std::string name;
+  unsigned long iterations;
+  double ns_per_op;
+  double allocs_per_op;
+  double bytes_per_op;
+};
+
+// 計測時間が min_time_s を超えるまで回数を増やして実行する
+static BenchResult run_benchmark(const Benchmark &bench, double min_time_s) {
+  const int64_t min_time_ns = static_cast<int64_t>(min_time_s * 1e9);
+  unsigned long iters = 1;
+  while (true) {
+    BenchTimer timer;
+    timer.resume();
+    bench.run(timer, iters);
+    timer.pause();
+    int64_t elapsed = timer.elapsed_ns() > 0 ? timer.elapsed_ns() : 1;
+    if (elapsed >= min_time_ns || iters >= 1000000000UL) {
+      BenchResult result;
+      result.name = bench.name;
+      result.iterations = iters;
+      result.ns_per_op = static_cast<double>(elapsed) / iters;
+      result.allocs_per_op = static_cast<double>(timer.allocs()) / iters;
+      result.bytes_per_op = static_cast<double>(timer.bytes()) / iters;
+      return result;
+    }
+    // 残り時間を予測して回数を決める (1回で最大100倍まで)
+    double scale = 1.2 * min_time_ns / elapsed;
+    scale = scale < 2.0 ? 2.0 : (scale > 100.0 ? 100.0 : scale);
+    iters = static_cast<unsigned long>(iters * scale);
+  }
+}
+
+static bool matches_filter(const char *name, const std::vector<const char *> &filters) {
+  if (filters.empty()) {
+    return true;
+  }
+  for (size_t i = 0; i < filters.size(); ++i) {
+    if (strstr(name, filters[i])) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool write_json(const char *path, const std::vector<BenchResult> &results,
+                       double min_time_s) {
+  FILE *out = fopen(path, "w");
+  if (!out) {
+    perror(path);
+    return false;
+  }
+  struct utsname host;
+  uname(&host);
+  time_t now = time(nullptr);
+  char timestamp[32];
+  strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+#ifdef __OPTIMIZE__
+  const bool optimized = true;
+#else
+  const bool optimized = false;
+#endif
+  fprintf(out, "{\n");
+  fprintf(out, "  \"timestamp\": \"%s\",\n", timestamp);
+  fprintf(out, "  \"host\": \"%s\",\n", host.nodename);
+  fprintf(out, "  \"machine\": \"%s\",\n", host.machine);
+  fprintf(out, "  \"compiler\": \"%s\",\n", __VERSION__);
+  fprintf(out, "  \"optimized\": %s,\n", optimized ? "true" : "false");
+  fprintf(out, "  \"min_time_s\": %.3f,\n", min_time_s);
+  fprintf(out, "  \"benchmarks\": [\n");
+  for (size_t i = 0; i < results.size(); ++i) {
+    const BenchResult &r = results[i];
+    fprintf(out,
+            "    {\"name\": \"%s\", \"iterations\": %lu, \"ns_per_op\": %.1f, "
+            "\"allocs_per_op\": %.2f, \"bytes_per_op\": %.1f}%s\n",
+            r.name.c_str(), r.iterations, r.ns_per_op, r.allocs_per_op,
+            r.bytes_per_op, i + 1 < results.size() ? "," : "");
+  }
+  fprintf(out, "  ]\n}\n");
+  fclose(out);
+  return true;
+}
+
+int main(int argc, char **argv) {
+  const char *out_path = nullptr;
+  double min_time_s = 0.5;
+  std::vector<const char *> filters;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+      out_path = argv[++i];
+    } else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+      min_time_s = atof(argv[++i]);
+    } else {
+      filters.push_back(argv[i]);
+    }
+  }
+
+  // 制御コードのデバッグ出力 (printf) は実機と同じく実行するが、表示はしない
+  fflush(stdout);
+  int saved_stdout = dup(STDOUT_FILENO);
+  if (!freopen("/dev/null", "w", stdout)) {
+    perror("freopen");
+  }
+
+  // main.cpp の起動処理と同じ状態を作る
+  if (!loadConfig("config.ini")) {
+    fprintf(stderr, "config.ini を読み込めません。リポジトリのルートで実行してください。\n");
+    return 1;
+  }
+  thrust_curve_load();
+  thruster_init();
+  control_init();
+  g_sim_hardware.pressure = 1013.25f;
+  g_sim_hardware.adc[0] = 1.2f;
+  g_sim_hardware.adc[1] = 0.4f;
+  g_config.client_host = "127.0.0.1";
+  bool network_ok = bench_network_open();
+  if (!network_ok) {
+    fprintf(stderr, "警告: ループバックのソケットを作成できないため network/* を省略します。\n");
+  }
+
+  std::vector<BenchResult> results;
+  fprintf(stderr, "%-28s %12s %12s %10s %10s\n", "benchmark", "iterations",
+          "ns/op", "allocs/op", "bytes/op");
+  for (size_t i = 0; i < sizeof(BENCHMARKS) / sizeof(BENCHMARKS[0]); ++i) {
+    const Benchmark &bench = BENCHMARKS[i];
+    if (!matches_filter(bench.name, filters) || (bench.needs_network && !network_ok)) {
+      continue;
+    }
+    BenchResult r = run_benchmark(bench, min_time_s);
+    fprintf(stderr, "%-28s %12lu %12.1f %10.2f %10.1f\n", r.name.c_str(),
+            r.iterations, r.ns_per_op, r.allocs_per_op, r.bytes_per_op);
+    results.push_back(r);
+  }
+
+  // 姿勢推定を計測した場合は、推定の精度も確かめる (許容を超えれば終了コード1)
+  bool accurate = !matches_filter("attitude/update", filters) || check_attitude_accuracy();
+
+  if (network_ok) {
+    network_close(&bench_net);
+    close(bench_sender);
+  }
+  fflush(stdout);
+  dup2(saved_stdout, STDOUT_FILENO);
+  close(saved_stdout);
+
+  if (out_path && !write_json(out_path, results, min_time_s)) {
+    return 1;
+  }
+  return accurate ? 0 : 1;
+}
@@ -0,0 +1,305 @@
+// 設定同期サーバー (src/config_synchronizer.cpp) に接続するコマンドラインのクライアント。
+// 地上局アプリケーションの代わりにセッションや従来形式の更新を送り、応答を表示する。
+// ループバックで動作を確認したり、スクリプトから設定を変更したりするために使う。
+//
+// 使い方: config_sync_client [--host <IP>] [--port <ポート>] <コマンド>
+//   get                         全項目を取得して "[SECTION]KEY=VALUE" で表示する
+//   set [SECTION]KEY=VALUE ...  差分として送り、ACK または ERROR を表示する
+//   watch [秒]                  機体から届く差分を表示し続ける (既定は Ctrl+C まで)
+//   legacy [ファイル]            従来形式 (長さ + 行) で送り、応答の行を表示する (既定は標準入力)
+//   raw                         標準入力のバイト列をそのまま送り、応答を表示する (不正な入力の確認用)
+//   終了コード: 0 = 成功, 1 = 接続・通信の失敗, 2 = 機体が更新を拒否した
+#include "config_session.h" // フレームの符号化と復号
+
+#include <arpa/inet.h>  // inet_pton, htons
+#include <errno.h>      // errno
+#include <netinet/in.h> // sockaddr_in
+#include <stdio.h>      // printf, fprintf
+#include <stdlib.h>     // atoi, atof
+#include <string.h>     // strcmp, strerror
+#include <sys/socket.h> // socket, connect, send, recv
+#include <sys/time.h>   // timeval
+#include <unistd.h>     // close, read
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+static int connect_to(const char *host, int port) {
+  int sock = socket(AF_INET, SOCK_STREAM, 0);
+  if (sock < 0) {
+    fprintf(stderr, "ソケットを作成できません: %s\n", strerror(errno));
+    return -1;
+  }
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  if (inet_pton(AF_INET, host, &addr.sin_addr) != 1) {
+    fprintf(stderr, "IPアドレスが不正です: %s\n", host);
+    close(sock);
+    return -1;
+  }
+  if (connect(sock, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0) {
+    fprintf(stderr, "%s:%d に接続できません: %s\n", host, port, strerror(errno));
+    close(sock);
+    return -1;
+  }
+  return sock;
+}
+
+static void set_recv_timeout(int sock, double seconds) {
+  struct timeval tv;
+  tv.tv_sec = static_cast<time_t>(seconds);
+  tv.tv_usec = static_cast<suseconds_t>((seconds - tv.tv_sec) * 1e6);
+  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+}
+
+static bool send_all(int sock, const std::string &data) {
+  size_t sent = 0;
+  while (sent < data.size()) {
+    ssize_t n = send(sock, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      fprintf(stderr, "送信に失敗しました: %s\n", strerror(errno));
+      return false;
+    }
+    sent += static_cast<size_t>(n);
+  }
+  return true;
+}
+
+static bool send_frame(int sock, const ConfigFrame &frame) {
+  std::string out;
+  config_session_encode(frame, out);
+  return send_all(sock, out);
+}
+
+// 1フレームを受信する。timed_out には受信タイムアウトで終わったかを入れる
+static bool recv_frame(int sock, std::string &rx, ConfigFrame &frame, bool *timed_out) {
+  if (timed_out) {
+    *timed_out = false;
+  }
+  while (true) {
+    size_t consumed = 0;
+    std::string error;
+    ConfigDecodeResult result = config_session_decode(rx.data(), rx.size(), frame, consumed, error);
+    if (result == CONFIG_DECODE_OK) {
+      rx.erase(0, consumed);
+      return true;
+    }
+    if (result == CONFIG_DECODE_ERROR) {
+      fprintf(stderr, "不正なフレームを受信しました: %s\n", error.c_str());
+      return false;
+    }
+    char buffer[4096];
+    ssize_t n = recv(sock, buffer, sizeof(buffer), 0);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) && timed_out) {
+      *timed_out = true;
+      return false;
+    }
+    if (n <= 0) {
+      fprintf(stderr, "機体との接続が切れました\n");
+      return false;
+    }
+    rx.append(buffer, static_cast<size_t>(n));
+  }
+}
+
+static void print_entries(const ConfigFrame &frame) {
+  for (size_t i = 0; i < frame.entries.size(); ++i) {
+    printf("[%s]%s=%s\n", frame.entries[i].section.c_str(), frame.entries[i].key.c_str(),
+           frame.entries[i].value.c_str());
+  }
+}
+
+// "[SECTION]KEY=VALUE" を項目に分解する
+static bool parse_entry(const char *text, ConfigEntry &entry) {
+  std::string s(text);
+  size_t close_pos = s.find(']');
+  size_t equals_pos = close_pos == std::string::npos ? std::string::npos : s.find('=', close_pos);
+  if (s.empty() || s[0] != '[' || close_pos == std::string::npos || equals_pos == std::string::npos) {
+    return false;
+  }
+  entry.section = s.substr(1, close_pos - 1);
+  entry.key = s.substr(close_pos + 1, equals_pos - close_pos - 1);
+  entry.value = s.substr(equals_pos + 1);
+  return !entry.section.empty() && !entry.key.empty();
+}
+
+// セッションを開始し、最初の応答 (SNAPSHOT) を受け取る
+static bool open_session(int sock, std::string &rx, ConfigFrame &snapshot) {
+  ConfigFrame hello = ConfigFrame();
+  hello.type = CONFIG_FRAME_HELLO;
+  if (!send_all(sock, CONFIG_SESSION_MAGIC) || !send_frame(sock, hello)) {
+    return false;
+  }
+  while (recv_frame(sock, rx, snapshot, nullptr)) {
+    if (snapshot.type == CONFIG_FRAME_SNAPSHOT || snapshot.type == CONFIG_FRAME_DELTA) {
+      return true;
+    }
+    if (snapshot.type == CONFIG_FRAME_ERROR) {
+      fprintf(stderr, "機体がセッションを拒否しました: %s\n", snapshot.message.c_str());
+      return false;
+    }
+  }
+  return false;
+}
+
+static int run_set(int sock, int argc, char **argv, int first) {
+  ConfigFrame delta = ConfigFrame();
+  delta.type = CONFIG_FRAME_DELTA;
+  for (int i = first; i < argc; ++i) {
+    ConfigEntry entry;
+    if (!parse_entry(argv[i], entry)) {
+      fprintf(stderr, "項目は [SECTION]KEY=VALUE の形式で指定してください: %s\n", argv[i]);
+      return 1;
+    }
+    delta.entries.push_back(entry);
+  }
+  if (delta.entries.empty()) {
+    fprintf(stderr, "変更する項目を指定してください\n");
+    return 1;
+  }
+
+  std::string rx;
+  ConfigFrame frame;
+  if (!open_session(sock, rx, frame)) {
+    return 1;
+  }
+  delta.epoch = frame.epoch;
+  delta.version = frame.version;
+  if (!send_frame(sock, delta)) {
+    return 1;
+  }
+  while (recv_frame(sock, rx, frame, nullptr)) {
+    if (frame.type == CONFIG_FRAME_ACK) {
+      printf("ACK version %llu\n", static_cast<unsigned long long>(frame.version));
+      return 0;
+    }
+    if (frame.type == CONFIG_FRAME_ERROR) {
+      printf("ERROR %s\n", frame.message.c_str());
+      return 2;
+    }
+  }
+  return 1;
+}
+
+static int run_watch(int sock, double seconds) {
+  std::string rx;
+  ConfigFrame frame;
+  if (!open_session(sock, rx, frame)) {
+    return 1;
+  }
+  printf("# epoch %u version %llu (%zu items)\n", frame.epoch,
+         static_cast<unsigned long long>(frame.version), frame.entries.size());
+  fflush(stdout);
+  if (seconds > 0.0) {
+    set_recv_timeout(sock, seconds);
+  }
+  bool timed_out = false;
+  while (recv_frame(sock, rx, frame, &timed_out)) {
+    if (frame.type == CONFIG_FRAME_DELTA) {
+      printf("# version %llu\n", static_cast<unsigned long long>(frame.version));
+      print_entries(frame);
+    } else if (frame.type == CONFIG_FRAME_PING) {
+      ConfigFrame pong = ConfigFrame();
+      pong.type = CONFIG_FRAME_PONG;
+      pong.message = frame.message;
+      if (!send_frame(sock, pong)) {
+        return 1;
+      }
+    } else if (frame.type == CONFIG_FRAME_ERROR) {
+      printf("ERROR %s\n", frame.message.c_str());
+    }
+    fflush(stdout);
+  }
+  return timed_out ? 0 : 1;
+}
+
+// 送信後に書き込み側を閉じ、機体が切断するまでの応答をすべて表示する
+static int send_and_print_reply(int sock, const std::string &data) {
+  if (!send_all(sock, data)) {
+    return 1;
+  }
+  shutdown(sock, SHUT_WR);
+  std::string reply;
+  char buffer[4096];
+  ssize_t n;
+  while ((n = recv(sock, buffer, sizeof(buffer), 0)) > 0) {
+    reply.append(buffer, static_cast<size_t>(n));
+  }
+  fwrite(reply.data(), 1, reply.size(), stdout);
+  return reply.compare(0, 3, "OK\n") == 0 ? 0 : 2;
+}
+
+int main(int argc, char **argv) {
+  const char *host = "127.0.0.1";
+  int port = 12348; // config.ini の [CONFIG_SYNC] CPP_RECV_PORT の既定値
+  int i = 1;
+  for (; i < argc && argv[i][0] == '-'; ++i) {
+    if (strcmp(argv[i], "--host") == 0 && i + 1 < argc) {
+      host = argv[++i];
+    } else if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+      port = atoi(argv[++i]);
+    } else {
+      break;
+    }
+  }
+  if (i >= argc) {
+    fprintf(stderr, "使い方: %s [--host <IP>] [--port <ポート>] get | set [SECTION]KEY=VALUE ... | "
+                    "watch [秒] | legacy [ファイル] | raw\n",
+            argv[0]);
+    return 1;
+  }
+  const char *command = argv[i++];
+
+  int sock = connect_to(host, port);
+  if (sock < 0) {
+    return 1;
+  }
+  set_recv_timeout(sock, 10.0);
+
+  int status = 1;
+  if (strcmp(command, "get") == 0) {
+    std::string rx;
+    ConfigFrame frame;
+    if (open_session(sock, rx, frame)) {
+      print_entries(frame);
+      status = 0;
+    }
+  } else if (strcmp(command, "set") == 0) {
+    status = run_set(sock, argc, argv, i);
+  } else if (strcmp(command, "watch") == 0) {
+    status = run_watch(sock, i < argc ? atof(argv[i]) : 0.0);
+  } else if (strcmp(command, "legacy") == 0 || strcmp(command, "raw") == 0) {
+    std::stringstream ss;
+    if (i < argc) {
+      std::ifstream file(argv[i]);
+      if (!file.is_open()) {
+        fprintf(stderr, "%s を開けません\n", argv[i]);
+        close(sock);
+        return 1;
+      }
+      ss << file.rdbuf();
+    } else {
+      ss << std::cin.rdbuf();
+    }
+    std::string body = ss.str();
+    if (strcmp(command, "legacy") == 0) {
+      body = std::to_string(body.size()) + "\n" + body;
+    }
+    status = send_and_print_reply(sock, body);
+  } else {
+    fprintf(stderr, "不明なコマンドです: %s\n", command);
+  }
+
+  close(sock);
+  return status;
+}
@@ -0,0 +1,217 @@
+// フライトレコーダーの記録 (flight_*.rec) を、機体と同じ制御コードに全速で流し込み、
+// 記録された PWM 出力とビット単位で一致するかを確認するツール。
+//
+// 使い方: flight_replay <記録ファイル> [--verbose]
+//   推力曲線の CSV は記録時と同じ相対パスで読み込むため、リポジトリのルートで実行すること。
+//   終了コード: 0 = 全周期一致, 1 = 不一致または周期の欠落あり, 2 = ファイルの読み込みエラー
+#include "aux_output.h"       // 記録開始時の補助出力の段階を復元するため
+#include "config.h"           // loadConfig, g_config
+#include "config_schema.h"    // 記録されたパラメータ変更の適用
+#include "control_loop.h"     // control_init, control_step
+#include "flight_recorder.h"  // 記録ファイルの形式
+#include "sim_hardware.h"     // ハードウェアのシミュレーション層
+#include "thrust_curve.h"     // 推力曲線の読み込み
+#include "thruster_control.h" // PWM 出力の取得
+
+#include <stdio.h>  // fopen, fread, fprintf
+#include <stdlib.h> // mkstemp
+#include <string.h> // strcmp, memcmp
+#include <mutex>
+#include <time.h>   // clock_gettime
+#include <unistd.h> // write, close, unlink
+#include <string>
+#include <vector>
+
+// 表示する不一致の最大件数 (周期単位)
+static const unsigned long MAX_REPORTED_MISMATCHES = 10;
+
+static int64_t now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+// 記録された設定ファイルの全文を一時ファイルに書き出して読み込む
+static bool apply_recorded_config(const std::vector<char> &contents) {
+  char path[] = "/tmp/flight_replay_XXXXXX";
+  int fd = mkstemp(path);
+  if (fd < 0) {
+    perror("mkstemp");
+    return false;
+  }
+  bool ok = write(fd, contents.data(), contents.size()) ==
+            static_cast<ssize_t>(contents.size());
+  close(fd);
+  ok = ok && loadConfig(path);
+  unlink(path);
+  if (ok) {
+    thrust_curve_load();
+  }
+  return ok;
+}
+
+// パラメータ要求で変更された1項目 ("SECTION.KEY=値") を g_config に適用する
+// (機体では param_protocol.cpp が検証済みの値だけを記録する)
+static bool apply_recorded_param(const std::vector<char> &payload) {
+  std::string text(payload.begin(), payload.end());
+  size_t dot = text.find('.');
+  size_t equals = text.find('=');
+  if (dot == std::string::npos || equals == std::string::npos || equals < dot) {
+    return false;
+  }
+  const ConfigField *field = config_find_field(
+      text.substr(0, dot), text.substr(dot + 1, equals - dot - 1));
+  if (!field) {
+    return false;
+  }
+  std::string error;
+  std::lock_guard<std::mutex> lock(g_config_mutex);
+  return config_set_field(*field, text.substr(equals + 1), g_config, error);
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "使い方: %s <記録ファイル> [--verbose]\n", argv[0]);
+    return 2;
+  }
+  bool verbose = argc > 2 && strcmp(argv[2], "--verbose") == 0;
+
+  FILE *file = fopen(argv[1], "rb");
+  if (!file) {
+    perror(argv[1]);
+    return 2;
+  }
+  FlightRecordFileHeader file_header;
+  if (fread(&file_header, sizeof(file_header), 1, file) != 1 ||
+      memcmp(file_header.magic, FLIGHT_RECORD_MAGIC, sizeof(file_header.magic)) != 0) {
+    fprintf(stderr, "%s: フライトレコーダーの記録ではありません。\n", argv[1]);
+    return 2;
+  }
+  if (file_header.version != FLIGHT_RECORD_VERSION ||
+      file_header.tick_size != sizeof(FlightRecordTick)) {
+    fprintf(stderr, "%s: 記録の形式が異なります (version %u, tick %u バイト)。\n",
+            argv[1], file_header.version, file_header.tick_size);
+    return 2;
+  }
+
+  // 制御コードのデバッグ出力 (printf) は捨て、結果だけを標準エラー出力に表示する
+  if (!verbose && !freopen("/dev/null", "w", stdout)) {
+    perror("freopen");
+  }
+
+  bool initialized = false;
+  unsigned long ticks = 0;
+  unsigned long mismatched_ticks = 0;
+  unsigned long config_records = 0;
+  unsigned long param_records = 0;
+  uint32_t expected_tick = 0;
+  bool gap_found = false;
+  int64_t first_time_ns = 0;
+  int64_t last_time_ns = 0;
+  int64_t control_ns = 0;
+  std::vector<char> payload;
+  std::vector<char> packet;
+
+  FlightRecordHeader record;
+  while (fread(&record, sizeof(record), 1, file) == 1) {
+    payload.resize(record.length);
+    if (record.length > 0 &&
+        fread(payload.data(), 1, record.length, file) != record.length) {
+      fprintf(stderr, "警告: 記録の末尾が途切れています (周期 %lu の後)。\n", ticks);
+      break;
+    }
+
+    if (record.type == FLIGHT_RECORD_CONFIG) {
+      config_records++;
+      if (!apply_recorded_config(payload)) {
+        fprintf(stderr, "記録された設定を読み込めません。\n");
+        return 2;
+      }
+      if (!initialized) {
+        // main.cpp の起動処理と同じ状態を作る (thruster_init の代わりに直接設定する)
+        control_init();
+        thruster_set_all_pwm(g_config.pwm_min);
+        aux_output_set_levels(file_header.aux_levels);
+        initialized = true;
+      }
+      continue;
+    }
+    if (record.type == FLIGHT_RECORD_PARAM && initialized) {
+      // 記録では同じ周期のレコードの前に並ぶので、次の周期の制御より先に適用される
+      param_records++;
+      if (!apply_recorded_param(payload)) {
+        std::string text(payload.begin(), payload.end());
+        fprintf(stderr, "記録されたパラメータ変更を適用できません: %s\n", text.c_str());
+        return 2;
+      }
+      continue;
+    }
+    if (record.type != FLIGHT_RECORD_TICK || !initialized ||
+        record.length < sizeof(FlightRecordTick)) {
+      continue; // 未知のレコード、または設定より前の周期
+    }
+
+    FlightRecordTick tick;
+    memcpy(&tick, payload.data(), sizeof(tick));
+    if (tick.tick != expected_tick) {
+      // リングバッファ不足で欠落した周期があると、以降の制御状態は再現できない
+      fprintf(stderr, "警告: 周期 %u ~ %u が記録から欠落しています。ここで比較を終了します。\n",
+              expected_tick, tick.tick - 1);
+      gap_found = true;
+      break;
+    }
+    expected_tick = tick.tick + 1;
+    packet.assign(payload.begin() + sizeof(tick), payload.end());
+
+    ControlInputs inputs;
+    inputs.packet = packet.empty() ? nullptr : packet.data();
+    inputs.packet_len = static_cast<int>(packet.size());
+    inputs.gyro = tick.gyro;
+    inputs.accel = tick.accel;
+    inputs.mag = tick.mag;
+    inputs.pressure = tick.pressure;
+    memcpy(inputs.adc, tick.adc, sizeof(inputs.adc));
+    inputs.adc_valid = (tick.flags & FLIGHT_TICK_ADC_VALID) != 0;
+    inputs.dt_s = tick.dt_s;
+    inputs.control_enabled = (tick.flags & FLIGHT_TICK_CONTROL_ENABLED) != 0;
+
+    int64_t start_ns = now_ns();
+    if (tick.flags & FLIGHT_TICK_FAILSAFE_ENTERED) {
+      thruster_set_all_pwm(g_config.pwm_min);
+      control_reset_gamepad();
+    }
+    control_step(inputs);
+    control_ns += now_ns() - start_ns;
+
+    bool mismatch = false;
+    for (int ch = 0; ch < FLIGHT_RECORD_PWM_CHANNELS; ++ch) {
+      int replayed = thruster_get_output_pwm(ch);
+      if (replayed != tick.pwm_us[ch]) {
+        if (!mismatch && mismatched_ticks < MAX_REPORTED_MISMATCHES) {
+          fprintf(stderr, "不一致: 周期 %u Ch%d 記録=%u 再生=%d\n", tick.tick, ch,
+                  tick.pwm_us[ch], replayed);
+        }
+        mismatch = true;
+      }
+    }
+    if (mismatch) {
+      mismatched_ticks++;
+    }
+    if (ticks == 0) {
+      first_time_ns = tick.time_ns;
+    }
+    last_time_ns = tick.time_ns;
+    ticks++;
+  }
+  fclose(file);
+
+  double recorded_s = (last_time_ns - first_time_ns) / 1e9;
+  fprintf(stderr,
+          "周期数: %lu (記録時間 %.1f 秒), 設定レコード: %lu, パラメータ変更: %lu\n"
+          "制御コードの実行時間: %.1f ns/周期\n"
+          "不一致の周期: %lu\n",
+          ticks, recorded_s, config_records, param_records,
+          ticks > 0 ? static_cast<double>(control_ns) / ticks : 0.0,
+          mismatched_ticks);
+  return (mismatched_ticks == 0 && !gap_found) ? 0 : 1;
+}
@@ -0,0 +1,422 @@
+// フライトレコーダーの記録 (flight_*.rec) の加速度を反転検出器 (src/inversion_detector.cpp) に流し、
+// 検出の遅れと誤検出を評価するツール。
+//
+// 正解には、記録した加速度の生値の傾きに前後 TRUTH_WINDOW_S の中央値をとったもの (未来の値も
+// 使うため機体上では使えないが、1サンプルの反転や衝突の瞬間値には左右されない) を使い、
+// [INVERSION] の ENTER_ANGLE_DEG / EXIT_ANGLE_DEG のヒステリシスで反転区間を決める。
+//   - 検出の遅れ: DWELL_S 以上続いた反転区間の始まりから ENTERED までの時間
+//   - 誤検出: 直前 FALSE_POSITIVE_WINDOW_S 秒に正解の反転区間が無いのに ENTERED になった
+//   - 見逃し: DWELL_S 以上続いた反転区間の終わりから MISS_WINDOW_S 秒以内に ENTERED にならなかった
+//
+// 使い方: inversion_eval [--synth <出力ディレクトリ>] [記録ファイル...]
+//   --synth: 合成した加速度の記録 (1サンプルの符号反転、衝突のスパイク、横転と復帰) を書き出し、
+//            それらも評価する。実機の記録が無くても閾値を確認できる
+//   終了コード: 0 = 誤検出・見逃しなし, 1 = 誤検出または見逃しあり, 2 = ファイルの読み書きエラー
+#include "config.h"             // loadConfig, g_config
+#include "flight_recorder.h"    // 記録ファイルの形式
+#include "inversion_detector.h" // 評価する検出器
+
+#include <algorithm> // std::nth_element, std::max, std::min
+#include <cmath>     // std::sqrt, std::acos, std::sin, std::cos, std::log, std::fabs
+#include <errno.h>   // errno
+#include <fstream>   // 設定ファイルの読み込み
+#include <sstream>
+#include <stdio.h>    // fopen, fread, fwrite, fprintf
+#include <stdlib.h>   // mkstemp
+#include <string.h>   // strcmp, memcmp, memset
+#include <sys/stat.h> // mkdir
+#include <unistd.h>   // write, close, unlink
+#include <string>
+#include <vector>
+
+static const float RAD_TO_DEG = 57.2957795f;
+static const double TRUTH_WINDOW_S = 0.25;          // 正解の中央値をとる前後の幅
+static const double FALSE_POSITIVE_WINDOW_S = 2.0;  // 検出の直前にこの範囲で正解が反転していなければ誤検出
+static const double MISS_WINDOW_S = 2.0;            // 反転区間の終わりからこの時間内に検出されなければ見逃し
+static const double SYNTH_RATE_HZ = 100.0;          // 合成する記録の周期 (LOOP_DELAY_US=10000 相当)
+
+// 1周期分の評価の入力
+struct Sample {
+  double time_s;
+  float dt_s;
+  AxisData accel;
+};
+
+// 記録された設定ファイルの全文を一時ファイルに書き出して読み込む
+static bool apply_recorded_config(const std::string &contents) {
+  char path[] = "/tmp/inversion_eval_XXXXXX";
+  int fd = mkstemp(path);
+  if (fd < 0) {
+    perror("mkstemp");
+    return false;
+  }
+  bool ok = write(fd, contents.data(), contents.size()) ==
+            static_cast<ssize_t>(contents.size());
+  close(fd);
+  ok = ok && loadConfig(path);
+  unlink(path);
+  return ok;
+}
+
+// 記録から加速度と経過時間を読み出す。設定レコードがあれば最初のものを適用する
+static bool read_recording(const char *path, std::vector<Sample> &samples) {
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    perror(path);
+    return false;
+  }
+  FlightRecordFileHeader file_header;
+  if (fread(&file_header, sizeof(file_header), 1, file) != 1 ||
+      memcmp(file_header.magic, FLIGHT_RECORD_MAGIC, sizeof(file_header.magic)) != 0 ||
+      file_header.version != FLIGHT_RECORD_VERSION ||
+      file_header.tick_size != sizeof(FlightRecordTick)) {
+    fprintf(stderr, "%s: フライトレコーダーの記録ではないか、形式が異なります。\n", path);
+    fclose(file);
+    return false;
+  }
+  bool config_applied = false;
+  int64_t first_time_ns = 0;
+  std::vector<char> payload;
+  FlightRecordHeader record;
+  while (fread(&record, sizeof(record), 1, file) == 1) {
+    payload.resize(record.length);
+    if (record.length > 0 && fread(payload.data(), 1, record.length, file) != record.length) {
+      break; // 末尾が途切れている
+    }
+    if (record.type == FLIGHT_RECORD_CONFIG && !config_applied) {
+      if (!apply_recorded_config(std::string(payload.begin(), payload.end()))) {
+        fprintf(stderr, "%s: 記録された設定を読み込めません。\n", path);
+        fclose(file);
+        return false;
+      }
+      config_applied = true;
+    } else if (record.type == FLIGHT_RECORD_TICK && record.length >= sizeof(FlightRecordTick)) {
+      FlightRecordTick tick;
+      memcpy(&tick, payload.data(), sizeof(tick));
+      if (samples.empty()) {
+        first_time_ns = tick.time_ns;
+      }
+      Sample sample;
+      sample.time_s = (tick.time_ns - first_time_ns) / 1e9;
+      sample.dt_s = tick.dt_s;
+      sample.accel = tick.accel;
+      samples.push_back(sample);
+    }
+  }
+  fclose(file);
+  if (!config_applied) {
+    fprintf(stderr, "%s: 設定レコードが無いため config.ini の [INVERSION] で評価します。\n", path);
+    loadConfig("config.ini");
+  }
+  return true;
+}
+
+// 加速度の生値から、基準方向に対する傾き (deg) を求める。基準は検出器と同じ決め方
+static std::vector<float> raw_tilt(const std::vector<Sample> &samples) {
+  float reference[3] = {0.0f, 0.0f, 1.0f};
+  if (g_config.inversion_reference_z_sign != 0) {
+    reference[2] = g_config.inversion_reference_z_sign > 0 ? 1.0f : -1.0f;
+  } else {
+    double sum[3] = {0.0, 0.0, 0.0};
+    int count = 0;
+    for (size_t i = 0; i < samples.size() && count < std::max(1, g_config.inversion_calibration_samples); ++i) {
+      const AxisData &a = samples[i].accel;
+      double m = std::sqrt(a.x * a.x + a.y * a.y + a.z * a.z);
+      if (m > 0.0) {
+        sum[0] += a.x / m;
+        sum[1] += a.y / m;
+        sum[2] += a.z / m;
+        count++;
+      }
+    }
+    double n = std::sqrt(sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2]);
+    if (n > 0.0) {
+      for (int k = 0; k < 3; ++k) {
+        reference[k] = static_cast<float>(sum[k] / n);
+      }
+    }
+  }
+  std::vector<float> tilt(samples.size(), 0.0f);
+  for (size_t i = 0; i < samples.size(); ++i) {
+    const AxisData &a = samples[i].accel;
+    float m = std::sqrt(a.x * a.x + a.y * a.y + a.z * a.z);
+    if (m == 0.0f) {
+      continue;
+    }
+    float c = (a.x * reference[0] + a.y * reference[1] + a.z * reference[2]) / m;
+    tilt[i] = std::acos(std::max(-1.0f, std::min(1.0f, c))) * RAD_TO_DEG;
+  }
+  return tilt;
+}
+
+// 正解の反転状態 (前後 TRUTH_WINDOW_S の中央値にヒステリシスをかける)
+static std::vector<bool> truth_inverted(const std::vector<Sample> &samples,
+                                        const std::vector<float> &tilt) {
+  std::vector<bool> truth(samples.size(), false);
+  std::vector<float> window;
+  bool state = false;
+  size_t lo = 0, hi = 0;
+  for (size_t i = 0; i < samples.size(); ++i) {
+    while (samples[i].time_s - samples[lo].time_s > TRUTH_WINDOW_S) {
+      lo++;
+    }
+    while (hi < samples.size() && samples[hi].time_s - samples[i].time_s <= TRUTH_WINDOW_S) {
+      hi++;
+    }
+    window.assign(tilt.begin() + lo, tilt.begin() + hi);
+    std::nth_element(window.begin(), window.begin() + window.size() / 2, window.end());
+    float median = window[window.size() / 2];
+    if (!state && median > g_config.inversion_enter_angle_deg) {
+      state = true;
+    } else if (state && median < g_config.inversion_exit_angle_deg) {
+      state = false;
+    }
+    truth[i] = state;
+  }
+  return truth;
+}
+
+// 1つの記録を評価する。戻り値は終了コードと同じ (0: 問題なし, 1: 誤検出か見逃しあり, 2: 読み込みエラー)
+static int evaluate(const char *path) {
+  std::vector<Sample> samples;
+  if (!read_recording(path, samples)) {
+    return 2;
+  }
+  if (samples.empty()) {
+    fprintf(stderr, "%s: 周期の記録がありません。\n", path);
+    return 2;
+  }
+  std::vector<float> tilt = raw_tilt(samples);
+  std::vector<bool> truth = truth_inverted(samples, tilt);
+
+  // 検出器を記録の周期どおりに動かす (検出器のログは標準出力に出るので評価結果は標準エラー出力へ)
+  inversion_detector_init();
+  std::vector<double> entered;
+  for (size_t i = 0; i < samples.size(); ++i) {
+    if (inversion_detector_update(samples[i].accel, samples[i].dt_s) == InversionEvent::ENTERED) {
+      entered.push_back(samples[i].time_s);
+    }
+  }
+  InversionStatus status = inversion_detector_get_status();
+
+  // 正解の反転区間 (開始・終了時刻)
+  std::vector<std::pair<double, double> > episodes;
+  for (size_t i = 0; i < samples.size(); ++i) {
+    if (truth[i] && (i == 0 || !truth[i - 1])) {
+      episodes.push_back(std::make_pair(samples[i].time_s, samples.back().time_s));
+    } else if (!truth[i] && i > 0 && truth[i - 1]) {
+      episodes.back().second = samples[i].time_s;
+    }
+  }
+
+  unsigned false_positives = 0;
+  for (size_t e = 0; e < entered.size(); ++e) {
+    bool explained = false;
+    for (size_t k = 0; k < episodes.size() && !explained; ++k) {
+      explained = episodes[k].first <= entered[e] &&
+                  entered[e] - FALSE_POSITIVE_WINDOW_S <= episodes[k].second;
+    }
+    if (!explained) {
+      false_positives++;
+      fprintf(stderr, "  誤検出: %.2f 秒\n", entered[e]);
+    }
+  }
+
+  unsigned sustained = 0, missed = 0;
+  double latency_sum = 0.0, latency_max = 0.0;
+  for (size_t k = 0; k < episodes.size(); ++k) {
+    if (episodes[k].second - episodes[k].first < g_config.inversion_dwell_s) {
+      continue; // DWELL_S より短い反転は検出しなくてよい
+    }
+    sustained++;
+    double detected = -1.0;
+    for (size_t e = 0; e < entered.size() && detected < 0.0; ++e) {
+      if (entered[e] >= episodes[k].first && entered[e] <= episodes[k].second + MISS_WINDOW_S) {
+        detected = entered[e];
+      }
+    }
+    if (detected < 0.0) {
+      missed++;
+      fprintf(stderr, "  見逃し: %.2f ~ %.2f 秒の反転\n", episodes[k].first, episodes[k].second);
+      continue;
+    }
+    double latency = detected - episodes[k].first;
+    latency_sum += latency;
+    latency_max = std::max(latency_max, latency);
+  }
+
+  unsigned detected_count = sustained - missed;
+  fprintf(stderr,
+          "%s: %.1f 秒 (%zu 周期), 正解の反転 %u 回, 検出 %zu 回, 誤検出 %u, 見逃し %u, "
+          "破棄したサンプル %u",
+          path, samples.back().time_s, samples.size(), sustained, entered.size(),
+          false_positives, missed, status.rejected);
+  if (detected_count > 0) {
+    fprintf(stderr, ", 検出の遅れ 平均 %.2f 秒 / 最大 %.2f 秒", latency_sum / detected_count,
+            latency_max);
+  }
+  fprintf(stderr, "\n");
+  return (false_positives == 0 && missed == 0) ? 0 : 1;
+}
+
+// --- 合成した記録 ---
+
+// 再現できるように固定のシードで生成する正規乱数 (Box-Muller)
+static unsigned long rng_state = 12345;
+static double uniform01() {
+  rng_state = rng_state * 6364136223846793005ULL + 1442695040888963407ULL;
+  return ((rng_state >> 11) + 0.5) / 9007199254740992.0;
+}
+static double gaussian() {
+  return std::sqrt(-2.0 * std::log(uniform01())) * std::cos(6.283185307179586 * uniform01());
+}
+
+// x 軸まわりに roll_deg 傾けた姿勢での重力 (g 単位) にノイズを加える
+static AxisData gravity(double roll_deg, double noise_g) {
+  double r = roll_deg / RAD_TO_DEG;
+  AxisData a;
+  a.x = static_cast<float>(noise_g * gaussian());
+  a.y = static_cast<float>(std::sin(r) + noise_g * gaussian());
+  a.z = static_cast<float>(std::cos(r) + noise_g * gaussian());
+  return a;
+}
+
+// 加速度の列を記録ファイルとして書き出す (設定レコードには現在の config.ini を入れる)
+static bool write_recording(const std::string &path, const std::vector<AxisData> &accel) {
+  std::ifstream config_file("config.ini", std::ios::binary);
+  std::stringstream config_contents;
+  config_contents << config_file.rdbuf();
+  std::string config = config_contents.str();
+
+  FILE *file = fopen(path.c_str(), "wb");
+  if (!file) {
+    perror(path.c_str());
+    return false;
+  }
+  FlightRecordFileHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, FLIGHT_RECORD_MAGIC, sizeof(header.magic));
+  header.version = FLIGHT_RECORD_VERSION;
+  header.tick_size = sizeof(FlightRecordTick);
+  fwrite(&header, sizeof(header), 1, file);
+  FlightRecordHeader record = {FLIGHT_RECORD_CONFIG, 0, static_cast<uint32_t>(config.size())};
+  fwrite(&record, sizeof(record), 1, file);
+  fwrite(config.data(), 1, config.size(), file);
+
+  const float dt_s = static_cast<float>(1.0 / SYNTH_RATE_HZ);
+  for (size_t i = 0; i < accel.size(); ++i) {
+    FlightRecordTick tick;
+    memset(&tick, 0, sizeof(tick));
+    tick.tick = static_cast<uint32_t>(i);
+    tick.time_ns = static_cast<int64_t>(i * 1e9 / SYNTH_RATE_HZ);
+    tick.dt_s = dt_s;
+    tick.accel = accel[i];
+    record.type = FLIGHT_RECORD_TICK;
+    record.length = sizeof(tick);
+    fwrite(&record, sizeof(record), 1, file);
+    fwrite(&tick, sizeof(tick), 1, file);
+  }
+  bool ok = !ferror(file);
+  fclose(file);
+  return ok;
+}
+
+// 合成した記録を dir に書き出し、パスを paths に追加する
+static bool write_synthetic(const std::string &dir, std::vector<std::string> &paths) {
+  if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+    perror(dir.c_str());
+    return false;
+  }
+  const int rate = static_cast<int>(SYNTH_RATE_HZ);
+  std::vector<AxisData> accel;
+
+  // 1. 正立のまま、2秒ごとに1サンプル (時々3サンプル続けて) Z の符号が反転する
+  accel.clear();
+  for (int i = 0; i < 60 * rate; ++i) {
+    AxisData a = gravity(0.0, 0.03);
+    int phase = i % (2 * rate);
+    if (phase == rate || (i % (10 * rate) >= rate && i % (10 * rate) < rate + 3)) {
+      a.z = -a.z;
+    }
+    accel.push_back(a);
+  }
+  paths.push_back(dir + "/synthetic_sign_flips.rec");
+  if (!write_recording(paths.back(), accel)) {
+    return false;
+  }
+
+  // 2. 正立のまま、3秒ごとに衝突 (3~5サンプル、3~4 g の任意の向き)
+  accel.clear();
+  for (int i = 0; i < 60 * rate; ++i) {
+    AxisData a = gravity(0.0, 0.03);
+    int phase = i % (3 * rate);
+    if (phase >= rate && phase < rate + 3 + (i / (3 * rate)) % 3) {
+      double m = 3.0 + uniform01();
+      a.x = static_cast<float>(m * gaussian());
+      a.y = static_cast<float>(m * gaussian());
+      a.z = static_cast<float>(-m * std::fabs(gaussian()));
+    }
+    accel.push_back(a);
+  }
+  paths.push_back(dir + "/synthetic_collisions.rec");
+  if (!write_recording(paths.back(), accel)) {
+    return false;
+  }
+
+  // 3. 正立 5 秒 -> 1 秒かけて 180 度横転 -> 5 秒保持 -> 1 秒かけて復帰、を3回
+  //    (横転中にも衝突のスパイクを混ぜる)
+  accel.clear();
+  for (int i = 0; i < 5 * rate; ++i) {
+    accel.push_back(gravity(0.0, 0.03));
+  }
+  for (int cycle = 0; cycle < 3; ++cycle) {
+    for (int i = 0; i < rate; ++i) {
+      accel.push_back(gravity(180.0 * i / rate, 0.05));
+    }
+    for (int i = 0; i < 5 * rate; ++i) {
+      AxisData a = gravity(180.0, 0.03);
+      if (i == 2 * rate) {
+        a.z = 3.5f;
+      }
+      accel.push_back(a);
+    }
+    for (int i = 0; i < rate; ++i) {
+      accel.push_back(gravity(180.0 - 180.0 * i / rate, 0.05));
+    }
+    for (int i = 0; i < 5 * rate; ++i) {
+      accel.push_back(gravity(0.0, 0.03));
+    }
+  }
+  paths.push_back(dir + "/synthetic_rollover.rec");
+  return write_recording(paths.back(), accel);
+}
+
+int main(int argc, char **argv) {
+  std::vector<std::string> paths;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--synth") == 0 && i + 1 < argc) {
+      if (!write_synthetic(argv[++i], paths)) {
+        return 2;
+      }
+    } else if (argv[i][0] == '-') {
+      fprintf(stderr, "使い方: %s [--synth <出力ディレクトリ>] [記録ファイル...]\n", argv[0]);
+      return 2;
+    } else {
+      paths.push_back(argv[i]);
+    }
+  }
+  if (paths.empty()) {
+    fprintf(stderr, "使い方: %s [--synth <出力ディレクトリ>] [記録ファイル...]\n", argv[0]);
+    return 2;
+  }
+
+  // 検出器と設定の読み込みのログは捨て、評価結果だけを標準エラー出力に表示する
+  if (!freopen("/dev/null", "w", stdout)) {
+    perror("freopen");
+  }
+  int status = 0;
+  for (size_t i = 0; i < paths.size(); ++i) {
+    status = std::max(status, evaluate(paths[i].c_str()));
+  }
+  return status;
+}
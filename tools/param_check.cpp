@@ -0,0 +1,441 @@
+// パラメータ要求 (param_protocol.h) の set が、不正な値を拒否して g_config を変えないことを
+// 確認するツール。ネットワークは使わず、受信済みの要求を NetworkContext の param_queue に
+// 直接入れて param_protocol_process に渡し、ループバックの UDP ソケットで受けた応答 (ack / nack) を
+// 確かめる。反映されるべき値は param:get で読み直す。
+// 続けて、設定同期のスレッド (ConfigSynchronizer) を一時ディレクトリの config.ini の写しと
+// ループバックのポートで動かし、live で変えた項目が別の項目の persist で保存されないことを確かめる。
+// 最後に、同じディレクトリの config_sync_client から改行や余分な文字を含む値を送り、
+// ERROR が返って config.ini が変わらないことを確かめる。
+//
+// 使い方: param_check   (config.ini を読むため、リポジトリのルートで実行する)
+//   終了コード: 0 = すべて期待どおり, 1 = 期待と異なる結果あり
+#include "config.h"              // g_config, g_config_mutex
+#include "config_schema.h"       // 値の文字列化
+#include "config_synchronizer.h" // ConfigSynchronizer, g_config_updated_flag
+#include "ini_document.h"        // 保存された config.ini の確認
+#include "metrics.h"             // 拒否数 (param_rejected) の確認
+#include "network.h"             // NetworkContext
+#include "param_protocol.h"      // param_protocol_init, param_protocol_process
+
+#include <arpa/inet.h>  // htonl
+#include <math.h>       // fabs
+#include <netinet/in.h> // sockaddr_in
+#include <poll.h>       // 応答を期限付きで待つ
+#include <stdio.h>      // printf, snprintf
+#include <stdlib.h>     // mkdtemp, strtod
+#include <string.h>     // memset, strlen
+#include <sys/socket.h> // 空いているポートを探す
+#include <sys/wait.h>   // waitpid (config_sync_client の終了コード)
+#include <unistd.h>     // close, unlink, rmdir, fork, execv
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct SetCase {
+  const char *name;  // SECTION.KEY
+  const char *value; // 送る値
+  bool accepted;     // 反映されるべきか
+};
+
+static const SetCase CASES[] = {
+    {"THRUSTER_CONTROL.KP_YAW", "0.25", true},
+    {"THRUSTER_CONTROL.KP_YAW", "nan", false},
+    {"THRUSTER_CONTROL.KP_YAW", "NAN", false},
+    {"THRUSTER_CONTROL.KP_YAW", "inf", false},
+    {"THRUSTER_CONTROL.KP_YAW", "-inf", false},
+    {"THRUSTER_CONTROL.KP_YAW", "1e999", false},
+    {"THRUSTER_CONTROL.KP_YAW", "0.5x", false},
+    {"THRUSTER_CONTROL.SMOOTHING_FACTOR_HORIZONTAL", "nan", false},
+    {"THRUSTER_CONTROL.SMOOTHING_FACTOR_HORIZONTAL", "2", false},
+    {"THRUSTER_CONTROL.SMOOTHING_FACTOR_HORIZONTAL", "0.1", true},
+    {"PWM.PWM_FREQUENCY", "infinity", false},
+    {"PWM.PWM_MIN", "nan", false},
+};
+
+// 設定同期で拒否されるべき項目 (config_sync_client の set に渡す形式)
+static const char *const SYNC_REJECTED[] = {
+    // 改行を含む値 (書き出すと別の行・セクションとして解釈される)
+    "[GSTREAMER_CAMERA_1]DEVICE=/dev/video2\n[PWM]\nPWM_MIN=abc",
+    // 数値の後ろに余分な文字がある値 (先頭の数値だけが読まれてはいけない)
+    "[THRUSTER_CONTROL]KP_YAW=0.3xyz",
+    "[PWM]PWM_FREQUENCY=12 abc",
+};
+
+static std::string current_value(const std::string &name) {
+  size_t dot = name.find('.');
+  const ConfigField *field =
+      config_find_field(name.substr(0, dot), name.substr(dot + 1));
+  std::lock_guard<std::mutex> lock(g_config_mutex);
+  return field ? config_format_field(*field, g_config) : "";
+}
+
+// 応答を受け取るループバックの UDP ソケット (open_reply_socket が ctx の送信先をここに向ける)
+static int reply_socket = -1;
+
+static bool open_reply_socket(NetworkContext *ctx) {
+  reply_socket = socket(AF_INET, SOCK_DGRAM, 0);
+  ctx->send_socket = socket(AF_INET, SOCK_DGRAM, 0);
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t len = sizeof(addr);
+  if (reply_socket < 0 || ctx->send_socket < 0 ||
+      bind(reply_socket, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+      getsockname(reply_socket, (struct sockaddr *)&addr, &len) != 0) {
+    return false;
+  }
+  ctx->client_addr_send = addr;
+  return true;
+}
+
+// <seq> が一致する応答 (param:ack / nack / value) を待つ。1秒以内に届かなければ空文字列
+static std::string receive_reply(const std::string &seq) {
+  std::chrono::steady_clock::time_point deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds(1);
+  char buffer[NET_BUFFER_SIZE];
+  for (;;) {
+    int remaining_ms = static_cast<int>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now())
+            .count());
+    struct pollfd pfd = {reply_socket, POLLIN, 0};
+    if (remaining_ms <= 0 || poll(&pfd, 1, remaining_ms) <= 0) {
+      return "";
+    }
+    ssize_t n = recv(reply_socket, buffer, sizeof(buffer) - 1, 0);
+    if (n <= 0) {
+      continue;
+    }
+    std::string reply(buffer, static_cast<size_t>(n));
+    size_t first = reply.find(',');
+    size_t second = first == std::string::npos ? first : reply.find(',', first + 1);
+    if (second != std::string::npos &&
+        reply.compare(first + 1, second - first - 1, seq) == 0) {
+      return reply;
+    }
+  }
+}
+
+// 要求を1件処理し、その応答を返す (要求は "param:<コマンド>,<seq>,..." の形式)
+static std::string send_request(NetworkContext *ctx, ConfigSynchronizer *sync,
+                                const std::string &text) {
+  NetworkMessage &request = ctx->param_queue[0];
+  memset(&request, 0, sizeof(request));
+  snprintf(request.data, sizeof(request.data), "%s", text.c_str());
+  request.len = strlen(request.data);
+  request.from.sin_family = AF_INET;
+  request.from.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  ctx->param_queue_count = 1;
+  param_protocol_process(ctx, sync);
+  size_t first = text.find(',');
+  size_t second = text.find(',', first + 1);
+  return receive_reply(text.substr(first + 1, second - first - 1));
+}
+
+static bool starts_with(const std::string &text, const char *prefix) {
+  return text.compare(0, strlen(prefix), prefix) == 0;
+}
+
+// param:get で読み直した値 (param:value の最後の欄。読めなければ空文字列)
+static std::string read_back(NetworkContext *ctx, int seq,
+                             const std::string &name) {
+  std::string reply = send_request(
+      ctx, nullptr, "param:get," + std::to_string(seq) + "," + name);
+  if (!starts_with(reply, "param:value,")) {
+    return "";
+  }
+  return reply.substr(reply.rfind(',') + 1);
+}
+
+// ループバックで空いている TCP ポートの番号 (見つからなければ 0)
+static int free_loopback_port() {
+  int sock = socket(AF_INET, SOCK_STREAM, 0);
+  if (sock < 0) {
+    return 0;
+  }
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t len = sizeof(addr);
+  int port = 0;
+  if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) == 0 &&
+      getsockname(sock, (struct sockaddr *)&addr, &len) == 0) {
+    port = ntohs(addr.sin_port);
+  }
+  close(sock);
+  return port;
+}
+
+// config.ini の写しを一時ディレクトリ dir に作り、設定同期をループバックの空きポートで動かす設定にする
+static bool prepare_sync_config(char *dir, std::string &path, int &sync_port) {
+  std::ifstream source("config.ini");
+  std::stringstream contents;
+  contents << source.rdbuf();
+  IniDocument doc;
+  doc.parse(contents);
+  sync_port = free_loopback_port();
+  int wpf_port = free_loopback_port(); // 待ち受けていないポート (初期設定の送信は失敗し続ける)
+  if (!source || sync_port == 0 || wpf_port == 0) {
+    printf("FAIL 一時的な設定ファイルかポートを用意できない\n");
+    return false;
+  }
+  doc.set("CONFIG_SYNC", "WPF_HOST", "127.0.0.1");
+  doc.set("CONFIG_SYNC", "WPF_RECV_PORT", std::to_string(wpf_port));
+  doc.set("CONFIG_SYNC", "CPP_RECV_PORT", std::to_string(sync_port));
+
+  if (!mkdtemp(dir)) {
+    printf("FAIL 一時ディレクトリを作れない\n");
+    return false;
+  }
+  path = std::string(dir) + "/config.ini";
+  if (!config_write_file_atomic(path, doc.to_string())) {
+    printf("FAIL 一時的な設定ファイルを書けない (%s)\n", path.c_str());
+    rmdir(dir);
+    return false;
+  }
+  return true;
+}
+
+static void remove_sync_config(const char *dir, const std::string &path) {
+  unlink(path.c_str());
+  unlink(config_last_good_path(path).c_str());
+  rmdir(dir);
+}
+
+static std::string read_file(const std::string &path) {
+  std::ifstream file(path);
+  std::stringstream contents;
+  contents << file.rdbuf();
+  return contents.str();
+}
+
+// config_sync_client を実行し、終了コードを返す (標準出力は output に入れる。実行できなければ -1)
+static int run_sync_client(const std::string &client, int port,
+                           const std::vector<std::string> &args,
+                           std::string &output) {
+  int fds[2];
+  if (pipe(fds) != 0) {
+    return -1;
+  }
+  std::string port_text = std::to_string(port);
+  std::vector<char *> argv;
+  argv.push_back(const_cast<char *>(client.c_str()));
+  argv.push_back(const_cast<char *>("--port"));
+  argv.push_back(const_cast<char *>(port_text.c_str()));
+  for (size_t i = 0; i < args.size(); ++i) {
+    argv.push_back(const_cast<char *>(args[i].c_str()));
+  }
+  argv.push_back(nullptr);
+
+  pid_t pid = fork();
+  if (pid == 0) {
+    dup2(fds[1], STDOUT_FILENO);
+    close(fds[0]);
+    close(fds[1]);
+    execv(client.c_str(), argv.data());
+    _exit(127);
+  }
+  close(fds[1]);
+  output.clear();
+  char buffer[256];
+  ssize_t n;
+  while ((n = read(fds[0], buffer, sizeof(buffer))) > 0) {
+    output.append(buffer, static_cast<size_t>(n));
+  }
+  close(fds[0]);
+  int status = 0;
+  if (pid < 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status)) {
+    return -1;
+  }
+  return WEXITSTATUS(status);
+}
+
+// config_sync_client の get の出力に expected が含まれるまで繰り返す (5秒以内に含まれなければ false)。
+// 待ち受けの開始や、機体側の変更が地上局向けに取り込まれたことの確認に使う
+static bool wait_for_sync_get(const std::string &client, int port,
+                              const std::string &expected) {
+  std::chrono::steady_clock::time_point deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  std::vector<std::string> get(1, "get");
+  std::string output;
+  while (std::chrono::steady_clock::now() < deadline) {
+    if (run_sync_client(client, port, get, output) == 0 &&
+        output.find(expected) != std::string::npos) {
+      return true;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  }
+  return false;
+}
+
+// 地上局と同じ経路 (config_sync_client の set) で不正な項目を送り、ERROR が返って
+// config.ini が1バイトも変わらないことを確認する
+static int check_sync_rejects(const std::string &client) {
+  const int count = sizeof(SYNC_REJECTED) / sizeof(SYNC_REJECTED[0]);
+
+  char dir[] = "/tmp/param_check.XXXXXX";
+  std::string path;
+  int sync_port = 0;
+  if (!prepare_sync_config(dir, path, sync_port)) {
+    return count;
+  }
+  int failures = 0;
+  if (loadConfig(path)) {
+    ConfigSynchronizer sync(path);
+    sync.start();
+    bool ready = wait_for_sync_get(client, sync_port, "");
+    std::string output;
+    std::string before = read_file(path);
+    for (int i = 0; i < count; ++i) {
+      std::vector<std::string> args;
+      args.push_back("set");
+      args.push_back(SYNC_REJECTED[i]);
+      int status = ready ? run_sync_client(client, sync_port, args, output) : -1;
+      bool unchanged = read_file(path) == before &&
+                       access(config_last_good_path(path).c_str(), F_OK) != 0;
+      bool ok = status == 2 && output.compare(0, 5, "ERROR") == 0 && unchanged;
+      std::string shown = SYNC_REJECTED[i];
+      for (size_t j = 0; j < shown.size(); ++j) {
+        if (shown[j] == '\n') shown[j] = '|';
+      }
+      printf("%-4s sync set %s -> 終了コード %d, config.ini %s\n",
+             ok ? "OK" : "FAIL", shown.c_str(), status,
+             unchanged ? "変更なし" : "変更あり");
+      if (!ok) {
+        failures++;
+      }
+    }
+    sync.stop();
+    g_config_updated_flag.store(false);
+  } else {
+    printf("FAIL 一時的な設定ファイルを読み込めない (%s)\n", path.c_str());
+    failures = count;
+  }
+  remove_sync_config(dir, path);
+  return failures;
+}
+
+// live で変えた項目 (A) が、別の項目 (B) の persist で config.ini に保存されないことを確認する
+static bool check_live_not_persisted(NetworkContext *ctx, const std::string &client) {
+  const char *live_key = "KP_YAW";              // A
+  const char *persist_key = "KP_ROLL";          // B
+  const char *live_value = "0.31";
+  const char *persist_value = "0.27";
+
+  char dir[] = "/tmp/param_check.XXXXXX";
+  std::string path;
+  int sync_port = 0;
+  if (!prepare_sync_config(dir, path, sync_port)) {
+    return false;
+  }
+  IniDocument doc;
+  doc.load(path);
+  std::string original = doc.get("THRUSTER_CONTROL", live_key);
+  bool ok = loadConfig(path);
+  if (ok) {
+    ConfigSynchronizer sync(path);
+    sync.start();
+    // 同期スレッドが読み込みを終えて待ち受けを始めてから変更する (読み込み前の変更は差分にならない)
+    ok = wait_for_sync_get(client, sync_port, "");
+    g_config_updated_flag.store(false);
+
+    std::string request = std::string("param:set,100,live,THRUSTER_CONTROL.") +
+                          live_key + "," + live_value;
+    ok = ok && starts_with(send_request(ctx, &sync, request), "param:ack,");
+    // 同期スレッドが live の変更を地上局向けに取り込んだ (get に現れた) ことを確かめてから persist する
+    ok = ok && wait_for_sync_get(client, sync_port,
+                                 std::string("[THRUSTER_CONTROL]") + live_key +
+                                     "=" + live_value);
+    request = std::string("param:set,101,persist,THRUSTER_CONTROL.") +
+              persist_key + "," + persist_value;
+    ok = ok && starts_with(send_request(ctx, &sync, request), "param:ack,");
+    // 保存するとリロードが通知される
+    std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (ok && !g_config_updated_flag.load() &&
+           std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ok = ok && g_config_updated_flag.load();
+    sync.stop();
+    g_config_updated_flag.store(false);
+
+    IniDocument saved;
+    ok = saved.load(path) && ok;
+    std::string saved_live = saved.get("THRUSTER_CONTROL", live_key);
+    std::string saved_persist = saved.get("THRUSTER_CONTROL", persist_key);
+    ok = ok && saved_live == original && saved_persist == persist_value;
+    printf("%-4s live %s=%s -> persist %s=%s: config.ini の %s=%s, %s=%s\n",
+           ok ? "OK" : "FAIL", live_key, live_value, persist_key, persist_value,
+           live_key, saved_live.c_str(), persist_key, saved_persist.c_str());
+  } else {
+    printf("FAIL 一時的な設定ファイルを読み込めない (%s)\n", path.c_str());
+  }
+  remove_sync_config(dir, path);
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  (void)argc;
+  NetworkContext ctx;
+  memset(&ctx, 0, sizeof(ctx));
+  ctx.recv_socket = -1;
+  ctx.send_socket = -1;
+  if (!open_reply_socket(&ctx)) {
+    printf("FAIL 応答を受け取るソケットを用意できない\n");
+    return 1;
+  }
+  param_protocol_init();
+
+  int failures = 0;
+  const int count = sizeof(CASES) / sizeof(CASES[0]);
+  for (int i = 0; i < count; ++i) {
+    const SetCase &c = CASES[i];
+    std::string before = current_value(c.name);
+    uint64_t rejected = g_metrics.param_rejected.load();
+
+    char request[NET_BUFFER_SIZE];
+    snprintf(request, sizeof(request), "param:set,%d,live,%s,%s", i, c.name,
+             c.value);
+    std::string reply = send_request(&ctx, nullptr, request);
+
+    std::string after = current_value(c.name);
+    bool was_rejected = g_metrics.param_rejected.load() != rejected;
+    bool ok;
+    if (c.accepted) {
+      // 反映された値を param:get で読み直して確かめる
+      std::string read = read_back(&ctx, 1000 + i, c.name);
+      ok = !was_rejected && starts_with(reply, "param:ack,") && !read.empty() &&
+           fabs(strtod(read.c_str(), nullptr) - strtod(c.value, nullptr)) < 1e-6;
+      after = read.empty() ? "読み直せない" : read;
+    } else {
+      ok = was_rejected && starts_with(reply, "param:nack,") && after == before;
+    }
+    printf("%-4s set %s=%s -> %s (%s)\n", ok ? "OK" : "FAIL", c.name, c.value,
+           was_rejected ? "拒否" : "反映", after.c_str());
+    if (!ok) {
+      failures++;
+    }
+  }
+
+  // config_sync_client はこのツールと同じディレクトリにビルドされる
+  std::string client = argv[0];
+  size_t slash = client.rfind('/');
+  client = (slash == std::string::npos ? std::string(".") : client.substr(0, slash)) +
+           "/config_sync_client";
+  if (!check_live_not_persisted(&ctx, client)) {
+    failures++;
+  }
+  failures += check_sync_rejects(client);
+
+  const int total =
+      count + 1 + static_cast<int>(sizeof(SYNC_REJECTED) / sizeof(SYNC_REJECTED[0]));
+  printf("%d/%d 件が期待どおり\n", total - failures, total);
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,213 @@
+// 稼働中の制御プロセスが共有メモリに公開している状態 (src/live_state.cpp) を読み出して表示するツール。
+// 読み出しは mmap した領域を直接参照するだけなので、制御ループに負荷をかけない。
+//
+// 使い方: rov_state [--watch [Hz]] [--json] [--name <共有メモリ名>]
+//   --watch: 指定した頻度 (既定 10 Hz) で表示し続ける (Ctrl+C で終了)。
+//            制御プロセスの起動を待ち、再起動した場合は共有メモリを開き直す
+//   --json:  1行1オブジェクトの JSON で出力する (他のツールへのパイプ用)
+//   終了コード: 0 = 成功, 1 = 共有メモリが無い、形式が一致しない、または書き込み途中で書き込み側が終了した
+#include "live_state.h" // 共有メモリのレイアウトと seqlock の読み出し
+
+#include <errno.h>    // errno
+#include <fcntl.h>    // O_RDONLY
+#include <signal.h>   // kill
+#include <stdio.h>    // printf, fprintf
+#include <stdlib.h>   // atof
+#include <string.h>   // strcmp, memcmp, strerror
+#include <sys/mman.h> // shm_open, mmap
+#include <sys/stat.h> // fstat (共有メモリの作り直しの検知)
+#include <unistd.h>   // close, usleep
+
+// 共有メモリの名前が指している実体 (inode)。無ければ 0
+static ino_t segment_inode(const char *name) {
+  int fd = shm_open(name, O_RDONLY, 0);
+  if (fd < 0) {
+    return 0;
+  }
+  struct stat st;
+  ino_t inode = fstat(fd, &st) == 0 ? st.st_ino : 0;
+  close(fd);
+  return inode;
+}
+
+// 共有メモリを開いて形式を確認する。失敗した場合は quiet でなければ理由を表示して nullptr を返す
+static const LiveStateSegment *open_segment(const char *name, ino_t *inode, bool quiet) {
+  int fd = shm_open(name, O_RDONLY, 0);
+  if (fd < 0) {
+    if (!quiet) {
+      fprintf(stderr, "共有メモリ %s を開けません: %s (制御プロセスは起動していますか?)\n", name,
+              strerror(errno));
+    }
+    return nullptr;
+  }
+  struct stat st;
+  *inode = fstat(fd, &st) == 0 ? st.st_ino : 0;
+  void *mapped = mmap(nullptr, sizeof(LiveStateSegment), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    if (!quiet) {
+      fprintf(stderr, "共有メモリをマップできません: %s\n", strerror(errno));
+    }
+    return nullptr;
+  }
+  const LiveStateSegment *segment = static_cast<const LiveStateSegment *>(mapped);
+  if (memcmp(segment->magic, LIVE_STATE_MAGIC, sizeof(segment->magic)) != 0 ||
+      segment->version != LIVE_STATE_VERSION || segment->data_size != sizeof(LiveStateData)) {
+    if (!quiet) {
+      fprintf(stderr, "共有メモリの形式が一致しません (version %u, size %u)。"
+                      "制御プロセスとこのツールを同じソースからビルドしてください。\n",
+              segment->version, segment->data_size);
+    }
+    munmap(mapped, sizeof(LiveStateSegment));
+    return nullptr;
+  }
+  return segment;
+}
+
+static void close_segment(const LiveStateSegment *segment) {
+  munmap(const_cast<LiveStateSegment *>(segment), sizeof(LiveStateSegment));
+}
+
+static void print_text(const LiveStateData &d) {
+  printf("tick %llu  period %.0f us  work %.0f us  overruns %u  failsafe %s (%u)\n",
+         static_cast<unsigned long long>(d.tick), d.tick_period_us, d.tick_work_us,
+         d.loop_overruns, d.failsafe ? "ON" : "off", d.failsafe_entries);
+  printf("gamepad  LX %6d LY %6d RX %6d RY %6d  LT %4d RT %4d  buttons 0x%04x\n",
+         d.left_thumb_x, d.left_thumb_y, d.right_thumb_x, d.right_thumb_y, d.lt, d.rt,
+         d.buttons);
+  printf("pwm     ");
+  for (int ch = 0; ch < LIVE_STATE_PWM_CHANNELS; ++ch) {
+    printf(" %4u", d.pwm_us[ch]);
+  }
+  printf("\naux     ");
+  for (int i = 0; i < LIVE_STATE_AUX_OUTPUTS; ++i) {
+    printf(" %u", d.aux_levels[i]);
+  }
+  printf("\nattitude roll %7.2f pitch %7.2f yaw %7.2f deg  %s\n", d.roll_deg, d.pitch_deg,
+         d.yaw_deg, d.inverted ? "INVERTED" : "");
+  printf("depth    %.2f m  setpoint %.2f m  hold %s  pressure %.2f\n", d.depth_m,
+         d.depth_setpoint_m, d.depth_hold_active ? "on" : "off", d.pressure);
+  printf("gyro  %8.3f %8.3f %8.3f\n", d.gyro[0], d.gyro[1], d.gyro[2]);
+  printf("accel %8.3f %8.3f %8.3f\n", d.accel[0], d.accel[1], d.accel[2]);
+  printf("mag   %8.3f %8.3f %8.3f\n", d.mag[0], d.mag[1], d.mag[2]);
+  printf("control %s\n", d.control_enabled ? "enabled" : "disabled");
+}
+
+static void print_json(const LiveStateData &d) {
+  printf("{\"tick\":%llu,\"time_ns\":%lld,\"tick_period_us\":%.1f,\"tick_work_us\":%.1f,"
+         "\"loop_overruns\":%u,\"failsafe\":%u,\"failsafe_entries\":%u,"
+         "\"control_enabled\":%u,\"depth_hold_active\":%u,\"inverted\":%u,",
+         static_cast<unsigned long long>(d.tick), static_cast<long long>(d.time_ns),
+         d.tick_period_us, d.tick_work_us, d.loop_overruns, d.failsafe, d.failsafe_entries,
+         d.control_enabled, d.depth_hold_active, d.inverted);
+  printf("\"gamepad\":{\"lx\":%d,\"ly\":%d,\"rx\":%d,\"ry\":%d,\"lt\":%d,\"rt\":%d,"
+         "\"buttons\":%u},",
+         d.left_thumb_x, d.left_thumb_y, d.right_thumb_x, d.right_thumb_y, d.lt, d.rt,
+         d.buttons);
+  printf("\"pwm_us\":[");
+  for (int ch = 0; ch < LIVE_STATE_PWM_CHANNELS; ++ch) {
+    printf("%s%u", ch ? "," : "", d.pwm_us[ch]);
+  }
+  printf("],\"aux_levels\":[");
+  for (int i = 0; i < LIVE_STATE_AUX_OUTPUTS; ++i) {
+    printf("%s%u", i ? "," : "", d.aux_levels[i]);
+  }
+  printf("],\"gyro\":[%g,%g,%g],\"accel\":[%g,%g,%g],\"mag\":[%g,%g,%g],\"pressure\":%g,",
+         d.gyro[0], d.gyro[1], d.gyro[2], d.accel[0], d.accel[1], d.accel[2], d.mag[0],
+         d.mag[1], d.mag[2], d.pressure);
+  printf("\"roll_deg\":%g,\"pitch_deg\":%g,\"yaw_deg\":%g,\"depth_m\":%g,"
+         "\"depth_setpoint_m\":%g}\n",
+         d.roll_deg, d.pitch_deg, d.yaw_deg, d.depth_m, d.depth_setpoint_m);
+}
+
+int main(int argc, char **argv) {
+  const char *name = LIVE_STATE_DEFAULT_NAME;
+  bool watch = false;
+  bool json = false;
+  double rate_hz = 10.0;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--watch") == 0) {
+      watch = true;
+      if (i + 1 < argc && argv[i + 1][0] != '-') {
+        rate_hz = atof(argv[++i]);
+      }
+    } else if (strcmp(argv[i], "--json") == 0) {
+      json = true;
+    } else if (strcmp(argv[i], "--name") == 0 && i + 1 < argc) {
+      name = argv[++i];
+    } else {
+      fprintf(stderr, "使い方: %s [--watch [Hz]] [--json] [--name <共有メモリ名>]\n", argv[0]);
+      return 1;
+    }
+  }
+  if (rate_hz <= 0.0) {
+    rate_hz = 10.0;
+  }
+
+  ino_t inode = 0;
+  const LiveStateSegment *segment = open_segment(name, &inode, false);
+  if (!segment && !watch) {
+    return 1;
+  }
+  uint32_t writer_pid = segment ? segment->writer_pid : 0;
+  if (segment && kill(static_cast<pid_t>(writer_pid), 0) != 0 && errno == ESRCH) {
+    fprintf(stderr, "警告: 書き込み側のプロセス (pid %u) は終了しています。最後の状態を表示します。\n",
+            writer_pid);
+  }
+
+  useconds_t interval_us = static_cast<useconds_t>(1000000.0 / rate_hz);
+  int status = 0;
+  do {
+    // 制御プロセスが再起動すると、共有メモリは作り直される (inode が変わる) か、
+    // 同じ領域を別のプロセスが初期化し直す (writer_pid が変わる)。どちらも開き直す
+    if (watch && segment &&
+        (segment_inode(name) != inode || segment->writer_pid != writer_pid)) {
+      close_segment(segment);
+      segment = nullptr;
+    }
+    if (!segment) {
+      segment = open_segment(name, &inode, true);
+      if (!segment) {
+        if (!json) {
+          printf("\033[H\033[2J共有メモリ %s を待っています...\n", name);
+          fflush(stdout);
+        }
+        usleep(interval_us);
+        continue;
+      }
+      writer_pid = segment->writer_pid;
+    }
+
+    LiveStateData data;
+    if (!live_state_read(segment, &data)) {
+      // 書き込み側が書き込み途中で終了した (seq が奇数のまま)
+      if (!watch) {
+        fprintf(stderr, "共有メモリを読み出せません (書き込み側のプロセス pid %u が書き込み途中で停止しています)。\n",
+                segment->writer_pid);
+        status = 1;
+        break;
+      }
+      close_segment(segment);
+      segment = nullptr;
+      usleep(interval_us);
+      continue;
+    }
+    if (json) {
+      print_json(data);
+    } else {
+      if (watch) {
+        printf("\033[H\033[2J"); // 画面を消去して先頭から表示する
+      }
+      print_text(data);
+    }
+    fflush(stdout);
+    if (watch) {
+      usleep(interval_us);
+    }
+  } while (watch);
+
+  if (segment) {
+    close_segment(segment);
+  }
+  return status;
+}
@@ -0,0 +1,46 @@
+#include "sim_hardware.h"
+
+SimHardwareState g_sim_hardware = {{0.0f, 0.0f, 0.0f},
+                                   {0.0f, 0.0f, 1.0f},
+                                   {0.0f, 0.0f, 0.0f},
+                                   0.0f,
+                                   0.0f,
+                                   false,
+                                   {0.0f, 0.0f, 0.0f, 0.0f},
+                                   false,
+                                   0.0f,
+                                   {0.0f},
+                                   0};
+
+// --- bindings.h の関数のシミュレーション実装 ---
+
+void init(void) {}
+
+float read_temp(void) { return g_sim_hardware.temperature; }
+
+float read_pressure(void) { return g_sim_hardware.pressure; }
+
+bool read_leak(void) { return g_sim_hardware.leak; }
+
+void read_adc_all(float *into, uintptr_t size) {
+  for (uintptr_t i = 0; i < size; ++i) {
+    into[i] = (i < 4) ? g_sim_hardware.adc[i] : 0.0f;
+  }
+}
+
+AxisData read_accel(void) { return g_sim_hardware.accel; }
+
+AxisData read_gyro(void) { return g_sim_hardware.gyro; }
+
+AxisData read_mag(void) { return g_sim_hardware.mag; }
+
+void set_pwm_enable(bool state) { g_sim_hardware.pwm_enabled = state; }
+
+void set_pwm_freq_hz(float freq) { g_sim_hardware.pwm_freq_hz = freq; }
+
+void set_pwm_channel_duty_cycle(uintptr_t channel, float duty_cycle) {
+  if (channel < 16) {
+    g_sim_hardware.pwm_duty[channel] = duty_cycle;
+  }
+  g_sim_hardware.pwm_writes++;
+}
@@ -0,0 +1,26 @@
+#ifndef SIM_HARDWARE_H // インクルードガード
+#define SIM_HARDWARE_H
+
+#include "bindings.h" // AxisData 構造体と、このシミュレーターが実装する関数の宣言
+
+// Navigator ハードウェアライブラリ (libbluerobotics_navigator) の代わりにリンクする
+// シミュレーション層。read_* はここに設定した値を返し、PWM の出力は記録するだけ。
+// リプレイツールやベンチマークなど、実機なしで制御コードを動かすときに使用する。
+struct SimHardwareState {
+  AxisData gyro;
+  AxisData accel;
+  AxisData mag;
+  float pressure;
+  float temperature;
+  bool leak;
+  float adc[4];
+  bool pwm_enabled;
+  float pwm_freq_hz;
+  float pwm_duty[16];          // set_pwm_channel_duty_cycle で設定された値
+  unsigned long pwm_writes;    // set_pwm_channel_duty_cycle の呼び出し回数
+};
+
+// シミュレーション層の状態 (テストコードから直接読み書きする)
+extern SimHardwareState g_sim_hardware;
+
+#endif // SIM_HARDWARE_H